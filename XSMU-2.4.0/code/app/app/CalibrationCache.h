@@ -0,0 +1,119 @@
+#ifndef __SMU_CALIBRATION_CACHE__
+#define __SMU_CALIBRATION_CACHE__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+namespace smu {
+
+/*
+ * Calibration tables and hardware version of one SMU, as last read
+ * from it, kept on disk so that the next open need not read them again.
+ *
+ * The file is named after the SMU's serial number, and holds good only
+ * while the SMU's firmware version and calibration checksum are those
+ * it was saved with. Points are kept by meter, range and index, as
+ * pairs of a DAC or ADC code and a value.
+ *
+ * Not thread safe; the caller serialises access.
+ */
+class CalibrationCache
+{
+	public:
+	enum Meter
+	{
+		CS,
+		VS,
+		CM,
+		VM,
+		VM2,
+		METERS,
+	};
+
+	CalibrationCache (void);
+
+	public:
+	/**** Forgets all points, and starts afresh for the given SMU ****/
+	void reset (const std::string& serialNo, uint32_t firmware,
+				uint32_t checksum);
+
+	/*
+	 * As reset(), then reads the SMU's file, if any. Returns whether
+	 * it was read, and made for this firmware and checksum.
+	 */
+	bool load (const std::string& serialNo, uint32_t firmware,
+			   uint32_t checksum);
+
+	/*
+	 * Writes the file, under checksum, which the SMU should have
+	 * reported since it last changed. Replaces any older file in
+	 * one go, so that readers never see half of one.
+	 */
+	bool save (uint32_t checksum);
+
+	/**** Whether anything has changed since load() ****/
+	bool dirty (void) const { return dirty_; }
+
+	/**** The SMU's checksum, as of load() or save() ****/
+	uint32_t checksum (void) const { return checksum_; }
+
+	/**** Whether the SMU has changed since its checksum was taken ****/
+	bool stale (void) const { return stale_; }
+
+	public:
+	bool lookup (Meter meter, uint16_t range, uint16_t index,
+				 int32_t* code, float* value) const;
+
+	void store (Meter meter, uint16_t range, uint16_t index,
+				int32_t code, float value);
+
+	/**** Forgets a range's points, which the SMU has replaced ****/
+	void invalidate (Meter meter, uint16_t range);
+
+	/**** As above, for all of a meter's ranges ****/
+	void invalidate (Meter meter);
+
+	public:
+	bool hardwareVersion (uint32_t* version) const;
+	void setHardwareVersion (uint32_t version);
+	void invalidateHardwareVersion (void);
+
+	public:
+	/*
+	 * $XSMU_CACHE_DIR, else xsmu under $XDG_CACHE_HOME or ~/.cache,
+	 * or under %LOCALAPPDATA% on Windows. Empty if none is set.
+	 */
+	static std::string directory (void);
+
+	std::string path (void) const;
+
+	private:
+	struct Point
+	{
+		int32_t code;
+		float value;
+	};
+
+	static uint32_t key (Meter meter, uint16_t range, uint16_t index) {
+		return ((uint32_t) meter << 24) | ((uint32_t) range << 16) | index;
+	}
+
+	bool read (const std::string& path);
+
+	private:
+	std::string serialNo_;
+	uint32_t firmware_;
+	uint32_t checksum_;
+
+	std::map<uint32_t, Point> points_;
+	bool haveHardwareVersion_;
+	uint32_t hardwareVersion_;
+
+	bool dirty_;                  // Differs from the file
+	bool stale_;                  // checksum_ no longer describes the SMU
+};
+
+} // end of namespace smu
+
+#endif
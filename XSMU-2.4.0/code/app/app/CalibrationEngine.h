@@ -0,0 +1,82 @@
+#ifndef __SMU_CALIBRATION_ENGINE__
+#define __SMU_CALIBRATION_ENGINE__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * Converts ADC codes to readings, in bulk, by a piecewise linear map
+ * per range, precomputed from the range's calibration table.
+ *
+ * Points come in one at a time, as the SMU reports them. Until all of a
+ * range's points are in, its codes pass through unconverted, as they
+ * did before there was an engine.
+ *
+ * convert() picks each code's segment by comparing it with the points
+ * in between, and interpolates from the segment's lower point. With
+ * AVX2 or SSE2 enabled at compile time, it does so 8 or 4 codes at a
+ * time, by the same arithmetic as the scalar code.
+ *
+ * Not thread safe; the caller serialises access.
+ */
+class CalibrationEngine
+{
+	public:
+	enum
+	{
+		MAX_RANGES = 8,
+		MAX_POINTS = 8,
+	};
+
+	CalibrationEngine (uint8_t points);
+
+	public:
+	uint8_t points (void) const { return points_; }
+
+	void setPoint (uint8_t range, uint8_t index, int32_t adc, float value);
+
+	/**** Forgets a range's points, which the SMU has replaced ****/
+	void invalidate (uint8_t range);
+
+	/**** Whether all of a range's points are in ****/
+	bool calibrated (uint8_t range) const;
+
+	void convert (uint8_t range, const int32_t* adc,
+				  float* values, size_t n) const;
+
+	private:
+	struct Point
+	{
+		int32_t adc;
+		float value;
+	};
+
+	/*
+	 * Segment i starts at code adc[i], where it reads value[i],
+	 * and rises by slope[i] per code. Segment 0 also covers codes
+	 * below the table, and the last one codes above it.
+	 */
+	struct Map
+	{
+		uint8_t segments;
+		int32_t adc[MAX_POINTS];
+		float value[MAX_POINTS];
+		float slope[MAX_POINTS];
+	};
+
+	void build (uint8_t range);
+	static void convert (const Map& map, const int32_t* adc,
+						 float* values, size_t n);
+
+	private:
+	uint8_t points_;
+	Point table_[MAX_RANGES][MAX_POINTS];
+	uint32_t known_[MAX_RANGES];       // Bit per point received
+	Map maps_[MAX_RANGES];
+};
+
+} // end of namespace smu
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "../../sys/sys/QP4.h"
 #include "../../sys/sys/FTDI.h"
+#include "../../sys/sys/Transport.h"
 #include "../../sys/sys/Applet.h"
 #include "../../stl/inet"
 
@@ -10,6 +11,9 @@
 #include <stdint.h>
 #include <string>
 #include <cstddef>
+#include <cstring>
+#include <deque>
+#include <chrono>
 #include <mutex>
 
 namespace smu{
@@ -71,6 +75,13 @@ enum Comm_Opcode
 	COMM_OPCODE_REC_DATA,                                           //45
 	COMM_OPCODE_START_REC,                                          //46
 	COMM_OPCODE_STOP_REC,                                           //47
+	COMM_OPCODE_START_REC_PUSH,                                     //48
+	COMM_OPCODE_REC_PUSH_DATA,                                      //49
+	COMM_OPCODE_CALIBRATION_CHECKSUM,                               //50
+	COMM_OPCODE_GET_CALIBRATION_TABLES,                             //51
+	COMM_OPCODE_SYSTEM_CONFIG_GET_LIST,                             //52
+	COMM_OPCODE_SOURCE_MEASURE,                                     //53
+	COMM_OPCODE_BURST_READ,                                         //54
 };
 
 enum Comm_SourceMode
@@ -139,8 +150,24 @@ enum Comm_VM_Terminal
 
 Comm_VM_Terminal toComm_VM_Terminal (uint16_t i);
 
+/**** Meters whose calibration tables are read in bulk ****/
+enum Comm_Meter
+{
+	COMM_METER_CS,
+	COMM_METER_VS,
+	COMM_METER_CM,
+	COMM_METER_VM,
+	COMM_METER_VM2,
+};
+
 /************************************************************************/
 
+/*
+ * Every packet begins with an opcode and a reserve word. Comm tags each
+ * request in the reserve word, and firmware that copies it into the
+ * response lets Comm match responses by tag; firmware that leaves it
+ * zero is matched by order instead.
+ */
 class CommPacket
 {
 protected:
@@ -152,6 +179,9 @@ protected:
 public:
 	uint16_t opcode (void) const { return smu::ntoh (opcode_); }
 
+	uint16_t tag (void) const { return smu::ntoh (reserve_); }
+	void tag (uint16_t tag) { reserve_ = smu::hton (tag); }
+
 private:
 	uint16_t opcode_;
 	uint16_t reserve_;
@@ -1678,12 +1708,18 @@ public:
         return smu::ntoh(recData_[idx]);
 	}
 
+	/**** Samples in network order, as received ****/
+	const void* rawData (void) const {return recData_;}
+
 private:
 	uint16_t size_;
 	uint16_t reserve_;
 	int32_t recData_[];
 };
 
+/**** Most samples a single QP4 frame carries in a recData response ****/
+enum {COMM_REC_DATA_MAX_SAMPLES = (1024 - 2 * sizeof (uint32_t)) / sizeof (int32_t)};
+
 /************************************************************************/
 
 class CommPacket_StartRec : public CommPacket
@@ -1728,6 +1764,322 @@ private:
 	CommResponse_StopRec (void);
 };
 
+/************************************************************************/
+
+class CommPacket_StartRecPush : public CommPacket
+{
+protected:
+	CommPacket_StartRecPush (void) :
+		CommPacket (COMM_OPCODE_START_REC_PUSH)
+	{}
+};
+
+class CommRequest_StartRecPush : public CommPacket_StartRecPush
+{
+public:
+	CommRequest_StartRecPush (uint16_t chunkSize) :
+		chunkSize_ (smu::hton (chunkSize)),
+		reserve_ (0)
+	{}
+
+private:
+	uint16_t chunkSize_;
+	uint16_t reserve_;
+};
+
+class CommResponse_StartRecPush : public CommPacket_StartRecPush
+{
+private:
+	CommResponse_StartRecPush (void);
+
+public:
+	uint16_t chunkSize (void) const {return smu::ntoh(chunkSize_);}
+
+private:
+	uint16_t chunkSize_;
+	uint16_t reserve_;
+};
+
+/************************************************************************/
+
+/*
+ * Sent by the SMU on its own, once chunkSize samples are ready, while
+ * recording in push mode. Laid out as a recData response, with the
+ * reserve word numbering the frames so that losses show.
+ */
+class CommPacket_recPushData : public CommPacket
+{
+protected:
+	CommPacket_recPushData (void) :
+		CommPacket (COMM_OPCODE_REC_PUSH_DATA)
+	{}
+};
+
+class CommResponse_recPushData : public CommPacket_recPushData
+{
+private:
+	CommResponse_recPushData (void);
+
+public:
+	uint16_t size (void) const {return smu::ntoh(size_);}
+	uint16_t sequence (void) const {return smu::ntoh(sequence_);}
+
+	/**** Samples in network order, as received ****/
+	const void* rawData (void) const {return recData_;}
+
+private:
+	uint16_t size_;
+	uint16_t sequence_;
+	int32_t recData_[];
+};
+
+/************************************************************************/
+
+/*
+ * A checksum over the SMU's calibration tables, of every meter and
+ * range, and its system configuration. Any change to either changes
+ * it, so that a copy kept by the host may be checked in one go.
+ */
+class CommPacket_CalibrationChecksum : public CommPacket
+{
+protected:
+	CommPacket_CalibrationChecksum (void) :
+		CommPacket (COMM_OPCODE_CALIBRATION_CHECKSUM)
+	{}
+};
+
+class CommRequest_CalibrationChecksum : public CommPacket_CalibrationChecksum
+{
+public:
+	CommRequest_CalibrationChecksum (void) {}
+};
+
+class CommResponse_CalibrationChecksum : public CommPacket_CalibrationChecksum
+{
+private:
+	CommResponse_CalibrationChecksum (void);
+
+public:
+	uint32_t checksum (void) const {return smu::ntoh(checksum_);}
+
+private:
+	uint32_t checksum_;
+};
+
+/************************************************************************/
+
+/*
+ * The calibration tables of every range of a meter, in one frame,
+ * range after range, each point a code and a value.
+ */
+class CommPacket_GetCalibrationTables : public CommPacket
+{
+protected:
+	CommPacket_GetCalibrationTables (void) :
+		CommPacket (COMM_OPCODE_GET_CALIBRATION_TABLES)
+	{}
+};
+
+class CommRequest_GetCalibrationTables : public CommPacket_GetCalibrationTables
+{
+public:
+	CommRequest_GetCalibrationTables (Comm_Meter meter) :
+		meter_ (smu::hton ((uint16_t) meter)),
+		reserve_ (0)
+	{}
+
+private:
+	uint16_t meter_;
+	uint16_t reserve_;
+};
+
+class CommResponse_GetCalibrationTables : public CommPacket_GetCalibrationTables
+{
+private:
+	CommResponse_GetCalibrationTables (void);
+
+public:
+	uint16_t meter  (void) const {return smu::ntoh(meter_);}
+	uint16_t ranges (void) const {return smu::ntoh(ranges_);}
+	uint16_t points (void) const {return smu::ntoh(points_);}
+
+	/**** Points in network order, as received ****/
+	const void* rawPoints (void) const {return points__;}
+
+private:
+	uint16_t meter_;
+	uint16_t ranges_;
+	uint16_t points_;
+	uint16_t reserve_;
+	int32_t points__[];
+};
+
+/************************************************************************/
+
+/*
+ * Any number of system configuration parameters in one frame. The
+ * firmware takes requests of up to 32 bytes, which limits the count.
+ */
+enum {COMM_SYSTEM_CONFIG_LIST_MAX = (32 - 2 * sizeof (uint32_t)) / sizeof (int16_t)};
+
+class CommPacket_SystemConfig_GetList : public CommPacket
+{
+protected:
+	CommPacket_SystemConfig_GetList (void) :
+		CommPacket (COMM_OPCODE_SYSTEM_CONFIG_GET_LIST)
+	{}
+};
+
+class CommRequest_SystemConfig_GetList : public CommPacket_SystemConfig_GetList
+{
+public:
+	CommRequest_SystemConfig_GetList (uint16_t count, const int16_t* paramIDs) :
+		count_ (smu::hton (count)),
+		reserve_ (0)
+	{
+		for (uint16_t i = 0; i < COMM_SYSTEM_CONFIG_LIST_MAX; ++i)
+			paramIDs_[i] = smu::hton ((i < count) ? paramIDs[i] : (int16_t) 0);
+	}
+
+private:
+	uint16_t count_;
+	uint16_t reserve_;
+	int16_t paramIDs_[COMM_SYSTEM_CONFIG_LIST_MAX];
+};
+
+class CommResponse_SystemConfig_GetList : public CommPacket_SystemConfig_GetList
+{
+private:
+	CommResponse_SystemConfig_GetList (void);
+
+public:
+	uint16_t count (void) const {return smu::ntoh(count_);}
+
+	/**** paramID and value pairs in network order, as received ****/
+	const void* rawValues (void) const {return values_;}
+
+private:
+	uint16_t count_;
+	uint16_t reserve_;
+	int16_t values_[];
+};
+
+/************************************************************************/
+
+/*
+ * Sets the current or voltage source, waits settlingTime microseconds,
+ * then reads a meter, all on the SMU. The response holds the value the
+ * source applied and the reading.
+ */
+class CommPacket_SourceMeasure : public CommPacket
+{
+protected:
+	CommPacket_SourceMeasure (void) :
+		CommPacket (COMM_OPCODE_SOURCE_MEASURE)
+	{}
+};
+
+class CommRequest_SourceMeasure : public CommPacket_SourceMeasure
+{
+public:
+	CommRequest_SourceMeasure (Comm_SourceMode source, float value,
+							   uint32_t settlingTime, Comm_Meter meter,
+							   uint16_t filterLength) :
+		source_ (smu::hton ((uint16_t) source)),
+		meter_ (smu::hton ((uint16_t) meter)),
+		value_ (smu::hton (value)),
+		settlingTime_ (smu::hton (settlingTime)),
+		filterLength_ (smu::hton (filterLength)),
+		reserve_ (0)
+	{}
+
+private:
+	uint16_t source_;
+	uint16_t meter_;
+	float value_;
+	uint32_t settlingTime_;
+	uint16_t filterLength_;
+	uint16_t reserve_;
+};
+
+class CommResponse_SourceMeasure : public CommPacket_SourceMeasure
+{
+private:
+	CommResponse_SourceMeasure (void);
+
+public:
+	uint16_t source  (void) const {return smu::ntoh(source_);}
+	uint16_t meter   (void) const {return smu::ntoh(meter_);}
+	float    value   (void) const {return smu::ntoh(value_);}
+	float    reading (void) const {return smu::ntoh(reading_);}
+
+private:
+	uint16_t source_;
+	uint16_t meter_;
+	float value_;
+	float reading_;
+};
+
+/************************************************************************/
+
+/*
+ * count consecutive filtered readings of a meter, on its present range
+ * and terminal. The firmware answers with as many frames as it takes,
+ * each carrying the offset of its first reading and the total, and
+ * sends each one as soon as it fills.
+ */
+class CommPacket_BurstRead : public CommPacket
+{
+protected:
+	CommPacket_BurstRead (void) :
+		CommPacket (COMM_OPCODE_BURST_READ)
+	{}
+};
+
+class CommRequest_BurstRead : public CommPacket_BurstRead
+{
+public:
+	CommRequest_BurstRead (Comm_Meter meter, uint16_t filterLength,
+						   uint32_t count) :
+		meter_ (smu::hton ((uint16_t) meter)),
+		filterLength_ (smu::hton (filterLength)),
+		count_ (smu::hton (count))
+	{}
+
+private:
+	uint16_t meter_;
+	uint16_t filterLength_;
+	uint32_t count_;
+};
+
+class CommResponse_BurstRead : public CommPacket_BurstRead
+{
+private:
+	CommResponse_BurstRead (void);
+
+public:
+	uint16_t meter  (void) const {return smu::ntoh(meter_);}
+	uint16_t size   (void) const {return smu::ntoh(size_);}
+	uint32_t offset (void) const {return smu::ntoh(offset_);}
+	uint32_t total  (void) const {return smu::ntoh(total_);}
+
+	/**** Whether no more frames follow ****/
+	bool last (void) const {return offset() + size() >= total();}
+
+	/**** Readings in network order, as received ****/
+	const void* rawReadings (void) const {return readings_;}
+
+private:
+	uint16_t meter_;
+	uint16_t size_;
+	uint32_t offset_;
+	uint32_t total_;
+	float readings_[];
+};
+
+/**** Most readings a single QP4 frame carries in a BurstRead response ****/
+enum {COMM_BURST_READ_MAX_READINGS = (1024 - 4 * sizeof (uint32_t)) / sizeof (float)};
+
 /************************************************************************/
 /************************************************************************/
 
@@ -1792,6 +2144,13 @@ enum Comm_CallbackCode
 	COMM_CBCODE_REC_DATA,                                     //45
 	COMM_CBCODE_START_REC,                                    //46
 	COMM_CBCODE_STOP_REC,                                     //47
+	COMM_CBCODE_START_REC_PUSH,                               //48
+	COMM_CBCODE_REC_PUSH_DATA,                                //49
+	COMM_CBCODE_CALIBRATION_CHECKSUM,                         //50
+	COMM_CBCODE_GET_CALIBRATION_TABLES,                       //51
+	COMM_CBCODE_SYSTEM_CONFIG_GET_LIST,                       //52
+	COMM_CBCODE_SOURCE_MEASURE,                               //53
+	COMM_CBCODE_BURST_READ,                                   //54
 };
 
 /************************************************************************/
@@ -1801,14 +2160,31 @@ class CommCB
 {
 protected:
 	CommCB (Comm_CallbackCode code) :
-		code_ (code)
+		code_ (code),
+		tag_ (0)
 	{}
 
 public:
 	Comm_CallbackCode code (void) const {return code_;}
 
+	/**** Tag of the request answered, or 0 if sent unasked ****/
+	uint16_t tag (void) const {return tag_;}
+	void tag (uint16_t tag) {tag_ = tag;}
+
 private:
 	Comm_CallbackCode code_;
+	uint16_t tag_;
+};
+
+/************************************************************************/
+
+/**** The SMU's answer to a request it does not know ****/
+class CommCB_NOP : public CommCB
+{
+public:
+	CommCB_NOP (void) :
+		CommCB (COMM_CBCODE_NOP)
+	{}
 };
 
 /************************************************************************/
@@ -2564,20 +2940,28 @@ private:
 class CommCB_recData : public CommCB
 {
 public:
-	CommCB_recData (uint16_t size, std::vector<int32_t> recData) :
+	CommCB_recData (uint16_t size, const void* recData) :
 		CommCB (COMM_CBCODE_REC_DATA),
 		size_ (size),
 		recData_ (recData)
-
 	{}
 
 public:
 	uint16_t size (void) const {return size_;}
-	std::vector<int32_t> recData (void) const {return recData_;}
+
+	/*
+	 * The samples are left in the received frame, and are only valid
+	 * during the callback. Converts them into dst, which must have
+	 * room for size() of them.
+	 */
+	void recData (int32_t* dst) const {smu::ntoh (dst, recData_, size_);}
+
+	/* The samples as received, in network order */
+	const void* rawData (void) const {return recData_;}
 
 private:
 	uint16_t size_;
-	std::vector<int32_t> recData_;
+	const void* recData_;
 };
 
 /************************************************************************/
@@ -2599,6 +2983,191 @@ public:
 		CommCB (COMM_CBCODE_STOP_REC)
 	{}
 };
+
+/************************************************************************/
+
+class CommCB_StartRecPush : public CommCB
+{
+public:
+	CommCB_StartRecPush (uint16_t chunkSize) :
+		CommCB (COMM_CBCODE_START_REC_PUSH),
+		chunkSize_ (chunkSize)
+	{}
+
+public:
+	uint16_t chunkSize (void) const {return chunkSize_;}
+
+private:
+	uint16_t chunkSize_;
+};
+
+/************************************************************************/
+
+class CommCB_recPushData : public CommCB
+{
+public:
+	CommCB_recPushData (uint16_t size, uint16_t sequence,
+						const void* recData) :
+		CommCB (COMM_CBCODE_REC_PUSH_DATA),
+		size_ (size),
+		sequence_ (sequence),
+		recData_ (recData)
+	{}
+
+public:
+	uint16_t size (void) const {return size_;}
+	uint16_t sequence (void) const {return sequence_;}
+
+	/* The samples as received, in network order, valid during the callback */
+	const void* rawData (void) const {return recData_;}
+
+private:
+	uint16_t size_;
+	uint16_t sequence_;
+	const void* recData_;
+};
+
+/************************************************************************/
+
+class CommCB_CalibrationChecksum : public CommCB
+{
+public:
+	CommCB_CalibrationChecksum (uint32_t checksum) :
+		CommCB (COMM_CBCODE_CALIBRATION_CHECKSUM),
+		checksum_ (checksum)
+	{}
+
+public:
+	uint32_t checksum (void) const {return checksum_;}
+
+private:
+	uint32_t checksum_;
+};
+
+/************************************************************************/
+
+class CommCB_GetCalibrationTables : public CommCB
+{
+public:
+	CommCB_GetCalibrationTables (uint16_t meter, uint16_t ranges,
+								 uint16_t points, const void* rawPoints) :
+		CommCB (COMM_CBCODE_GET_CALIBRATION_TABLES),
+		meter_ (meter),
+		ranges_ (ranges),
+		points_ (points),
+		rawPoints_ (reinterpret_cast<const int32_t*> (rawPoints))
+	{}
+
+public:
+	uint16_t meter  (void) const {return meter_;}
+	uint16_t ranges (void) const {return ranges_;}
+	uint16_t points (void) const {return points_;}
+
+	/**** Valid during the callback ****/
+	int32_t code (uint16_t range, uint16_t index) const {
+		return smu::ntoh (rawPoints_[2 * (range * points_ + index)]);
+	}
+
+	float value (uint16_t range, uint16_t index) const {
+		float x;
+		memcpy (&x, &rawPoints_[2 * (range * points_ + index) + 1], sizeof (x));
+		return smu::ntoh (x);
+	}
+
+private:
+	uint16_t meter_;
+	uint16_t ranges_;
+	uint16_t points_;
+	const int32_t* rawPoints_;
+};
+
+/************************************************************************/
+
+class CommCB_SystemConfig_GetList : public CommCB
+{
+public:
+	CommCB_SystemConfig_GetList (uint16_t count, const void* rawValues) :
+		CommCB (COMM_CBCODE_SYSTEM_CONFIG_GET_LIST),
+		count_ (count),
+		rawValues_ (reinterpret_cast<const int16_t*> (rawValues))
+	{}
+
+public:
+	uint16_t count (void) const {return count_;}
+
+	/**** Valid during the callback ****/
+	int16_t paramID (uint16_t i) const {return smu::ntoh (rawValues_[2 * i]);}
+	int16_t value   (uint16_t i) const {return smu::ntoh (rawValues_[2 * i + 1]);}
+
+private:
+	uint16_t count_;
+	const int16_t* rawValues_;
+};
+
+/************************************************************************/
+
+class CommCB_SourceMeasure : public CommCB
+{
+public:
+	CommCB_SourceMeasure (uint16_t source, uint16_t meter,
+						  float value, float reading) :
+		CommCB (COMM_CBCODE_SOURCE_MEASURE),
+		source_ (source),
+		meter_ (meter),
+		value_ (value),
+		reading_ (reading)
+	{}
+
+public:
+	Comm_SourceMode source (void) const {return toComm_SourceMode (source_);}
+	uint16_t meter (void) const {return meter_;}
+	float value (void) const {return value_;}
+	float reading (void) const {return reading_;}
+
+private:
+	uint16_t source_;
+	uint16_t meter_;
+	float value_;
+	float reading_;
+};
+
+/************************************************************************/
+
+class CommCB_BurstRead : public CommCB
+{
+public:
+	CommCB_BurstRead (uint16_t meter, uint16_t size, uint32_t offset,
+					  uint32_t total, const void* rawReadings) :
+		CommCB (COMM_CBCODE_BURST_READ),
+		meter_ (meter),
+		size_ (size),
+		offset_ (offset),
+		total_ (total),
+		rawReadings_ (reinterpret_cast<const uint8_t*> (rawReadings))
+	{}
+
+public:
+	uint16_t meter  (void) const {return meter_;}
+	uint16_t size   (void) const {return size_;}
+	uint32_t offset (void) const {return offset_;}
+	uint32_t total  (void) const {return total_;}
+
+	bool last (void) const {return offset_ + size_ >= total_;}
+
+	/**** Valid during the callback ****/
+	float reading (uint16_t idx) const {
+		float x;
+		memcpy (&x, rawReadings_ + idx * sizeof (x), sizeof (x));
+		return smu::ntoh (x);
+	}
+
+private:
+	uint16_t meter_;
+	uint16_t size_;
+	uint32_t offset_;
+	uint32_t total_;
+	const uint8_t* rawReadings_;
+};
 /************************************************************************/
 /************************************************************************/
 
@@ -2613,6 +3182,13 @@ union CommCB_Union
 	char gen6[sizeof (CommCB_recData)];
 	char gen7[sizeof (CommCB_StartRec)];
 	char gen8[sizeof (CommCB_StopRec)];
+	char gen9[sizeof (CommCB_StartRecPush)];
+	char gen10[sizeof (CommCB_recPushData)];
+	char gen11[sizeof (CommCB_CalibrationChecksum)];
+	char gen12[sizeof (CommCB_GetCalibrationTables)];
+	char gen13[sizeof (CommCB_SystemConfig_GetList)];
+	char gen14[sizeof (CommCB_SourceMeasure)];
+	char gen15[sizeof (CommCB_BurstRead)];
 
 	char cs0[sizeof (CommCB_CS_SetRange)];
 	char cs1[sizeof (CommCB_CS_GetCalibration)];
@@ -2665,6 +3241,37 @@ union CommCB_Union
 /************************************************************************/
 /************************************************************************/
 
+/*
+ * When Comm writes queued requests to the transport. Requests queued
+ * while a write is in progress always go out together in the next one.
+ * Besides, a request may be held back up to maxDelay seconds for others
+ * to join it, unless maxBytes are already pending or someone is waiting
+ * for a response.
+ */
+class Comm_TransmitPolicy
+{
+	public:
+	Comm_TransmitPolicy (void) :
+		maxDelay_ (0),
+		maxBytes_ (4096)
+	{}
+
+	public:
+	double   maxDelay (void) const { return maxDelay_; }
+	uint32_t maxBytes (void) const { return maxBytes_; }
+
+	public:
+	void maxDelay (double delay)    { maxDelay_ = delay; }
+	void maxBytes (uint32_t bytes)  { maxBytes_ = bytes; }
+
+	private:
+	double   maxDelay_;
+	uint32_t maxBytes_;
+};
+
+/************************************************************************/
+/************************************************************************/
+
 class Comm : public Applet
 {
 public:
@@ -2678,91 +3285,143 @@ public:
 	void open  (const char* serialNo);
 	void close (void);
 
+	/*
+	 * open() picks a transport by the form of its argument:
+	 * "/dev/..." opens a tty through the kernel driver, "loop:"
+	 * an in-memory loopback, "sim:" the firmware simulator, and
+	 * anything else an FTDI serial number through libftdi. A
+	 * transport attached beforehand is used instead, and owned
+	 * by Comm from then on.
+	 */
+public:
+	void attach (Transport* transport);
+	int pollfd (void) const;
+
+	/*
+	 * While a transport is open, a receive thread parses whatever
+	 * arrives and delivers the callbacks, so responses complete as
+	 * soon as they are off the wire. check() drains the transport
+	 * synchronously, and is only needed without that thread.
+	 */
 public:
 	void check (void);
-	void transmitIdentify (void);
-	void transmit_keepAlive (uint32_t lease_time_ms);
-	void transmitSourceMode (Comm_SourceMode mode);
+
+	/*
+	 * Each transmit returns the tag of the request it sent,
+	 * which the response's CommCB carries back.
+	 */
+public:
+	/**** Whether a tagged request is still awaiting its response ****/
+	bool pending (uint16_t tag);
+
+public:
+	uint16_t transmitIdentify (void);
+	uint16_t transmit_keepAlive (uint32_t lease_time_ms);
+	uint16_t transmitSourceMode (Comm_SourceMode mode);
 
 	/********************************/
 
-	void transmit_CS_setRange            (Comm_CS_Range range);
-	void transmit_CS_getCalibration      (uint16_t index);
-	void transmit_CS_verifyCalibration   (uint16_t index);
-	void transmit_CS_setCalibration      (uint16_t index, float current);
-	void transmit_CS_saveCalibration     (void);
-	void transmit_CS_setCurrent          (float current);
+	uint16_t transmit_CS_setRange            (Comm_CS_Range range);
+	uint16_t transmit_CS_getCalibration      (uint16_t index);
+	uint16_t transmit_CS_verifyCalibration   (uint16_t index);
+	uint16_t transmit_CS_setCalibration      (uint16_t index, float current);
+	uint16_t transmit_CS_saveCalibration     (void);
+	uint16_t transmit_CS_setCurrent          (float current);
 
 	/********************************/
 
-	void transmit_VS_setRange            (Comm_VS_Range range);
-	void transmit_VS_getCalibration      (uint16_t index);
-	void transmit_VS_verifyCalibration   (uint16_t index);
-	void transmit_VS_setCalibration      (uint16_t index, float voltage);
-	void transmit_VS_saveCalibration     (void);
-	void transmit_VS_setVoltage          (float voltage);
+	uint16_t transmit_VS_setRange            (Comm_VS_Range range);
+	uint16_t transmit_VS_getCalibration      (uint16_t index);
+	uint16_t transmit_VS_verifyCalibration   (uint16_t index);
+	uint16_t transmit_VS_setCalibration      (uint16_t index, float voltage);
+	uint16_t transmit_VS_saveCalibration     (void);
+	uint16_t transmit_VS_setVoltage          (float voltage);
 
 	/********************************/
 
-	void transmit_CM_setRange            (Comm_CM_Range range);
-	void transmit_CM_getCalibration      (uint16_t index);
-	void transmit_CM_setCalibration      (uint16_t index, float current);
-	void transmit_CM_saveCalibration     (void);
-	void transmit_CM_read                (uint16_t filterLength);
+	uint16_t transmit_CM_setRange            (Comm_CM_Range range);
+	uint16_t transmit_CM_getCalibration      (uint16_t index);
+	uint16_t transmit_CM_setCalibration      (uint16_t index, float current);
+	uint16_t transmit_CM_saveCalibration     (void);
+	uint16_t transmit_CM_read                (uint16_t filterLength);
 
 	/********************************/
 
-	void transmit_VM_setRange            (Comm_VM_Range range);
-	void transmit_VM_getCalibration      (uint16_t index);
-	void transmit_VM_setCalibration      (uint16_t index, float voltage);
-	void transmit_VM_saveCalibration     (void);
-	void transmit_VM_read                (uint16_t filterLength);
+	uint16_t transmit_VM_setRange            (Comm_VM_Range range);
+	uint16_t transmit_VM_getCalibration      (uint16_t index);
+	uint16_t transmit_VM_setCalibration      (uint16_t index, float voltage);
+	uint16_t transmit_VM_saveCalibration     (void);
+	uint16_t transmit_VM_read                (uint16_t filterLength);
 
 	/********************************/
 
-	void transmit_CS_loadDefaultCalibration (void);
-	void transmit_VS_loadDefaultCalibration (void);
-	void transmit_CM_loadDefaultCalibration (void);
-	void transmit_VM_loadDefaultCalibration (void);
+	uint16_t transmit_CS_loadDefaultCalibration (void);
+	uint16_t transmit_VS_loadDefaultCalibration (void);
+	uint16_t transmit_CM_loadDefaultCalibration (void);
+	uint16_t transmit_VM_loadDefaultCalibration (void);
 
 	/********************************/
 
-	void transmit_RM_readAutoscale (uint16_t filterLength);
+	uint16_t transmit_RM_readAutoscale (uint16_t filterLength);
 
 	/********************************/
 
-	void transmit_SystemConfig_Get (uint16_t paramID);
-	void transmit_SystemConfig_Set (uint16_t paramID, int16_t value);
-	void transmit_SystemConfig_Save (void);
-	void transmit_SystemConfig_LoadDefault (void);
+	uint16_t transmit_SystemConfig_Get (uint16_t paramID);
+	uint16_t transmit_SystemConfig_Set (uint16_t paramID, int16_t value);
+	uint16_t transmit_SystemConfig_Save (void);
+	uint16_t transmit_SystemConfig_LoadDefault (void);
 
 	/********************************/
 
-	void transmit_VM2_setRange            (Comm_VM2_Range range);
-	void transmit_VM2_getCalibration      (uint16_t index);
-	void transmit_VM2_setCalibration      (uint16_t index, float voltage);
-	void transmit_VM2_saveCalibration     (void);
-	void transmit_VM2_read                (uint16_t filterLength);
-	void transmit_VM2_loadDefaultCalibration (void);
+	uint16_t transmit_VM2_setRange            (Comm_VM2_Range range);
+	uint16_t transmit_VM2_getCalibration      (uint16_t index);
+	uint16_t transmit_VM2_setCalibration      (uint16_t index, float voltage);
+	uint16_t transmit_VM2_saveCalibration     (void);
+	uint16_t transmit_VM2_read                (uint16_t filterLength);
+	uint16_t transmit_VM2_loadDefaultCalibration (void);
 
 	/********************************/
 
-	void transmit_VM_setTerminal (Comm_VM_Terminal terminal);
-	void transmit_VM_getTerminal (void);
+	uint16_t transmit_VM_setTerminal (Comm_VM_Terminal terminal);
+	uint16_t transmit_VM_getTerminal (void);
 
 	/********************************/
 
-	void transmit_changeBaud     (uint32_t baudRate);
-	void transmit_recSize (void);
-	void transmit_recData (uint16_t recSize);
-	void transmit_StartRec (void);
-	void transmit_StopRec (void);
+	uint16_t transmit_changeBaud     (uint32_t baudRate);
+	uint16_t transmit_recSize (void);
+	uint16_t transmit_recData (uint16_t recSize);
+	uint16_t transmit_StartRec (void);
+	uint16_t transmit_StopRec (void);
+	uint16_t transmit_StartRecPush (uint16_t chunkSize);
+	uint16_t transmit_CalibrationChecksum (void);
+	uint16_t transmit_GetCalibrationTables (Comm_Meter meter);
+	uint16_t transmit_SystemConfig_GetList (uint16_t count,
+											const int16_t* paramIDs);
+	uint16_t transmit_SourceMeasure (Comm_SourceMode source, float value,
+									 uint32_t settlingTime, Comm_Meter meter,
+									 uint16_t filterLength);
+
+	uint16_t transmit_BurstRead (Comm_Meter meter, uint16_t filterLength,
+								 uint32_t count);
 
 private:
 	QP4* qp4_;
-	FTDI* ftdi_;
+	Transport* transport_;
+	bool attached_;
 	CommCB_Union callbackObject_;
 
+private:
+	static Transport* createTransport (const char* name,
+						const char** address);
+
+private:
+	int rxWatch_;                 // IoEngine watch on the transport, or 0
+	std::mutex rxLock_;           // Serializes parsing and callbacks
+
+	void startReceiver (void);
+	void stopReceiver (void);
+	static bool receive (void* user_data);
+
 private:
 	void checkReceiveQueue        (void);
 
@@ -2829,12 +3488,122 @@ private:
 	void recDataCB  (const void* data, uint16_t size);
 	void StartRecCB (const void* data, uint16_t size);
 	void StopRecCB  (const void* data, uint16_t size);
+	void StartRecPushCB (const void* data, uint16_t size);
+	void recPushDataCB  (const void* data, uint16_t size);
+	void CalibrationChecksumCB (const void* data, uint16_t size);
+	void GetCalibrationTablesCB (const void* data, uint16_t size);
+	void SystemConfig_GetListCB (const void* data, uint16_t size);
+	void SourceMeasureCB (const void* data, uint16_t size);
+	void BurstReadCB (const void* data, uint16_t size);
+
+private:
+	void transmit (const void* frame, uint16_t size);
+
+	/*
+	 * Frames a request on the stack, tags it and queues it,
+	 * e.g. transmit<CommRequest_keepAlive> (lease_time_ms).
+	 */
+	template <typename Request, typename... Args>
+	uint16_t transmit (Args... args)
+	{
+		QP4_Frame<Request> frame (args...);
+
+		std::unique_lock<std::mutex> txLock;
+		uint16_t tag;
+		bool write;
+
+		/*
+		 * Tags go on the wire in the order they are issued. The write
+		 * itself waits till tagLock_ is let go, lest a slow transport
+		 * hold up the receive side, which matches tags under it.
+		 */
+		{
+			std::lock_guard<std::mutex> lock (tagLock_);
+
+			tag = issueTag (frame.body().opcode());
+			frame.body().tag (tag);
+			frame.seal();
+
+			txLock = std::unique_lock<std::mutex> (txLock_);
+			write = queue (frame.data(), frame.size(), txLock);
+		}
+
+		if (write)
+			writeQueued (txLock);
+
+		return tag;
+	}
+
+private:
+	/*
+	 * Requests sent and not yet answered, oldest first. The firmware
+	 * answers one request at a time, so a response answers the oldest
+	 * request of its opcode, or of any for NOP, unless it carries a
+	 * tag; those ahead of it went unanswered. A request answered in
+	 * several frames stays pending till the last.
+	 */
+	struct PendingRequest
+	{
+		uint16_t tag;
+		uint16_t opcode;
+	};
+
+	enum {MAX_PENDING_REQUESTS = 1024};
+
+	std::deque<PendingRequest> pendingRequests_;
+	uint16_t nextTag_;
+	std::mutex tagLock_;
+	uint16_t rxTag_;              // Of the response being interpreted
+
+	uint16_t issueTag (uint16_t opcode);
+	uint16_t matchTag (const CommPacket* packet, bool last);
+	void do_callback (CommCB* oCB);
+
+public:
+	void setTransmitPolicy (const Comm_TransmitPolicy& policy);
+	Comm_TransmitPolicy transmitPolicy (void) const;
+
+	/*
+	 * Sends queued requests without waiting out maxDelay.
+	 */
+	void flush (void);
+
+	/*
+	 * Between cork() and uncork(), requests are only queued, and
+	 * uncork() sends them in one write, as one burst on the wire.
+	 */
+	void cork (void);
+	void uncork (void);
 
 private:
-	void transmit (const QP4_Packet* packet);
+	/**** Transmit queue, drained on the IoEngine's writer thread ****/
+	std::vector<uint8_t> txQueue_;
+	std::vector<uint8_t> txBuffer_;     // Being written
+	std::chrono::steady_clock::time_point txQueuedAt_;
+	Comm_TransmitPolicy txPolicy_;
+	bool txFlush_;
+	bool txRunning_;
+	bool txWriting_;                    // txBuffer_ being written
+	bool txCorked_;                     // Queue only, till uncork()
+	int txTask_;                        // Pending write, or 0
+	mutable std::mutex txLock_;
+
+	void startTransmitter (void);
+	void stopTransmitter (void);
+	static double transmitTask (void* user_data);
+	double transmitQueued (void);
+	double transmitDelay (void) const;
+	void writeQueued (std::unique_lock<std::mutex>& lock);
+	bool queue (const void* frame, uint16_t size,
+				std::unique_lock<std::mutex>& lock);
 
 public:
-	void setBaudRate (uint32_t baudRate);
+	bool setBaudRate (uint32_t baudRate);
+	uint32_t receiveErrors (void) const;
+
+public:
+	bool setTransportParameters (const FTDI_Parameters& parameters);
+	FTDI_Parameters transportParameters (void) const;
 
 public:
 	std::unique_lock<std::mutex> lock (void)
@@ -2842,6 +3611,12 @@ public:
 		return std::unique_lock<std::mutex> (_lock);
 	}
 
+	/**** As lock(), not owning the lock if another thread has it ****/
+	std::unique_lock<std::mutex> tryLock (void)
+	{
+		return std::unique_lock<std::mutex> (_lock, std::try_to_lock);
+	}
+
 private:
 	std::mutex _lock;
 };
@@ -22,4 +22,13 @@ public:
 	{}
 };
 
+class RequestLost : public std::runtime_error
+{
+
+public:
+	RequestLost (void) :
+		std::runtime_error ("XSMU Error : Request Lost")
+	{}
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef __SMU_POLL_SCHEDULER__
+#define __SMU_POLL_SCHEDULER__
+
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * How often the stream is polled. Times are in seconds.
+ */
+class StreamPollPolicy
+{
+	public:
+	StreamPollPolicy (void) :
+		minInterval_   (10e-3),
+		maxInterval_   (1),
+		targetLatency_ (100e-3),
+		targetFill_    (0.5),
+		capacity_      (8192)
+	{}
+
+	public:
+	double   minInterval   (void) const { return minInterval_;   }
+	double   maxInterval   (void) const { return maxInterval_;   }
+	double   targetLatency (void) const { return targetLatency_; }
+	double   targetFill    (void) const { return targetFill_;    }
+	uint32_t capacity      (void) const { return capacity_;      }
+
+	public:
+	void minInterval   (double t)    { minInterval_   = t; }
+	void maxInterval   (double t)    { maxInterval_   = t; }
+	void targetLatency (double t)    { targetLatency_ = t; }
+	void targetFill    (double f)    { targetFill_    = f; }
+	void capacity      (uint32_t n)  { capacity_      = n; }
+
+	private:
+	double   minInterval_;      // Never polls more often than this
+	double   maxInterval_;      // Nor less often than this
+	double   targetLatency_;    // Longest a sample should wait in the SMU
+	double   targetFill_;       // Fraction of the SMU's queue to let fill
+	uint32_t capacity_;         // Samples the SMU's queue holds
+};
+
+/*
+ * Picks when to poll the stream next, from the rate the SMU's queue
+ * fills at, as seen in successive recSize replies: often enough that
+ * samples wait no longer than the target latency, and the queue stays
+ * below the target fill, within the policy's bounds.
+ *
+ * The rate estimate follows a rise at once, since that risks overflow,
+ * but a fall only gradually.
+ */
+class PollScheduler
+{
+	public:
+	PollScheduler (void);
+
+	public:
+	const StreamPollPolicy& policy (void) const { return policy_; }
+	void setPolicy (const StreamPollPolicy& policy) { policy_ = policy; }
+
+	/**** Restarts estimation, from the expected rate if known ****/
+	void start (double expectedRate);
+
+	/*
+	 * Takes the number of samples the SMU reported at time at, and how
+	 * many were then drained, which may include some that arrived
+	 * later. Returns when to poll next.
+	 */
+	double update (double at, uint32_t available, uint32_t drained);
+
+	/**** Samples per second, or zero if not known yet ****/
+	double rate (void) const { return rate_; }
+
+	/**** Samples the SMU should hold by time at ****/
+	uint32_t expected (double at) const;
+
+	private:
+	double interval (void) const;
+
+	private:
+	StreamPollPolicy policy_;
+	double rate_;
+	bool primed_;               // Whether lastAt_ and leftover_ are valid
+	double lastAt_;
+	int64_t leftover_;          // Samples left with the SMU at lastAt_,
+								// less any fetched after that
+};
+
+} // end of namespace smu
+
+#endif
@@ -0,0 +1,277 @@
+#ifndef __SMU_SIMULATOR__
+#define __SMU_SIMULATOR__
+
+#include "../../sys/sys/Transport.h"
+#include "../../sys/sys/QP4.h"
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * Timing and measurement model of a simulated SMU.
+ * Times are in seconds.
+ */
+class SimulatorParameters
+{
+	public:
+	SimulatorParameters (void);
+
+	public:
+	double   usbLatency      (void) const { return usbLatency_;      }
+	double   jitter          (void) const { return jitter_;          }
+	double   transferTime    (void) const { return transferTime_;    }
+	double   processingTime  (void) const { return processingTime_;  }
+	double   conversionTime  (void) const { return conversionTime_;  }
+	double   sampleRate      (void) const { return sampleRate_;      }
+	uint32_t streamCapacity  (void) const { return streamCapacity_;  }
+	uint32_t maxBaudRate     (void) const { return maxBaudRate_;     }
+	double   load            (void) const { return load_;            }
+	double   noise           (void) const { return noise_;           }
+	bool     echoTags        (void) const { return echoTags_;        }
+
+	public:
+	void usbLatency     (double t)     { usbLatency_     = t;    }
+	void jitter         (double t)     { jitter_         = t;    }
+	void transferTime   (double t)     { transferTime_   = t;    }
+	void processingTime (double t)     { processingTime_ = t;    }
+	void conversionTime (double t)     { conversionTime_ = t;    }
+	void sampleRate     (double rate)  { sampleRate_     = rate; }
+	void streamCapacity (uint32_t n)   { streamCapacity_ = n;    }
+	void maxBaudRate    (uint32_t bd)  { maxBaudRate_    = bd;   }
+	void load           (double ohms)  { load_           = ohms; }
+	void noise          (double ratio) { noise_          = ratio;}
+	void echoTags       (bool echo)    { echoTags_       = echo; }
+
+	public:
+	/*
+	 * Parses comma separated key=value pairs, e.g.
+	 * "latency=0.001,jitter=0.0002,rate=1000". Unknown keys
+	 * are ignored.
+	 */
+	void parse (const char* options);
+
+	private:
+	double   usbLatency_;       // Added to every reply, like the latency timer
+	double   jitter_;           // Uniformly distributed extra delay
+	double   transferTime_;     // Host overhead of each USB write
+	double   processingTime_;   // Firmware time per request
+	double   conversionTime_;   // ADC time per sample of a filtered read
+	double   sampleRate_;       // Streaming samples per second
+	uint32_t streamCapacity_;   // Samples the firmware can hold
+	uint32_t maxBaudRate_;      // Fastest rate the cable carries cleanly
+	double   load_;             // Resistance across the terminals
+	double   noise_;            // Reading noise, relative to full scale
+	bool     echoTags_;         // Echo request tags, unlike firmware
+};
+
+/*
+ * In-process model of the XPLORE SMU firmware, usable as a transport.
+ *
+ * Requests are decoded with the real QP4 framing and answered as the
+ * firmware would, from a resistive load model. Each reply becomes
+ * readable only once it would have crossed the serial link at the
+ * current baud rate, plus USB latency and jitter. A baud rate mismatch
+ * between the two ends garbles the bytes, as it would on the wire.
+ *
+ * Comm opens a simulator for names of the form "sim:<options>", with
+ * options as accepted by SimulatorParameters::parse().
+ */
+class Simulator : public Transport
+{
+	public:
+	Simulator (void);
+	Simulator (const SimulatorParameters& parameters);
+	~Simulator (void);
+
+	public:
+	void open (const char* name, int baudrate);
+	uint32_t read (void* data, uint32_t size);
+	uint32_t write (const void* data, uint32_t size);
+	void close (void);
+
+	public:
+	bool good (void) const { return open_; }
+	bool setBaudRate (uint32_t bd);
+	int pollfd (void) const { return timerfd_; }
+
+	public:
+	const SimulatorParameters& parameters (void) const { return parameters_; }
+	void setParameters (const SimulatorParameters& parameters);
+
+	private:
+	struct Chunk
+	{
+		double due;                   // When the host may read it
+		uint32_t baudRate;            // Device side rate while sent
+		std::vector<uint8_t> bytes;
+	};
+
+	class Reply;
+
+	private:
+	void reset (void);
+	void execute (const uint8_t* data, uint16_t size, double arrival);
+	void send (const Reply& reply, double ready);
+	uint32_t deviceBaudRate (double at) const;
+	void armTimer (void);
+
+	private:
+	double measure (uint16_t filterLength, double value, double fullScale);
+	double sourceVoltage (void) const;
+	double sourceCurrent (void) const;
+	int32_t streamSample (void);
+	uint32_t streamPending (double at);
+	void pushStream (double until);
+	void pushFrame (uint32_t size, double at);
+
+	private:
+	/**** Request handlers, indexed by opcode ****/
+	typedef void (Simulator::*Handler)(const uint8_t*, uint16_t, Reply&);
+
+	void acknowledge         (const uint8_t* req, uint16_t size, Reply& res);
+	void identify            (const uint8_t* req, uint16_t size, Reply& res);
+	void keepAlive           (const uint8_t* req, uint16_t size, Reply& res);
+	void setSourceMode       (const uint8_t* req, uint16_t size, Reply& res);
+
+	void CS_setRange         (const uint8_t* req, uint16_t size, Reply& res);
+	void CS_getCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void CS_verifyCalibration(const uint8_t* req, uint16_t size, Reply& res);
+	void CS_setCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void CS_setCurrent       (const uint8_t* req, uint16_t size, Reply& res);
+
+	void VS_setRange         (const uint8_t* req, uint16_t size, Reply& res);
+	void VS_getCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void VS_verifyCalibration(const uint8_t* req, uint16_t size, Reply& res);
+	void VS_setCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void VS_setVoltage       (const uint8_t* req, uint16_t size, Reply& res);
+
+	void CM_setRange         (const uint8_t* req, uint16_t size, Reply& res);
+	void CM_getCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void CM_setCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void CM_read             (const uint8_t* req, uint16_t size, Reply& res);
+
+	void VM_setRange         (const uint8_t* req, uint16_t size, Reply& res);
+	void VM_getCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void VM_setCalibration   (const uint8_t* req, uint16_t size, Reply& res);
+	void VM_read             (const uint8_t* req, uint16_t size, Reply& res);
+
+	void CS_loadDefaultCalibration (const uint8_t* req, uint16_t size, Reply& res);
+	void VS_loadDefaultCalibration (const uint8_t* req, uint16_t size, Reply& res);
+	void CM_loadDefaultCalibration (const uint8_t* req, uint16_t size, Reply& res);
+	void VM_loadDefaultCalibration (const uint8_t* req, uint16_t size, Reply& res);
+
+	void RM_readAutoscale    (const uint8_t* req, uint16_t size, Reply& res);
+
+	void SystemConfig_get    (const uint8_t* req, uint16_t size, Reply& res);
+	void SystemConfig_set    (const uint8_t* req, uint16_t size, Reply& res);
+	void SystemConfig_loadDefault (const uint8_t* req, uint16_t size, Reply& res);
+
+	void VM2_setRange        (const uint8_t* req, uint16_t size, Reply& res);
+	void VM2_getCalibration  (const uint8_t* req, uint16_t size, Reply& res);
+	void VM2_setCalibration  (const uint8_t* req, uint16_t size, Reply& res);
+	void VM2_read            (const uint8_t* req, uint16_t size, Reply& res);
+	void VM2_loadDefaultCalibration (const uint8_t* req, uint16_t size, Reply& res);
+
+	void VM_setTerminal      (const uint8_t* req, uint16_t size, Reply& res);
+	void VM_getTerminal      (const uint8_t* req, uint16_t size, Reply& res);
+
+	void changeBaud          (const uint8_t* req, uint16_t size, Reply& res);
+	void recSize             (const uint8_t* req, uint16_t size, Reply& res);
+	void recData             (const uint8_t* req, uint16_t size, Reply& res);
+	void startRec            (const uint8_t* req, uint16_t size, Reply& res);
+	void stopRec             (const uint8_t* req, uint16_t size, Reply& res);
+	void startRecPush        (const uint8_t* req, uint16_t size, Reply& res);
+	void calibrationChecksum (const uint8_t* req, uint16_t size, Reply& res);
+	void getCalibrationTables(const uint8_t* req, uint16_t size, Reply& res);
+	void SystemConfig_getList(const uint8_t* req, uint16_t size, Reply& res);
+	void sourceMeasure       (const uint8_t* req, uint16_t size, Reply& res);
+	void burstRead           (const uint8_t* req, uint16_t size, Reply& res);
+
+	private:
+	/*
+	 * A calibration point pairs a DAC or ADC code with the
+	 * physical value it corresponds to.
+	 */
+	struct CalibrationPoint
+	{
+		int32_t code;
+		float value;
+	};
+
+	typedef std::vector<CalibrationPoint> CalibrationTable;
+
+	enum
+	{
+		CALIBRATION_POINTS = 5,
+		DAC_STEP = 16000,             // Code step between DAC points
+		ADC_STEP = 4000000,           // Code step between ADC points
+	};
+
+	static CalibrationTable defaultTable (double fullScale, int32_t step);
+	static int32_t toCode (const CalibrationTable& table, double value);
+
+	/**** Full scale of each range ****/
+	static double CS_fullScale  (uint16_t range);
+	static double VS_fullScale  (uint16_t range);
+	static double CM_fullScale  (uint16_t range);
+	static double VM_fullScale  (uint16_t range);
+	static double VM2_fullScale (uint16_t range);
+
+	private:
+	SimulatorParameters parameters_;
+	mutable std::mutex lock_;
+	bool open_;
+	int timerfd_;
+	double clock_;                // Firmware time of the request in hand
+
+	/**** Link model ****/
+	QP4_Receiver receiver_;
+	uint32_t hostBaudRate_;
+	uint32_t deviceBaudRate_;
+	uint32_t pendingBaudRate_;
+	double baudSwitchAt_;
+	double inboundFreeAt_;
+	double outboundFreeAt_;
+	double busyUntil_;
+	double lastDue_;
+	uint32_t corruptCounter_;
+	std::deque<Chunk> outbound_;
+	size_t outboundOffset_;
+
+	std::mt19937 random_;
+
+	/**** Instrument state ****/
+	uint16_t sourceMode_;
+	uint16_t CS_range_, VS_range_, CM_range_, VM_range_, VM2_range_;
+	uint16_t VM_terminal_;
+	double current_, voltage_;
+	int32_t CS_dac_, VS_dac_;
+
+	std::vector<CalibrationTable> CS_calibration_, VS_calibration_;
+	std::vector<CalibrationTable> CM_calibration_, VM_calibration_;
+	std::vector<CalibrationTable> VM2_calibration_;
+
+	int16_t systemConfig_[3];
+
+	/**** Streaming engine ****/
+	bool recording_;
+	double recStartedAt_;
+	uint64_t recProduced_;
+	uint64_t recConsumed_;
+	bool recPush_;                // Sending frames unasked
+	uint16_t recPushChunk_;       // Samples that make a frame worth sending
+	uint16_t recPushSequence_;
+	double recPushAt_;            // When the next frame may be ready
+
+	private:
+	Simulator (const Simulator&);
+	Simulator& operator= (const Simulator&);
+};
+} // end of namespace smu
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef __SMU_STREAM_CLOCK__
+#define __SMU_STREAM_CLOCK__
+
+#include <stdint.h>
+#include <vector>
+
+namespace smu {
+
+/*
+ * Host time of streamed samples, as a straight line through the stream:
+ * time = at + period * (index - origin). Cheap to copy, so that samples
+ * may be stamped without holding up the clock.
+ */
+class StreamTimebase
+{
+	public:
+	StreamTimebase (void) :
+		origin_ (0),
+		at_ (0),
+		period_ (0)
+	{}
+
+	StreamTimebase (uint64_t origin, double at, double period) :
+		origin_ (origin),
+		at_ (at),
+		period_ (period)
+	{}
+
+	public:
+	double time (uint64_t index) const {
+		return at_ + period_ * (double (index) - double (origin_));
+	}
+
+	double period (void) const { return period_; }
+
+	/**** Number of samples taken by time t ****/
+	uint64_t index (double t) const {
+		const double n = (period_ > 0) ? (t - at_) / period_ + 1 : 0;
+		return origin_ + ((n > 0) ? uint64_t (n) : 0);
+	}
+
+	private:
+	uint64_t origin_;
+	double at_;
+	double period_;
+};
+
+/*
+ * Estimates when the SMU took each streamed sample, on the host's
+ * monotonic clock, from nothing more than when chunks of them arrive.
+ *
+ * The SMU samples at a steady rate, off a clock of its own, so a sample's
+ * arrival time is a straight line in its index, plus a latency which is
+ * never negative. The line's slope, the device's sample period, is fitted
+ * by least squares, with older chunks forgotten over timeConstant()
+ * seconds, which tracks the drift between the two clocks. Its offset is
+ * pinned to the lower envelope of the arrivals, that is, to the chunks
+ * that were least delayed, which rises only slowly once set.
+ *
+ * A sample's time so found is when it reached the host at the earliest,
+ * which lags when it was taken by the shortest transfer seen.
+ */
+class StreamClock
+{
+	public:
+	StreamClock (void);
+
+	public:
+	/*
+	 * Restarts estimation at time at, with index the number of the
+	 * first sample to come, from the expected rate if known.
+	 */
+	void start (double at, uint64_t index, double expectedRate);
+
+	/**** Samples numbered below end arrived by time at ****/
+	void observe (double at, uint64_t end);
+
+	/**** Samples per second, or zero if not known yet ****/
+	double rate (void) const;
+
+	StreamTimebase timebase (void) const;
+
+	double timeConstant (void) const { return timeConstant_; }
+	void setTimeConstant (double seconds) { timeConstant_ = seconds; }
+
+	private:
+	double period (void) const;
+
+	private:
+	double timeConstant_;       // Seconds over which chunks are forgotten
+	double expectedPeriod_;     // From the expected rate, or zero
+
+	double startAt_;
+	uint64_t origin_;           // Index of the first sample since start()
+
+	/**** Exponentially weighted sums, relative to startAt_ and origin_ ****/
+	uint32_t chunks_;
+	double lastAt_;
+	double weight_;
+	double meanIndex_;
+	double meanAt_;
+	double varIndex_;           // Sums of squared and cross deviations
+	double covar_;
+
+	double floor_;              // Lower envelope of arrivals, off the line
+};
+
+/*
+ * Turns timestamped samples into values on a uniform grid of times,
+ * at multiples of the interval, by linear interpolation.
+ */
+class StreamResampler
+{
+	public:
+	StreamResampler (void);
+
+	public:
+	void start (double interval);
+	double interval (void) const { return interval_; }
+
+	/*
+	 * Takes the value of a sample at time at, and appends to values
+	 * those on the grid up to there. Samples should come in order.
+	 */
+	void feed (double at, float value, std::vector<float>& values);
+
+	/**** Time of the next value on the grid ****/
+	double next (void) const { return interval_ * next_; }
+
+	private:
+	double interval_;
+	bool primed_;
+	int64_t next_;              // Next value on the grid, as a multiple
+	double lastAt_;
+	float lastValue_;
+};
+
+} // end of namespace smu
+
+#endif
@@ -14,6 +14,8 @@ enum SystemConfig_ParamID
 class SystemConfig
 {
 public:
+	enum {MAX_PARAMS = 16};
+
 	SystemConfig (void);
 
 public:
@@ -51,7 +53,7 @@ public:
 	}
 
 private:
-	int16_t values_[16];
+	int16_t values_[MAX_PARAMS];
 };
 } //namespace smu 
 
@@ -10,12 +10,23 @@
 #include "RM.h"
 #include "SystemConfig.h"
 #include "version.h"
+#include "PollScheduler.h"
+#include "StreamClock.h"
+#include "CalibrationEngine.h"
+#include "CalibrationCache.h"
+
+#include "../../sys/sys/StreamBuffer.h"
 
-#include <bitset>
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <future>
 #include <mutex>
-#include <queue>
+#include <map>
+#include <string>
 
 namespace smu {
 
@@ -30,7 +41,86 @@ enum class SourceMode {
 
 SourceMode toSourceMode (unsigned int i);
 
-class AckBits:public std::bitset<64> {
+enum class Meter {
+
+	CM,
+	VM,
+	VM2,
+};
+
+/*
+ * One command of a batch run by Driver::execute(). argument is the
+ * value to source, the range, mode or terminal to set, by its enum
+ * value, or the filter length of a read. execute() sets result to
+ * what the SMU applied or read, in the same terms, and status.
+ */
+enum class BatchOp {
+
+	SET_SOURCE_MODE,
+	CS_SET_RANGE,
+	CS_SET_CURRENT,
+	VS_SET_RANGE,
+	VS_SET_VOLTAGE,
+	CM_SET_RANGE,
+	CM_READ,
+	VM_SET_RANGE,
+	VM_READ,
+	VM2_READ,
+	RM_READ_AUTOSCALE,
+	VM_SET_TERMINAL,
+};
+
+enum class BatchStatus {
+
+	DONE,
+	TIMEOUT,              // Not answered within the batch's timeout
+	NO_OPERATION,         // Rejected by the firmware
+	LOST,                 // Answer lost on the way
+	INVALID,              // Not a BatchOp
+};
+
+struct BatchCommand
+{
+	BatchOp op;
+	double argument;
+	double result;
+	BatchStatus status;
+};
+
+/*
+ * Per-opcode response counters. A request arms its opcode with reset()
+ * before transmitting, and the receive thread completes it with set()
+ * once the response is interpreted. A NOP response, sent by firmware
+ * that does not know the opcode, wakes every waiter.
+ */
+class Completions {
+
+ public:
+	Completions (void);
+
+ public:
+	void reset (uint16_t code);
+	void set (uint16_t code);
+
+	bool wait (uint16_t code,
+			   std::chrono::steady_clock::time_point deadline);
+
+	/**** Waits for count completions since reset, for pipelined requests ****/
+	bool wait (uint16_t code, uint32_t count,
+			   std::chrono::steady_clock::time_point deadline);
+
+	bool nop (uint16_t code) const;
+
+ private:
+	enum {CODES = 64};
+
+	mutable std::mutex lock_;
+	std::condition_variable cond_[CODES];
+	uint32_t completed_[CODES];
+	uint32_t armed_[CODES];
+	uint32_t nopArmed_[CODES];     // NOP count when armed
+
+	bool done (uint16_t code, uint32_t count = 1) const;
 };
 
 class Driver {
@@ -57,14 +147,37 @@ class Driver {
 	void open (const char* serialNo, float* timeout);
 	void close (void);
 
+	int pollfd (void) const { return comm_->pollfd(); }
+
+	/*
+	 * Uses the given transport, e.g. a Simulator, for the next
+	 * open(). The driver takes ownership of it.
+	 */
+	void attach (Transport* transport) { comm_->attach (transport); }
+
+ public:
+	/***************************************************/
+	/* USB transport tuning                            */
+
+	void autoTune (bool enable) { autoTune_ = enable; }
+	void tuneTransport (float* timeout);
+
+	bool setTransportParameters (const FTDI_Parameters& parameters);
+	FTDI_Parameters transportParameters (void) const;
+
+	void setTransmitPolicy (const Comm_TransmitPolicy& policy);
+	Comm_TransmitPolicy transmitPolicy (void) const;
+
  public:
 	/***************************************************/
 
 	void identify (float* timeout);
 
 	void keepAlive (uint32_t* lease_time_ms, float* timeout);
-	void thread (void);
-	void poll_stream (void);
+	double service (void);
+
+	/**** Expects the comm lock held ****/
+	double poll_stream (void);
 
 	void setSourceMode (SourceMode* mode, float* timeout);
 
@@ -151,6 +264,36 @@ class Driver {
 	void SystemConfig_Set_hardwareVersion (uint32_t* version, float* timeout);
 	void SystemConfig_Get_hardwareVersion (uint32_t* version, float* timeout);
 
+	/*
+	 * Reads count parameters into values, in as few round trips as
+	 * the firmware's request size allows, or one per parameter with
+	 * firmware that reads one at a time.
+	 */
+	void SystemConfig_Get (uint16_t count, const int16_t* paramIDs,
+						   int16_t* values, float* timeout);
+
+	/***************************************************/
+	/*
+	 * Read the calibration tables of every range of a meter in one
+	 * round trip, into tables, indexed by range. With firmware that
+	 * reads one point at a time, leave tables empty and set timeout
+	 * to 0; *_getCalibration reads the present range's points.
+	 */
+	void CS_getCalibrationTables (
+		std::vector<CS_CalibrationTable>* tables, float* timeout);
+
+	void VS_getCalibrationTables (
+		std::vector<VS_CalibrationTable>* tables, float* timeout);
+
+	void CM_getCalibrationTables (
+		std::vector<CM_CalibrationTable>* tables, float* timeout);
+
+	void VM_getCalibrationTables (
+		std::vector<VM_CalibrationTable>* tables, float* timeout);
+
+	void VM2_getCalibrationTables (
+		std::vector<VM_CalibrationTable>* tables, float* timeout);
+
 	/***************************************************/
 
 	void VM2_setRange (VM2_Range* range, float* timeout);
@@ -173,12 +316,103 @@ class Driver {
 	/***************************************************/
 
 	void changeBaud (uint32_t* baudRate, float* timeout);
+	void negotiateBaudRate (uint32_t* baudRate, float* timeout);
+
+	void setStreamSampleRate (float rate) { streamSampleRate_ = rate; }
+	float streamSampleRate (void) const { return streamSampleRate_; }
 
 	void recSize  (uint16_t* recSize, float* timeout);
 	void recData  (uint16_t* size, float* timeout);
 	void StartRec (float* timeout);
 	void StopRec  (float* timeout);
 
+	/*
+	 * Starts recording with the SMU sending chunkSize samples at a time
+	 * on its own, rather than being polled for them. A chunkSize of 0
+	 * picks one from the sample rate and the poll policy's target
+	 * latency. Returns the size the SMU settled on in chunkSize. Falls
+	 * back to polling, returning 0, with firmware that cannot push.
+	 */
+	void StartRecPush (uint16_t* chunkSize, float* timeout);
+
+	/*
+	 * Checksum over the SMU's calibration tables and system config.
+	 * Sets timeout to 0 with firmware that cannot checksum them.
+	 */
+	void CalibrationChecksum (uint32_t* checksum, float* timeout);
+
+	/*
+	 * Sources value, current or voltage as source says, waits
+	 * settlingTime seconds, then reads meter over filterLength
+	 * conversions, all on the SMU in one round trip. Returns the
+	 * value applied in value, and the reading in reading. timeout
+	 * must allow for the settling and the read. With firmware that
+	 * cannot, sources and reads in two round trips, settling on
+	 * the host in between.
+	 */
+	void SourceMeasure (SourceMode source, float* value, float settlingTime,
+						Meter meter, uint16_t filterLength,
+						float* reading, float* timeout);
+
+	/*
+	 * Reads meter count times over filterLength conversions each, on
+	 * its present range and terminal, in one request. The readings come
+	 * back as many to a frame as fit, and are returned in readings, in
+	 * the order taken, or none on timeout. timeout must allow for all of
+	 * them. With firmware that cannot, reads them in pipelined requests,
+	 * and returns none with a zero timeout if it cannot read meter.
+	 */
+	void BurstRead (Meter meter, uint16_t filterLength, uint32_t count,
+					std::vector<float>* readings, float* timeout);
+
+	/***************************************************/
+ public:
+	/*
+	 * Pipelined requests. Each sends its request and returns at once,
+	 * with a future that the receive thread fulfils from the response,
+	 * so that many may be outstanding over the one connection, and
+	 * alongside the blocking calls above. A future fails with
+	 * NoOperation if the firmware rejected the request, and with
+	 * RequestLost if its response never came, as told by a later
+	 * response overtaking it, or by close(). Callers bound their
+	 * wait with std::future::wait_for.
+	 */
+	std::future<float> CS_setCurrentAsync (float current);
+	std::future<float> VS_setVoltageAsync (float voltage);
+	std::future<float> CM_readAsync (uint16_t filterLength);
+	std::future<float> VM_readAsync (uint16_t filterLength);
+	std::future<float> VM2_readAsync (uint16_t filterLength);
+	std::future<float> RM_readAutoscaleAsync (uint16_t filterLength);
+	std::future<int16_t> SystemConfig_GetAsync (uint16_t paramID);
+
+	/**** Number of pipelined requests awaiting their response ****/
+	size_t pendingRequests (void);
+
+	/*
+	 * Runs commands in order, with their requests sent in one burst
+	 * and their responses awaited together, roughly one round trip
+	 * for the lot. Each command is sent whatever became of those
+	 * before it, and has its own result and status.
+	 */
+	void execute (std::vector<BatchCommand>* commands, float* timeout);
+
+	/***************************************************/
+ public:
+	/*
+	 * Calibration tables and the hardware version, once read, are kept
+	 * on disk, as CalibrationCache describes. open() checks the file
+	 * against the SMU's calibration checksum, and if it matches, serves
+	 * *_getCalibration and SystemConfig_Get_hardwareVersion from it,
+	 * for ranges set since. Setting, saving or loading default tables
+	 * drops them from the cache, and close() brings the file up to date.
+	 * Firmware without CalibrationChecksum always goes to the SMU.
+	 */
+	void enableCalibrationCache (bool enable) { cacheEnabled_ = enable; }
+	bool calibrationCacheEnabled (void) const { return cacheEnabled_; }
+
+	/**** Whether open() found the cache good ****/
+	bool calibrationCacheLoaded (void) const { return cacheLoaded_; }
+
 	/***************************************************/
  public:
 	bool goodID (void) const;
@@ -187,11 +421,12 @@ class Driver {
 	}
  private:
 	bool waitForResponse (uint16_t checkBit, float* timeout);
-	bool waitForResponse (const AckBits & checkBits, float* timeout);
+	bool waitForResponses (uint16_t checkBit, uint32_t count, float* timeout);
 
  private:
 	static void comm_cb (void* user_data, const void* oCB);
 	void comm_cb (const CommCB* oCB);
+	void dispatch (const CommCB* oCB);
 
 	void nopCB (const CommCB* oCB);
 	void identityCB (const CommCB* oCB);
@@ -252,6 +487,46 @@ class Driver {
 	void recDataCB (const CommCB* oCB);
 	void StartRecCB (const CommCB* oCB);
 	void StopRecCB (const CommCB* oCB);
+	void StartRecPushCB (const CommCB* oCB);
+	void recPushDataCB (const CommCB* oCB);
+	void CalibrationChecksumCB (const CommCB* oCB);
+	void GetCalibrationTablesCB (const CommCB* oCB);
+	void SystemConfig_GetListCB (const CommCB* oCB);
+	void SourceMeasureCB (const CommCB* oCB);
+	void BurstReadCB (const CommCB* oCB);
+
+ private:
+	/*
+	 * Pipelined requests not yet answered, in the order sent. Their
+	 * responses complete them here, bypassing the opcode's callback
+	 * and completions_, so that blocking callers of the same opcode
+	 * are never woken by them.
+	 */
+	struct AsyncRequest
+	{
+		uint16_t tag;
+		std::function<void (const CommCB*)> complete;
+		std::function<void (std::exception_ptr)> fail;
+	};
+
+	std::deque<AsyncRequest> asyncRequests_;
+	std::mutex asyncLock_;
+
+	/*
+	 * Sends a request with transmit(), which returns its tag, and
+	 * fulfils the future with complete(oCB) once it is answered.
+	 */
+	template <typename Result, typename Transmit, typename Complete>
+	std::future<Result> submit (Transmit transmit, Complete complete);
+
+	/**** As submit(), with the comm lock held ****/
+	template <typename Result, typename Transmit, typename Complete>
+	std::future<Result> enqueue (Transmit transmit, Complete complete);
+
+	std::future<double> enqueueBatchCommand (const BatchCommand& command);
+
+	bool completeAsync (const CommCB* oCB);
+	void failAsync (void);
 
  private:
 	Comm* comm_;
@@ -263,34 +538,233 @@ class Driver {
 	RM* rm_;
 	SystemConfig* sysconf_;
 	VersionInfo* versionInfo_;
-	AckBits ackBits_;
+	Completions completions_;
 	std::string identity_;
 
 private:
 	uint32_t baudRate_;
-	bool _alive;
-	std::future<void> _thread_future;
+	std::atomic<bool> _alive;
+
+	mutable std::mutex _alive_lock;
+
+	/**** IoEngine task renewing the lease and polling the stream ****/
+	int serviceTask_;
+	double keepAliveAt_;
+	static double serviceTask (void* user_data);
 
 private:
+	/*
+	 * Baud rate negotiation. All of these expect the comm lock held.
+	 */
+	uint32_t failedBaudRate_;      // Lowest rate known to fail, 0 if none
+	uint32_t idleBaudRate_;     // Rate to return to when streaming stops
+	float streamSampleRate_;    // Samples per second expected while streaming
+
+	bool escalateBaudRate (uint32_t target, float* timeout);
+	bool tryBaudRate (uint32_t baudRate, float* timeout);
+	bool confirmBaudRate (float* timeout);
+	void restoreBaudRate (uint32_t baudRate, float* timeout);
+	uint32_t streamBaudRate (bool push) const;
 
-	uint16_t recSize_;             //Stores size of available data with FW
-	std::queue<int32_t> _dataq_32; //Stores ADC data obtained from FW
+private:
 
-	//Stores ADC data converted to float using calibration table
-	std::queue<float> _dataq;
+	uint16_t recSize_;             //Stores size of available data with FW
+	uint16_t recDataSize_;         //Samples in the last recData response
+	std::atomic<uint32_t> recDataReceived_; //Samples in all responses since reset
+	StreamBuffer stream_;          //Stores ADC data obtained from FW
 
-	std::mutex _dataq_lock;
+	std::mutex _dataq_lock;        //Serialises consumers of stream_
 
 public:
 	std::vector<float> getData (void);
+	size_t getData (float* data, size_t size);
+
+	/*
+	 * As above, also returning in time when each sample was taken, on
+	 * the monotonic clock of Timer::get(), as estimated by streamClock.
+	 */
+	size_t getData (float* data, double* time, size_t size);
+
+	/*
+	 * As above, also returning in range the VM range each sample was
+	 * taken on. Samples are in volts once the range's calibration table
+	 * is known, from VM_getCalibration or VM_setCalibration, and in ADC
+	 * codes till then. Either of time and range may be null.
+	 */
+	size_t getData (float* data, double* time, VM_Range* range, size_t size);
+
+	/**** Whether streamed samples taken on range come out in volts ****/
+	bool streamCalibrated (VM_Range range) const;
+
+	/*
+	 * Drains the stream into values on a uniform grid of times, at
+	 * multiples of interval seconds, interpolating between samples.
+	 * Returns in start the time of the first value. Successive calls
+	 * continue the grid, unless the interval changes.
+	 */
+	std::vector<float> getResampledData (double interval, double* start);
+
+	/*
+	 * Sets the capacity, in samples, of the stream buffer and what
+	 * becomes of samples that overflow it. Discards buffered samples,
+	 * so should be called while not recording.
+	 */
+	void setStreamBuffer (size_t capacity, StreamOverflow overflow);
+
+	size_t streamCapacity (void) const { return stream_.capacity(); }
+	StreamOverflow streamOverflow (void) const { return stream_.overflow(); }
+
+	uint64_t streamDropped   (void) const { return stream_.dropped();   }
+	uint64_t streamSpilled   (void) const { return stream_.spilled();   }
+	size_t   streamHighWater (void) const { return stream_.highWater(); }
+
+	/**** Bounds and targets for scheduling stream polls ****/
+	void setStreamPollPolicy (const StreamPollPolicy& policy);
+	StreamPollPolicy streamPollPolicy (void) const;
+
+	/**** Whether the SMU is pushing the stream, and frames lost if so ****/
+	bool streamPush (void) const { return _push; }
+	uint64_t streamFramesLost (void) const { return pushFramesLost_; }
+
+	/**** Samples per second the SMU's queue is seen to fill at ****/
+	double streamFillRate (void) const;
+
+	/**** Samples per second the SMU takes, as timed by the host ****/
+	double streamClockRate (void) const;
+
+	/**** Seconds over which the stream clock forgets older chunks ****/
+	void setStreamClockTimeConstant (double seconds);
+	double streamClockTimeConstant (void) const;
+
+	/*
+	 * Number of recData requests kept in flight while fetching the
+	 * stream, or 0 to size the pipeline to the link's bandwidth-delay
+	 * product.
+	 */
+	void setStreamPipelineDepth (uint32_t depth) { pipelineDepth_ = depth; }
+	uint32_t streamPipelineDepth (void) const { return pipelineDepth_; }
 
 private:
-	bool _rec;
+	std::atomic<bool> _rec;
+	std::atomic<bool> _push;        // Recording, with the SMU pushing
+	uint16_t pushSequence_;         // Next frame expected, receive thread only
+	uint16_t recPushChunkSize_;     // Samples per pushed frame
+	std::atomic<uint64_t> pushFramesLost_;
 	double _poll_stream_at = 100e-3;
-	static constexpr double _poll_stream_interval = 1000e-3;
+	static constexpr double _poll_stream_room_wait = 100e-3;
+
+	PollScheduler pollScheduler_;   // Guarded by _alive_lock
+
+	StreamClock streamClock_;       // Guarded by clockLock_
+	mutable std::mutex clockLock_;
+	StreamResampler resampler_;     // Guarded by _dataq_lock
+
+	void startStreamClock (void);
+	void observeStream (uint64_t end);
+	size_t drainStream (float* data, double* time,
+						VM_Range* range, size_t size);
+
+	std::atomic<uint32_t> pipelineDepth_;
+	double streamRoundTrip_;        // Smoothed recSize round trip, seconds
+
+	enum {MAX_PIPELINE_DEPTH = 16};
+
+	uint32_t fetchStream (uint32_t expected, uint32_t* available,
+						  float* timeout);
+	void renewLease (uint32_t* lease_time_ms, float* timeout);
+	uint32_t pipelineDepth (void) const;
+
+private:
+	/*
+	 * Streamed samples are stored as ADC codes, and converted as they
+	 * are drained, by the VM table of the range they were taken on.
+	 * Each range change marks the first sample taken on the new range.
+	 */
+	struct RangeMark
+	{
+		uint64_t from;
+		VM_Range range;
+	};
+
+	CalibrationEngine streamCalibration_;   // Guarded by calibrationLock_
+	std::deque<RangeMark> rangeMarks_;      // Guarded by calibrationLock_
+	mutable std::mutex calibrationLock_;
+	VM_Range drainRange_;                   // Guarded by _dataq_lock
+
+	void calibrateStream (uint16_t index, int32_t adc, float voltage);
+	void markStreamRange (VM_Range range);
+	void convertStream (const int32_t* adc, const uint64_t* index,
+						size_t n, float* data, VM_Range* range);
+
+private:
+	CalibrationCache calibrationCache_;     // Guarded by cacheLock_
+	mutable std::mutex cacheLock_;
+	std::atomic<bool> cacheEnabled_;
+	std::atomic<bool> cacheLoaded_;
+	bool cacheActive_;              // The SMU reported a checksum
+	int cachedRange_[CalibrationCache::METERS]; // Range set, -1 till then
+	uint32_t calibrationChecksum_;  // From the last CalibrationChecksum
+
+	void openCalibrationCache (float* timeout);
+	void closeCalibrationCache (void);
+
+	/**** All of these apply to the range each meter was last set to ****/
+	void setCachedRange (CalibrationCache::Meter meter, uint16_t range);
+	bool cachedCalibration (CalibrationCache::Meter meter, uint16_t index,
+							int32_t* code, float* value, float* timeout);
+	bool lookupCalibration (CalibrationCache::Meter meter, uint16_t index,
+							int32_t* code, float* value);
+	void cacheCalibration (CalibrationCache::Meter meter, uint16_t index,
+						   int32_t code, float value);
+	void invalidateCalibration (CalibrationCache::Meter meter);
+	void invalidateHardwareVersion (void);
+	void setHostCalibration (CalibrationCache::Meter meter, uint16_t index,
+							 int32_t code, float value);
+
+private:
+	/*
+	 * Bulk reads. Each *_getCalibration that misses the cache reads
+	 * all of the meter's tables into it, while the firmware can.
+	 */
+	struct CalibrationPoint
+	{
+		int32_t code;
+		float value;
+	};
+
+	std::vector< std::vector<CalibrationPoint> > calibrationTables_;
+	std::atomic<bool> bulkCalibration_;     // Firmware reads tables whole
+	std::atomic<bool> bulkSystemConfig_;    // Firmware reads lists
+	std::atomic<bool> sourceMeasure_;       // Firmware sources and reads at once
+	std::atomic<bool> burstRead_;           // Firmware reads in bursts
+
+	/*
+	 * Readings of the burst under way, filled in frame by frame. Frames
+	 * left over from an earlier burst that timed out carry its tag.
+	 */
+	std::vector<float> burstReadings_;
+	uint32_t burstReceived_;
+	uint16_t burstTag_;
+	std::mutex burstLock_;
+
+	template <typename Table>
+	bool getCalibrationTables (Comm_Meter meter, std::vector<Table>* tables,
+							   float* timeout);
+
+	bool fetchCalibrationTables (CalibrationCache::Meter meter,
+								 float* timeout);
+
+	bool SystemConfig_GetList (uint16_t count, const int16_t* paramIDs,
+							   int16_t* values, float* timeout);
 
 private:
-	float applyCalibration (int32_t adc_value);
+	bool autoTune_;
+	std::string serialNo_;
+	double roundTripTime (float* timeout);
+
+	// Tuned parameters, per serial number, shared by all drivers.
+	static std::map<std::string, FTDI_Parameters> tunedParameters_;
+	static std::mutex tunedParametersLock_;
 };
 
 /************************************************************************/
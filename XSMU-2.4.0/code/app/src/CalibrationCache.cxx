@@ -0,0 +1,314 @@
+#include "../app/CalibrationCache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+static const char* const CACHE_MAGIC = "XSMU calibration cache 1";
+
+static const char* const meterNames[CalibrationCache::METERS] =
+{
+	"CS", "VS", "CM", "VM", "VM2",
+};
+
+static void makeDirectory (const std::string& path)
+/*
+ * Creates path and any missing parents, ignoring
+ * failures; opening the file then reports them.
+ */
+{
+	for (size_t i = 1; i <= path.size(); ++i) {
+
+		if ((i < path.size()) && (path[i] != '/') && (path[i] != '\\'))
+			continue;
+
+#if defined(_WIN32) || defined(_WIN64)
+		_mkdir (path.substr (0, i).c_str());
+#else
+		mkdir (path.substr (0, i).c_str(), 0755);
+#endif
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+CalibrationCache::CalibrationCache (void)
+{
+	reset ("", 0, 0);
+}
+
+void CalibrationCache::reset (const std::string& serialNo,
+							  uint32_t firmware, uint32_t checksum)
+{
+	serialNo_ = serialNo;
+	firmware_ = firmware;
+	checksum_ = checksum;
+
+	points_.clear();
+	haveHardwareVersion_ = false;
+	hardwareVersion_ = 0;
+
+	dirty_ = false;
+	stale_ = false;
+}
+
+bool CalibrationCache::load (const std::string& serialNo,
+							 uint32_t firmware, uint32_t checksum)
+{
+	reset (serialNo, firmware, checksum);
+
+	const std::string file = path();
+	if (file.empty() || read (file))
+		return !file.empty();
+
+	/**** Made for another firmware or calibration; start afresh ****/
+	reset (serialNo, firmware, checksum);
+	return false;
+}
+
+bool CalibrationCache::read (const std::string& file)
+/*
+ * Takes the points in the file, and returns whether the
+ * header matches the SMU. The caller discards them if not.
+ */
+{
+	FILE* fp = fopen (file.c_str(), "r");
+	if (!fp) return false;
+
+	char line[256];
+	bool good = fgets (line, sizeof (line), fp) &&
+		(strncmp (line, CACHE_MAGIC, strlen (CACHE_MAGIC)) == 0);
+
+	unsigned int matched = 0;
+
+	while (good && fgets (line, sizeof (line), fp)) {
+
+		char name[32], text[128];
+		unsigned long u;
+		unsigned int range, index;
+		long code;
+		float value;
+
+		if (sscanf (line, "serial %127s", text) == 1) {
+
+			good = (serialNo_ == text);
+			matched |= 1;
+		}
+
+		else if (sscanf (line, "firmware %lu", &u) == 1) {
+
+			good = (firmware_ == u);
+			matched |= 2;
+		}
+
+		else if (sscanf (line, "checksum %lu", &u) == 1) {
+
+			good = (checksum_ == u);
+			matched |= 4;
+		}
+
+		else if (sscanf (line, "hardware %lu", &u) == 1)
+			setHardwareVersion (u);
+
+		else if (sscanf (line, "%31s %u %u %ld %g",
+						 name, &range, &index, &code, &value) == 5) {
+
+			for (int m = 0; m < METERS; ++m)
+				if (strcmp (name, meterNames[m]) == 0)
+					store ((Meter) m, range, index, code, value);
+		}
+	}
+
+	fclose (fp);
+
+	dirty_ = false;
+	return good && (matched == 7);
+}
+
+bool CalibrationCache::save (uint32_t checksum)
+{
+	const std::string file = path();
+	if (file.empty()) return false;
+
+	makeDirectory (directory());
+
+	const std::string temp = file + ".tmp";
+	FILE* fp = fopen (temp.c_str(), "w");
+	if (!fp) return false;
+
+	fprintf (fp, "%s\n", CACHE_MAGIC);
+	fprintf (fp, "serial %s\n", serialNo_.c_str());
+	fprintf (fp, "firmware %lu\n", (unsigned long) firmware_);
+	fprintf (fp, "checksum %lu\n", (unsigned long) checksum);
+
+	if (haveHardwareVersion_)
+		fprintf (fp, "hardware %lu\n", (unsigned long) hardwareVersion_);
+
+	/**** Nine digits bring a float back exactly ****/
+	for (std::map<uint32_t, Point>::const_iterator it = points_.begin();
+		 it != points_.end(); ++it)
+		fprintf (fp, "%s %u %u %ld %.9g\n", meterNames[it->first >> 24],
+			(it->first >> 16) & 0xFF, it->first & 0xFFFF,
+			(long) it->second.code, it->second.value);
+
+	const bool written = !ferror (fp);
+
+	if ((fclose (fp) != 0) || !written) {
+
+		remove (temp.c_str());
+		return false;
+	}
+
+#if defined(_WIN32) || defined(_WIN64)
+	remove (file.c_str());
+#endif
+
+	if (rename (temp.c_str(), file.c_str()) != 0) {
+
+		remove (temp.c_str());
+		return false;
+	}
+
+	checksum_ = checksum;
+	dirty_ = false;
+	stale_ = false;
+	return true;
+}
+
+/************************************************************************/
+
+bool CalibrationCache::lookup (Meter meter, uint16_t range, uint16_t index,
+							   int32_t* code, float* value) const
+{
+	std::map<uint32_t, Point>::const_iterator it =
+		points_.find (key (meter, range, index));
+
+	if (it == points_.end())
+		return false;
+
+	*code = it->second.code;
+	*value = it->second.value;
+	return true;
+}
+
+void CalibrationCache::store (Meter meter, uint16_t range, uint16_t index,
+							  int32_t code, float value)
+{
+	if ((meter >= METERS) || (range > 0xFF))
+		return;
+
+	const Point point = {code, value};
+
+	std::pair<std::map<uint32_t, Point>::iterator, bool> inserted =
+		points_.insert (std::make_pair (key (meter, range, index), point));
+
+	if (inserted.second ||
+		(inserted.first->second.code != code) ||
+		(inserted.first->second.value != value))
+			dirty_ = true;
+
+	inserted.first->second = point;
+}
+
+void CalibrationCache::invalidate (Meter meter, uint16_t range)
+{
+	points_.erase (points_.lower_bound (key (meter, range, 0)),
+				   points_.upper_bound (key (meter, range, 0xFFFF)));
+
+	dirty_ = true;
+	stale_ = true;
+}
+
+void CalibrationCache::invalidate (Meter meter)
+{
+	points_.erase (points_.lower_bound (key (meter, 0, 0)),
+				   points_.upper_bound (key (meter, 0xFF, 0xFFFF)));
+
+	dirty_ = true;
+	stale_ = true;
+}
+
+/************************************************************************/
+
+bool CalibrationCache::hardwareVersion (uint32_t* version) const
+{
+	if (haveHardwareVersion_)
+		*version = hardwareVersion_;
+
+	return haveHardwareVersion_;
+}
+
+void CalibrationCache::setHardwareVersion (uint32_t version)
+{
+	if (!haveHardwareVersion_ || (hardwareVersion_ != version))
+		dirty_ = true;
+
+	haveHardwareVersion_ = true;
+	hardwareVersion_ = version;
+}
+
+void CalibrationCache::invalidateHardwareVersion (void)
+{
+	haveHardwareVersion_ = false;
+
+	dirty_ = true;
+	stale_ = true;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+std::string CalibrationCache::directory (void)
+{
+	if (const char* dir = getenv ("XSMU_CACHE_DIR"))
+		return dir;
+
+#if defined(_WIN32) || defined(_WIN64)
+	if (const char* dir = getenv ("LOCALAPPDATA"))
+		return std::string (dir) + "\\xsmu";
+#else
+	if (const char* dir = getenv ("XDG_CACHE_HOME"))
+		if (*dir) return std::string (dir) + "/xsmu";
+
+	if (const char* dir = getenv ("HOME"))
+		return std::string (dir) + "/.cache/xsmu";
+#endif
+
+	return std::string();
+}
+
+std::string CalibrationCache::path (void) const
+/*
+ * Serial numbers are alphanumeric, but
+ * are kept out of other directories regardless.
+ */
+{
+	const std::string dir = directory();
+	if (dir.empty() || serialNo_.empty())
+		return std::string();
+
+	std::string name;
+	for (size_t i = 0; i < serialNo_.size(); ++i)
+		name += isalnum ((unsigned char) serialNo_[i]) ? serialNo_[i] : '_';
+
+	return dir + "/" + name + ".cache";
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // end of namespace smu
@@ -0,0 +1,198 @@
+#include "../app/CalibrationEngine.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+CalibrationEngine::CalibrationEngine (uint8_t points) :
+	points_ (std::min<uint8_t> (points, MAX_POINTS))
+{
+	for (uint8_t range = 0; range < MAX_RANGES; ++range) {
+
+		for (uint8_t i = 0; i < MAX_POINTS; ++i) {
+
+			table_[range][i].adc = 0;
+			table_[range][i].value = 0;
+		}
+
+		known_[range] = 0;
+		build (range);
+	}
+}
+
+void CalibrationEngine::setPoint (uint8_t range, uint8_t index,
+								  int32_t adc, float value)
+{
+	if ((range >= MAX_RANGES) || (index >= points_))
+		return;
+
+	table_[range][index].adc = adc;
+	table_[range][index].value = value;
+	known_[range] |= 1u << index;
+
+	build (range);
+}
+
+void CalibrationEngine::invalidate (uint8_t range)
+{
+	if (range >= MAX_RANGES)
+		return;
+
+	known_[range] = 0;
+	build (range);
+}
+
+bool CalibrationEngine::calibrated (uint8_t range) const
+{
+	return (range < MAX_RANGES) && (known_[range] == (1u << points_) - 1);
+}
+
+/************************************************************************/
+
+void CalibrationEngine::build (uint8_t range)
+/*
+ * Points are taken in order of code, and of those sharing one, the
+ * last. Short of two distinct points, the map is the identity.
+ */
+{
+	Map& map = maps_[range];
+
+	Point points[MAX_POINTS];
+	uint8_t n = 0;
+
+	if (calibrated (range)) {
+
+		std::copy (table_[range], table_[range] + points_, points);
+
+		std::stable_sort (points, points + points_,
+			[](const Point& a, const Point& b) { return a.adc < b.adc; });
+
+		for (uint8_t i = 0; i < points_; ++i) {
+
+			if (n && (points[n - 1].adc == points[i].adc))
+				--n;
+
+			points[n++] = points[i];
+		}
+	}
+
+	if (n < 2) {
+
+		map.segments = 1;
+		map.adc[0] = 0;
+		map.value[0] = 0;
+		map.slope[0] = 1;
+		return;
+	}
+
+	map.segments = n - 1;
+
+	for (uint8_t i = 0; i < map.segments; ++i) {
+
+		map.adc[i] = points[i].adc;
+		map.value[i] = points[i].value;
+		map.slope[i] = float (
+			(double (points[i + 1].value) - points[i].value) /
+			(double (points[i + 1].adc) - points[i].adc));
+	}
+}
+
+/************************************************************************/
+
+void CalibrationEngine::convert (uint8_t range, const int32_t* adc,
+								 float* values, size_t n) const
+{
+	convert (maps_[std::min<uint8_t> (range, MAX_RANGES - 1)],
+		adc, values, n);
+}
+
+void CalibrationEngine::convert (const Map& map, const int32_t* adc,
+								 float* values, size_t n)
+/*
+ * Each lane starts on segment 0, and moves on to every segment
+ * whose first code it has reached, since segments are in order.
+ */
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 8 <= n; i += 8) {
+
+		const __m256i x = _mm256_loadu_si256 (
+			reinterpret_cast<const __m256i*> (adc + i));
+
+		__m256i x0 = _mm256_set1_epi32 (map.adc[0]);
+		__m256 v0 = _mm256_set1_ps (map.value[0]);
+		__m256 k = _mm256_set1_ps (map.slope[0]);
+
+		for (uint8_t j = 1; j < map.segments; ++j) {
+
+			const __m256i in = _mm256_cmpgt_epi32 (
+				x, _mm256_set1_epi32 (map.adc[j] - 1));
+
+			x0 = _mm256_blendv_epi8 (x0, _mm256_set1_epi32 (map.adc[j]), in);
+			v0 = _mm256_blendv_ps (v0, _mm256_set1_ps (map.value[j]),
+				_mm256_castsi256_ps (in));
+			k = _mm256_blendv_ps (k, _mm256_set1_ps (map.slope[j]),
+				_mm256_castsi256_ps (in));
+		}
+
+		const __m256 d = _mm256_cvtepi32_ps (_mm256_sub_epi32 (x, x0));
+		_mm256_storeu_ps (values + i, _mm256_add_ps (v0, _mm256_mul_ps (k, d)));
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= n; i += 4) {
+
+		const __m128i x = _mm_loadu_si128 (
+			reinterpret_cast<const __m128i*> (adc + i));
+
+		__m128i x0 = _mm_set1_epi32 (map.adc[0]);
+		__m128 v0 = _mm_set1_ps (map.value[0]);
+		__m128 k = _mm_set1_ps (map.slope[0]);
+
+		for (uint8_t j = 1; j < map.segments; ++j) {
+
+			const __m128i in = _mm_cmpgt_epi32 (
+				x, _mm_set1_epi32 (map.adc[j] - 1));
+			const __m128 inf = _mm_castsi128_ps (in);
+
+			/**** No blend before SSE4.1, so masks select ****/
+			x0 = _mm_or_si128 (_mm_and_si128 (in,
+				_mm_set1_epi32 (map.adc[j])), _mm_andnot_si128 (in, x0));
+			v0 = _mm_or_ps (_mm_and_ps (inf,
+				_mm_set1_ps (map.value[j])), _mm_andnot_ps (inf, v0));
+			k = _mm_or_ps (_mm_and_ps (inf,
+				_mm_set1_ps (map.slope[j])), _mm_andnot_ps (inf, k));
+		}
+
+		const __m128 d = _mm_cvtepi32_ps (_mm_sub_epi32 (x, x0));
+		_mm_storeu_ps (values + i, _mm_add_ps (v0, _mm_mul_ps (k, d)));
+	}
+#endif
+
+	for (; i < n; ++i) {
+
+		uint8_t s = 0;
+
+		for (uint8_t j = 1; j < map.segments; ++j)
+			if (adc[i] >= map.adc[j])
+				s = j;
+
+		const float d = float (adc[i] - map.adc[s]);
+		values[i] = map.value[s] + map.slope[s] * d;
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
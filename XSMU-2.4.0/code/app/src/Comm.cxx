@@ -1,14 +1,18 @@
 #include "../app/Comm.h"
-
+#include "../app/Simulator.h"
+#include "../../sys/sys/DeviceRegistry.h"
+#include "../../sys/sys/IoEngine.h"
+#include "../../sys/sys/Log.h"
+#include "../../sys/sys/Loopback.h"
+#include "../../sys/sys/Serial.h"
+#include "../../sys/sys/Timer.h"
+
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <vector>
 
-#define PRINT_DEBUG(x) { \
-std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ":" << x << std::endl; }
-
 using namespace std;
 
 namespace smu {
@@ -109,16 +113,31 @@ Comm_VM_Terminal toComm_VM_Terminal (uint16_t i)
 /************************************************************************/
 /************************************************************************/
 
-Comm::Comm (void)
+Comm::Comm (void) :
+	rxWatch_ (0),
+	nextTag_ (1),
+	rxTag_ (0),
+	txFlush_ (false),
+	txRunning_ (false),
+	txWriting_ (false),
+	txCorked_ (false),
+	txTask_ (0)
 {
-	qp4_  = new QP4;
-	ftdi_ = new FTDI;
+	qp4_       = new QP4;
+	transport_ = 0;
+	attached_  = false;
 }
 
 Comm::~Comm (void)
 {
-	if (ftdi_->good()) ftdi_->close();
-	delete ftdi_;
+	stopReceiver();
+	stopTransmitter();
+
+	if (transport_) {
+
+		if (transport_->good()) transport_->close();
+		delete transport_;
+	}
 
 	delete qp4_;
 }
@@ -127,28 +146,310 @@ Comm::~Comm (void)
 
 vector<FTDI_DeviceInfo> Comm::scan (void)
 {
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	return DeviceRegistry::instance().devices();
+#else
 	return FTDI::scan();
+#endif
 }
 
 /*************************************************************************/
 
 void Comm::check (void)
 {
+	std::lock_guard<std::mutex> lock (rxLock_);
 	checkReceiveQueue();
 }
 
 /************************************************************************/
 
-void Comm::transmit (const QP4_Packet* packet)
+void Comm::startReceiver (void)
+{
+	if (rxWatch_ || !transport_ || !transport_->good()) return;
+
+	rxWatch_ = IoEngine::instance().watch (
+		transport_->pollfd(), &Comm::receive, this);
+}
+
+void Comm::stopReceiver (void)
+{
+	if (!rxWatch_) return;
+
+	IoEngine::instance().unwatch (rxWatch_);
+	rxWatch_ = 0;
+}
+
+bool Comm::receive (void* user_data)
+/*
+ * Parses whatever the transport has, on the IoEngine's thread.
+ * A transport that has failed is left alone from then on.
+ */
+{
+	Comm* comm = reinterpret_cast<Comm*> (user_data);
+
+	comm->check();
+	return comm->transport_->good();
+}
+
+/************************************************************************/
+
+void Comm::transmit (const void* frame, uint16_t size)
+{
+	std::unique_lock<std::mutex> lock (txLock_);
+
+	if (queue (frame, size, lock))
+		writeQueued (lock);
+}
+
+bool Comm::queue (const void* frame, uint16_t size,
+				  std::unique_lock<std::mutex>& lock)
+/*
+ * Queues a frame, with txLock_ held in lock. Returns whether the caller
+ * is to write the queue itself, with writeQueued(), once it has let go
+ * of any other lock.
+ */
+{
+	/**** Closed, so nothing is being received meanwhile ****/
+	if (!txRunning_) {
+
+		if (transport_)
+			transport_->write (frame, size);
+
+		return false;
+	}
+
+	if (txQueue_.empty())
+		txQueuedAt_ = std::chrono::steady_clock::now();
+
+	const uint8_t* src = reinterpret_cast<const uint8_t*> (frame);
+	txQueue_.insert (txQueue_.end(), src, src + size);
+
+	const double delay = (txQueue_.size() < txPolicy_.maxBytes()) ?
+		txPolicy_.maxDelay() : 0;
+
+	/*
+	 * The caller writes by itself, sparing a handoff to the writer,
+	 * when nothing else is going out. Requests queued meanwhile
+	 * are left to a write task once it is done.
+	 */
+	if (txWriting_ || txCorked_)
+		return false;
+
+	if (delay == 0)
+		return true;
+
+	if (!txTask_)
+		txTask_ = IoEngine::instance().scheduleWrite (
+			&Comm::transmitTask, this, delay);
+
+	return false;
+}
+
+void Comm::writeQueued (std::unique_lock<std::mutex>& lock)
+/*
+ * Writes the queue from the calling thread. Expects txLock_ held in
+ * lock, and no write under way. A write task still pending finds
+ * nothing left, or what was queued during this write.
+ */
+{
+	txWriting_ = true;
+	txBuffer_.swap (txQueue_);
+	txQueue_.clear();
+	txFlush_ = false;
+
+	lock.unlock();
+	transport_->write (txBuffer_.data(), txBuffer_.size());
+	lock.lock();
+
+	txWriting_ = false;
+
+	if (txQueue_.empty() || !txRunning_ || txCorked_)
+		return;
+
+	if (txTask_)
+		IoEngine::instance().reschedule (txTask_, transmitDelay());
+	else
+		txTask_ = IoEngine::instance().scheduleWrite (
+			&Comm::transmitTask, this, transmitDelay());
+}
+
+void Comm::cork (void)
+{
+	std::lock_guard<std::mutex> lock (txLock_);
+	txCorked_ = true;
+}
+
+void Comm::uncork (void)
+{
+	std::unique_lock<std::mutex> lock (txLock_);
+	txCorked_ = false;
+
+	/**** A write under way leaves the rest to a task ****/
+	if (txQueue_.empty() || txWriting_ || !txRunning_)
+		return;
+
+	writeQueued (lock);
+}
+
+void Comm::flush (void)
+{
+	std::unique_lock<std::mutex> lock (txLock_);
+	if (txQueue_.empty()) return;
+
+	txFlush_ = true;
+
+	/**** A write under way leaves the rest to a task ****/
+	if (txWriting_ || txCorked_ || !txRunning_)
+		return;
+
+	writeQueued (lock);
+}
+
+void Comm::setTransmitPolicy (const Comm_TransmitPolicy& policy)
+{
+	std::lock_guard<std::mutex> lock (txLock_);
+	txPolicy_ = policy;
+
+	if (txTask_)
+		IoEngine::instance().reschedule (txTask_, transmitDelay());
+}
+
+Comm_TransmitPolicy Comm::transmitPolicy (void) const
+{
+	std::lock_guard<std::mutex> lock (txLock_);
+	return txPolicy_;
+}
+
+/************************************************************************/
+
+void Comm::startTransmitter (void)
+{
+	std::lock_guard<std::mutex> lock (txLock_);
+
+	if (txRunning_) return;
+
+	txQueue_.clear();
+	txQueue_.reserve (txPolicy_.maxBytes());
+	txBuffer_.reserve (txPolicy_.maxBytes());
+	txFlush_ = false;
+	txRunning_ = true;
+	txWriting_ = false;
+	txCorked_ = false;
+	txTask_ = 0;
+}
+
+void Comm::stopTransmitter (void)
+/*
+ * Whatever is still queued is written before returning.
+ */
+{
+	int task;
+
+	{
+		std::lock_guard<std::mutex> lock (txLock_);
+
+		if (!txRunning_) return;
+
+		txRunning_ = false;
+		task = txTask_;
+		txTask_ = 0;
+	}
+
+	if (task)
+		IoEngine::instance().cancel (task);
+
+	std::lock_guard<std::mutex> lock (txLock_);
+
+	if (!txQueue_.empty() && transport_)
+		transport_->write (txQueue_.data(), txQueue_.size());
+
+	txQueue_.clear();
+}
+
+double Comm::transmitTask (void* user_data)
+{
+	return reinterpret_cast<Comm*> (user_data)->transmitQueued();
+}
+
+double Comm::transmitQueued (void)
+/*
+ * Writes everything queued in one go, on the IoEngine's writer thread.
+ * Requests queued meanwhile accumulate and go out together in the next
+ * write. Returns when that is due, or -1 if nothing is left.
+ */
+{
+	std::unique_lock<std::mutex> lock (txLock_);
+
+	/**** uncork(), or the caller writing, sends what is queued meanwhile ****/
+	if (txCorked_ || txWriting_ || txQueue_.empty()) {
+
+		txTask_ = 0;
+		return -1;
+	}
+
+	/**** Buffers swap back and forth, so neither reallocates ****/
+	txWriting_ = true;
+	txBuffer_.swap (txQueue_);
+	txQueue_.clear();
+	txFlush_ = false;
+
+	lock.unlock();
+
+	SMU_LOG_DEBUG (LOG_COMM, "Writing {} bytes", txBuffer_.size());
+	transport_->write (txBuffer_.data(), txBuffer_.size());
+
+	lock.lock();
+
+	txWriting_ = false;
+
+	if (txQueue_.empty() || txCorked_) {
+
+		txTask_ = 0;
+		return -1;
+	}
+
+	return transmitDelay();
+}
+
+double Comm::transmitDelay (void) const
+/*
+ * How long queued requests may yet wait. Expects txLock_ held.
+ */
 {
-	ftdi_->write (packet, packet->size());
+	if (txFlush_ || (txQueue_.size() >= txPolicy_.maxBytes()))
+		return 0;
+
+	const double waited = std::chrono::duration<double> (
+		std::chrono::steady_clock::now() - txQueuedAt_).count();
+
+	return std::max (0.0, txPolicy_.maxDelay() - waited);
 }
 
 /************************************************************************/
 
-void Comm::setBaudRate (uint32_t baudRate)
+bool Comm::setBaudRate (uint32_t baudRate)
+{
+	return transport_ && transport_->setBaudRate (baudRate);
+}
+
+uint32_t Comm::receiveErrors (void) const
+{
+	return qp4_->receiver().errors();
+}
+
+bool Comm::setTransportParameters (const FTDI_Parameters& parameters)
+/*
+ * Only the libftdi transport has USB parameters to tune.
+ */
+{
+	FTDI* ftdi = dynamic_cast<FTDI*> (transport_);
+	return ftdi && ftdi->setParameters (parameters);
+}
+
+FTDI_Parameters Comm::transportParameters (void) const
 {
-	ftdi_->setBaudRate (baudRate);
+	const FTDI* ftdi = dynamic_cast<const FTDI*> (transport_);
+	return ftdi ? ftdi->parameters() : FTDI_Parameters();
 }
 
 /************************************************************************/
@@ -159,7 +460,9 @@ void Comm::checkReceiveQueue (void)
 	char rxbuf[4096];
 	uint32_t rxsize;
 
-	while ((rxsize = ftdi_->read (rxbuf, sizeof (rxbuf))))
+	if (!transport_) return;
+
+	while ((rxsize = transport_->read (rxbuf, sizeof (rxbuf))))
 		processReceivedData (rxbuf, rxsize);
 }
 
@@ -167,10 +470,11 @@ void Comm::processReceivedData (const void* data, uint16_t size)
 {
 	const uint8_t* src = reinterpret_cast<const uint8_t*> (data);
 
-	if (size) do {
+	while (size) {
 
-		//std::printf ("%X %c\n", static_cast<unsigned> (*src), *src);
-		qp4_->receiver().push_back (*src++);
+		const uint16_t consumed = qp4_->receiver().push (src, size);
+		src += consumed;
+		size -= consumed;
 
 		if (qp4_->receiver().ready()) {
 
@@ -180,8 +484,7 @@ void Comm::processReceivedData (const void* data, uint16_t size)
 			interpret (packet.first, packet.second);
 			qp4_->receiver().clear();
 		}
-
-	} while (--size);
+	}
 }
 
 void Comm::interpret (const void* data, uint16_t size)
@@ -248,6 +551,13 @@ void Comm::interpret (const void* data, uint16_t size)
 		&Comm::recDataCB,
 		&Comm::StartRecCB,
 		&Comm::StopRecCB,
+		&Comm::StartRecPushCB,
+		&Comm::recPushDataCB,
+		&Comm::CalibrationChecksumCB,
+		&Comm::GetCalibrationTablesCB,
+		&Comm::SystemConfig_GetListCB,
+		&Comm::SourceMeasureCB,
+		&Comm::BurstReadCB,
 	};
 
 	if (size < sizeof (CommPacket))
@@ -256,15 +566,92 @@ void Comm::interpret (const void* data, uint16_t size)
 	const CommPacket *packet =
 		reinterpret_cast<const CommPacket *> (data);
 
+	/**** Bursts come in several frames; only the last answers ****/
+	const bool last = (packet->opcode() != COMM_OPCODE_BURST_READ) ||
+		(size < sizeof (CommResponse_BurstRead)) ||
+		reinterpret_cast<const CommResponse_BurstRead*> (data)->last();
+
+	rxTag_ = matchTag (packet, last);
+
 	if (packet->opcode() < sizeof (cbs) / sizeof (cbs[0]))
 		(this->*cbs[packet->opcode()])(data, size);
 }
 
+/************************************************************************/
+
+uint16_t Comm::issueTag (uint16_t opcode)
+/*
+ * Expects tagLock_ held. Zero is never issued, as it
+ * is what untagging firmware sends back.
+ */
+{
+	const uint16_t tag = nextTag_;
+	nextTag_ = (nextTag_ == 0xFFFF) ? 1 : (nextTag_ + 1);
+
+	if (pendingRequests_.size() >= MAX_PENDING_REQUESTS)
+		pendingRequests_.pop_front();
+
+	const PendingRequest request = {tag, opcode};
+	pendingRequests_.push_back (request);
+
+	return tag;
+}
+
+uint16_t Comm::matchTag (const CommPacket* packet, bool last)
+/*
+ * Takes the request a response answers off the pending list, unless
+ * more frames are to follow, and returns its tag, or 0 for frames the
+ * SMU sends unasked.
+ */
+{
+	std::lock_guard<std::mutex> lock (tagLock_);
+
+	const uint16_t tag = packet->tag();
+	const uint16_t opcode = packet->opcode();
+
+	for (std::deque<PendingRequest>::iterator it = pendingRequests_.begin();
+		 it != pendingRequests_.end(); ++it) {
+
+		const bool answers = tag ? (it->tag == tag) :
+			((it->opcode == opcode) || (opcode == COMM_OPCODE_NOP));
+
+		if (answers) {
+
+			const uint16_t matched = it->tag;
+			pendingRequests_.erase (pendingRequests_.begin(),
+									last ? (it + 1) : it);
+			return matched;
+		}
+	}
+
+	return 0;
+}
+
+bool Comm::pending (uint16_t tag)
+{
+	std::lock_guard<std::mutex> lock (tagLock_);
+
+	for (std::deque<PendingRequest>::const_iterator it =
+		 pendingRequests_.begin(); it != pendingRequests_.end(); ++it)
+			if (it->tag == tag)
+				return true;
+
+	return false;
+}
+
+void Comm::do_callback (CommCB* oCB)
+{
+	oCB->tag (rxTag_);
+	Applet::do_callback (oCB);
+}
+
 /************************************************************************/
 /************************************************************************/
 
 void Comm::nopCB (const void* data, uint16_t size)
-{}
+{
+	do_callback (new (&callbackObject_) CommCB_NOP);
+}
 
 /************************************************************************/
 
@@ -787,33 +1174,18 @@ void Comm::recSizeCB (const void* data, uint16_t size)
 
 void Comm::recDataCB (const void* data, uint16_t size)
 {
-	PRINT_DEBUG ("Size : " << size << "Expected : " << sizeof(CommResponse_recData))
-
 	if (size < sizeof (CommResponse_recData))
-	{
-		PRINT_DEBUG ("SIZE NOT OKAY")
 		return;
-	}
-
-	PRINT_DEBUG ("SIZE OKAY")
 
 	const CommResponse_recData* res =
 		reinterpret_cast<const CommResponse_recData*> (data);
 
-	//Construct a std::vector<int32_t> from the recieved data array
-	uint16_t n = res->size();
-	std::vector<int32_t> recData;
-
-	for (uint16_t i = 0; i < n; ++i)
-	{
-		recData.push_back (res->recData(i));
-		std::cout << "Data pushed: " << recData[i] << std::endl;
-	}
+	/**** Never reads past the frame, whatever the count says ****/
+	const uint16_t capacity =
+		(size - sizeof (CommResponse_recData)) / sizeof (int32_t);
 
-	PRINT_DEBUG ("VECTOR CONSTRUCTED")
-
-	do_callback (new (&callbackObject_)
-		CommCB_recData (n, recData));
+	do_callback (new (&callbackObject_) CommCB_recData (
+		std::min (res->size(), capacity), res->rawData()));
 }
 
 /************************************************************************/
@@ -836,729 +1208,551 @@ void Comm::StopRecCB (const void* data, uint16_t size)
 	do_callback (new (&callbackObject_) CommCB_StopRec);
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Comm::open (const char* serialNo)
+void Comm::StartRecPushCB (const void* data, uint16_t size)
 {
-	ftdi_->open (serialNo, 9600);
+	if (size < sizeof (CommResponse_StartRecPush))
+		return;
+
+	const CommResponse_StartRecPush* res =
+		reinterpret_cast<const CommResponse_StartRecPush*> (data);
+
+	do_callback (new (&callbackObject_)
+		CommCB_StartRecPush (res->chunkSize()));
 }
 
-void Comm::close (void)
+/************************************************************************/
+
+void Comm::recPushDataCB (const void* data, uint16_t size)
+/*
+ * Unsolicited; arrives between the responses to whatever
+ * else is in flight.
+ */
 {
-	ftdi_->close();
+	if (size < sizeof (CommResponse_recPushData))
+		return;
+
+	const CommResponse_recPushData* res =
+		reinterpret_cast<const CommResponse_recPushData*> (data);
+
+	const uint16_t capacity =
+		(size - sizeof (CommResponse_recPushData)) / sizeof (int32_t);
+
+	do_callback (new (&callbackObject_) CommCB_recPushData (
+		std::min (res->size(), capacity), res->sequence(), res->rawData()));
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Comm::transmitIdentify (void)
+void Comm::CalibrationChecksumCB (const void* data, uint16_t size)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (sizeof (CommRequest_Identity));
+	if (size < sizeof (CommResponse_CalibrationChecksum))
+		return;
 
-	new (req->body()) CommRequest_Identity;
+	const CommResponse_CalibrationChecksum* res =
+		reinterpret_cast<const CommResponse_CalibrationChecksum*> (data);
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	do_callback (new (&callbackObject_)
+		CommCB_CalibrationChecksum (res->checksum()));
 }
 
 /************************************************************************/
 
-void Comm::transmit_keepAlive (uint32_t lease_time_ms)
+void Comm::GetCalibrationTablesCB (const void* data, uint16_t size)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_keepAlive));
+	if (size < sizeof (CommResponse_GetCalibrationTables))
+		return;
 
-	new (req->body())
-		CommRequest_keepAlive (lease_time_ms);
+	const CommResponse_GetCalibrationTables* res =
+		reinterpret_cast<const CommResponse_GetCalibrationTables*> (data);
 
-	req->seal();
-	transmit (req);
+	/**** Never reads past the frame, whatever the counts say ****/
+	const size_t capacity =
+		(size - sizeof (CommResponse_GetCalibrationTables)) /
+			(2 * sizeof (int32_t));
 
-	qp4_->transmitter().free_packet (req);
+	if ((size_t) res->ranges() * res->points() > capacity)
+		return;
+
+	do_callback (new (&callbackObject_) CommCB_GetCalibrationTables (
+		res->meter(), res->ranges(), res->points(), res->rawPoints()));
 }
+
 /************************************************************************/
 
-void Comm::transmitSourceMode (Comm_SourceMode mode)
+void Comm::SystemConfig_GetListCB (const void* data, uint16_t size)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_SetSourceMode));
+	if (size < sizeof (CommResponse_SystemConfig_GetList))
+		return;
+
+	const CommResponse_SystemConfig_GetList* res =
+		reinterpret_cast<const CommResponse_SystemConfig_GetList*> (data);
 
-	new (req->body())
-		CommRequest_SetSourceMode (mode);
+	const uint16_t capacity =
+		(size - sizeof (CommResponse_SystemConfig_GetList)) /
+			(2 * sizeof (int16_t));
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	do_callback (new (&callbackObject_) CommCB_SystemConfig_GetList (
+		std::min (res->count(), capacity), res->rawValues()));
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Comm::transmit_CS_setRange (Comm_CS_Range range)
+void Comm::SourceMeasureCB (const void* data, uint16_t size)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_SetRange));
+	if (size < sizeof (CommResponse_SourceMeasure))
+		return;
 
-	new (req->body()) CommRequest_CS_SetRange (range);
+	const CommResponse_SourceMeasure* res =
+		reinterpret_cast<const CommResponse_SourceMeasure*> (data);
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	do_callback (new (&callbackObject_) CommCB_SourceMeasure (
+		res->source(), res->meter(), res->value(), res->reading()));
 }
 
-void Comm::transmit_CS_getCalibration (uint16_t index)
+/************************************************************************/
+
+void Comm::BurstReadCB (const void* data, uint16_t size)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_GetCalibration));
+	if (size < sizeof (CommResponse_BurstRead))
+		return;
 
-	new (req->body())
-		CommRequest_CS_GetCalibration (index);
+	const CommResponse_BurstRead* res =
+		reinterpret_cast<const CommResponse_BurstRead*> (data);
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	/**** Never reads past the frame, whatever the count says ****/
+	const uint16_t capacity =
+		(size - sizeof (CommResponse_BurstRead)) / sizeof (float);
+
+	do_callback (new (&callbackObject_) CommCB_BurstRead (
+		res->meter(), std::min (res->size(), capacity),
+		res->offset(), res->total(), res->rawReadings()));
 }
 
-void Comm::transmit_CS_verifyCalibration (uint16_t index)
+/************************************************************************/
+/************************************************************************/
+
+void Comm::open (const char* serialNo)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_VerifyCalibration));
+	const char* address = serialNo;
 
-	new (req->body())
-		CommRequest_CS_VerifyCalibration (index);
+	stopReceiver();
+	stopTransmitter();
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
-}
+	if (!attached_) {
 
-void Comm::transmit_CS_setCalibration (uint16_t index,
-									   float current)
-{
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_SetCalibration));
+		delete transport_;
+		transport_ = createTransport (serialNo, &address);
+	}
 
-	new (req->body())
-		CommRequest_CS_SetCalibration (index, current);
+	qp4_->receiver().clear();
+	transport_->open (address, 9600);
+
+	{
+		std::lock_guard<std::mutex> lock (tagLock_);
+		pendingRequests_.clear();
+	}
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	if (!transport_->good())
+		SMU_LOG_WARNING (LOG_COMM, "Cannot open {}", serialNo);
+
+	startTransmitter();
+	startReceiver();
 }
 
-void Comm::transmit_CS_saveCalibration (void)
+void Comm::close (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_SaveCalibration));
-
-	new (req->body())
-		CommRequest_CS_SaveCalibration;
+	stopTransmitter();
+	stopReceiver();
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	if (transport_)
+		transport_->close();
 }
 
-void Comm::transmit_CS_setCurrent (float current)
+void Comm::attach (Transport* transport)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_SetCurrent));
+	stopReceiver();
+	stopTransmitter();
+	delete transport_;
 
-	new (req->body())
-		CommRequest_CS_SetCurrent (current);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	transport_ = transport;
+	attached_  = (transport != 0);
 }
 
-/************************************************************************/
+int Comm::pollfd (void) const
+{
+	return transport_ ? transport_->pollfd() : -1;
+}
 
-void Comm::transmit_VS_setRange (Comm_VS_Range range)
+Transport* Comm::createTransport (const char* name, const char** address)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_SetRange));
+	static const char loopbackPrefix[] = "loop:";
+	static const char simulatorPrefix[] = "sim:";
 
-	new (req->body())
-		CommRequest_VS_SetRange (range);
+	if (strncmp (name, simulatorPrefix, sizeof (simulatorPrefix) - 1) == 0) {
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
-}
+		*address = name + sizeof (simulatorPrefix) - 1;
+		return new Simulator;
+	}
 
-void Comm::transmit_VS_getCalibration (uint16_t index)
-{
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_GetCalibration));
+	if (strncmp (name, loopbackPrefix, sizeof (loopbackPrefix) - 1) == 0) {
 
-	new (req->body())
-		CommRequest_VS_GetCalibration (index);
+		*address = name + sizeof (loopbackPrefix) - 1;
+		return new Loopback;
+	}
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (strncmp (name, "/dev/", 5) == 0) {
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+		*address = name;
+		return new Serial;
+	}
+#endif
+
+	*address = name;
+	return new FTDI;
 }
 
-void Comm::transmit_VS_verifyCalibration (uint16_t index)
+/************************************************************************/
+/************************************************************************/
+
+uint16_t Comm::transmitIdentify (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_VerifyCalibration));
+	return transmit<CommRequest_Identity>();
+}
 
-	new (req->body())
-		CommRequest_VS_VerifyCalibration (index);
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_keepAlive (uint32_t lease_time_ms)
+{
+	return transmit<CommRequest_keepAlive> (lease_time_ms);
 }
+/************************************************************************/
 
-void Comm::transmit_VS_setCalibration (uint16_t index,
-									   float voltage)
+uint16_t Comm::transmitSourceMode (Comm_SourceMode mode)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_SetCalibration));
+	return transmit<CommRequest_SetSourceMode> (mode);
+}
 
-	new (req->body())
-		CommRequest_VS_SetCalibration (index, voltage);
+/************************************************************************/
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_CS_setRange (Comm_CS_Range range)
+{
+	return transmit<CommRequest_CS_SetRange> (range);
 }
 
-void Comm::transmit_VS_saveCalibration (void)
+uint16_t Comm::transmit_CS_getCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_SaveCalibration));
-
-	new (req->body())
-		CommRequest_VS_SaveCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_CS_GetCalibration> (index);
 }
 
-void Comm::transmit_VS_setVoltage (float voltage)
+uint16_t Comm::transmit_CS_verifyCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_SetVoltage));
-	//std::cout << "Comm : QP4_Packet allocated" << std::endl;
+	return transmit<CommRequest_CS_VerifyCalibration> (index);
+}
 
-	new (req->body())
-		CommRequest_VS_SetVoltage (voltage);
+uint16_t Comm::transmit_CS_setCalibration (uint16_t index,
+										   float current)
+{
+	return transmit<CommRequest_CS_SetCalibration> (index, current);
+}
 
-	req->seal();
-	transmit (req);
-	//std::cout << "Comm : Packet Sealed and Transmitted" << std::endl;
+uint16_t Comm::transmit_CS_saveCalibration (void)
+{
+	return transmit<CommRequest_CS_SaveCalibration>();
+}
 
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_CS_setCurrent (float current)
+{
+	return transmit<CommRequest_CS_SetCurrent> (current);
 }
 
 /************************************************************************/
 
-void Comm::transmit_CM_setRange (Comm_CM_Range range)
+uint16_t Comm::transmit_VS_setRange (Comm_VS_Range range)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_SetRange));
-
-	new (req->body())
-		CommRequest_CM_SetRange (range);
+	return transmit<CommRequest_VS_SetRange> (range);
+}
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_VS_getCalibration (uint16_t index)
+{
+	return transmit<CommRequest_VS_GetCalibration> (index);
 }
 
-void Comm::transmit_CM_getCalibration (uint16_t index)
+uint16_t Comm::transmit_VS_verifyCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_GetCalibration));
+	return transmit<CommRequest_VS_VerifyCalibration> (index);
+}
 
-	new (req->body())
-		CommRequest_CM_GetCalibration (index);
+uint16_t Comm::transmit_VS_setCalibration (uint16_t index,
+										   float voltage)
+{
+	return transmit<CommRequest_VS_SetCalibration> (index, voltage);
+}
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_VS_saveCalibration (void)
+{
+	return transmit<CommRequest_VS_SaveCalibration>();
 }
 
-void Comm::transmit_CM_setCalibration (uint16_t index,
-									   float current)
+uint16_t Comm::transmit_VS_setVoltage (float voltage)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_SetCalibration));
+	return transmit<CommRequest_VS_SetVoltage> (voltage);
+}
 
-	new (req->body())
-		CommRequest_CM_SetCalibration (index, current);
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_CM_setRange (Comm_CM_Range range)
+{
+	return transmit<CommRequest_CM_SetRange> (range);
 }
 
-void Comm::transmit_CM_saveCalibration (void)
+uint16_t Comm::transmit_CM_getCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_SaveCalibration));
-
-	new (req->body())
-		CommRequest_CM_SaveCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_CM_GetCalibration> (index);
 }
 
-void Comm::transmit_CM_read (uint16_t filterLength)
+uint16_t Comm::transmit_CM_setCalibration (uint16_t index,
+										   float current)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_Read));
+	return transmit<CommRequest_CM_SetCalibration> (index, current);
+}
 
-	new (req->body())
-		CommRequest_CM_Read (filterLength);
+uint16_t Comm::transmit_CM_saveCalibration (void)
+{
+	return transmit<CommRequest_CM_SaveCalibration>();
+}
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_CM_read (uint16_t filterLength)
+{
+	return transmit<CommRequest_CM_Read> (filterLength);
 }
 
 /************************************************************************/
 /************************************************************************/
 
-void Comm::transmit_VM_setRange (Comm_VM_Range range)
+uint16_t Comm::transmit_VM_setRange (Comm_VM_Range range)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_SetRange));
-
-	new (req->body())
-		CommRequest_VM_SetRange (range);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_SetRange> (range);
 }
 
-void Comm::transmit_VM_getCalibration (uint16_t index)
+uint16_t Comm::transmit_VM_getCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_GetCalibration));
-
-	new (req->body())
-		CommRequest_VM_GetCalibration (index);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_GetCalibration> (index);
 }
 
-void Comm::transmit_VM_setCalibration (uint16_t index,
-									   float voltage)
+uint16_t Comm::transmit_VM_setCalibration (uint16_t index,
+										   float voltage)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_SetCalibration));
-
-	new (req->body())
-		CommRequest_VM_SetCalibration (index, voltage);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_SetCalibration> (index, voltage);
 }
 
-void Comm::transmit_VM_saveCalibration (void)
+uint16_t Comm::transmit_VM_saveCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_SaveCalibration));
-
-	new (req->body())
-		CommRequest_VM_SaveCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_SaveCalibration>();
 }
 
-void Comm::transmit_VM_read (uint16_t filterLength)
+uint16_t Comm::transmit_VM_read (uint16_t filterLength)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_Read));
-
-	new (req->body())
-		CommRequest_VM_Read (filterLength);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_Read> (filterLength);
 }
 
 /************************************************************************/
 /************************************************************************/
 
-void Comm::transmit_CS_loadDefaultCalibration (void)
+uint16_t Comm::transmit_CS_loadDefaultCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CS_LoadDefaultCalibration));
-
-	new (req->body())
-		CommRequest_CS_LoadDefaultCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_CS_LoadDefaultCalibration>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_VS_loadDefaultCalibration (void)
+uint16_t Comm::transmit_VS_loadDefaultCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VS_LoadDefaultCalibration));
-
-	new (req->body())
-		CommRequest_VS_LoadDefaultCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VS_LoadDefaultCalibration>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_CM_loadDefaultCalibration (void)
+uint16_t Comm::transmit_CM_loadDefaultCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_CM_LoadDefaultCalibration));
-
-	new (req->body())
-		CommRequest_CM_LoadDefaultCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_CM_LoadDefaultCalibration>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_VM_loadDefaultCalibration (void)
+uint16_t Comm::transmit_VM_loadDefaultCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_LoadDefaultCalibration));
-
-	new (req->body())
-		CommRequest_VM_LoadDefaultCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_LoadDefaultCalibration>();
 }
 
 /************************************************************************/
 /************************************************************************/
 
-void Comm::transmit_RM_readAutoscale (uint16_t filterLength)
+uint16_t Comm::transmit_RM_readAutoscale (uint16_t filterLength)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_RM_ReadAutoscale));
-
-	new (req->body())
-		CommRequest_RM_ReadAutoscale (filterLength);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_RM_ReadAutoscale> (filterLength);
 }
 
 /************************************************************************/
 /************************************************************************/
 
-void Comm::transmit_SystemConfig_Get (uint16_t paramID)
+uint16_t Comm::transmit_SystemConfig_Get (uint16_t paramID)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_SystemConfig_Get));
-
-	new (req->body()) CommRequest_SystemConfig_Get (paramID);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SystemConfig_Get> (paramID);
 }
 
-void Comm::transmit_SystemConfig_Set (uint16_t paramID, int16_t value)
+uint16_t Comm::transmit_SystemConfig_Set (uint16_t paramID, int16_t value)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_SystemConfig_Set));
-
-	new (req->body()) CommRequest_SystemConfig_Set (paramID, value);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SystemConfig_Set> (paramID, value);
 }
 
-void Comm::transmit_SystemConfig_Save (void)
+uint16_t Comm::transmit_SystemConfig_Save (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_SystemConfig_Save));
-
-	new (req->body()) CommRequest_SystemConfig_Save;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SystemConfig_Save>();
 }
 
-void Comm::transmit_SystemConfig_LoadDefault (void)
+uint16_t Comm::transmit_SystemConfig_LoadDefault (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_SystemConfig_LoadDefault));
-
-	new (req->body()) CommRequest_SystemConfig_LoadDefault;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SystemConfig_LoadDefault>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_VM2_setRange (Comm_VM2_Range range)
+uint16_t Comm::transmit_VM2_setRange (Comm_VM2_Range range)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_SetRange));
-
-	new (req->body())
-		CommRequest_VM2_SetRange (range);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM2_SetRange> (range);
 }
 
-void Comm::transmit_VM2_getCalibration (uint16_t index)
+uint16_t Comm::transmit_VM2_getCalibration (uint16_t index)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_GetCalibration));
-
-	new (req->body())
-		CommRequest_VM2_GetCalibration (index);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM2_GetCalibration> (index);
 }
 
-void Comm::transmit_VM2_setCalibration (uint16_t index,
-									   float voltage)
+uint16_t Comm::transmit_VM2_setCalibration (uint16_t index,
+										   float voltage)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_SetCalibration));
-
-	new (req->body())
-		CommRequest_VM2_SetCalibration (index, voltage);
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM2_SetCalibration> (index, voltage);
 }
 
-void Comm::transmit_VM2_saveCalibration (void)
+uint16_t Comm::transmit_VM2_saveCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_SaveCalibration));
-
-	new (req->body())
-		CommRequest_VM2_SaveCalibration;
+	return transmit<CommRequest_VM2_SaveCalibration>();
+}
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_VM2_read (uint16_t filterLength)
+{
+	return transmit<CommRequest_VM2_Read> (filterLength);
 }
 
-void Comm::transmit_VM2_read (uint16_t filterLength)
+uint16_t Comm::transmit_VM2_loadDefaultCalibration (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_Read));
+	return transmit<CommRequest_VM2_LoadDefaultCalibration>();
+}
 
-	new (req->body())
-		CommRequest_VM2_Read (filterLength);
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_VM_setTerminal (Comm_VM_Terminal terminal)
+{
+	return transmit<CommRequest_VM_SetTerminal> (terminal);
 }
 
-void Comm::transmit_VM2_loadDefaultCalibration (void)
+uint16_t Comm::transmit_VM_getTerminal (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM2_LoadDefaultCalibration));
-
-	new (req->body())
-		CommRequest_VM2_LoadDefaultCalibration;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_VM_GetTerminal>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_VM_setTerminal (Comm_VM_Terminal terminal)
+uint16_t Comm::transmit_changeBaud (uint32_t baudRate)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_SetTerminal));
+	return transmit<CommRequest_changeBaud> (baudRate);
+}
 
-	new (req->body())
-		CommRequest_VM_SetTerminal (terminal);
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_recSize (void)
+{
+	return transmit<CommRequest_recSize>();
 }
 
-void Comm::transmit_VM_getTerminal (void)
+/************************************************************************/
+
+uint16_t Comm::transmit_recData (uint16_t size)
+/*
+ * Creates and transmits a CommRequest_recData packet, requesting for
+ * 'size' number of datapoints of recorded data to be transmitted
+ */
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_VM_GetTerminal));
+	return transmit<CommRequest_recData> (size);
+}
 
-	new (req->body())
-		CommRequest_VM_GetTerminal ();
+/************************************************************************/
 
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_StartRec (void)
+{
+	return transmit<CommRequest_StartRec>();
 }
 
 /************************************************************************/
 
-void Comm::transmit_changeBaud (uint32_t baudRate)
+uint16_t Comm::transmit_StopRec (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_changeBaud));
-
-	new (req->body())
-		CommRequest_changeBaud (baudRate);
+	return transmit<CommRequest_StopRec>();
+}
 
-	req->seal();
-	transmit (req);
+/************************************************************************/
 
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_StartRecPush (uint16_t chunkSize)
+{
+	return transmit<CommRequest_StartRecPush> (chunkSize);
 }
 
 /************************************************************************/
 
-void Comm::transmit_recSize (void)
+uint16_t Comm::transmit_CalibrationChecksum (void)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_recSize));
-
-	new (req->body())
-		CommRequest_recSize();
+	return transmit<CommRequest_CalibrationChecksum>();
+}
 
-	req->seal();
-	transmit (req);
+/************************************************************************/
 
-	qp4_->transmitter().free_packet (req);
+uint16_t Comm::transmit_GetCalibrationTables (Comm_Meter meter)
+{
+	return transmit<CommRequest_GetCalibrationTables> (meter);
 }
 
 /************************************************************************/
 
-void Comm::transmit_recData (uint16_t size)
+uint16_t Comm::transmit_SystemConfig_GetList (uint16_t count,
+											  const int16_t* paramIDs)
 /*
- * Creates and transmits a CommRequest_recData packet, requesting for
- * 'size' number of datapoints of recorded data to be transmitted
+ * Sends at most COMM_SYSTEM_CONFIG_LIST_MAX
+ * parameters; the caller splits longer lists.
  */
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_recData));
-
-	new (req->body())
-		CommRequest_recData (size);
-
-	req->seal();
-	transmit (req);
-
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SystemConfig_GetList> (
+		std::min<uint16_t> (count, COMM_SYSTEM_CONFIG_LIST_MAX), paramIDs);
 }
 
 /************************************************************************/
 
-void Comm::transmit_StartRec (void)
+uint16_t Comm::transmit_SourceMeasure (Comm_SourceMode source, float value,
+									   uint32_t settlingTime, Comm_Meter meter,
+									   uint16_t filterLength)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_StartRec));
-
-	new (req->body())
-		CommRequest_StartRec;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_SourceMeasure> (
+		source, value, settlingTime, meter, filterLength);
 }
 
 /************************************************************************/
 
-void Comm::transmit_StopRec (void)
+uint16_t Comm::transmit_BurstRead (Comm_Meter meter, uint16_t filterLength,
+								   uint32_t count)
 {
-	QP4_Packet* req =
-		qp4_->transmitter().alloc_packet (
-			sizeof (CommRequest_StopRec));
-
-	new (req->body())
-		CommRequest_StopRec;
-
-	req->seal();
-	transmit (req);
-	qp4_->transmitter().free_packet (req);
+	return transmit<CommRequest_BurstRead> (meter, filterLength, count);
 }
 
 /************************************************************************/
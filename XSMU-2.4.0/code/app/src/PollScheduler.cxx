@@ -0,0 +1,80 @@
+#include "../app/PollScheduler.h"
+#include "../../sys/sys/Log.h"
+
+#include <algorithm>
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+PollScheduler::PollScheduler (void) :
+	rate_ (0),
+	primed_ (false),
+	lastAt_ (0),
+	leftover_ (0)
+{}
+
+void PollScheduler::start (double expectedRate)
+{
+	rate_ = std::max (0.0, expectedRate);
+	primed_ = false;
+	leftover_ = 0;
+}
+
+double PollScheduler::update (double at, uint32_t available, uint32_t drained)
+{
+	static const double decay = 0.25;   // Weight of a lower rate
+
+	if (primed_ && (at > lastAt_)) {
+
+		/**** What arrived since, over the time it took ****/
+		const double produced =
+			std::max<int64_t> (0, int64_t (available) - leftover_);
+
+		const double rate = produced / (at - lastAt_);
+
+		rate_ = (rate > rate_) ? rate : (rate_ + decay * (rate - rate_));
+	}
+
+	if (available >= policy_.capacity())
+		SMU_LOG_WARNING (LOG_STREAM,
+			"SMU queue full at {} samples, polling too slowly", available);
+
+	primed_ = true;
+	lastAt_ = at;
+	leftover_ = int64_t (available) - drained;
+
+	return at + interval();
+}
+
+uint32_t PollScheduler::expected (double at) const
+{
+	if (!primed_)
+		return 0;
+
+	const double n = leftover_ + rate_ * std::max (0.0, at - lastAt_);
+	return (n > 0) ? uint32_t (n) : 0;
+}
+
+double PollScheduler::interval (void) const
+{
+	double interval = policy_.maxInterval();
+
+	if (rate_ > 0) {
+
+		const double room = policy_.targetFill() * policy_.capacity() -
+			std::max<int64_t> (0, leftover_);
+
+		interval = std::min (policy_.targetLatency(),
+							 std::max (0.0, room) / rate_);
+	}
+
+	return std::max (policy_.minInterval(),
+					 std::min (policy_.maxInterval(), interval));
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -0,0 +1,1464 @@
+#include "../app/Simulator.h"
+#include "../app/Comm.h"
+#include "../app/version.h"
+#include "../../sys/sys/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+SimulatorParameters::SimulatorParameters (void) :
+	usbLatency_     (1e-3),
+	jitter_         (0),
+	transferTime_   (125e-6),
+	processingTime_ (50e-6),
+	conversionTime_ (100e-6),
+	sampleRate_     (10),
+	streamCapacity_ (8192),
+	maxBaudRate_    (3000000),
+	load_           (1e3),
+	noise_          (1e-4),
+	echoTags_       (false)
+{}
+
+void SimulatorParameters::parse (const char* options)
+{
+	std::string s (options);
+	size_t begin = 0;
+
+	while (begin < s.size()) {
+
+		size_t end = s.find (',', begin);
+		if (end == std::string::npos) end = s.size();
+
+		const std::string option = s.substr (begin, end - begin);
+		const size_t eq = option.find ('=');
+		begin = end + 1;
+
+		if (eq == std::string::npos)
+			continue;
+
+		const std::string key = option.substr (0, eq);
+		const double value = strtod (option.c_str() + eq + 1, 0);
+
+		if      (key == "latency")    usbLatency (value);
+		else if (key == "jitter")     jitter (value);
+		else if (key == "transfer")   transferTime (value);
+		else if (key == "processing") processingTime (value);
+		else if (key == "conversion") conversionTime (value);
+		else if (key == "rate")       sampleRate (value);
+		else if (key == "capacity")   streamCapacity (value);
+		else if (key == "maxbaud")    maxBaudRate (value);
+		else if (key == "load")       load (value);
+		else if (key == "noise")      noise (value);
+		else if (key == "tags")       echoTags (value != 0);
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+/*
+ * Response under construction. Fields are appended in network order,
+ * after the opcode and reserve words every packet begins with. The
+ * reserve word carries the request's tag back, as CommPacket describes.
+ */
+class Simulator::Reply
+{
+	public:
+	Reply (uint16_t opcode, uint16_t tag) :
+		busy_ (0),
+		silent_ (false)
+	{
+		put16 (opcode);
+		put16 (tag);
+	}
+
+	public:
+	void put16 (uint16_t x) {
+		bytes_.push_back (x >> 8);
+		bytes_.push_back (x & 0xFF);
+	}
+
+	void put32 (uint32_t x) {
+		put16 (x >> 16);
+		put16 (x & 0xFFFF);
+	}
+
+	void putFloat (float x) {
+		uint32_t u;
+		memcpy (&u, &x, sizeof (u));
+		put32 (u);
+	}
+
+	void putString (const char* str, size_t size) {
+		const size_t len = std::min (strlen (str), size);
+		bytes_.insert (bytes_.end(), str, str + len);
+		bytes_.insert (bytes_.end(), size - len, 0);
+	}
+
+	public:
+	void delay (double t) { busy_ += t; }
+	void silence (void)   { silent_ = true; }
+
+	public:
+	const std::vector<uint8_t>& bytes (void) const { return bytes_; }
+	double busy   (void) const { return busy_;   }
+	bool   silent (void) const { return silent_; }
+
+	private:
+	std::vector<uint8_t> bytes_;
+	double busy_;
+	bool silent_;
+};
+
+/************************************************************************/
+
+static uint16_t get16 (const uint8_t* req, uint16_t size, uint16_t offset)
+{
+	if (offset + 2 > size) return 0;
+	return ((uint16_t)(req[offset]) << 8) | req[offset + 1];
+}
+
+static uint32_t get32 (const uint8_t* req, uint16_t size, uint16_t offset)
+{
+	return ((uint32_t)(get16 (req, size, offset)) << 16) |
+		get16 (req, size, offset + 2);
+}
+
+static float getFloat (const uint8_t* req, uint16_t size, uint16_t offset)
+{
+	const uint32_t u = get32 (req, size, offset);
+
+	float x;
+	memcpy (&x, &u, sizeof (x));
+	return x;
+}
+
+static double now (void)
+{
+	return std::chrono::duration<double> (
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/************************************************************************/
+/************************************************************************/
+
+Simulator::Simulator (void) :
+	open_ (false),
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	timerfd_ (timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+#else
+	timerfd_ (-1)
+#endif
+{
+	reset();
+}
+
+Simulator::Simulator (const SimulatorParameters& parameters) :
+	parameters_ (parameters),
+	open_ (false),
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	timerfd_ (timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+#else
+	timerfd_ (-1)
+#endif
+{
+	reset();
+}
+
+Simulator::~Simulator (void)
+{
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (timerfd_ >= 0)
+		::close (timerfd_);
+#endif
+}
+
+void Simulator::setParameters (const SimulatorParameters& parameters)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	parameters_ = parameters;
+}
+
+void Simulator::reset (void)
+/*
+ * Power-on state of the firmware and an idle link.
+ */
+{
+	receiver_.clear();
+	hostBaudRate_    = 9600;
+	deviceBaudRate_  = 9600;
+	pendingBaudRate_ = 0;
+	baudSwitchAt_    = 0;
+	inboundFreeAt_   = 0;
+	outboundFreeAt_  = 0;
+	busyUntil_       = 0;
+	lastDue_         = 0;
+	corruptCounter_  = 0;
+	outbound_.clear();
+	outboundOffset_  = 0;
+	random_.seed (0);
+
+	sourceMode_  = COMM_SOURCE_MODE_CURRENT;
+	CS_range_    = COMM_CS_RANGE_10uA;
+	VS_range_    = COMM_VS_RANGE_10V;
+	CM_range_    = COMM_CM_RANGE_10uA;
+	VM_range_    = COMM_VM_RANGE_1mV;
+	VM2_range_   = COMM_VM2_RANGE_10V;
+	VM_terminal_ = COMM_VM_TERMINAL_MEASUREMENT;
+	current_ = voltage_ = 0;
+	CS_dac_  = VS_dac_  = 0;
+
+	CS_calibration_.clear();
+	for (uint16_t r = 0; r < 5; ++r)
+		CS_calibration_.push_back (defaultTable (CS_fullScale (r), DAC_STEP));
+
+	VS_calibration_.clear();
+	for (uint16_t r = 0; r < 2; ++r)
+		VS_calibration_.push_back (defaultTable (VS_fullScale (r), DAC_STEP));
+
+	CM_calibration_.clear();
+	for (uint16_t r = 0; r < 5; ++r)
+		CM_calibration_.push_back (defaultTable (CM_fullScale (r), ADC_STEP));
+
+	VM_calibration_.clear();
+	for (uint16_t r = 0; r < 6; ++r)
+		VM_calibration_.push_back (defaultTable (VM_fullScale (r), ADC_STEP));
+
+	VM2_calibration_.assign (1, defaultTable (VM2_fullScale (0), ADC_STEP));
+
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO]  = 4;
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO]    = 0;
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO] = 0;
+
+	recording_    = false;
+	recStartedAt_ = 0;
+	recProduced_  = 0;
+	recConsumed_  = 0;
+	recPush_      = false;
+	recPushChunk_ = 1;
+	recPushSequence_ = 0;
+	recPushAt_    = 0;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Simulator::open (const char* name, int baudrate)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	if (open_) return;
+
+	parameters_.parse (name);
+	reset();
+
+	hostBaudRate_ = deviceBaudRate_ = baudrate;
+	open_ = true;
+}
+
+void Simulator::close (void)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	open_ = false;
+	outbound_.clear();
+	outboundOffset_ = 0;
+	armTimer();
+}
+
+bool Simulator::setBaudRate (uint32_t bd)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	if (!open_ || (bd < 300) || (bd > 3000000))
+		return false;
+
+	hostBaudRate_ = bd;
+	return true;
+}
+
+/************************************************************************/
+
+uint32_t Simulator::write (const void* data, uint32_t size)
+/*
+ * Each write is one USB transfer, which blocks the caller for
+ * transferTime, like libftdi does. Its bytes then reach the firmware
+ * as they are clocked out at the host's baud rate, behind anything
+ * written earlier.
+ */
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	if (!open_) return 0;
+
+	const double start =
+		std::max (now(), inboundFreeAt_) + parameters_.transferTime();
+
+	inboundFreeAt_ = start + size * 10.0 / hostBaudRate_;
+
+	const uint32_t baudRate = deviceBaudRate (inboundFreeAt_);
+	const uint8_t* src = reinterpret_cast<const uint8_t*> (data);
+
+	for (uint32_t i = 0; i < size; ++i) {
+
+		const double arrival = start + (i + 1) * 10.0 / hostBaudRate_;
+
+		uint8_t x = src[i];
+
+		if (baudRate != hostBaudRate_)
+			x ^= 0x55;
+
+		else if ((baudRate > parameters_.maxBaudRate()) &&
+			(++corruptCounter_ % 50 == 0))
+				x ^= 0x01;
+
+		receiver_.push_back (x);
+
+		if (receiver_.ready()) {
+
+			std::pair<const void*, uint16_t> packet = receiver_.data();
+
+			execute (reinterpret_cast<const uint8_t*> (packet.first),
+				packet.second, arrival);
+
+			receiver_.clear();
+		}
+	}
+
+	lock.unlock();
+
+	if (parameters_.transferTime() > 0)
+		Timer::sleep (parameters_.transferTime());
+
+	return size;
+}
+
+uint32_t Simulator::read (void* data, uint32_t size)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	if (!open_) return 0;
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	uint64_t expirations;
+	if (::read (timerfd_, &expirations, sizeof (expirations)) < 0) {}
+#endif
+
+	const double t = now();
+	uint8_t* dst = reinterpret_cast<uint8_t*> (data);
+	uint32_t rxsize = 0;
+
+	pushStream (t);
+
+	while ((rxsize < size) && !outbound_.empty() &&
+		(outbound_.front().due <= t)) {
+
+		const Chunk& chunk = outbound_.front();
+		const uint8_t mask = (chunk.baudRate != hostBaudRate_) ? 0x55 : 0;
+
+		while ((rxsize < size) && (outboundOffset_ < chunk.bytes.size()))
+			dst[rxsize++] = chunk.bytes[outboundOffset_++] ^ mask;
+
+		if (outboundOffset_ == chunk.bytes.size()) {
+
+			outbound_.pop_front();
+			outboundOffset_ = 0;
+		}
+	}
+
+	armTimer();
+	return rxsize;
+}
+
+/************************************************************************/
+
+uint32_t Simulator::deviceBaudRate (double at) const
+{
+	if (pendingBaudRate_ && (baudSwitchAt_ >= 0) && (at >= baudSwitchAt_))
+		return pendingBaudRate_;
+
+	return deviceBaudRate_;
+}
+
+void Simulator::execute (const uint8_t* data, uint16_t size, double arrival)
+{
+	static const Handler handlers[] =
+	{
+		&Simulator::acknowledge,
+		&Simulator::identify,
+		&Simulator::keepAlive,
+		&Simulator::setSourceMode,
+
+		&Simulator::CS_setRange,
+		&Simulator::CS_getCalibration,
+		&Simulator::CS_verifyCalibration,
+		&Simulator::CS_setCalibration,
+		&Simulator::acknowledge,                // CS_SAVE_CALIBRATION
+		&Simulator::CS_setCurrent,
+
+		&Simulator::VS_setRange,
+		&Simulator::VS_getCalibration,
+		&Simulator::VS_verifyCalibration,
+		&Simulator::VS_setCalibration,
+		&Simulator::acknowledge,                // VS_SAVE_CALIBRATION
+		&Simulator::VS_setVoltage,
+
+		&Simulator::CM_setRange,
+		&Simulator::CM_getCalibration,
+		&Simulator::CM_setCalibration,
+		&Simulator::acknowledge,                // CM_SAVE_CALIBRATION
+		&Simulator::CM_read,
+
+		&Simulator::VM_setRange,
+		&Simulator::VM_getCalibration,
+		&Simulator::VM_setCalibration,
+		&Simulator::acknowledge,                // VM_SAVE_CALIBRATION
+		&Simulator::VM_read,
+
+		&Simulator::CS_loadDefaultCalibration,
+		&Simulator::VS_loadDefaultCalibration,
+		&Simulator::CM_loadDefaultCalibration,
+		&Simulator::VM_loadDefaultCalibration,
+
+		&Simulator::RM_readAutoscale,
+
+		&Simulator::SystemConfig_get,
+		&Simulator::SystemConfig_set,
+		&Simulator::acknowledge,                // SYSTEM_CONFIG_SAVE
+		&Simulator::SystemConfig_loadDefault,
+
+		&Simulator::VM2_setRange,
+		&Simulator::VM2_getCalibration,
+		&Simulator::VM2_setCalibration,
+		&Simulator::acknowledge,                // VM2_SAVE_CALIBRATION
+		&Simulator::VM2_read,
+		&Simulator::VM2_loadDefaultCalibration,
+
+		&Simulator::VM_setTerminal,
+		&Simulator::VM_getTerminal,
+
+		&Simulator::changeBaud,
+		&Simulator::recSize,
+		&Simulator::recData,
+		&Simulator::startRec,
+		&Simulator::stopRec,
+		&Simulator::startRecPush,
+		&Simulator::acknowledge,                // REC_PUSH_DATA, sent unasked
+		&Simulator::calibrationChecksum,
+		&Simulator::getCalibrationTables,
+		&Simulator::SystemConfig_getList,
+		&Simulator::sourceMeasure,
+		&Simulator::burstRead,
+	};
+
+	const uint16_t opcode = get16 (data, size, 0);
+
+	if ((size < sizeof (uint32_t)) ||
+		(opcode >= sizeof (handlers) / sizeof (handlers[0])))
+			return;
+
+	/**** The firmware serves one request at a time ****/
+	const double start = std::max (arrival, busyUntil_);
+
+	if (pendingBaudRate_ && (baudSwitchAt_ >= 0) && (start >= baudSwitchAt_)) {
+
+		deviceBaudRate_ = pendingBaudRate_;
+		pendingBaudRate_ = 0;
+	}
+
+	/**** Pushed frames ready meanwhile go out ahead of the reply ****/
+	pushStream (start);
+
+	clock_ = start + parameters_.processingTime();
+
+	Reply res (opcode,
+		parameters_.echoTags() ? get16 (data, size, 2) : 0);
+
+	(this->*handlers[opcode])(data, size, res);
+
+	busyUntil_ = clock_ + res.busy();
+
+	if (!res.silent())
+		send (res, busyUntil_);
+}
+
+void Simulator::send (const Reply& reply, double ready)
+{
+	const std::vector<uint8_t>& body = reply.bytes();
+
+	QP4_Packet* packet = QP4_Packet::alloc (body.size());
+	memcpy (packet->body(), &body[0], body.size());
+	packet->seal();
+
+	const uint8_t* frame = reinterpret_cast<const uint8_t*> (packet);
+
+	Chunk chunk;
+	chunk.bytes.assign (frame, frame + packet->size());
+	QP4_Packet::free (packet);
+
+	/**** Clocked out at the device's rate, behind earlier replies ****/
+	const double txStart = std::max (ready, outboundFreeAt_);
+	chunk.baudRate = deviceBaudRate (txStart);
+
+	const double txEnd = txStart + chunk.bytes.size() * 10.0 / chunk.baudRate;
+	outboundFreeAt_ = txEnd;
+
+	if (chunk.baudRate > parameters_.maxBaudRate())
+		for (size_t i = 0; i < chunk.bytes.size(); ++i)
+			if (++corruptCounter_ % 50 == 0)
+				chunk.bytes[i] ^= 0x01;
+
+	/**** A baud rate change takes effect once its reply is out ****/
+	if (pendingBaudRate_ && (baudSwitchAt_ < 0))
+		baudSwitchAt_ = txEnd;
+
+	std::uniform_real_distribution<double> jitter (0, parameters_.jitter());
+
+	chunk.due = txEnd + parameters_.usbLatency() + jitter (random_);
+	chunk.due = std::max (chunk.due, lastDue_);
+	lastDue_ = chunk.due;
+
+	outbound_.push_back (chunk);
+	armTimer();
+}
+
+void Simulator::armTimer (void)
+/*
+ * Makes the timer descriptor readable once the oldest
+ * pending reply is due, or a pushed frame may be ready.
+ */
+{
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (timerfd_ < 0) return;
+
+	struct itimerspec spec;
+	memset (&spec, 0, sizeof (spec));
+
+	const bool pushing = open_ && recPush_ && (parameters_.sampleRate() > 0);
+
+	if (!outbound_.empty() || pushing) {
+
+		double due = std::numeric_limits<double>::max();
+
+		if (!outbound_.empty())
+			due = outbound_.front().due;
+
+		if (pushing)
+			due = std::min (due, std::max (recPushAt_, outboundFreeAt_));
+
+		/**** An all-zero value would disarm the timer ****/
+		due = std::max (due, 1e-9);
+
+		spec.it_value.tv_sec  = (time_t)(due);
+		spec.it_value.tv_nsec = (long)((due - spec.it_value.tv_sec) * 1e9);
+	}
+
+	timerfd_settime (timerfd_, TFD_TIMER_ABSTIME, &spec, 0);
+#endif
+}
+
+/************************************************************************/
+/************************************************************************/
+
+Simulator::CalibrationTable
+Simulator::defaultTable (double fullScale, int32_t step)
+/*
+ * Evenly spaced points from -fullScale to +fullScale.
+ */
+{
+	CalibrationTable table (CALIBRATION_POINTS);
+	const int mid = CALIBRATION_POINTS / 2;
+
+	for (int i = 0; i < CALIBRATION_POINTS; ++i) {
+
+		table[i].code  = (i - mid) * step;
+		table[i].value = fullScale * (i - mid) / mid;
+	}
+
+	return table;
+}
+
+int32_t Simulator::toCode (const CalibrationTable& table, double value)
+{
+	const CalibrationPoint& lo = table.front();
+	const CalibrationPoint& hi = table.back();
+
+	if (hi.value == lo.value)
+		return lo.code;
+
+	return lo.code + (int32_t) std::lround (
+		(value - lo.value) * (hi.code - lo.code) / (hi.value - lo.value));
+}
+
+double Simulator::CS_fullScale (uint16_t range)
+{
+	return 10e-6 * std::pow (10.0, range);
+}
+
+double Simulator::VS_fullScale (uint16_t range)
+{
+	return 10 * std::pow (10.0, range);
+}
+
+double Simulator::CM_fullScale (uint16_t range)
+{
+	return 10e-6 * std::pow (10.0, range);
+}
+
+double Simulator::VM_fullScale (uint16_t range)
+{
+	return 1e-3 * std::pow (10.0, range);
+}
+
+double Simulator::VM2_fullScale (uint16_t range)
+{
+	return 10;
+}
+
+/************************************************************************/
+
+double Simulator::sourceVoltage (void) const
+{
+	return (sourceMode_ == COMM_SOURCE_MODE_VOLTAGE) ?
+		voltage_ : current_ * parameters_.load();
+}
+
+double Simulator::sourceCurrent (void) const
+{
+	return (sourceMode_ == COMM_SOURCE_MODE_CURRENT) ?
+		current_ : voltage_ / parameters_.load();
+}
+
+double Simulator::measure (uint16_t filterLength, double value,
+						   double fullScale)
+/*
+ * A filtered reading clips at full scale, and averages the noise
+ * down over filterLength conversions.
+ */
+{
+	const double n = std::max<uint16_t> (filterLength, 1);
+	std::normal_distribution<double> noise (0,
+		parameters_.noise() * fullScale / std::sqrt (n));
+
+	value = std::max (-fullScale, std::min (fullScale, value));
+	return value + noise (random_);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Simulator::acknowledge (const uint8_t* req, uint16_t size, Reply& res)
+{
+	if (get16 (req, size, 0) == COMM_OPCODE_NOP)
+		res.silence();
+}
+
+void Simulator::identify (const uint8_t* req, uint16_t size, Reply& res)
+{
+	res.putString ("XPLORE SMU", 32);
+
+	res.put32 (MAKE_VERSION_NO (
+		systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO],
+		systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO],
+		systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO]));
+
+	res.put32 (MAKE_VERSION_NO (2, 4, 0));
+}
+
+void Simulator::keepAlive (const uint8_t* req, uint16_t size, Reply& res)
+{
+	res.put32 (get32 (req, size, 4));
+}
+
+void Simulator::setSourceMode (const uint8_t* req, uint16_t size, Reply& res)
+{
+	sourceMode_ = toComm_SourceMode (get16 (req, size, 4));
+
+	res.put16 (sourceMode_);
+	res.put16 (0);
+}
+
+/************************************************************************/
+
+void Simulator::CS_setRange (const uint8_t* req, uint16_t size, Reply& res)
+{
+	CS_range_ = toComm_CS_Range (get16 (req, size, 4));
+	current_ = CS_dac_ = 0;
+
+	res.put16 (CS_range_);
+	res.put16 (0);
+}
+
+void Simulator::CS_getCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = CS_calibration_[CS_range_][index];
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::CS_verifyCalibration (const uint8_t* req, uint16_t size,
+									  Reply& res)
+/*
+ * Drives the output at a calibration point.
+ */
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = CS_calibration_[CS_range_][index];
+
+	CS_dac_ = point.code;
+	current_ = CS_dac_ * CS_fullScale (CS_range_) / (2 * DAC_STEP);
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::CS_setCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+/*
+ * Records the value measured externally for the present DAC code.
+ */
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	CalibrationPoint& point = CS_calibration_[CS_range_][index];
+	point.code  = CS_dac_;
+	point.value = getFloat (req, size, 8);
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::CS_setCurrent (const uint8_t* req, uint16_t size, Reply& res)
+{
+	const double fullScale = CS_fullScale (CS_range_);
+	const double current =
+		std::max (-fullScale, std::min<double> (fullScale,
+			getFloat (req, size, 4)));
+
+	CS_dac_ = toCode (CS_calibration_[CS_range_], current);
+	current_ = CS_dac_ * fullScale / (2 * DAC_STEP);
+
+	res.putFloat (current);
+}
+
+/************************************************************************/
+
+void Simulator::VS_setRange (const uint8_t* req, uint16_t size, Reply& res)
+{
+	VS_range_ = toComm_VS_Range (get16 (req, size, 4));
+	voltage_ = VS_dac_ = 0;
+
+	res.put16 (VS_range_);
+	res.put16 (0);
+}
+
+void Simulator::VS_getCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = VS_calibration_[VS_range_][index];
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VS_verifyCalibration (const uint8_t* req, uint16_t size,
+									  Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = VS_calibration_[VS_range_][index];
+
+	VS_dac_ = point.code;
+	voltage_ = VS_dac_ * VS_fullScale (VS_range_) / (2 * DAC_STEP);
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VS_setCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	CalibrationPoint& point = VS_calibration_[VS_range_][index];
+	point.code  = VS_dac_;
+	point.value = getFloat (req, size, 8);
+
+	res.put16 (index);
+	res.put16 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VS_setVoltage (const uint8_t* req, uint16_t size, Reply& res)
+{
+	const double fullScale = VS_fullScale (VS_range_);
+	const double voltage =
+		std::max (-fullScale, std::min<double> (fullScale,
+			getFloat (req, size, 4)));
+
+	VS_dac_ = toCode (VS_calibration_[VS_range_], voltage);
+	voltage_ = VS_dac_ * fullScale / (2 * DAC_STEP);
+
+	res.putFloat (voltage);
+}
+
+/************************************************************************/
+
+void Simulator::CM_setRange (const uint8_t* req, uint16_t size, Reply& res)
+{
+	CM_range_ = toComm_CM_Range (get16 (req, size, 4));
+
+	res.put16 (CM_range_);
+	res.put16 (0);
+}
+
+void Simulator::CM_getCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = CM_calibration_[CM_range_][index];
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::CM_setCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+/*
+ * Records the externally known value against the present ADC reading.
+ */
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const double fullScale = CM_fullScale (CM_range_);
+
+	CalibrationPoint& point = CM_calibration_[CM_range_][index];
+	point.code  = toCode (defaultTable (fullScale, ADC_STEP),
+		measure (1, sourceCurrent(), fullScale));
+	point.value = getFloat (req, size, 8);
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::CM_read (const uint8_t* req, uint16_t size, Reply& res)
+{
+	const uint16_t filterLength = get16 (req, size, 4);
+
+	res.delay (filterLength * parameters_.conversionTime());
+	res.putFloat (measure (filterLength, sourceCurrent(),
+		CM_fullScale (CM_range_)));
+}
+
+/************************************************************************/
+
+void Simulator::VM_setRange (const uint8_t* req, uint16_t size, Reply& res)
+{
+	VM_range_ = toComm_VM_Range (get16 (req, size, 4));
+
+	res.put16 (VM_range_);
+	res.put16 (0);
+}
+
+void Simulator::VM_getCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = VM_calibration_[VM_range_][index];
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VM_setCalibration (const uint8_t* req, uint16_t size,
+								   Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const double fullScale = VM_fullScale (VM_range_);
+
+	CalibrationPoint& point = VM_calibration_[VM_range_][index];
+	point.code  = toCode (defaultTable (fullScale, ADC_STEP),
+		measure (1, sourceVoltage(), fullScale));
+	point.value = getFloat (req, size, 8);
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VM_read (const uint8_t* req, uint16_t size, Reply& res)
+{
+	const uint16_t filterLength = get16 (req, size, 4);
+
+	res.delay (filterLength * parameters_.conversionTime());
+	res.putFloat (measure (filterLength, sourceVoltage(),
+		VM_fullScale (VM_range_)));
+}
+
+/************************************************************************/
+
+void Simulator::CS_loadDefaultCalibration (const uint8_t* req, uint16_t size,
+										   Reply& res)
+{
+	CS_calibration_[CS_range_] =
+		defaultTable (CS_fullScale (CS_range_), DAC_STEP);
+}
+
+void Simulator::VS_loadDefaultCalibration (const uint8_t* req, uint16_t size,
+										   Reply& res)
+{
+	VS_calibration_[VS_range_] =
+		defaultTable (VS_fullScale (VS_range_), DAC_STEP);
+}
+
+void Simulator::CM_loadDefaultCalibration (const uint8_t* req, uint16_t size,
+										   Reply& res)
+{
+	CM_calibration_[CM_range_] =
+		defaultTable (CM_fullScale (CM_range_), ADC_STEP);
+}
+
+void Simulator::VM_loadDefaultCalibration (const uint8_t* req, uint16_t size,
+										   Reply& res)
+{
+	VM_calibration_[VM_range_] =
+		defaultTable (VM_fullScale (VM_range_), ADC_STEP);
+}
+
+/************************************************************************/
+
+void Simulator::RM_readAutoscale (const uint8_t* req, uint16_t size,
+								  Reply& res)
+/*
+ * Autoscaling takes a voltage and a current reading.
+ */
+{
+	const uint16_t filterLength = get16 (req, size, 4);
+	const double load = parameters_.load();
+
+	res.delay (2 * filterLength * parameters_.conversionTime());
+	res.putFloat (measure (filterLength, load, 2 * load));
+}
+
+/************************************************************************/
+
+void Simulator::SystemConfig_get (const uint8_t* req, uint16_t size,
+								  Reply& res)
+{
+	const uint16_t paramID = get16 (req, size, 4);
+	const int16_t value = (paramID < 3) ? systemConfig_[paramID] : 0;
+
+	res.put16 (paramID);
+	res.put16 (value);
+}
+
+void Simulator::SystemConfig_set (const uint8_t* req, uint16_t size,
+								  Reply& res)
+{
+	const uint16_t paramID = get16 (req, size, 4);
+
+	if (paramID < 3)
+		systemConfig_[paramID] = get16 (req, size, 6);
+
+	res.put16 (paramID);
+	res.put16 ((paramID < 3) ? systemConfig_[paramID] : 0);
+}
+
+void Simulator::SystemConfig_loadDefault (const uint8_t* req, uint16_t size,
+										  Reply& res)
+{
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO]  = 4;
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO]    = 0;
+	systemConfig_[COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO] = 0;
+}
+
+/************************************************************************/
+
+void Simulator::VM2_setRange (const uint8_t* req, uint16_t size, Reply& res)
+{
+	VM2_range_ = toComm_VM2_Range (get16 (req, size, 4));
+
+	res.put16 (VM2_range_);
+	res.put16 (0);
+}
+
+void Simulator::VM2_getCalibration (const uint8_t* req, uint16_t size,
+									Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const CalibrationPoint& point = VM2_calibration_[VM2_range_][index];
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VM2_setCalibration (const uint8_t* req, uint16_t size,
+									Reply& res)
+{
+	const uint16_t index =
+		std::min<uint16_t> (get16 (req, size, 4), CALIBRATION_POINTS - 1);
+
+	const double fullScale = VM2_fullScale (VM2_range_);
+
+	CalibrationPoint& point = VM2_calibration_[VM2_range_][index];
+	point.code  = toCode (defaultTable (fullScale, ADC_STEP),
+		measure (1, sourceVoltage(), fullScale));
+	point.value = getFloat (req, size, 8);
+
+	res.put16 (index);
+	res.put16 (0);
+	res.put32 (point.code);
+	res.putFloat (point.value);
+}
+
+void Simulator::VM2_read (const uint8_t* req, uint16_t size, Reply& res)
+{
+	const uint16_t filterLength = get16 (req, size, 4);
+
+	res.delay (filterLength * parameters_.conversionTime());
+	res.putFloat (measure (filterLength, sourceVoltage(),
+		VM2_fullScale (VM2_range_)));
+}
+
+void Simulator::VM2_loadDefaultCalibration (const uint8_t* req, uint16_t size,
+											Reply& res)
+{
+	VM2_calibration_[VM2_range_] =
+		defaultTable (VM2_fullScale (VM2_range_), ADC_STEP);
+}
+
+/************************************************************************/
+
+void Simulator::VM_setTerminal (const uint8_t* req, uint16_t size, Reply& res)
+{
+	VM_terminal_ = toComm_VM_Terminal (get16 (req, size, 4));
+
+	res.put16 (VM_terminal_);
+	res.put16 (0);
+}
+
+void Simulator::VM_getTerminal (const uint8_t* req, uint16_t size, Reply& res)
+{
+	res.put16 (VM_terminal_);
+	res.put16 (0);
+}
+
+/************************************************************************/
+
+void Simulator::changeBaud (const uint8_t* req, uint16_t size, Reply& res)
+/*
+ * Replies at the present rate, then switches. Rates the
+ * FT232 cannot generate are refused with the present rate.
+ */
+{
+	const uint32_t baudRate = get32 (req, size, 4);
+
+	if ((baudRate < 300) || (baudRate > 3000000)) {
+
+		res.put32 (deviceBaudRate_);
+		return;
+	}
+
+	pendingBaudRate_ = baudRate;
+	baudSwitchAt_ = -1;
+
+	res.put32 (baudRate);
+}
+
+uint32_t Simulator::streamPending (double at)
+/*
+ * Samples are produced at a steady rate while recording. Once the
+ * firmware's buffer is full, the oldest samples are overwritten.
+ */
+{
+	if (recording_)
+		recProduced_ = (uint64_t)
+			((at - recStartedAt_) * parameters_.sampleRate());
+
+	if (recProduced_ - recConsumed_ > parameters_.streamCapacity())
+		recConsumed_ = recProduced_ - parameters_.streamCapacity();
+
+	return recProduced_ - recConsumed_;
+}
+
+int32_t Simulator::streamSample (void)
+{
+	const double fullScale = VM_fullScale (VM_range_);
+
+	return toCode (VM_calibration_[VM_range_],
+		measure (1, sourceVoltage(), fullScale));
+}
+
+void Simulator::recSize (const uint8_t* req, uint16_t size, Reply& res)
+{
+	res.put16 (std::min<uint32_t> (streamPending (clock_), 0xFFFF));
+	res.put16 (0);
+}
+
+void Simulator::recData (const uint8_t* req, uint16_t size, Reply& res)
+/*
+ * As many samples as asked for, the buffer holds,
+ * and a single QP4 frame carries.
+ */
+{
+	static const uint16_t maxSamples =
+		(1024 - 2 * sizeof (uint32_t)) / sizeof (int32_t);
+
+	const uint16_t n = std::min<uint32_t> (
+		std::min<uint32_t> (get16 (req, size, 4), streamPending (clock_)),
+		maxSamples);
+
+	res.put16 (n);
+	res.put16 (0);
+
+	for (uint16_t i = 0; i < n; ++i)
+		res.put32 (streamSample());
+
+	recConsumed_ += n;
+}
+
+void Simulator::startRec (const uint8_t* req, uint16_t size, Reply& res)
+{
+	recording_    = true;
+	recStartedAt_ = clock_;
+	recProduced_  = 0;
+	recConsumed_  = 0;
+}
+
+void Simulator::stopRec (const uint8_t* req, uint16_t size, Reply& res)
+/*
+ * When pushing, what is left goes out ahead of the reply.
+ */
+{
+	uint32_t pending = streamPending (clock_);
+
+	if (recPush_) {
+
+		pushStream (clock_);
+
+		while ((pending = streamPending (clock_)))
+			pushFrame (std::min<uint32_t> (pending, COMM_REC_DATA_MAX_SAMPLES),
+				clock_);
+	}
+
+	recording_ = false;
+	recPush_   = false;
+}
+
+void Simulator::startRecPush (const uint8_t* req, uint16_t size, Reply& res)
+{
+	recPushChunk_ = std::max<uint16_t> (1,
+		std::min<uint16_t> (get16 (req, size, 4), COMM_REC_DATA_MAX_SAMPLES));
+
+	startRec (req, size, res);
+
+	recPush_         = true;
+	recPushSequence_ = 0;
+	recPushAt_       = clock_;
+
+	res.put16 (recPushChunk_);
+	res.put16 (0);
+}
+
+void Simulator::pushStream (double until)
+/*
+ * Sends a frame, as the firmware would on its own, each time a chunk
+ * of samples is ready and the link is free, up to time until. A frame
+ * takes all that is ready when sent, so frames grow while the link
+ * lags behind.
+ */
+{
+	const double rate = parameters_.sampleRate();
+
+	if (!recPush_ || (rate <= 0))
+		return;
+
+	for (;;) {
+
+		const double at = std::max (recPushAt_, outboundFreeAt_);
+
+		if (at > until)
+			break;
+
+		const uint32_t pending = streamPending (at);
+
+		if (pending >= recPushChunk_)
+			pushFrame (std::min<uint32_t> (pending, COMM_REC_DATA_MAX_SAMPLES),
+				at);
+
+		/**** Half a sample on, lest rounding land just short ****/
+		else
+			recPushAt_ = recStartedAt_ +
+				(recConsumed_ + recPushChunk_ + 0.5) / rate;
+	}
+}
+
+void Simulator::pushFrame (uint32_t size, double at)
+{
+	Reply res (COMM_OPCODE_REC_PUSH_DATA, 0);
+
+	res.put16 (size);
+	res.put16 (recPushSequence_++);
+
+	for (uint32_t i = 0; i < size; ++i)
+		res.put32 (streamSample());
+
+	recConsumed_ += size;
+	send (res, at);
+}
+
+/************************************************************************/
+
+static uint32_t crc32 (uint32_t crc, uint32_t x)
+/*
+ * Folds the four bytes of x, most significant
+ * first, into a CRC-32 (IEEE 802.3).
+ */
+{
+	for (int shift = 24; shift >= 0; shift -= 8) {
+
+		crc ^= (x >> shift) & 0xFF;
+
+		for (int k = 0; k < 8; ++k)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+
+	return crc;
+}
+
+void Simulator::calibrationChecksum (const uint8_t* req, uint16_t size,
+									 Reply& res)
+/*
+ * Covers the tables of every range, so that setting
+ * any point, or loading defaults, changes it.
+ */
+{
+	const std::vector<CalibrationTable>* meters[] =
+	{
+		&CS_calibration_, &VS_calibration_, &CM_calibration_,
+		&VM_calibration_, &VM2_calibration_,
+	};
+
+	uint32_t crc = ~0u;
+
+	for (size_t m = 0; m < sizeof (meters) / sizeof (meters[0]); ++m)
+		for (size_t r = 0; r < meters[m]->size(); ++r)
+			for (size_t i = 0; i < (*meters[m])[r].size(); ++i) {
+
+				const CalibrationPoint& point = (*meters[m])[r][i];
+
+				uint32_t value;
+				memcpy (&value, &point.value, sizeof (value));
+
+				crc = crc32 (crc, point.code);
+				crc = crc32 (crc, value);
+			}
+
+	for (int i = 0; i < 3; ++i)
+		crc = crc32 (crc, (uint16_t) systemConfig_[i]);
+
+	res.put32 (~crc);
+}
+
+void Simulator::getCalibrationTables (const uint8_t* req, uint16_t size,
+									  Reply& res)
+{
+	const std::vector<CalibrationTable>* meters[] =
+	{
+		&CS_calibration_, &VS_calibration_, &CM_calibration_,
+		&VM_calibration_, &VM2_calibration_,
+	};
+
+	const uint16_t meter = get16 (req, size, 4);
+	const bool known = meter < sizeof (meters) / sizeof (meters[0]);
+	const uint16_t ranges = known ? meters[meter]->size() : 0;
+
+	res.put16 (meter);
+	res.put16 (ranges);
+	res.put16 (CALIBRATION_POINTS);
+	res.put16 (0);
+
+	for (uint16_t r = 0; r < ranges; ++r)
+		for (uint16_t i = 0; i < CALIBRATION_POINTS; ++i) {
+
+			res.put32 ((*meters[meter])[r][i].code);
+			res.putFloat ((*meters[meter])[r][i].value);
+		}
+}
+
+void Simulator::SystemConfig_getList (const uint8_t* req, uint16_t size,
+									  Reply& res)
+{
+	const uint16_t count = std::min<uint16_t> (get16 (req, size, 4),
+		COMM_SYSTEM_CONFIG_LIST_MAX);
+
+	res.put16 (count);
+	res.put16 (0);
+
+	for (uint16_t i = 0; i < count; ++i) {
+
+		const uint16_t paramID = get16 (req, size, 8 + 2 * i);
+
+		res.put16 (paramID);
+		res.put16 ((paramID < 3) ? systemConfig_[paramID] : 0);
+	}
+}
+
+void Simulator::sourceMeasure (const uint8_t* req, uint16_t size, Reply& res)
+/*
+ * Sources and reads through the separate handlers, as
+ * the firmware would, with the settling time between.
+ */
+{
+	const uint16_t source = get16 (req, size, 4);
+	const uint16_t meter = get16 (req, size, 6);
+	const double settlingTime = get32 (req, size, 12) * 1e-6;
+
+	/**** Requests laid out as the separate handlers expect ****/
+	uint8_t sourceReq[8] = {0};
+	uint8_t readReq[6] = {0};
+
+	if (size >= 18) {
+
+		memcpy (sourceReq + 4, req + 8, 4);
+		memcpy (readReq + 4, req + 16, 2);
+	}
+
+	Reply applied (COMM_OPCODE_SOURCE_MEASURE, 0);
+
+	if (source == COMM_SOURCE_MODE_VOLTAGE)
+		VS_setVoltage (sourceReq, sizeof (sourceReq), applied);
+	else
+		CS_setCurrent (sourceReq, sizeof (sourceReq), applied);
+
+	Reply reading (COMM_OPCODE_SOURCE_MEASURE, 0);
+
+	if (meter == COMM_METER_CM)
+		CM_read (readReq, sizeof (readReq), reading);
+	else if (meter == COMM_METER_VM2)
+		VM2_read (readReq, sizeof (readReq), reading);
+	else
+		VM_read (readReq, sizeof (readReq), reading);
+
+	res.delay (settlingTime + reading.busy());
+	res.put16 (source);
+	res.put16 (meter);
+	res.put32 (get32 (&applied.bytes()[0], applied.bytes().size(), 4));
+	res.put32 (get32 (&reading.bytes()[0], reading.bytes().size(), 4));
+}
+
+/************************************************************************/
+
+void Simulator::burstRead (const uint8_t* req, uint16_t size, Reply& res)
+/*
+ * Each frame goes out as soon as its readings are taken,
+ * while the next fill. The last one is the reply proper.
+ */
+{
+	const uint16_t meter = get16 (req, size, 4);
+	const uint32_t total = get32 (req, size, 8);
+	const uint16_t tag = get16 (&res.bytes()[0], res.bytes().size(), 2);
+
+	/**** Laid out as the read handlers expect ****/
+	uint8_t readReq[6] = {0};
+	if (size >= 8) memcpy (readReq + 4, req + 6, 2);
+
+	uint32_t offset = 0;
+	double elapsed = 0;
+
+	do {
+		const uint16_t n = std::min<uint32_t> (
+			total - offset, COMM_BURST_READ_MAX_READINGS);
+
+		Reply frame (COMM_OPCODE_BURST_READ, tag);
+		frame.put16 (meter);
+		frame.put16 (n);
+		frame.put32 (offset);
+		frame.put32 (total);
+
+		for (uint16_t i = 0; i < n; ++i) {
+
+			Reply reading (COMM_OPCODE_BURST_READ, 0);
+
+			if (meter == COMM_METER_CM)
+				CM_read (readReq, sizeof (readReq), reading);
+			else if (meter == COMM_METER_VM2)
+				VM2_read (readReq, sizeof (readReq), reading);
+			else
+				VM_read (readReq, sizeof (readReq), reading);
+
+			elapsed += reading.busy();
+			frame.put32 (get32 (&reading.bytes()[0],
+				reading.bytes().size(), 4));
+		}
+
+		offset += n;
+
+		if (offset < total)
+			send (frame, clock_ + elapsed);
+
+		else {
+
+			res = frame;
+			res.delay (elapsed);
+		}
+
+	} while (offset < total);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -0,0 +1,160 @@
+#include "../app/StreamClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+StreamClock::StreamClock (void) :
+	timeConstant_ (60),
+	expectedPeriod_ (0),
+	startAt_ (0),
+	origin_ (0),
+	chunks_ (0),
+	lastAt_ (0),
+	weight_ (0),
+	meanIndex_ (0),
+	meanAt_ (0),
+	varIndex_ (0),
+	covar_ (0),
+	floor_ (0)
+{}
+
+void StreamClock::start (double at, uint64_t index, double expectedRate)
+{
+	expectedPeriod_ = (expectedRate > 0) ? 1 / expectedRate : 0;
+
+	startAt_ = at;
+	origin_ = index;
+
+	chunks_ = 0;
+	lastAt_ = at;
+	weight_ = 0;
+	meanIndex_ = meanAt_ = 0;
+	varIndex_ = covar_ = 0;
+	floor_ = 0;
+}
+
+void StreamClock::observe (double at, uint64_t end)
+/*
+ * The last sample of a chunk is the one that arrived
+ * soonest after it was taken.
+ */
+{
+	static const double rise = 0.01;    // Weight of a later arrival
+
+	if (end <= origin_)
+		return;
+
+	const double x = double (end - 1 - origin_);
+	const double y = at - startAt_;
+
+	const double decay = chunks_ ?
+		std::exp (-std::max (0.0, at - lastAt_) / timeConstant_) : 0;
+
+	weight_ = decay * weight_ + 1;
+
+	const double dx = x - meanIndex_;
+	const double dy = y - meanAt_;
+
+	meanIndex_ += dx / weight_;
+	meanAt_ += dy / weight_;
+
+	varIndex_ = decay * varIndex_ + dx * (x - meanIndex_);
+	covar_ = decay * covar_ + dx * (y - meanAt_);
+
+	++chunks_;
+	lastAt_ = at;
+
+	const double residual = y - meanAt_ - period() * (x - meanIndex_);
+
+	floor_ = (chunks_ == 1) ? residual :
+		std::min (residual, floor_ + rise * (residual - floor_));
+}
+
+double StreamClock::period (void) const
+/*
+ * A fit of the first few chunks, which may be close together, is not
+ * trusted over the expected period, unless that is clearly wrong.
+ */
+{
+	static const uint32_t trusted = 4;  // Chunks to trust a fit from
+
+	if ((chunks_ >= 2) && (varIndex_ > 0)) {
+
+		const double period = covar_ / varIndex_;
+
+		const bool unexpected = (period < 0.5 * expectedPeriod_) ||
+			(period > 2 * expectedPeriod_);
+
+		if ((period > 0) && ((chunks_ >= trusted) || unexpected))
+			return period;
+	}
+
+	return expectedPeriod_;
+}
+
+double StreamClock::rate (void) const
+{
+	const double p = period();
+	return (p > 0) ? 1 / p : 0;
+}
+
+StreamTimebase StreamClock::timebase (void) const
+{
+	const double p = period();
+
+	if (chunks_ == 0)
+		return StreamTimebase (origin_, startAt_, p);
+
+	return StreamTimebase (origin_,
+		startAt_ + meanAt_ + floor_ - p * meanIndex_, p);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+StreamResampler::StreamResampler (void) :
+	interval_ (0),
+	primed_ (false),
+	next_ (0),
+	lastAt_ (0),
+	lastValue_ (0)
+{}
+
+void StreamResampler::start (double interval)
+{
+	interval_ = interval;
+	primed_ = false;
+}
+
+void StreamResampler::feed (double at, float value, std::vector<float>& values)
+{
+	if (interval_ <= 0)
+		return;
+
+	if (!primed_) {
+
+		next_ = int64_t (std::ceil (at / interval_));
+		lastAt_ = at;
+		lastValue_ = value;
+		primed_ = true;
+	}
+
+	for (double t = interval_ * next_; t <= at; t = interval_ * ++next_) {
+
+		const double f = (at > lastAt_) ? (t - lastAt_) / (at - lastAt_) : 1;
+		values.push_back (lastValue_ + f * (value - lastValue_));
+	}
+
+	lastAt_ = at;
+	lastValue_ = value;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -1,13 +1,14 @@
 #include "../app/virtuaSMU.h"
 #include "../../sys/sys/Timer.h"
 #include "../../app/app/Exception.h"
+#include "../../sys/sys/IoEngine.h"
+#include "../../sys/sys/Log.h"
 
 #include <cstdio>
 #include <string>
-#include <iostream>
-
-#define PRINT_DEBUG(x) { \
-std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ":" << x << std::endl; }
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 namespace smu {
 
@@ -25,13 +26,74 @@ SourceMode toSourceMode (unsigned int i)
 /************************************************************************/
 /************************************************************************/
 
+Completions::Completions (void)
+{
+	for (int i = 0; i < CODES; ++i)
+		completed_[i] = armed_[i] = nopArmed_[i] = 0;
+}
+
+void Completions::reset (uint16_t code)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	armed_[code] = completed_[code];
+	nopArmed_[code] = completed_[COMM_CBCODE_NOP];
+}
+
+void Completions::set (uint16_t code)
+{
+	{
+		std::lock_guard<std::mutex> lock (lock_);
+		++completed_[code];
+	}
+
+	if (code != COMM_CBCODE_NOP)
+		cond_[code].notify_all();
+
+	else for (int i = 0; i < CODES; ++i)
+		cond_[i].notify_all();
+}
+
+bool Completions::wait (uint16_t code,
+						std::chrono::steady_clock::time_point deadline)
+{
+	return wait (code, 1, deadline);
+}
+
+bool Completions::wait (uint16_t code, uint32_t count,
+						std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	while (!done (code, count) &&
+		   (completed_[COMM_CBCODE_NOP] == nopArmed_[code]))
+		if (cond_[code].wait_until (lock, deadline) ==
+			std::cv_status::timeout)
+				break;
+
+	return done (code, count);
+}
+
+bool Completions::nop (uint16_t code) const
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	return completed_[COMM_CBCODE_NOP] != nopArmed_[code];
+}
+
+bool Completions::done (uint16_t code, uint32_t count) const
+{
+	return completed_[code] - armed_[code] >= count;
+}
+
+/************************************************************************/
+/************************************************************************/
+
 std::vector <FTDI_DeviceInfo> Driver::scan (void)
 {
-	std::cout << "libxsmu version: "
-		      << MAJOR_VERSION_NO (LIBXSMU_VERSION) << "."
-		      << MINOR_VERSION_NO (LIBXSMU_VERSION) << "."
-		      << BUGFIX_VERSION_NO (LIBXSMU_VERSION)
-			  << std::endl;
+	SMU_LOG_INFO (LOG_DRIVER, "libxsmu version: {}.{}.{}",
+		MAJOR_VERSION_NO (LIBXSMU_VERSION),
+		MINOR_VERSION_NO (LIBXSMU_VERSION),
+		BUGFIX_VERSION_NO (LIBXSMU_VERSION));
 
 	std::vector <FTDI_DeviceInfo> device_list;
 	std::vector <FTDI_DeviceInfo>::const_iterator it;
@@ -41,12 +103,13 @@ std::vector <FTDI_DeviceInfo> Driver::scan (void)
 		if (std::string (it->description()) == "XPLORE SMU")
 			device_list.push_back (*it);
         else
-            std::cout << "Found: " << it->description() << std::endl;
+            SMU_LOG_INFO (LOG_DRIVER, "Found: {}", it->description());
 
 		return device_list;
 }
 
-Driver::Driver (void)
+Driver::Driver (void) :
+	streamCalibration_ (VM_CALIBRATION_TABLE_SIZE)
 {
 	cs_  = new CS;
 	vs_  = new VS;
@@ -59,6 +122,41 @@ Driver::Driver (void)
 
 	comm_ = new Comm;
 	comm_->callback (comm_cb, this);
+
+	autoTune_ = false;
+	_alive = false;
+	_rec = false;
+	_push = false;
+	serviceTask_ = 0;
+	keepAliveAt_ = 0;
+	pushSequence_ = 0;
+	recPushChunkSize_ = 0;
+	pushFramesLost_ = 0;
+
+	baudRate_ = 9600;
+	failedBaudRate_ = 0;
+	idleBaudRate_ = 9600;
+	streamSampleRate_ = 10;
+
+	recDataReceived_ = 0;
+	pipelineDepth_ = 0;
+	streamRoundTrip_ = 0;
+
+	drainRange_ = vm_->range();
+
+	cacheEnabled_ = true;
+	cacheLoaded_ = false;
+	bulkCalibration_ = true;
+	bulkSystemConfig_ = true;
+	sourceMeasure_ = true;
+	burstRead_ = true;
+	burstReceived_ = 0;
+	burstTag_ = 0;
+	cacheActive_ = false;
+	calibrationChecksum_ = 0;
+
+	for (int m = 0; m < CalibrationCache::METERS; ++m)
+		cachedRange_[m] = -1;
 }
 
 Driver::~Driver (void)
@@ -83,6 +181,12 @@ void Driver::comm_cb (void* user_data, const void* oCB)
 }
 
 void Driver::comm_cb (const CommCB* oCB)
+{
+	if (!completeAsync (oCB))
+		dispatch (oCB);
+}
+
+void Driver::dispatch (const CommCB* oCB)
 {
 	typedef void (Driver::*cb_t) (const CommCB* );
 
@@ -145,6 +249,13 @@ void Driver::comm_cb (const CommCB* oCB)
 		&Driver::recDataCB,
 		&Driver::StartRecCB,
 		&Driver::StopRecCB,
+		&Driver::StartRecPushCB,
+		&Driver::recPushDataCB,
+		&Driver::CalibrationChecksumCB,
+		&Driver::GetCalibrationTablesCB,
+		&Driver::SystemConfig_GetListCB,
+		&Driver::SourceMeasureCB,
+		&Driver::BurstReadCB,
 	};
 
 	if (oCB->code() < sizeof (cbs) / sizeof (cbs[0]))
@@ -156,7 +267,7 @@ void Driver::comm_cb (const CommCB* oCB)
 
 void Driver::nopCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_NOP);
+	completions_.set (COMM_CBCODE_NOP);
 }
 
 /************************************************************************/
@@ -170,14 +281,14 @@ void Driver::identityCB (const CommCB* oCB)
 	versionInfo_->hardware_version (o->hardware_version());
 	versionInfo_->firmware_version (o->firmware_version());
 
-	ackBits_.set (COMM_CBCODE_IDN);
+	completions_.set (COMM_CBCODE_IDN);
 }
 
 /************************************************************************/
 
 void Driver::keepAliveCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_KEEP_ALIVE);
+	completions_.set (COMM_CBCODE_KEEP_ALIVE);
 }
 
 /************************************************************************/
@@ -199,7 +310,7 @@ void Driver::setSourceModeCB (const CommCB* oCB)
 			break;
 	}
 
-	ackBits_.set (COMM_CBCODE_SET_SOURCE_MODE);
+	completions_.set (COMM_CBCODE_SET_SOURCE_MODE);
 }
 
 /************************************************************************/
@@ -211,7 +322,9 @@ void Driver::CS_setRangeCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CS_SetRange*> (oCB);
 
 	cs_->setRange (toCS_Range (o->range()));
-	ackBits_.set (COMM_CBCODE_CS_SET_RANGE);
+	setCachedRange (CalibrationCache::CS, cs_->range());
+
+	completions_.set (COMM_CBCODE_CS_SET_RANGE);
 }
 
 /************************************************************************/
@@ -222,7 +335,10 @@ void Driver::CS_getCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CS_GetCalibration*> (oCB);
 
 	cs_->setCalibration (o->index(), o->dac(), o->current());
-	ackBits_.set (COMM_CBCODE_CS_GET_CALIBRATION);
+	cacheCalibration (CalibrationCache::CS,
+		o->index(), o->dac(), o->current());
+
+	completions_.set (COMM_CBCODE_CS_GET_CALIBRATION);
 }
 
 /************************************************************************/
@@ -233,7 +349,10 @@ void Driver::CS_verifyCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CS_VerifyCalibration*> (oCB);
 
 	cs_->setCalibration (o->index(), o->dac(), o->current());
-	ackBits_.set (COMM_CBCODE_CS_VERIFY_CALIBRATION);
+	cacheCalibration (CalibrationCache::CS,
+		o->index(), o->dac(), o->current());
+
+	completions_.set (COMM_CBCODE_CS_VERIFY_CALIBRATION);
 }
 
 /************************************************************************/
@@ -244,14 +363,21 @@ void Driver::CS_setCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CS_SetCalibration*> (oCB);
 
 	cs_->setCalibration (o->index(), o->dac(), o->current());
-	ackBits_.set (COMM_CBCODE_CS_SET_CALIBRATION);
+
+	/**** The rest of the range may have moved with it ****/
+	invalidateCalibration (CalibrationCache::CS);
+	cacheCalibration (CalibrationCache::CS,
+		o->index(), o->dac(), o->current());
+
+	completions_.set (COMM_CBCODE_CS_SET_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::CS_saveCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_CS_SAVE_CALIBRATION);
+	invalidateCalibration (CalibrationCache::CS);
+	completions_.set (COMM_CBCODE_CS_SAVE_CALIBRATION);
 }
 
 /************************************************************************/
@@ -262,7 +388,7 @@ void Driver::CS_setCurrentCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CS_SetCurrent*> (oCB);
 
 	cs_->setCurrent (o->current());
-	ackBits_.set (COMM_CBCODE_CS_SET_CURRENT);
+	completions_.set (COMM_CBCODE_CS_SET_CURRENT);
 }
 
 /************************************************************************/
@@ -274,7 +400,9 @@ void Driver::VS_setRangeCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VS_SetRange*> (oCB);
 
 	vs_->setRange (toVS_Range (o->range()));
-	ackBits_.set (COMM_CBCODE_VS_SET_RANGE);
+	setCachedRange (CalibrationCache::VS, vs_->range());
+
+	completions_.set (COMM_CBCODE_VS_SET_RANGE);
 }
 
 /************************************************************************/
@@ -285,7 +413,10 @@ void Driver::VS_getCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VS_GetCalibration*> (oCB);
 
 	vs_->setCalibration (o->index(), o->dac(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VS_GET_CALIBRATION);
+	cacheCalibration (CalibrationCache::VS,
+		o->index(), o->dac(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VS_GET_CALIBRATION);
 }
 
 /************************************************************************/
@@ -296,7 +427,10 @@ void Driver::VS_verifyCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VS_VerifyCalibration*> (oCB);
 
 	vs_->setCalibration (o->index(), o->dac(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VS_VERIFY_CALIBRATION);
+	cacheCalibration (CalibrationCache::VS,
+		o->index(), o->dac(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VS_VERIFY_CALIBRATION);
 }
 
 /************************************************************************/
@@ -307,14 +441,21 @@ void Driver::VS_setCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VS_SetCalibration*> (oCB);
 
 	vs_->setCalibration (o->index(), o->dac(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VS_SET_CALIBRATION);
+
+	/**** The rest of the range may have moved with it ****/
+	invalidateCalibration (CalibrationCache::VS);
+	cacheCalibration (CalibrationCache::VS,
+		o->index(), o->dac(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VS_SET_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::VS_saveCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VS_SAVE_CALIBRATION);
+	invalidateCalibration (CalibrationCache::VS);
+	completions_.set (COMM_CBCODE_VS_SAVE_CALIBRATION);
 }
 
 /************************************************************************/
@@ -325,7 +466,7 @@ void Driver::VS_setVoltageCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VS_SetVoltage*> (oCB);
 
 	vs_->setVoltage (o->voltage());
-	ackBits_.set (COMM_CBCODE_VS_SET_VOLTAGE);
+	completions_.set (COMM_CBCODE_VS_SET_VOLTAGE);
 
 }
 
@@ -338,7 +479,9 @@ void Driver::CM_setRangeCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CM_SetRange*> (oCB);
 
 	cm_->setRange (toCM_Range (o->range()));
-	ackBits_.set (COMM_CBCODE_CM_SET_RANGE);
+	setCachedRange (CalibrationCache::CM, cm_->range());
+
+	completions_.set (COMM_CBCODE_CM_SET_RANGE);
 }
 
 /************************************************************************/
@@ -349,7 +492,10 @@ void Driver::CM_getCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CM_GetCalibration*> (oCB);
 
 	cm_->setCalibration (o->index(), o->adc(), o->current());
-	ackBits_.set (COMM_CBCODE_CM_GET_CALIBRATION);
+	cacheCalibration (CalibrationCache::CM,
+		o->index(), o->adc(), o->current());
+
+	completions_.set (COMM_CBCODE_CM_GET_CALIBRATION);
 }
 
 /************************************************************************/
@@ -360,14 +506,21 @@ void Driver::CM_setCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CM_SetCalibration*> (oCB);
 
 	cm_->setCalibration (o->index(), o->adc(), o->current());
-	ackBits_.set (COMM_CBCODE_CM_SET_CALIBRATION);
+
+	/**** The rest of the range may have moved with it ****/
+	invalidateCalibration (CalibrationCache::CM);
+	cacheCalibration (CalibrationCache::CM,
+		o->index(), o->adc(), o->current());
+
+	completions_.set (COMM_CBCODE_CM_SET_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::CM_saveCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_CM_SAVE_CALIBRATION);
+	invalidateCalibration (CalibrationCache::CM);
+	completions_.set (COMM_CBCODE_CM_SAVE_CALIBRATION);
 }
 
 /************************************************************************/
@@ -378,7 +531,7 @@ void Driver::CM_readCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_CM_Read*> (oCB);
 
 	cm_->setCurrent (o->current());
-	ackBits_.set (COMM_CBCODE_CM_READ);
+	completions_.set (COMM_CBCODE_CM_READ);
 }
 
 /************************************************************************/
@@ -386,11 +539,14 @@ void Driver::CM_readCB (const CommCB* oCB)
 
 void Driver::VM_setRangeCB (const CommCB* oCB)
 {
-    const CommCB_VM_GetCalibration* o =
-	reinterpret_cast<const CommCB_VM_GetCalibration*> (oCB);
+	const CommCB_VM_SetRange* o =
+	reinterpret_cast<const CommCB_VM_SetRange*> (oCB);
 
-	vm_->setCalibration (o->index(), o->adc(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VM_GET_CALIBRATION);
+	vm_->setRange (toVM_Range (o->range()));
+	markStreamRange (vm_->range());
+	setCachedRange (CalibrationCache::VM, vm_->range());
+
+	completions_.set (COMM_CBCODE_VM_SET_RANGE);
 }
 
 /************************************************************************/
@@ -401,7 +557,11 @@ void Driver::VM_getCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM_GetCalibration*> (oCB);
 
 	vm_->setCalibration (o->index(), o->adc(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VM_GET_CALIBRATION);
+	calibrateStream (o->index(), o->adc(), o->voltage());
+	cacheCalibration (CalibrationCache::VM,
+		o->index(), o->adc(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VM_GET_CALIBRATION);
 }
 
 /************************************************************************/
@@ -412,14 +572,22 @@ void Driver::VM_setCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM_SetCalibration*> (oCB);
 
 	vm_->setCalibration (o->index(), o->adc(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VM_SET_CALIBRATION);
+	calibrateStream (o->index(), o->adc(), o->voltage());
+
+	/**** The rest of the range may have moved with it ****/
+	invalidateCalibration (CalibrationCache::VM);
+	cacheCalibration (CalibrationCache::VM,
+		o->index(), o->adc(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VM_SET_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::VM_saveCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VM_SAVE_CALIBRATION);
+	invalidateCalibration (CalibrationCache::VM);
+	completions_.set (COMM_CBCODE_VM_SAVE_CALIBRATION);
 }
 
 /************************************************************************/
@@ -430,7 +598,7 @@ void Driver::VM_readCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM_Read*> (oCB);
 
 	vm_->setVoltage (o->voltage());
-	ackBits_.set (COMM_CBCODE_VM_READ);
+	completions_.set (COMM_CBCODE_VM_READ);
 }
 
 /************************************************************************/
@@ -438,28 +606,38 @@ void Driver::VM_readCB (const CommCB* oCB)
 
 void Driver::CS_loadDefaultCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION);
+	invalidateCalibration (CalibrationCache::CS);
+	completions_.set (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::VS_loadDefaultCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION);
+	invalidateCalibration (CalibrationCache::VS);
+	completions_.set (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::CM_loadDefaultCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION);
+	invalidateCalibration (CalibrationCache::CM);
+	completions_.set (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::VM_loadDefaultCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION);
+	/**** The SMU's table has changed, and is no longer known ****/
+	{
+		std::lock_guard<std::mutex> lock (calibrationLock_);
+		streamCalibration_.invalidate (vm_->range());
+	}
+
+	invalidateCalibration (CalibrationCache::VM);
+	completions_.set (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION);
 }
 
 /************************************************************************/
@@ -471,7 +649,7 @@ void Driver::RM_readAutoscaleCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_RM_ReadAutoscale*> (oCB);
 
 	rm_->setResistance (o->resistance());
-	ackBits_.set (COMM_CBCODE_RM_READ_AUTOSCALE);
+	completions_.set (COMM_CBCODE_RM_READ_AUTOSCALE);
 }
 
 /************************************************************************/
@@ -483,7 +661,7 @@ void Driver::SystemConfig_GetCB (const CommCB* oCB)
 		reinterpret_cast <const CommCB_SystemConfig_Get*> (oCB);
 
 	sysconf_->set (o->paramID(), o->value());
-	ackBits_.set (COMM_CBCODE_SYSTEM_CONFIG_GET);
+	completions_.set (COMM_CBCODE_SYSTEM_CONFIG_GET);
 }
 
 void Driver::SystemConfig_SetCB (const CommCB* oCB)
@@ -492,17 +670,21 @@ void Driver::SystemConfig_SetCB (const CommCB* oCB)
 		reinterpret_cast <const CommCB_SystemConfig_Set*> (oCB);
 
 	sysconf_->set (o->paramID(), o->value());
-	ackBits_.set (COMM_CBCODE_SYSTEM_CONFIG_SET);
+	invalidateHardwareVersion();
+
+	completions_.set (COMM_CBCODE_SYSTEM_CONFIG_SET);
 }
 
 void Driver::SystemConfig_SaveCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_SYSTEM_CONFIG_SAVE);
+	invalidateHardwareVersion();
+	completions_.set (COMM_CBCODE_SYSTEM_CONFIG_SAVE);
 }
 
 void Driver::SystemConfig_LoadDefaultCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT);
+	invalidateHardwareVersion();
+	completions_.set (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT);
 }
 
 /************************************************************************/
@@ -514,7 +696,9 @@ void Driver::VM2_setRangeCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM2_SetRange*> (oCB);
 
 	vm2_->setRange (toVM2_Range (o->range()));
-	ackBits_.set (COMM_CBCODE_VM2_SET_RANGE);
+	setCachedRange (CalibrationCache::VM2, vm2_->range());
+
+	completions_.set (COMM_CBCODE_VM2_SET_RANGE);
 }
 
 /************************************************************************/
@@ -525,7 +709,10 @@ void Driver::VM2_getCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM2_GetCalibration*> (oCB);
 
 	vm2_->setCalibration (o->index(), o->adc(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VM2_GET_CALIBRATION);
+	cacheCalibration (CalibrationCache::VM2,
+		o->index(), o->adc(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VM2_GET_CALIBRATION);
 }
 
 /************************************************************************/
@@ -536,14 +723,21 @@ void Driver::VM2_setCalibrationCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM2_SetCalibration*> (oCB);
 
 	vm2_->setCalibration (o->index(), o->adc(), o->voltage());
-	ackBits_.set (COMM_CBCODE_VM2_SET_CALIBRATION);
+
+	/**** The rest of the range may have moved with it ****/
+	invalidateCalibration (CalibrationCache::VM2);
+	cacheCalibration (CalibrationCache::VM2,
+		o->index(), o->adc(), o->voltage());
+
+	completions_.set (COMM_CBCODE_VM2_SET_CALIBRATION);
 }
 
 /************************************************************************/
 
 void Driver::VM2_saveCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VM2_SAVE_CALIBRATION);
+	invalidateCalibration (CalibrationCache::VM2);
+	completions_.set (COMM_CBCODE_VM2_SAVE_CALIBRATION);
 }
 
 /************************************************************************/
@@ -554,12 +748,13 @@ void Driver::VM2_readCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM2_Read*> (oCB);
 
 	vm2_->setVoltage (o->voltage());
-	ackBits_.set (COMM_CBCODE_VM2_READ);
+	completions_.set (COMM_CBCODE_VM2_READ);
 }
 
 void Driver::VM2_loadDefaultCalibrationCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION);
+	invalidateCalibration (CalibrationCache::VM2);
+	completions_.set (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION);
 }
 
 /************************************************************************/
@@ -570,7 +765,7 @@ void Driver::VM_setTerminalCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM_SetTerminal*> (oCB);
 
 	vm_->setTerminal (toVM_Terminal (o->terminal()));
-	ackBits_.set (COMM_CBCODE_VM_SET_TERMINAL);
+	completions_.set (COMM_CBCODE_VM_SET_TERMINAL);
 }
 
 
@@ -580,7 +775,7 @@ void Driver::VM_getTerminalCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_VM_GetTerminal*> (oCB);
 
 	vm_->setTerminal (toVM_Terminal (o->terminal()));
-	ackBits_.set (COMM_CBCODE_VM_GET_TERMINAL);
+	completions_.set (COMM_CBCODE_VM_GET_TERMINAL);
 }
 
 /************************************************************************/
@@ -590,10 +785,11 @@ void Driver::changeBaudCB (const CommCB* oCB)
 	const CommCB_changeBaud* o =
 	reinterpret_cast<const CommCB_changeBaud*> (oCB);
 
-	baudRate_ =  o->baudRate();
+	/**** baudRate_ keeps tracking the host side ****/
+	if (comm_->setBaudRate (o->baudRate()))
+		baudRate_ = o->baudRate();
 
-	comm_->setBaudRate (baudRate_);
-	ackBits_.set (COMM_CBCODE_CHANGE_BAUD);
+	completions_.set (COMM_CBCODE_CHANGE_BAUD);
 }
 
 /************************************************************************/
@@ -604,1020 +800,2991 @@ void Driver::recSizeCB (const CommCB* oCB)
 	reinterpret_cast<const CommCB_recSize*> (oCB);
 
 	recSize_ =  o->recSize();
-	ackBits_.set (COMM_CBCODE_REC_SIZE);
+
+	/*
+	 * Replies arrive in order, so the stream buffer has what the SMU
+	 * sent before, and the SMU has just produced the rest. This is a
+	 * fresher sign of its clock than the recData replies that follow,
+	 * which arrive in a burst, whatever the age of their samples.
+	 */
+	if (_rec && !_push)
+		observeStream (stream_.offered() + recSize_);
+
+	completions_.set (COMM_CBCODE_REC_SIZE);
 }
 
 /************************************************************************/
 
 void Driver::recDataCB (const CommCB* oCB)
+/*
+ * Converts the samples straight from the received frame
+ * into the stream buffer.
+ */
 {
 	const CommCB_recData* o =
 	reinterpret_cast<const CommCB_recData*> (oCB);
 
-	uint16_t size = o->size(); //Size of data sent in this packet
-    PRINT_DEBUG ("***********recSize in CB : " << size)
-	std::vector<int32_t> data = o->recData(); //Data in this packet
-
-	PRINT_DEBUG ("Trying to acquire dataq lock")
-	std::lock_guard<std::mutex> lock(_dataq_lock);
+	stream_.pushNetworkOrder (o->rawData(), o->size());
+	recDataSize_ = o->size();
+	recDataReceived_ += o->size();
 
-	for (uint16_t i = 0; i < size; ++i)
-	{
-		_dataq_32.push (data[i]);
-		_dataq.push (applyCalibration (data[i]));
-	}
-
-	PRINT_DEBUG ("Written to dataq")
-
-	ackBits_.set (COMM_CBCODE_REC_DATA);
+	completions_.set (COMM_CBCODE_REC_DATA);
 }
 
 /************************************************************************/
 
 void Driver::StartRecCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_START_REC);
-	Timer timer;
-	_poll_stream_at = timer.get();
-	_rec = true;
+	{
+		std::lock_guard<std::mutex> lock (_alive_lock);
 
-	/*
-	 * Change Baud Rate of communication when streaming starts
-	 */
+		Timer timer;
+		_poll_stream_at = timer.get();
+		pollScheduler_.start (streamSampleRate_);
+		_rec = true;
+	}
+
+	startStreamClock();
 
-	// uint32_t baudRate = 9600;
-	// float timeout = 1;
-	// changeBaud (&baudRate, &timeout);
+	IoEngine::instance().reschedule (serviceTask_, 0);
+	completions_.set (COMM_CBCODE_START_REC);
 }
 
 void Driver::StopRecCB (const CommCB* oCB)
 {
-	ackBits_.set (COMM_CBCODE_STOP_REC);
+	completions_.set (COMM_CBCODE_STOP_REC);
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Driver::open (const char* serialNo, float* timeout)
+void Driver::StartRecPushCB (const CommCB* oCB)
 {
-	PRINT_DEBUG ("Opening Device")
+	const CommCB_StartRecPush* o =
+	reinterpret_cast<const CommCB_StartRecPush*> (oCB);
 
-	std::cout << "libxsmu version: "
-		 << MAJOR_VERSION_NO (versionInfo_->libxsmu_version()) << "."
-		 << MINOR_VERSION_NO (versionInfo_->libxsmu_version()) << "."
-		 << BUGFIX_VERSION_NO (versionInfo_->libxsmu_version())
-		 << std::endl;
-
-	comm_->open (serialNo);
-
-	identify (timeout);
-	if (!goodID()) return;
+	{
+		std::lock_guard<std::mutex> lock (_alive_lock);
 
-	std::cout << "Hardware version: "
-		 << MAJOR_VERSION_NO (versionInfo_->hardware_version()) << '.'
-		 << MINOR_VERSION_NO (versionInfo_->hardware_version()) << '.'
-		 << BUGFIX_VERSION_NO (versionInfo_->hardware_version())
-		 << std::endl;
+		recPushChunkSize_ = o->chunkSize();
+		pushSequence_ = 0;
+		_push = true;
+		_rec = true;
+	}
 
-	std::cout << "Firmware version: "
-		 << MAJOR_VERSION_NO (versionInfo_->firmware_version()) << '.'
-		 << MINOR_VERSION_NO (versionInfo_->firmware_version()) << '.'
-		 << BUGFIX_VERSION_NO (versionInfo_->firmware_version())
-		 << std::endl;
+	startStreamClock();
 
-	_alive = true;
-	_rec = false;
-	_thread_future = std::async (std::launch::async, &Driver::thread, this);
-	PRINT_DEBUG ("Async thread launched")
+	completions_.set (COMM_CBCODE_START_REC_PUSH);
 }
 
-void Driver::close (void)
+void Driver::recPushDataCB (const CommCB* oCB)
+/*
+ * Pushed frames go straight into the stream buffer, with nobody
+ * waiting on them. There is no holding the SMU back, so under the
+ * block policy samples that do not fit are dropped.
+ */
 {
-	try {
-		PRINT_DEBUG ("Closing Device")
-		_alive = false;
-		if (_thread_future.valid())
-            _thread_future.get();
-	}
-	catch (...)
-	{}
+	const CommCB_recPushData* o =
+	reinterpret_cast<const CommCB_recPushData*> (oCB);
 
-	try
-	{
-		float timeout = 1;
-		uint32_t lease_time_ms = 0;
-		keepAlive (&lease_time_ms, &timeout);
+	const uint16_t lost = o->sequence() - pushSequence_;
+
+	if (lost) {
+
+		pushFramesLost_ += lost;
+		SMU_LOG_WARNING (LOG_STREAM, "{} pushed frames lost before frame {}",
+			lost, o->sequence());
 	}
-	catch (...)
-	{}
 
-	comm_->close();
+	pushSequence_ = o->sequence() + 1;
+	stream_.pushNetworkOrder (o->rawData(), o->size());
+	observeStream (stream_.offered());
 }
 
-bool Driver::waitForResponse (const AckBits & checkBits, float* timeout)
+/************************************************************************/
+
+void Driver::CalibrationChecksumCB (const CommCB* oCB)
 {
-	Timer timer;
-	double elapsed = 0;
-	const double entry = timer.get();
+	const CommCB_CalibrationChecksum* o =
+	reinterpret_cast<const CommCB_CalibrationChecksum*> (oCB);
 
-	do {
+	calibrationChecksum_ = o->checksum();
+	completions_.set (COMM_CBCODE_CALIBRATION_CHECKSUM);
+}
 
-		comm_->check();
-		elapsed = timer.get() - entry;
+/************************************************************************/
 
-		if (elapsed >* timeout)
-			break;
+void Driver::GetCalibrationTablesCB (const CommCB* oCB)
+/*
+ * Every range of the meter goes into the cache,
+ * whichever range the meter is on.
+ */
+{
+	const CommCB_GetCalibrationTables* o =
+	reinterpret_cast<const CommCB_GetCalibrationTables*> (oCB);
 
-		/********************************************************
-		* Prevents 100% CPU utilization,
-		* in case the operation is taking longer than 100ms.
-		* *******************************************************/
-		if (elapsed > 100e-3)
-			timer.sleep (10e-3);
+	calibrationTables_.assign (o->ranges(),
+		std::vector<CalibrationPoint> (o->points()));
 
-	}
-	while ( (ackBits_ & checkBits) != checkBits);
+	for (uint16_t r = 0; r < o->ranges(); ++r)
+		for (uint16_t i = 0; i < o->points(); ++i) {
 
-	*timeout = (elapsed >* timeout) ? 0 : (*timeout - elapsed);
-	return ( (ackBits_ & checkBits) == checkBits);
-}
+			calibrationTables_[r][i].code = o->code (r, i);
+			calibrationTables_[r][i].value = o->value (r, i);
+		}
 
-bool Driver::waitForResponse (uint16_t checkBit, float* timeout)
-{
-	Timer timer;
-	double elapsed = 0;
-	const double entry = timer.get();
+	/**** Comm_Meter and CalibrationCache::Meter go in the same order ****/
+	if (o->meter() < CalibrationCache::METERS) {
 
-	do {
+		const CalibrationCache::Meter meter =
+			static_cast<CalibrationCache::Meter> (o->meter());
 
-		comm_->check();
-		elapsed = timer.get() - entry;
+		std::lock_guard<std::mutex> lock (cacheLock_);
 
-		if (elapsed >* timeout)
-			break;
+		for (uint16_t r = 0; cacheActive_ && (r < o->ranges()); ++r)
+			for (uint16_t i = 0; i < o->points(); ++i)
+				calibrationCache_.store (meter, r, i,
+					o->code (r, i), o->value (r, i));
 
-		/********************************************************
-		* Prevents 100% CPU utilization,
-		* in case the operation is taking longer than 100ms.
-		* *******************************************************/
-		if (elapsed > 100e-3)
-			timer.sleep (10e-3);
+		const int range = cachedRange_[meter];
 
-		if (ackBits_[COMM_CBCODE_NOP])
-			throw NoOperation();
+		if ((range >= 0) && (range < o->ranges()))
+			for (uint16_t i = 0; i < o->points(); ++i)
+				setHostCalibration (meter, i,
+					o->code (range, i), o->value (range, i));
 	}
-	while (!ackBits_[checkBit]);
-
-	*timeout = (elapsed >* timeout) ? 0 : (*timeout - elapsed);
-	return ackBits_[checkBit];
-}
 
-/************************************************************************/
-/************************************************************************/
+	if (o->meter() == COMM_METER_VM) {
 
-bool Driver::goodID (void) const
-{
-	return (identity_ == "XPLORE SMU");
-}
+		std::lock_guard<std::mutex> lock (calibrationLock_);
 
-void Driver::identify (float* timeout)
-{
-	identity_.clear();
-	versionInfo_->clear();
-    ackBits_.reset (COMM_CBCODE_IDN);
+		for (uint16_t r = 0; r < o->ranges(); ++r)
+			for (uint16_t i = 0; i < o->points(); ++i)
+				streamCalibration_.setPoint (r, i,
+					o->code (r, i), o->value (r, i));
+	}
 
-	comm_->transmitIdentify();
-	waitForResponse (COMM_CBCODE_IDN, timeout);
+	completions_.set (COMM_CBCODE_GET_CALIBRATION_TABLES);
 }
 
 /************************************************************************/
 
-void Driver::keepAlive (uint32_t* lease_time_ms, float* timeout)
+void Driver::SystemConfig_GetListCB (const CommCB* oCB)
 {
-	PRINT_DEBUG ("Trying to Acquire Lock")
-	auto unique_lock = comm_->lock();
-	PRINT_DEBUG ("Lock Acquired")
+	const CommCB_SystemConfig_GetList* o =
+	reinterpret_cast<const CommCB_SystemConfig_GetList*> (oCB);
 
-	ackBits_.reset (COMM_CBCODE_KEEP_ALIVE);
-	comm_->transmit_keepAlive (*lease_time_ms);
+	for (uint16_t i = 0; i < o->count(); ++i)
+		if ((o->paramID (i) >= 0) &&
+			(o->paramID (i) < SystemConfig::MAX_PARAMS))
+				sysconf_->set (o->paramID (i), o->value (i));
 
-	waitForResponse (COMM_CBCODE_KEEP_ALIVE, timeout);
+	completions_.set (COMM_CBCODE_SYSTEM_CONFIG_GET_LIST);
 }
 
-void Driver::thread (void)
-{
-	Timer timer;
-
-	uint32_t lease_time_ms = 10000;
-	float timeout = 2;
+/************************************************************************/
 
-	keepAlive (&lease_time_ms, &timeout);
-	double last_sent_at = timer.get();
-	double elapsed = 0;
+void Driver::SourceMeasureCB (const CommCB* oCB)
+{
+	const CommCB_SourceMeasure* o =
+	reinterpret_cast<const CommCB_SourceMeasure*> (oCB);
 
-	while (_alive)
-	{
-		elapsed = timer.get() - last_sent_at;
-		if (elapsed > lease_time_ms/3000)
-		{
-			timeout = 1;
-			keepAlive (&lease_time_ms, &timeout);
-			last_sent_at = timer.get();
-		}
+	if (o->source() == COMM_SOURCE_MODE_VOLTAGE)
+		vs_->setVoltage (o->value());
+	else
+		cs_->setCurrent (o->value());
 
+	switch (o->meter()) {
 
-        if (_rec && timer.get() >= _poll_stream_at)
-		{
-			poll_stream();
+		case COMM_METER_CM:
+			cm_->setCurrent (o->reading());
+			break;
 
-			_poll_stream_at = timer.get() + _poll_stream_interval;
-		}
+		case COMM_METER_VM2:
+			vm2_->setVoltage (o->reading());
+			break;
 
-		/********************************************************
-		* Prevents 100% CPU utilization,
-		* in case the operation is taking longer than 100ms.
-		* *******************************************************/
-		timer.sleep (10e-3);
+		default:
+			vm_->setVoltage (o->reading());
+			break;
 	}
+
+	completions_.set (COMM_CBCODE_SOURCE_MEASURE);
 }
 
 /************************************************************************/
 
-void Driver::poll_stream (void)
+void Driver::BurstReadCB (const CommCB* oCB)
+/*
+ * The meter keeps the last reading, as after a single read.
+ */
 {
-	uint16_t size;
+	const CommCB_BurstRead* o =
+	reinterpret_cast<const CommCB_BurstRead*> (oCB);
 
-	float timeout = 1;
-	recSize (&size, &timeout);
+	std::lock_guard<std::mutex> lock (burstLock_);
+
+	/**** Untagged frames of another burst are told by its size, at best ****/
+	if ((o->tag() && (o->tag() != burstTag_)) ||
+		(o->total() != burstReadings_.size()))
+			return;
 
-    PRINT_DEBUG ("*****************Size of data : " << size);
+	for (uint16_t i = 0; i < o->size(); ++i)
+		if (o->offset() + i < burstReadings_.size()) {
 
-	if (size) do {
+			burstReadings_[o->offset() + i] = o->reading (i);
+			++burstReceived_;
+		}
+
+	if (o->size()) {
 
-		uint16_t rx_size = size;
+		const float reading = o->reading (o->size() - 1);
 
-		float timeout = 10;
-		recData (&rx_size, &timeout); // Stores the data in _dataq_32
+		switch (o->meter()) {
 
-        PRINT_DEBUG (">>>>>>>>>>>>>>>>>>Size of rx data : " << rx_size);
+			case COMM_METER_CM:
+				cm_->setCurrent (reading);
+				break;
 
-		size -= rx_size;
+			case COMM_METER_VM2:
+				vm2_->setVoltage (reading);
+				break;
+
+			default:
+				vm_->setVoltage (reading);
+				break;
+		}
+	}
 
-	} while (size);
+	if (o->last())
+		completions_.set (COMM_CBCODE_BURST_READ);
 }
 
 /************************************************************************/
 
-void Driver::setSourceMode (SourceMode* mode, float* timeout)
+void Driver::startStreamClock (void)
+/*
+ * Called on the engine's thread, as the
+ * SMU confirms that it has started.
+ */
 {
-	auto unique_lock = comm_->lock();
-
-	ackBits_.reset (COMM_CBCODE_SET_SOURCE_MODE);
-	comm_->transmitSourceMode (toComm_SourceMode ((uint16_t)*mode));
-	if (waitForResponse (COMM_CBCODE_SET_SOURCE_MODE, timeout)) {
+	std::lock_guard<std::mutex> lock (clockLock_);
+	streamClock_.start (Timer::get(), stream_.offered(), streamSampleRate_);
+}
 
-		if (cs_->active())
-			*mode = SourceMode::CURRENT;
+void Driver::observeStream (uint64_t end)
+/*
+ * Called on the engine's thread, on word that the
+ * samples numbered below end have been taken.
+ */
+{
+	const double at = Timer::get();
 
-		if (vs_->active())
-			*mode = SourceMode::VOLTAGE;
-	}
+	std::lock_guard<std::mutex> lock (clockLock_);
+	streamClock_.observe (at, end);
 }
 
-/************************************************************************/
-/************************************************************************/
-
-void Driver::CS_setRange (CS_Range* range, float* timeout)
+double Driver::streamClockRate (void) const
 {
-	auto unique_lock = comm_->lock();
+	std::lock_guard<std::mutex> lock (clockLock_);
+	return streamClock_.rate();
+}
 
-	ackBits_.reset (COMM_CBCODE_CS_SET_RANGE);
-	comm_->transmit_CS_setRange (toComm_CS_Range (*range));
+void Driver::setStreamClockTimeConstant (double seconds)
+{
+	std::lock_guard<std::mutex> lock (clockLock_);
+	streamClock_.setTimeConstant (seconds);
+}
 
-	if (waitForResponse (COMM_CBCODE_CS_SET_RANGE, timeout))
-		*range = (cs_->range());
+double Driver::streamClockTimeConstant (void) const
+{
+	std::lock_guard<std::mutex> lock (clockLock_);
+	return streamClock_.timeConstant();
 }
 
+/************************************************************************/
 /************************************************************************/
 
-void Driver::CS_getCalibration (uint16_t* index, int16_t* dac,
-								  float* current, float* timeout)
+void Driver::open (const char* serialNo, float* timeout)
 {
-	ackBits_.reset (COMM_CBCODE_CS_GET_CALIBRATION);
-	comm_->transmit_CS_getCalibration (*index);
+	SMU_LOG_INFO (LOG_DRIVER, "Opening {}, libxsmu version: {}.{}.{}",
+		serialNo,
+		MAJOR_VERSION_NO (versionInfo_->libxsmu_version()),
+		MINOR_VERSION_NO (versionInfo_->libxsmu_version()),
+		BUGFIX_VERSION_NO (versionInfo_->libxsmu_version()));
 
-	if (waitForResponse (COMM_CBCODE_CS_GET_CALIBRATION, timeout)) {
+	serialNo_ = serialNo;
+	comm_->open (serialNo);
 
-		*dac = cs_->calibration_dac (*index);
-		*current = cs_->calibration_current (*index);
-	}
-}
+	/**** Comm always opens at 9600 baud ****/
+	baudRate_ = 9600;
+	failedBaudRate_ = 0;
+	idleBaudRate_ = baudRate_;
 
-/************************************************************************/
+	identify (timeout);
+	if (!goodID()) return;
 
-void Driver::CS_verifyCalibration (uint16_t* index, int16_t* dac,
-									 float* current, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+	SMU_LOG_INFO (LOG_DRIVER, "Hardware version: {}.{}.{}",
+		MAJOR_VERSION_NO (versionInfo_->hardware_version()),
+		MINOR_VERSION_NO (versionInfo_->hardware_version()),
+		BUGFIX_VERSION_NO (versionInfo_->hardware_version()));
 
-	ackBits_.reset (COMM_CBCODE_CS_VERIFY_CALIBRATION);
-	comm_->transmit_CS_verifyCalibration (*index);
+	SMU_LOG_INFO (LOG_DRIVER, "Firmware version: {}.{}.{}",
+		MAJOR_VERSION_NO (versionInfo_->firmware_version()),
+		MINOR_VERSION_NO (versionInfo_->firmware_version()),
+		BUGFIX_VERSION_NO (versionInfo_->firmware_version()));
 
-	if (waitForResponse (COMM_CBCODE_CS_VERIFY_CALIBRATION, timeout)) {
+	openCalibrationCache (timeout);
 
-		*dac = cs_->calibration_dac (*index);
-		*current = cs_->calibration_current (*index);
+	if (autoTune_) {
+
+		float tune_timeout = 5;
+		tuneTransport (&tune_timeout);
 	}
-}
 
-/************************************************************************/
+	_alive = true;
+	_rec = false;
+	keepAliveAt_ = 0;
+	serviceTask_ = IoEngine::instance().schedule (&Driver::serviceTask, this, 0);
+	SMU_LOG_DEBUG (LOG_DRIVER, "Keep-alive task scheduled");
+}
 
-void Driver::CS_setCalibration (uint16_t* index, int16_t* dac,
-								  float* current, float* timeout)
+void Driver::close (void)
 {
-	auto unique_lock = comm_->lock();
+	try {
+		SMU_LOG_DEBUG (LOG_DRIVER, "Closing {}", serialNo_);
+		_alive = false;
 
-	ackBits_.reset (COMM_CBCODE_CS_SET_CALIBRATION);
-	comm_->transmit_CS_setCalibration (*index,* current);
+		if (serviceTask_)
+			IoEngine::instance().cancel (serviceTask_);
 
-	if (waitForResponse (COMM_CBCODE_CS_SET_CALIBRATION, timeout)) {
+		serviceTask_ = 0;
+	}
+	catch (...)
+	{}
 
-		*dac = cs_->calibration_dac (*index);
-		*current = cs_->calibration_current (*index);
+	try {
+		closeCalibrationCache();
+	}
+	catch (...)
+	{}
+
+	try
+	{
+		float timeout = 1;
+		uint32_t lease_time_ms = 0;
+		keepAlive (&lease_time_ms, &timeout);
 	}
+	catch (...)
+	{}
+
+	comm_->close();
+	failAsync();
 }
 
 /************************************************************************/
 
-void Driver::CS_saveCalibration (float* timeout)
+void Driver::openCalibrationCache (float* timeout)
+/*
+ * One round trip tells whether the tables
+ * on disk are still those of the SMU.
+ */
 {
-	auto unique_lock = comm_->lock();
+	{
+		std::lock_guard<std::mutex> lock (cacheLock_);
+
+		cacheActive_ = false;
+		for (int m = 0; m < CalibrationCache::METERS; ++m)
+			cachedRange_[m] = -1;
+	}
+
+	cacheLoaded_ = false;
+
+	if (!cacheEnabled_)
+		return;
+
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CALIBRATION_CHECKSUM);
+	comm_->transmit_CalibrationChecksum();
+
+	try {
+
+		if (!waitForResponse (COMM_CBCODE_CALIBRATION_CHECKSUM, timeout))
+			return;
+	}
+	catch (const NoOperation&) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware cannot checksum its "
+			"calibration; not caching it");
+		return;
+	}
+
+	unique_lock.unlock();
+
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	cacheActive_ = true;
+	cacheLoaded_ = calibrationCache_.load (serialNo_, firmware_version(),
+										   calibrationChecksum_);
+
+	SMU_LOG_INFO (LOG_DRIVER, "Calibration cache {}: {}",
+		calibrationCache_.path(), cacheLoaded_ ? "good" : "out of date");
+
+	if (!cacheLoaded_)
+		return;
+
+	/**** Streamed samples come out calibrated from the start ****/
+	std::lock_guard<std::mutex> calibration (calibrationLock_);
+
+	for (uint16_t range = 0; range < CalibrationEngine::MAX_RANGES; ++range)
+		for (uint16_t i = 0; i < VM_CALIBRATION_TABLE_SIZE; ++i) {
+
+			int32_t adc;
+			float voltage;
+
+			if (calibrationCache_.lookup (CalibrationCache::VM,
+					range, i, &adc, &voltage))
+				streamCalibration_.setPoint (range, i, adc, voltage);
+		}
+}
+
+void Driver::closeCalibrationCache (void)
+/*
+ * Writes back what was read or dropped since open(), under
+ * the checksum the SMU reports now, should it have changed.
+ */
+{
+	uint32_t checksum;
+	bool stale;
+
+	{
+		std::lock_guard<std::mutex> lock (cacheLock_);
+
+		if (!cacheActive_ || !calibrationCache_.dirty()) {
+
+			cacheActive_ = false;
+			return;
+		}
+
+		checksum = calibrationCache_.checksum();
+		stale = calibrationCache_.stale();
+	}
+
+	bool answered = true;
+
+	if (stale) {
+
+		auto unique_lock = comm_->lock();
+
+		float timeout = 1;
+		completions_.reset (COMM_CBCODE_CALIBRATION_CHECKSUM);
+		comm_->transmit_CalibrationChecksum();
+
+		answered = waitForResponse (COMM_CBCODE_CALIBRATION_CHECKSUM,
+									&timeout);
+		checksum = calibrationChecksum_;
+	}
+
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	/**** Without a checksum to go by, the file stays as it was ****/
+	if (answered && !calibrationCache_.save (checksum))
+		SMU_LOG_WARNING (LOG_DRIVER, "Could not write calibration cache {}",
+			calibrationCache_.path());
+
+	cacheActive_ = false;
+}
+
+/************************************************************************/
+
+static const uint16_t calibrationTableSize[CalibrationCache::METERS] =
+{
+	CS_CALIBRATION_TABLE_SIZE,
+	VS_CALIBRATION_TABLE_SIZE,
+	CM_CALIBRATION_TABLE_SIZE,
+	VM_CALIBRATION_TABLE_SIZE,
+	VM_CALIBRATION_TABLE_SIZE,
+};
+
+void Driver::setCachedRange (CalibrationCache::Meter meter, uint16_t range)
+/*
+ * Called on the engine's thread, as the SMU confirms a range. The
+ * host object takes the range's table from the cache, as far as the
+ * cache has it, lest it show points of the range before.
+ */
+{
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	cachedRange_[meter] = range;
+
+	if (!cacheActive_)
+		return;
+
+	for (uint16_t i = 0; i < calibrationTableSize[meter]; ++i) {
+
+		int32_t code;
+		float value;
+
+		if (!calibrationCache_.lookup (meter, range, i, &code, &value))
+			continue;
+
+		setHostCalibration (meter, i, code, value);
+	}
+}
+
+void Driver::setHostCalibration (CalibrationCache::Meter meter,
+								 uint16_t index, int32_t code, float value)
+/*
+ * Called on the engine's thread. Each host object
+ * holds the table of the range it is on.
+ */
+{
+	if (index >= calibrationTableSize[meter])
+		return;
+
+	switch (meter) {
+		case CalibrationCache::CS:
+			cs_->setCalibration (index, code, value);
+			break;
+
+		case CalibrationCache::VS:
+			vs_->setCalibration (index, code, value);
+			break;
+
+		case CalibrationCache::CM:
+			cm_->setCalibration (index, code, value);
+			break;
+
+		case CalibrationCache::VM:
+			vm_->setCalibration (index, code, value);
+			break;
+
+		case CalibrationCache::VM2:
+			vm2_->setCalibration (index, code, value);
+			break;
+
+		default:
+			break;
+	}
+}
+
+bool Driver::cachedCalibration (CalibrationCache::Meter meter, uint16_t index,
+								int32_t* code, float* value, float* timeout)
+/*
+ * On a miss, reads all of the meter's tables
+ * in one go, rather than the one point asked for.
+ */
+{
+	if (lookupCalibration (meter, index, code, value))
+		return true;
+
+	return fetchCalibrationTables (meter, timeout) &&
+		lookupCalibration (meter, index, code, value);
+}
+
+bool Driver::lookupCalibration (CalibrationCache::Meter meter, uint16_t index,
+								int32_t* code, float* value)
+{
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	return cacheActive_ && (cachedRange_[meter] >= 0) &&
+		calibrationCache_.lookup (meter, cachedRange_[meter],
+								  index, code, value);
+}
+
+void Driver::cacheCalibration (CalibrationCache::Meter meter, uint16_t index,
+							   int32_t code, float value)
+{
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	if (cacheActive_ && (cachedRange_[meter] >= 0))
+		calibrationCache_.store (meter, cachedRange_[meter],
+								 index, code, value);
+}
+
+void Driver::invalidateCalibration (CalibrationCache::Meter meter)
+/*
+ * Without a range set since open(), the SMU may have
+ * changed any of them.
+ */
+{
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	if (!cacheActive_)
+		return;
+
+	if (cachedRange_[meter] >= 0)
+		calibrationCache_.invalidate (meter, cachedRange_[meter]);
+	else
+		calibrationCache_.invalidate (meter);
+}
+
+void Driver::invalidateHardwareVersion (void)
+{
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	if (cacheActive_)
+		calibrationCache_.invalidateHardwareVersion();
+}
+
+bool Driver::waitForResponse (uint16_t checkBit, float* timeout)
+/*
+ * Blocks till the receive thread completes checkBit, or the timeout
+ * passes. Throws NoOperation if the SMU rejected the request instead.
+ */
+{
+	return waitForResponses (checkBit, 1, timeout);
+}
+
+bool Driver::waitForResponses (uint16_t checkBit, uint32_t count,
+							   float* timeout)
+/*
+ * As waitForResponse(), for the count-th response since the reset.
+ */
+{
+	using namespace std::chrono;
+
+	const steady_clock::time_point entry = steady_clock::now();
+	const steady_clock::time_point deadline = entry +
+		duration_cast<steady_clock::duration> (duration<float> (*timeout));
+
+	/**** Nothing more is coming from this caller ****/
+	comm_->flush();
+
+	const bool done = completions_.wait (checkBit, count, deadline);
+
+	if (!done && completions_.nop (checkBit))
+		throw NoOperation();
+
+	if (!done)
+		SMU_LOG_DEBUG (LOG_DRIVER, "Timed out waiting for {}", checkBit);
+
+	const double elapsed =
+		duration<double> (steady_clock::now() - entry).count();
+
+	*timeout = (!done || (elapsed > *timeout)) ? 0 : (*timeout - elapsed);
+	return done;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+std::map<std::string, FTDI_Parameters> Driver::tunedParameters_;
+std::mutex Driver::tunedParametersLock_;
+
+bool Driver::setTransportParameters (const FTDI_Parameters& parameters)
+{
+	auto unique_lock = comm_->lock();
+	return comm_->setTransportParameters (parameters);
+}
+
+FTDI_Parameters Driver::transportParameters (void) const
+{
+	return comm_->transportParameters();
+}
+
+void Driver::setTransmitPolicy (const Comm_TransmitPolicy& policy)
+{
+	comm_->setTransmitPolicy (policy);
+}
+
+Comm_TransmitPolicy Driver::transmitPolicy (void) const
+{
+	return comm_->transmitPolicy();
+}
+
+void Driver::setStreamPollPolicy (const StreamPollPolicy& policy)
+{
+	std::lock_guard<std::mutex> lock (_alive_lock);
+	pollScheduler_.setPolicy (policy);
+}
+
+StreamPollPolicy Driver::streamPollPolicy (void) const
+{
+	std::lock_guard<std::mutex> lock (_alive_lock);
+	return pollScheduler_.policy();
+}
+
+double Driver::streamFillRate (void) const
+{
+	std::lock_guard<std::mutex> lock (_alive_lock);
+	return pollScheduler_.rate();
+}
+
+double Driver::roundTripTime (float* timeout)
+/*
+ * Median round-trip time of a few keepAlive exchanges,
+ * or infinity if any of them times out.
+ */
+{
+	Timer timer;
+	double samples[5];
+	const int N = sizeof (samples) / sizeof (samples[0]);
+
+	for (int i = 0; i < N; ++i) {
+
+		uint32_t lease_time_ms = 10000;
+		float probe_timeout = std::min (*timeout, 0.5f);
+
+		const double sent_at = timer.get();
+		keepAlive (&lease_time_ms, &probe_timeout);
+		samples[i] = timer.get() - sent_at;
+
+		*timeout = std::max (0.0, *timeout - samples[i]);
+		if (probe_timeout == 0)
+			return std::numeric_limits<double>::infinity();
+	}
+
+	std::nth_element (samples, samples + N / 2, samples + N);
+	return samples[N / 2];
+}
+
+void Driver::tuneTransport (float* timeout)
+/*
+ * Tries a few latency timer and read chunk settings, and keeps the one
+ * with the shortest command round trip. The result is remembered per
+ * serial number, so later opens of the same device skip the search.
+ */
+{
+	{
+		std::lock_guard<std::mutex> lock (tunedParametersLock_);
+
+		auto it = tunedParameters_.find (serialNo_);
+		if (it != tunedParameters_.end()) {
+
+			setTransportParameters (it->second);
+			return;
+		}
+	}
+
+	static const uint8_t latencies[] = {1, 2, 4, 16};
+	static const uint32_t chunkSizes[] = {512, 4096};
+
+	FTDI_Parameters best = transportParameters();
+	double best_rtt = roundTripTime (timeout);
+
+	for (uint8_t latency : latencies)
+		for (uint32_t chunkSize : chunkSizes) {
+
+			if (*timeout == 0)
+				break;
+
+			FTDI_Parameters candidate = best;
+			candidate.latencyTimer (latency);
+			candidate.readChunkSize (chunkSize);
+
+			if (!setTransportParameters (candidate))
+				continue;
+
+			const double rtt = roundTripTime (timeout);
+
+			if (rtt < best_rtt) {
+
+				best = candidate;
+				best_rtt = rtt;
+			}
+		}
+
+	setTransportParameters (best);
+
+	if (best_rtt != std::numeric_limits<double>::infinity()) {
+
+		std::lock_guard<std::mutex> lock (tunedParametersLock_);
+		tunedParameters_[serialNo_] = best;
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+bool Driver::goodID (void) const
+{
+	return (identity_ == "XPLORE SMU");
+}
+
+void Driver::identify (float* timeout)
+{
+	identity_.clear();
+	versionInfo_->clear();
+    completions_.reset (COMM_CBCODE_IDN);
+
+	comm_->transmitIdentify();
+	waitForResponse (COMM_CBCODE_IDN, timeout);
+}
+
+/************************************************************************/
+
+void Driver::keepAlive (uint32_t* lease_time_ms, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+	renewLease (lease_time_ms, timeout);
+}
+
+void Driver::renewLease (uint32_t* lease_time_ms, float* timeout)
+/*
+ * As keepAlive(), with the comm lock held.
+ */
+{
+	completions_.reset (COMM_CBCODE_KEEP_ALIVE);
+	comm_->transmit_keepAlive (*lease_time_ms);
+
+	waitForResponse (COMM_CBCODE_KEEP_ALIVE, timeout);
+}
+
+double Driver::serviceTask (void* user_data)
+{
+	return reinterpret_cast<Driver*> (user_data)->service();
+}
+
+/**** Delay before the service task retries a request that failed ****/
+static const double SERVICE_RETRY_DELAY = 0.1;
+
+/**** Delay before it tries again for a comm lock held by a user call ****/
+static const double SERVICE_BUSY_DELAY = 0.005;
+
+double Driver::service (void)
+/*
+ * Renews the keep-alive lease or polls the stream, whichever is due,
+ * on an IoEngine worker. Returns the delay till either is next due.
+ * StartRec brings it forward. A request that fails, e.g. on a stray
+ * NOP, is retried shortly; nothing escapes to the worker.
+ *
+ * Never waits for the comm lock, lest calls that hold it for long,
+ * like BurstRead(), tie up workers that other devices need. It
+ * comes back for the lock a few milliseconds later instead.
+ */
+{
+	const double now = Timer::get();
+
+	try {
+		const bool leaseDue = (now >= keepAliveAt_);
+		bool pollDue = false;
+
+		if (!leaseDue && _rec && !_push)
+		{
+			std::lock_guard<std::mutex> lock (_alive_lock);
+			pollDue = (now >= _poll_stream_at);
+		}
+
+		if (leaseDue || pollDue)
+		{
+			auto unique_lock = comm_->tryLock();
+
+			if (!unique_lock.owns_lock())
+				return SERVICE_BUSY_DELAY;
+
+			if (leaseDue)
+			{
+				uint32_t lease_time_ms = 10000;
+				float timeout = keepAliveAt_ ? 1 : 2;
+
+				renewLease (&lease_time_ms, &timeout);
+				keepAliveAt_ = Timer::get() + lease_time_ms/3000;
+			}
+
+			else
+			{
+				const double poll_stream_at = poll_stream();
+
+				std::lock_guard<std::mutex> lock (_alive_lock);
+				_poll_stream_at = poll_stream_at;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+
+		SMU_LOG_WARNING (LOG_DRIVER, "Service of {} failed: {}",
+			serialNo_, e.what());
+
+		return SERVICE_RETRY_DELAY;
+	}
+
+	std::lock_guard<std::mutex> lock (_alive_lock);
+
+	const double wake_at = (_rec && !_push) ?
+		std::min (keepAliveAt_, _poll_stream_at) : keepAliveAt_;
+
+	return std::max (0.0, wake_at - Timer::get());
+}
+
+/************************************************************************/
+
+double Driver::poll_stream (void)
+/*
+ * Drains what the SMU has queued, and returns when to poll next.
+ * Expects the comm lock held.
+ */
+{
+	uint32_t expected;
+
+	{
+		std::lock_guard<std::mutex> lock (_alive_lock);
+		expected = pollScheduler_.expected (Timer::get());
+	}
+
+	uint32_t available = 0;
+	float timeout = 1;
+
+	const uint32_t drained = fetchStream (expected, &available, &timeout);
+	const double at = Timer::get();
+
+	SMU_LOG_DEBUG (LOG_STREAM, "{} samples with the SMU, {} received",
+		available, drained);
+
+	std::lock_guard<std::mutex> lock (_alive_lock);
+
+	/**** A lost reply says nothing of the fill rate ****/
+	if (timeout == 0)
+		return at + pollScheduler_.policy().minInterval();
+
+	return pollScheduler_.update (at, available, drained);
+}
+
+uint32_t Driver::fetchStream (uint32_t expected, uint32_t* available,
+							  float* timeout)
+/*
+ * Asks for the SMU's queue size and, in the same write, for the samples
+ * expected to be there. More are asked for once the size is known,
+ * keeping up to pipelineDepth() recData requests in flight, so that the
+ * link stays busy rather than idling a round trip per chunk.
+ *
+ * Returns the number of samples received. Sets *available to the
+ * reported queue size, and *timeout to 0 if a reply was lost.
+ * Expects the comm lock held.
+ */
+{
+	const uint32_t depth = pipelineDepth();
+	const bool block = (stream_.overflow() == STREAM_OVERFLOW_BLOCK);
+
+	/**** Leaves the backlog with the SMU till there is room ****/
+	if (block && !stream_.waitForRoom (1, _poll_stream_room_wait))
+		expected = 0;
+
+	const uint32_t unlimited = std::numeric_limits<uint32_t>::max();
+	const uint32_t budget = block ?
+		std::min<size_t> (stream_.room(), unlimited) : unlimited;
+
+	uint32_t sent = 0, done = 0, requested = 0;
+	uint32_t wanted = std::min (expected, budget);
+	bool known = false;
+
+	completions_.reset (COMM_CBCODE_REC_SIZE);
+	completions_.reset (COMM_CBCODE_REC_DATA);
+	recDataReceived_ = 0;
+
+	const double sentAt = Timer::get();
+	comm_->transmit_recSize();
+
+	for (;;) {
+
+		/**** Keeps the pipeline full ****/
+		while ((sent - done < depth) && (requested < wanted)) {
+
+			const uint16_t n = std::min<uint32_t> (
+				COMM_REC_DATA_MAX_SAMPLES, wanted - requested);
+
+			comm_->transmit_recData (n);
+			requested += n;
+			++sent;
+		}
+
+		if (!known) {
+
+			if (!waitForResponse (COMM_CBCODE_REC_SIZE, timeout))
+				break;
+
+			const double roundTrip = Timer::get() - sentAt;
+			streamRoundTrip_ = (streamRoundTrip_ > 0) ?
+				(0.75 * streamRoundTrip_ + 0.25 * roundTrip) : roundTrip;
+
+			/*
+			 * The SMU answers in order, so it had all of these
+			 * when it took the requests that follow.
+			 */
+			known = true;
+			*available = recSize_;
+			wanted = std::max (requested, std::min (*available, budget));
+			continue;
+		}
+
+		if (done == sent)
+			break;
+
+		float chunk_timeout = 10;
+		if (!waitForResponses (COMM_CBCODE_REC_DATA, ++done, &chunk_timeout)) {
+
+			*timeout = 0;
+			break;
+		}
+	}
+
+	return recDataReceived_;
+}
+
+uint32_t Driver::pipelineDepth (void) const
+/*
+ * Enough requests to cover the round trip with replies in transit:
+ * one full chunk, at ten bits a byte, takes chunkTime on the wire.
+ */
+{
+	if (pipelineDepth_)
+		return std::min<uint32_t> (pipelineDepth_, MAX_PIPELINE_DEPTH);
+
+	const double chunkTime = 10.0 *
+		(COMM_REC_DATA_MAX_SAMPLES * sizeof (int32_t) + 16) / baudRate_;
+
+	const uint32_t depth = 1 + uint32_t (std::ceil (streamRoundTrip_ / chunkTime));
+	return std::max<uint32_t> (2, std::min<uint32_t> (depth, MAX_PIPELINE_DEPTH));
+}
+
+/************************************************************************/
+
+void Driver::setSourceMode (SourceMode* mode, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_SET_SOURCE_MODE);
+	comm_->transmitSourceMode (toComm_SourceMode ((uint16_t)*mode));
+	if (waitForResponse (COMM_CBCODE_SET_SOURCE_MODE, timeout)) {
+
+		if (cs_->active())
+			*mode = SourceMode::CURRENT;
+
+		if (vs_->active())
+			*mode = SourceMode::VOLTAGE;
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::CS_setRange (CS_Range* range, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_SET_RANGE);
+	comm_->transmit_CS_setRange (toComm_CS_Range (*range));
+
+	if (waitForResponse (COMM_CBCODE_CS_SET_RANGE, timeout))
+		*range = (cs_->range());
+}
+
+/************************************************************************/
+
+void Driver::CS_getCalibration (uint16_t* index, int16_t* dac,
+								  float* current, float* timeout)
+{
+	int32_t cached;
+	if (cachedCalibration (CalibrationCache::CS, *index, &cached, current, timeout)) {
+
+		*dac = cached;
+		return;
+	}
+
+	completions_.reset (COMM_CBCODE_CS_GET_CALIBRATION);
+	comm_->transmit_CS_getCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_CS_GET_CALIBRATION, timeout)) {
+
+		*dac = cs_->calibration_dac (*index);
+		*current = cs_->calibration_current (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::CS_verifyCalibration (uint16_t* index, int16_t* dac,
+									 float* current, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_VERIFY_CALIBRATION);
+	comm_->transmit_CS_verifyCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_CS_VERIFY_CALIBRATION, timeout)) {
+
+		*dac = cs_->calibration_dac (*index);
+		*current = cs_->calibration_current (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::CS_setCalibration (uint16_t* index, int16_t* dac,
+								  float* current, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_SET_CALIBRATION);
+	comm_->transmit_CS_setCalibration (*index,* current);
+
+	if (waitForResponse (COMM_CBCODE_CS_SET_CALIBRATION, timeout)) {
+
+		*dac = cs_->calibration_dac (*index);
+		*current = cs_->calibration_current (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::CS_saveCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_SAVE_CALIBRATION);
+	comm_->transmit_CS_saveCalibration();
+	waitForResponse (COMM_CBCODE_CS_SAVE_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::CS_setCurrent (float* current, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_SET_CURRENT);
+	comm_->transmit_CS_setCurrent (*current);
+
+	if (waitForResponse (COMM_CBCODE_CS_SET_CURRENT, timeout))
+		*current = cs_->current();
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::VS_setRange (VS_Range* range, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_SET_RANGE);
+	comm_->transmit_VS_setRange (toComm_VS_Range (*range));
+
+	if (waitForResponse (COMM_CBCODE_VS_SET_RANGE, timeout))
+		*range = (vs_->range());
+}
+
+/************************************************************************/
+
+void Driver::VS_getCalibration (uint16_t* index, int16_t* dac,
+								  float* voltage, float* timeout)
+{
+	int32_t cached;
+	if (cachedCalibration (CalibrationCache::VS, *index, &cached, voltage, timeout)) {
+
+		*dac = cached;
+		return;
+	}
+
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_GET_CALIBRATION);
+	comm_->transmit_VS_getCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_VS_GET_CALIBRATION, timeout)) {
+
+		*dac = vs_->calibration_dac (*index);
+		*voltage = vs_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VS_verifyCalibration (uint16_t* index, int16_t* dac,
+									 float* voltage, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_VERIFY_CALIBRATION);
+	comm_->transmit_VS_verifyCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_VS_VERIFY_CALIBRATION, timeout)) {
+
+		*dac = vs_->calibration_dac (*index);
+		*voltage = vs_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VS_setCalibration (uint16_t* index, int16_t* dac,
+								  float* voltage, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_SET_CALIBRATION);
+	comm_->transmit_VS_setCalibration (*index,* voltage);
+
+	if (waitForResponse (COMM_CBCODE_VS_SET_CALIBRATION, timeout)) {
+
+		*dac = vs_->calibration_dac (*index);
+		*voltage = vs_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VS_saveCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_SAVE_CALIBRATION);
+	comm_->transmit_VS_saveCalibration();
+	waitForResponse (COMM_CBCODE_VS_SAVE_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VS_setVoltage (float* voltage, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_SET_VOLTAGE);
+	comm_->transmit_VS_setVoltage (*voltage);
+
+	if (waitForResponse (COMM_CBCODE_VS_SET_VOLTAGE, timeout))
+		*voltage = vs_->voltage();
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::CM_setRange (CM_Range* range, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_SET_RANGE);
+	comm_->transmit_CM_setRange (toComm_CM_Range (*range));
+
+	if (waitForResponse (COMM_CBCODE_CM_SET_RANGE, timeout))
+		*range = (cm_->range());
+}
+
+/************************************************************************/
+
+void Driver::CM_getCalibration (uint16_t* index, int32_t* adc,
+								  float* current, float* timeout)
+{
+	if (cachedCalibration (CalibrationCache::CM, *index, adc, current, timeout))
+		return;
+
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_GET_CALIBRATION);
+	comm_->transmit_CM_getCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_CM_GET_CALIBRATION, timeout)) {
+
+		*adc = cm_->calibration_adc (*index);
+		*current = cm_->calibration_current (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::CM_setCalibration (uint16_t* index, int32_t* adc,
+								  float* current, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_SET_CALIBRATION);
+	comm_->transmit_CM_setCalibration (*index,* current);
+
+	if (waitForResponse (COMM_CBCODE_CM_SET_CALIBRATION, timeout)) {
+
+		*adc = cm_->calibration_adc (*index);
+		*current = cm_->calibration_current (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::CM_saveCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_SAVE_CALIBRATION);
+	comm_->transmit_CM_saveCalibration();
+	waitForResponse (COMM_CBCODE_CM_SAVE_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::CM_read (uint16_t* filterLength, float* current,
+						float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_READ);
+	comm_->transmit_CM_read (*filterLength);
+	if (waitForResponse (COMM_CBCODE_CM_READ, timeout)) {
+
+		*current = cm_->current();
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::VM_setRange (VM_Range* range, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_SET_RANGE);
+	comm_->transmit_VM_setRange (toComm_VM_Range (*range));
+
+	if (waitForResponse (COMM_CBCODE_VM_SET_RANGE, timeout))
+		*range = (vm_->range());
+}
+
+/************************************************************************/
+
+void Driver::VM_getCalibration (uint16_t* index, int32_t* adc,
+								  float* voltage, float* timeout)
+{
+	if (cachedCalibration (CalibrationCache::VM, *index, adc, voltage, timeout))
+		return;
+
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_GET_CALIBRATION);
+	comm_->transmit_VM_getCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_VM_GET_CALIBRATION, timeout)) {
+
+		*adc = vm_->calibration_adc (*index);
+		*voltage = vm_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VM_setCalibration (uint16_t* index, int32_t* adc,
+								  float* voltage, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_SET_CALIBRATION);
+	comm_->transmit_VM_setCalibration (*index,* voltage);
+
+	if (waitForResponse (COMM_CBCODE_VM_SET_CALIBRATION, timeout)) {
+
+		*adc = vm_->calibration_adc (*index);
+		*voltage = vm_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VM_saveCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_SAVE_CALIBRATION);
+	comm_->transmit_VM_saveCalibration();
+	waitForResponse (COMM_CBCODE_VM_SAVE_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VM_read (uint16_t* filterLength, float* voltage,
+						float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_READ);
+	comm_->transmit_VM_read (*filterLength);
+	if (waitForResponse (COMM_CBCODE_VM_READ, timeout)) {
+
+		*voltage = vm_->voltage();
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::CS_loadDefaultCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION);
+	comm_->transmit_CS_loadDefaultCalibration();
+	waitForResponse (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VS_loadDefaultCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION);
+	comm_->transmit_VS_loadDefaultCalibration();
+	waitForResponse (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::CM_loadDefaultCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION);
+	comm_->transmit_CM_loadDefaultCalibration();
+	waitForResponse (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VM_loadDefaultCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION);
+	comm_->transmit_VM_loadDefaultCalibration();
+	waitForResponse (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::RM_readAutoscale (uint16_t* filterLength,
+								  float* resistance,float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_RM_READ_AUTOSCALE);
+	comm_->transmit_RM_readAutoscale (*filterLength);
+	if (waitForResponse (COMM_CBCODE_RM_READ_AUTOSCALE, timeout)) {
+		*resistance = rm_->resistance();
+	}
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::SystemConfig_Save (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_SAVE);
+	comm_->transmit_SystemConfig_Save();
+	waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SAVE, timeout);
+}
+
+void Driver::SystemConfig_LoadDefault (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT);
+	comm_->transmit_SystemConfig_LoadDefault();
+	waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT, timeout);
+}
+
+void Driver::
+SystemConfig_Get_hardwareVersion (uint32_t* version, float* timeout)
+{
+	{
+		std::lock_guard<std::mutex> lock (cacheLock_);
+
+		if (cacheActive_ && calibrationCache_.hardwareVersion (version))
+			return;
+	}
+
+	auto unique_lock = comm_->lock();
+
+	/**** All three in one round trip, where the firmware can ****/
+	if (bulkSystemConfig_) {
+
+		static const int16_t paramIDs[] =
+		{
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO,
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO,
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO,
+		};
+
+		int16_t values[3];
+
+		try {
+
+			if (!SystemConfig_GetList (3, paramIDs, values, timeout))
+				return;
+		}
+		catch (const NoOperation&) {
+
+			bulkSystemConfig_ = false;
+		}
+	}
+
+	if (!bulkSystemConfig_) {
+
+		/**** Getting PCB information ****/
+		completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
+		comm_->transmit_SystemConfig_Get (
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO);
+
+		if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
+			return;
+
+		/**** Getting BOM information ****/
+		completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
+		comm_->transmit_SystemConfig_Get (
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO);
+
+		if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
+			return;
+
+		/**** Getting bugfix information ****/
+		completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
+		comm_->transmit_SystemConfig_Get (
+			COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO);
+
+		if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
+			return;
+	}
+
+	/**** Merging all info ****/
+
+	*version = MAKE_VERSION_NO   (sysconf_->hwBoardNo(),
+								  sysconf_->hwBomNo(),
+								  sysconf_->hwBugfixNo());
+
+	std::lock_guard<std::mutex> lock (cacheLock_);
+
+	if (cacheActive_)
+		calibrationCache_.setHardwareVersion (*version);
+}
+
+void Driver::
+SystemConfig_Set_hardwareVersion (uint32_t* version, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	/**** Setting PCB information ****/
+	completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
+	comm_->transmit_SystemConfig_Set (
+		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO,
+		MAJOR_VERSION_NO (*version));
+
+	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
+		return;
+
+	/**** Setting BOM information ****/
+	completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
+	comm_->transmit_SystemConfig_Set (
+		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO,
+		MINOR_VERSION_NO (*version));
+
+	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
+		return;
+
+	/**** Setting bugfix information ****/
+	completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
+	comm_->transmit_SystemConfig_Set (
+		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO,
+		BUGFIX_VERSION_NO (*version));
+
+	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
+		return;
+
+	/**** Merging all info ****/
+
+	*version = MAKE_VERSION_NO (sysconf_->hwBoardNo(),
+							    sysconf_->hwBomNo(),
+							    sysconf_->hwBugfixNo());
+}
+
+void Driver::SystemConfig_Get (uint16_t count, const int16_t* paramIDs,
+							   int16_t* values, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	if (bulkSystemConfig_) try {
+
+		SystemConfig_GetList (count, paramIDs, values, timeout);
+		return;
+	}
+	catch (const NoOperation&) {
 
-	ackBits_.reset (COMM_CBCODE_CS_SAVE_CALIBRATION);
-	comm_->transmit_CS_saveCalibration();
-	waitForResponse (COMM_CBCODE_CS_SAVE_CALIBRATION, timeout);
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware reads system config "
+			"a parameter at a time");
+
+		bulkSystemConfig_ = false;
+	}
+
+	/**** A round trip per parameter ****/
+	for (uint16_t i = 0; i < count; ++i) {
+
+		completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
+		comm_->transmit_SystemConfig_Get (paramIDs[i]);
+
+		if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
+			return;
+
+		values[i] = ((paramIDs[i] >= 0) &&
+			(paramIDs[i] < SystemConfig::MAX_PARAMS)) ?
+				sysconf_->get (paramIDs[i]) : 0;
+	}
+}
+
+bool Driver::SystemConfig_GetList (uint16_t count, const int16_t* paramIDs,
+								   int16_t* values, float* timeout)
+/*
+ * Expects the comm lock held. Returns
+ * whether all of the values came.
+ */
+{
+	for (uint16_t done = 0; done < count; ) {
+
+		const uint16_t n = std::min<uint16_t> (count - done,
+			COMM_SYSTEM_CONFIG_LIST_MAX);
+
+		completions_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET_LIST);
+		comm_->transmit_SystemConfig_GetList (n, paramIDs + done);
+
+		if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET_LIST, timeout))
+			return false;
+
+		for (uint16_t i = done; i < done + n; ++i)
+			values[i] = ((paramIDs[i] >= 0) &&
+				(paramIDs[i] < SystemConfig::MAX_PARAMS)) ?
+					sysconf_->get (paramIDs[i]) : 0;
+
+		done += n;
+	}
+
+	return true;
 }
 
+/************************************************************************/
 /************************************************************************/
 
-void Driver::CS_setCurrent (float* current, float* timeout)
+template <typename Table>
+bool Driver::getCalibrationTables (Comm_Meter meter,
+								   std::vector<Table>* tables, float* timeout)
+/*
+ * Reading other ranges a point at a time would mean changing the
+ * meter's range, so firmware without bulk reads gets none.
+ */
+{
+	tables->clear();
+
+	auto unique_lock = comm_->lock();
+
+	if (bulkCalibration_) try {
+
+		completions_.reset (COMM_CBCODE_GET_CALIBRATION_TABLES);
+		comm_->transmit_GetCalibrationTables (meter);
+
+		if (!waitForResponse (COMM_CBCODE_GET_CALIBRATION_TABLES, timeout))
+			return false;
+	}
+	catch (const NoOperation&) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware reads calibration tables "
+			"a point at a time");
+
+		bulkCalibration_ = false;
+	}
+
+	if (!bulkCalibration_) {
+
+		*timeout = 0;
+		return false;
+	}
+
+	tables->assign (calibrationTables_.size(), Table());
+
+	for (size_t r = 0; r < calibrationTables_.size(); ++r)
+		for (size_t i = 0; (i < calibrationTables_[r].size()) &&
+			 (i < (*tables)[r].size()); ++i)
+				(*tables)[r][i].set (calibrationTables_[r][i].code,
+									 calibrationTables_[r][i].value);
+
+	return true;
+}
+
+void Driver::CS_getCalibrationTables (
+	std::vector<CS_CalibrationTable>* tables, float* timeout)
+{
+	getCalibrationTables (COMM_METER_CS, tables, timeout);
+}
+
+void Driver::VS_getCalibrationTables (
+	std::vector<VS_CalibrationTable>* tables, float* timeout)
+{
+	getCalibrationTables (COMM_METER_VS, tables, timeout);
+}
+
+void Driver::CM_getCalibrationTables (
+	std::vector<CM_CalibrationTable>* tables, float* timeout)
+{
+	getCalibrationTables (COMM_METER_CM, tables, timeout);
+}
+
+void Driver::VM_getCalibrationTables (
+	std::vector<VM_CalibrationTable>* tables, float* timeout)
+{
+	getCalibrationTables (COMM_METER_VM, tables, timeout);
+}
+
+void Driver::VM2_getCalibrationTables (
+	std::vector<VM_CalibrationTable>* tables, float* timeout)
+{
+	getCalibrationTables (COMM_METER_VM2, tables, timeout);
+}
+
+bool Driver::fetchCalibrationTables (CalibrationCache::Meter meter,
+									 float* timeout)
+/*
+ * Reads all of the meter's tables into the cache, which
+ * GetCalibrationTablesCB fills. Returns whether it did.
+ */
+{
+	if (!bulkCalibration_)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock (cacheLock_);
+
+		if (!cacheActive_ || (cachedRange_[meter] < 0))
+			return false;
+	}
+
+	std::vector<VM_CalibrationTable> tables;
+
+	/**** A zero timeout would not be ours to report ****/
+	float timeout_ = *timeout;
+
+	if (!getCalibrationTables (static_cast<Comm_Meter> (meter),
+							   &tables, &timeout_)) {
+
+		if (bulkCalibration_)
+			*timeout = 0;
+
+		return false;
+	}
+
+	*timeout = timeout_;
+	return true;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::VM2_setRange (VM2_Range* range, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_SET_RANGE);
+	comm_->transmit_VM2_setRange (toComm_VM2_Range (*range));
+
+	if (waitForResponse (COMM_CBCODE_VM2_SET_RANGE, timeout))
+		*range = (vm2_->range());
+}
+
+/************************************************************************/
+
+void Driver::VM2_getCalibration (uint16_t* index, int32_t* adc,
+								  float* voltage, float* timeout)
+{
+	if (cachedCalibration (CalibrationCache::VM2, *index, adc, voltage, timeout))
+		return;
+
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_GET_CALIBRATION);
+	comm_->transmit_VM2_getCalibration (*index);
+
+	if (waitForResponse (COMM_CBCODE_VM2_GET_CALIBRATION, timeout)) {
+
+		*adc = vm2_->calibration_adc (*index);
+		*voltage = vm2_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VM2_setCalibration (uint16_t* index, int32_t* adc,
+								  float* voltage, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_SET_CALIBRATION);
+	comm_->transmit_VM2_setCalibration (*index,* voltage);
+
+	if (waitForResponse (COMM_CBCODE_VM2_SET_CALIBRATION, timeout)) {
+
+		*adc = vm2_->calibration_adc (*index);
+		*voltage = vm2_->calibration_voltage (*index);
+	}
+}
+
+/************************************************************************/
+
+void Driver::VM2_saveCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_SAVE_CALIBRATION);
+	comm_->transmit_VM2_saveCalibration();
+	waitForResponse (COMM_CBCODE_VM2_SAVE_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VM2_read (uint16_t* filterLength, float* voltage,
+						float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_READ);
+	comm_->transmit_VM2_read (*filterLength);
+
+	if (waitForResponse (COMM_CBCODE_VM2_READ, timeout))
+		*voltage = vm2_->voltage();
+}
+
+/************************************************************************/
+
+void Driver::VM2_loadDefaultCalibration (float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION);
+	comm_->transmit_VM2_loadDefaultCalibration();
+	waitForResponse (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION, timeout);
+}
+
+/************************************************************************/
+
+void Driver::VM_setTerminal (VM_Terminal* terminal, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_SET_TERMINAL);
+	comm_->transmit_VM_setTerminal (toComm_VM_Terminal (*terminal));
+
+	if (waitForResponse (COMM_CBCODE_VM_SET_TERMINAL, timeout))
+		*terminal = (vm_->terminal());
+}
+
+void Driver::VM_getTerminal (VM_Terminal* terminal, float* timeout)
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_VM_GET_TERMINAL);
+	comm_->transmit_VM_getTerminal ();
+
+	if (waitForResponse (COMM_CBCODE_VM_GET_TERMINAL, timeout))
+		*terminal = (vm_->terminal());
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void Driver::changeBaud (uint32_t* baudRate, float* timeout)
+/*
+ * Transmits a request for a change in the baudrate of communication
+ * channel; waits for acknowledgement of a change in baudrate in the
+ * firmware
+ */
+{
+	auto unique_lock = comm_->lock();
+
+	completions_.reset (COMM_CBCODE_CHANGE_BAUD);
+
+	comm_->transmit_changeBaud (*baudRate);
+
+	if (waitForResponse (COMM_CBCODE_CHANGE_BAUD, timeout))
+		*baudRate = baudRate_;
+}
+
+/************************************************************************/
+
+/*
+ * Candidate rates for negotiation, in increasing order. Rates above
+ * 115200 are non-standard rates derived from the FT232 3 MHz clock.
+ */
+static const uint32_t negotiationBaudRates[] = {
+
+	9600, 19200, 38400, 57600, 115200, 230400, 460800,
+	921600, 1000000, 1500000, 2000000, 3000000
+};
+
+void Driver::negotiateBaudRate (uint32_t* baudRate, float* timeout)
+/*
+ * Steps the link up through progressively faster rates, up to *baudRate,
+ * confirming each one with a few identify exchanges. Stops at the first
+ * rate that fails, and falls back to the last good one. On return,
+ * *baudRate holds the rate in use.
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_CS_SET_CURRENT);
-	comm_->transmit_CS_setCurrent (*current);
+	failedBaudRate_ = 0;
+	escalateBaudRate (*baudRate, timeout);
+
+	idleBaudRate_ = baudRate_;
+	*baudRate = baudRate_;
+}
+
+bool Driver::escalateBaudRate (uint32_t target, float* timeout)
+{
+	for (uint32_t rate : negotiationBaudRates) {
+
+		if (rate <= baudRate_)
+			continue;
+
+		if ((rate > target) || (failedBaudRate_ && (rate >= failedBaudRate_)))
+			break;
+
+		if (!tryBaudRate (rate, timeout)) {
+
+			failedBaudRate_ = rate;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Driver::tryBaudRate (uint32_t baudRate, float* timeout)
+/*
+ * Switches both ends to baudRate and checks that the link still works.
+ * Reverts to the previous rate otherwise.
+ */
+{
+	const uint32_t previous = baudRate_;
+
+	completions_.reset (COMM_CBCODE_CHANGE_BAUD);
+	comm_->transmit_changeBaud (baudRate);
+
+	/**** No reply, so the firmware is still at the old rate ****/
+	if (!waitForResponse (COMM_CBCODE_CHANGE_BAUD, timeout)) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "No reply to {} baud", baudRate);
+		return false;
+	}
+
+	if ((baudRate_ == baudRate) && confirmBaudRate (timeout)) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "Link at {} baud", baudRate);
+		return true;
+	}
+
+	SMU_LOG_INFO (LOG_DRIVER, "{} baud failed, back to {}",
+		baudRate, previous);
+
+	restoreBaudRate (previous, timeout);
+	return false;
+}
+
+bool Driver::confirmBaudRate (float* timeout)
+/*
+ * A rate is good if a few identify exchanges succeed
+ * without a single frame lost to a checksum error.
+ */
+{
+	const uint32_t errors = comm_->receiveErrors();
+
+	for (int i = 0; i < 3; ++i) {
+
+		float probe_timeout = std::min (*timeout, 0.5f);
+		const float allowed = probe_timeout;
+
+		identify (&probe_timeout);
+		*timeout = std::max (0.0f, *timeout - (allowed - probe_timeout));
+
+		if (!goodID())
+			return false;
+	}
+
+	return (comm_->receiveErrors() == errors);
+}
+
+void Driver::restoreBaudRate (uint32_t baudRate, float* timeout)
+/*
+ * Asks the firmware to go back to baudRate. The host follows even if the
+ * request is lost, since the firmware may not have switched either.
+ */
+{
+	float restore_timeout = std::min (*timeout, 0.5f);
+	const float allowed = restore_timeout;
+
+	completions_.reset (COMM_CBCODE_CHANGE_BAUD);
+	comm_->transmit_changeBaud (baudRate);
+
+	waitForResponse (COMM_CBCODE_CHANGE_BAUD, &restore_timeout);
+	*timeout = std::max (0.0f, *timeout - (allowed - restore_timeout));
+
+	if (baudRate_ != baudRate) {
+
+		comm_->setBaudRate (baudRate);
+		baudRate_ = baudRate;
+	}
+}
+
+uint32_t Driver::streamBaudRate (bool push) const
+/*
+ * Slowest candidate rate that carries the stream, at four bytes per
+ * sample and ten bits per byte, with twice that for framing and polls,
+ * or a quarter more for framing alone when the SMU pushes.
+ */
+{
+	const double required =
+		streamSampleRate_ * sizeof (int32_t) * 10 * (push ? 1.25 : 2);
+
+	for (uint32_t rate : negotiationBaudRates)
+		if (rate >= required)
+			return rate;
 
-	if (waitForResponse (COMM_CBCODE_CS_SET_CURRENT, timeout))
-		*current = cs_->current();
+	return negotiationBaudRates
+		[sizeof (negotiationBaudRates) / sizeof (negotiationBaudRates[0]) - 1];
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Driver::VS_setRange (VS_Range* range, float* timeout)
+void Driver::recSize (uint16_t* recSize, float* timeout)
+/*
+ * Transmits a request for the size of standby data queue stored in the
+ * SMU RAM, through the communication channel; and waits for a response
+ * within timeout duration.
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VS_SET_RANGE);
-	comm_->transmit_VS_setRange (toComm_VS_Range (*range));
+	completions_.reset (COMM_CBCODE_REC_SIZE);
 
-	if (waitForResponse (COMM_CBCODE_VS_SET_RANGE, timeout))
-		*range = (vs_->range());
+	comm_->transmit_recSize();
+
+	if (waitForResponse (COMM_CBCODE_REC_SIZE, timeout))
+		*recSize = recSize_;
 }
 
 /************************************************************************/
 
-void Driver::VS_getCalibration (uint16_t* index, int16_t* dac,
-								  float* voltage, float* timeout)
+void Driver::recData (uint16_t* size, float* timeout)
+/*
+ * Transmits a request for data stored in the data queue in SMU RAM,
+ * through the communication channel; and waits for a response
+ * within timeout duration.
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VS_GET_CALIBRATION);
-	comm_->transmit_VS_getCalibration (*index);
+	completions_.reset (COMM_CBCODE_REC_DATA);
 
-	if (waitForResponse (COMM_CBCODE_VS_GET_CALIBRATION, timeout)) {
+	comm_->transmit_recData (*size);
 
-		*dac = vs_->calibration_dac (*index);
-		*voltage = vs_->calibration_voltage (*index);
-	}
+	/**** The SMU may send fewer samples than asked for ****/
+	*size = waitForResponse (COMM_CBCODE_REC_DATA, timeout) ?
+		recDataSize_ : 0;
 }
 
 /************************************************************************/
 
-void Driver::VS_verifyCalibration (uint16_t* index, int16_t* dac,
-									 float* voltage, float* timeout)
+std::vector<float> Driver::getData (void)
+/*
+ * Passes streamed data stored in the Driver to the Application layer.
+ * Data stored in the queue is cleared as it passed to the user.
+ *
+ * Output : std::vector<float>
+ */
 {
-	auto unique_lock = comm_->lock();
+	std::vector<float> data (stream_.size());
 
-	ackBits_.reset (COMM_CBCODE_VS_VERIFY_CALIBRATION);
-	comm_->transmit_VS_verifyCalibration (*index);
+	data.resize (getData (data.data(), data.size()));
+	return data;
+}
 
-	if (waitForResponse (COMM_CBCODE_VS_VERIFY_CALIBRATION, timeout)) {
+size_t Driver::getData (float* data, size_t size)
+/*
+ * Drains up to size samples into data, in bulk.
+ * Returns the number of samples drained.
+ */
+{
+	return getData (data, 0, 0, size);
+}
 
-		*dac = vs_->calibration_dac (*index);
-		*voltage = vs_->calibration_voltage (*index);
-	}
+size_t Driver::getData (float* data, double* time, size_t size)
+{
+	return getData (data, time, 0, size);
 }
 
-/************************************************************************/
+size_t Driver::getData (float* data, double* time,
+						VM_Range* range, size_t size)
+{
+	std::lock_guard<std::mutex> lock (_dataq_lock);
+	return drainStream (data, time, range, size);
+}
 
-void Driver::VS_setCalibration (uint16_t* index, int16_t* dac,
-								  float* voltage, float* timeout)
+size_t Driver::drainStream (float* data, double* time,
+							VM_Range* range, size_t size)
+/*
+ * Expects _dataq_lock held. Samples are numbered in the stream, gaps
+ * included, and stamped off a snapshot of the stream clock's fit.
+ */
 {
-	auto unique_lock = comm_->lock();
+	enum {BLOCK = 1024};
 
-	ackBits_.reset (COMM_CBCODE_VS_SET_CALIBRATION);
-	comm_->transmit_VS_setCalibration (*index,* voltage);
+	int32_t adc_values[BLOCK];
+	uint64_t index[BLOCK];
+	size_t drained = 0;
 
-	if (waitForResponse (COMM_CBCODE_VS_SET_CALIBRATION, timeout)) {
+	StreamTimebase timebase;
 
-		*dac = vs_->calibration_dac (*index);
-		*voltage = vs_->calibration_voltage (*index);
+	if (time) {
+
+		std::lock_guard<std::mutex> lock (clockLock_);
+		timebase = streamClock_.timebase();
 	}
-}
 
-/************************************************************************/
+	while (drained < size) {
 
-void Driver::VS_saveCalibration (float* timeout)
-{
-	auto unique_lock = comm_->lock();
+		const size_t n = stream_.drain (adc_values,
+			std::min (size - drained, size_t (BLOCK)), index);
 
-	ackBits_.reset (COMM_CBCODE_VS_SAVE_CALIBRATION);
-	comm_->transmit_VS_saveCalibration();
-	waitForResponse (COMM_CBCODE_VS_SAVE_CALIBRATION, timeout);
-}
+		if (n == 0)
+			break;
 
-/************************************************************************/
+		if (time)
+			for (size_t i = 0; i < n; ++i)
+				time[drained + i] = timebase.time (index[i]);
 
-void Driver::VS_setVoltage (float* voltage, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+		convertStream (adc_values, index, n,
+			data + drained, range ? range + drained : 0);
 
-	ackBits_.reset (COMM_CBCODE_VS_SET_VOLTAGE);
-	comm_->transmit_VS_setVoltage (*voltage);
+		drained += n;
+	}
 
-	if (waitForResponse (COMM_CBCODE_VS_SET_VOLTAGE, timeout))
-		*voltage = vs_->voltage();
+	return drained;
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Driver::CM_setRange (CM_Range* range, float* timeout)
+void Driver::convertStream (const int32_t* adc, const uint64_t* index,
+							size_t n, float* data, VM_Range* range)
+/*
+ * Expects _dataq_lock held. Converts runs of
+ * samples taken on one range at a time.
+ */
 {
-	auto unique_lock = comm_->lock();
-
-	ackBits_.reset (COMM_CBCODE_CM_SET_RANGE);
-	comm_->transmit_CM_setRange (toComm_CM_Range (*range));
+	std::lock_guard<std::mutex> lock (calibrationLock_);
 
-	if (waitForResponse (COMM_CBCODE_CM_SET_RANGE, timeout))
-		*range = (cm_->range());
-}
+	for (size_t i = 0, end; i < n; i = end) {
 
-/************************************************************************/
+		while (!rangeMarks_.empty() && (rangeMarks_.front().from <= index[i])) {
 
-void Driver::CM_getCalibration (uint16_t* index, int32_t* adc,
-								  float* current, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+			drainRange_ = rangeMarks_.front().range;
+			rangeMarks_.pop_front();
+		}
 
-	ackBits_.reset (COMM_CBCODE_CM_GET_CALIBRATION);
-	comm_->transmit_CM_getCalibration (*index);
+		end = rangeMarks_.empty() ? n : size_t (
+			std::lower_bound (index + i, index + n,
+				rangeMarks_.front().from) - index);
 
-	if (waitForResponse (COMM_CBCODE_CM_GET_CALIBRATION, timeout)) {
+		streamCalibration_.convert (drainRange_,
+			adc + i, data + i, end - i);
 
-		*adc = cm_->calibration_adc (*index);
-		*current = cm_->calibration_current (*index);
+		if (range)
+			std::fill (range + i, range + end, drainRange_);
 	}
 }
 
-/************************************************************************/
+void Driver::calibrateStream (uint16_t index, int32_t adc, float voltage)
+/*
+ * Called on the engine's thread, as the SMU reports a point
+ * of the VM calibration table for the range it is on.
+ */
+{
+	std::lock_guard<std::mutex> lock (calibrationLock_);
+	streamCalibration_.setPoint (vm_->range(), index, adc, voltage);
+}
 
-void Driver::CM_setCalibration (uint16_t* index, int32_t* adc,
-								  float* current, float* timeout)
+void Driver::markStreamRange (VM_Range range)
+/*
+ * Called on the engine's thread, as the SMU confirms a range change.
+ * Samples up to now were taken on the old range, including those that
+ * have yet to arrive, which the stream clock tells the number of.
+ */
 {
-	auto unique_lock = comm_->lock();
+	uint64_t from = stream_.offered();
 
-	ackBits_.reset (COMM_CBCODE_CM_SET_CALIBRATION);
-	comm_->transmit_CM_setCalibration (*index,* current);
+	if (_rec) {
 
-	if (waitForResponse (COMM_CBCODE_CM_SET_CALIBRATION, timeout)) {
+		std::lock_guard<std::mutex> lock (clockLock_);
+		from = std::max (from,
+			streamClock_.timebase().index (Timer::get()));
+	}
 
-		*adc = cm_->calibration_adc (*index);
-		*current = cm_->calibration_current (*index);
+	std::lock_guard<std::mutex> lock (calibrationLock_);
+
+	if (!rangeMarks_.empty() && (rangeMarks_.back().from >= from))
+		rangeMarks_.back().range = range;
+
+	else {
+
+		const RangeMark mark = {from, range};
+		rangeMarks_.push_back (mark);
 	}
 }
 
-/************************************************************************/
+bool Driver::streamCalibrated (VM_Range range) const
+{
+	std::lock_guard<std::mutex> lock (calibrationLock_);
+	return streamCalibration_.calibrated (range);
+}
 
-void Driver::CM_saveCalibration (float* timeout)
+std::vector<float> Driver::getResampledData (double interval, double* start)
 {
-	auto unique_lock = comm_->lock();
+	std::lock_guard<std::mutex> lock (_dataq_lock);
 
-	ackBits_.reset (COMM_CBCODE_CM_SAVE_CALIBRATION);
-	comm_->transmit_CM_saveCalibration();
-	waitForResponse (COMM_CBCODE_CM_SAVE_CALIBRATION, timeout);
-}
+	std::vector<float> data (stream_.size());
+	std::vector<double> time (data.size());
 
-/************************************************************************/
+	data.resize (drainStream (data.data(), time.data(), 0, data.size()));
 
-void Driver::CM_read (uint16_t* filterLength, float* current,
-						float* timeout)
+	if (interval != resampler_.interval())
+		resampler_.start (interval);
+
+	std::vector<float> values;
+
+	for (size_t i = 0; i < data.size(); ++i)
+		resampler_.feed (time[i], data[i], values);
+
+	/**** The grid is contiguous, so it began that much earlier ****/
+	*start = resampler_.next() - interval * values.size();
+	return values;
+}
+
+void Driver::setStreamBuffer (size_t capacity, StreamOverflow overflow)
 {
+	/**** Keeps the poller and consumers out ****/
 	auto unique_lock = comm_->lock();
+	std::lock_guard<std::mutex> lock (_dataq_lock);
 
-	ackBits_.reset (COMM_CBCODE_CM_READ);
-	comm_->transmit_CM_read (*filterLength);
-	if (waitForResponse (COMM_CBCODE_CM_READ, timeout)) {
-
-		*current = cm_->current();
-	}
+	stream_.configure (capacity, overflow);
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Driver::VM_setRange (VM_Range* range, float* timeout)
+void Driver::StartRec (float *timeout)
+/*
+ * Sets a flag to instruct the SMU to start streaming data, and the driver
+ * to start recording the streamed data. Then instructs the firmware to
+ * start streaming data from the ADC
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VM_SET_RANGE);
-	comm_->transmit_VM_setRange (toComm_VM_Range (*range));
+	/**** Speed up the link to keep up with the stream ****/
+	idleBaudRate_ = baudRate_;
+	escalateBaudRate (streamBaudRate (false), timeout);
 
-	if (waitForResponse (COMM_CBCODE_VM_SET_RANGE, timeout))
-		*range = (vm_->range());
-}
+	completions_.reset (COMM_CBCODE_START_REC);
 
-/************************************************************************/
+	comm_->transmit_StartRec();
 
-void Driver::VM_getCalibration (uint16_t* index, int32_t* adc,
-								  float* voltage, float* timeout)
+	waitForResponse (COMM_CBCODE_START_REC, timeout);
+}
+
+void Driver::StartRecPush (uint16_t* chunkSize, float* timeout)
+/*
+ * As StartRec, but the SMU sends frames of samples as they fill
+ * up, which the receive thread routes to the stream buffer. The
+ * keep-alive thread stops polling meanwhile.
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VM_GET_CALIBRATION);
-	comm_->transmit_VM_getCalibration (*index);
+	if (*chunkSize == 0) {
 
-	if (waitForResponse (COMM_CBCODE_VM_GET_CALIBRATION, timeout)) {
+		std::lock_guard<std::mutex> lock (_alive_lock);
 
-		*adc = vm_->calibration_adc (*index);
-		*voltage = vm_->calibration_voltage (*index);
+		const double n =
+			streamSampleRate_ * pollScheduler_.policy().targetLatency();
+
+		*chunkSize = std::max (1.0,
+			std::min (n, double (COMM_REC_DATA_MAX_SAMPLES)));
 	}
-}
 
-/************************************************************************/
+	idleBaudRate_ = baudRate_;
+	escalateBaudRate (streamBaudRate (true), timeout);
 
-void Driver::VM_setCalibration (uint16_t* index, int32_t* adc,
-								  float* voltage, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+	completions_.reset (COMM_CBCODE_START_REC_PUSH);
 
-	ackBits_.reset (COMM_CBCODE_VM_SET_CALIBRATION);
-	comm_->transmit_VM_setCalibration (*index,* voltage);
+	comm_->transmit_StartRecPush (*chunkSize);
 
-	if (waitForResponse (COMM_CBCODE_VM_SET_CALIBRATION, timeout)) {
+	try {
+		*chunkSize = waitForResponse (COMM_CBCODE_START_REC_PUSH, timeout) ?
+			recPushChunkSize_ : 0;
+	}
 
-		*adc = vm_->calibration_adc (*index);
-		*voltage = vm_->calibration_voltage (*index);
+	/**** Older firmware only streams when polled ****/
+	catch (const NoOperation&) {
+
+		SMU_LOG_INFO (LOG_STREAM, "SMU cannot push the stream, polling");
+
+		*chunkSize = 0;
+		escalateBaudRate (streamBaudRate (false), timeout);
+
+		completions_.reset (COMM_CBCODE_START_REC);
+		comm_->transmit_StartRec();
+		waitForResponse (COMM_CBCODE_START_REC, timeout);
 	}
 }
 
-/************************************************************************/
-
-void Driver::VM_saveCalibration (float* timeout)
+void Driver::StopRec (float *timeout)
+/*
+ * Unsets a flag to instruct the SMU to stop streaming data, and the driver
+ * to stop recording. Then instructs the firmware to stop streaming data
+ * from the ADC
+ */
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VM_SAVE_CALIBRATION);
-	comm_->transmit_VM_saveCalibration();
-	waitForResponse (COMM_CBCODE_VM_SAVE_CALIBRATION, timeout);
+	completions_.reset (COMM_CBCODE_STOP_REC);
+
+	comm_->transmit_StopRec();
+
+	waitForResponse (COMM_CBCODE_STOP_REC, timeout);
+	_rec = false;
+	_push = false;
+
+	if (baudRate_ != idleBaudRate_)
+		restoreBaudRate (idleBaudRate_, timeout);
 }
 
 /************************************************************************/
 
-void Driver::VM_read (uint16_t* filterLength, float* voltage,
-						float* timeout)
+void Driver::CalibrationChecksum (uint32_t* checksum, float* timeout)
 {
 	auto unique_lock = comm_->lock();
 
-	ackBits_.reset (COMM_CBCODE_VM_READ);
-	comm_->transmit_VM_read (*filterLength);
-	if (waitForResponse (COMM_CBCODE_VM_READ, timeout)) {
+	completions_.reset (COMM_CBCODE_CALIBRATION_CHECKSUM);
+	comm_->transmit_CalibrationChecksum();
 
-		*voltage = vm_->voltage();
+	try {
+
+		if (waitForResponse (COMM_CBCODE_CALIBRATION_CHECKSUM, timeout))
+			*checksum = calibrationChecksum_;
+	}
+	catch (const NoOperation&) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware cannot checksum its calibration");
+		*timeout = 0;
 	}
 }
 
-/************************************************************************/
 /************************************************************************/
 
-void Driver::CS_loadDefaultCalibration (float* timeout)
+static Comm_Meter toComm_Meter (Meter meter)
 {
-	auto unique_lock = comm_->lock();
+	static const Comm_Meter meters[] =
+	{
+		COMM_METER_CM,
+		COMM_METER_VM,
+		COMM_METER_VM2,
+	};
 
-	ackBits_.reset (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION);
-	comm_->transmit_CS_loadDefaultCalibration();
-	waitForResponse (COMM_CBCODE_CS_LOAD_DEFAULT_CALIBRATION, timeout);
-}
+	const size_t m = static_cast<size_t> (meter);
 
-/************************************************************************/
+	return (m < sizeof (meters) / sizeof (meters[0])) ?
+		meters[m] : COMM_METER_VM;
+}
 
-void Driver::VS_loadDefaultCalibration (float* timeout)
+void Driver::SourceMeasure (SourceMode source, float* value,
+							float settlingTime, Meter meter,
+							uint16_t filterLength,
+							float* reading, float* timeout)
 {
-	auto unique_lock = comm_->lock();
+	if (sourceMeasure_) try {
 
-	ackBits_.reset (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION);
-	comm_->transmit_VS_loadDefaultCalibration();
-	waitForResponse (COMM_CBCODE_VS_LOAD_DEFAULT_CALIBRATION, timeout);
-}
+		auto unique_lock = comm_->lock();
 
-/************************************************************************/
+		/**** In microseconds; 4000 s is about as many as fit ****/
+		const uint32_t settlingTime_us = static_cast<uint32_t> (
+			std::min (std::max (settlingTime, 0.0f), 4000.0f) * 1e6);
 
-void Driver::CM_loadDefaultCalibration (float* timeout)
-{
-	auto unique_lock = comm_->lock();
+		completions_.reset (COMM_CBCODE_SOURCE_MEASURE);
+		comm_->transmit_SourceMeasure (
+			toComm_SourceMode ((uint16_t) source), *value, settlingTime_us,
+			toComm_Meter (meter), filterLength);
 
-	ackBits_.reset (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION);
-	comm_->transmit_CM_loadDefaultCalibration();
-	waitForResponse (COMM_CBCODE_CM_LOAD_DEFAULT_CALIBRATION, timeout);
+		if (waitForResponse (COMM_CBCODE_SOURCE_MEASURE, timeout)) {
+
+			*value = (source == SourceMode::VOLTAGE) ?
+				vs_->voltage() : cs_->current();
+
+			*reading = (meter == Meter::CM)  ? cm_->current() :
+					   (meter == Meter::VM2) ? vm2_->voltage() :
+											   vm_->voltage();
+		}
+
+		return;
+	}
+	catch (const NoOperation&) {
+
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware sources and measures "
+			"in separate requests");
+
+		sourceMeasure_ = false;
+	}
+
+	/**** Two round trips, settling on the host ****/
+	if (source == SourceMode::VOLTAGE)
+		VS_setVoltage (value, timeout);
+	else
+		CS_setCurrent (value, timeout);
+
+	if (*timeout <= settlingTime) {
+
+		*timeout = 0;
+		return;
+	}
+
+	if (settlingTime > 0) {
+
+		Timer::sleep (settlingTime);
+		*timeout -= settlingTime;
+	}
+
+	switch (meter) {
+
+		case Meter::CM:
+			CM_read (&filterLength, reading, timeout);
+			break;
+
+		case Meter::VM2:
+			VM2_read (&filterLength, reading, timeout);
+			break;
+
+		default:
+			VM_read (&filterLength, reading, timeout);
+			break;
+	}
 }
 
 /************************************************************************/
 
-void Driver::VM_loadDefaultCalibration (float* timeout)
+void Driver::BurstRead (Meter meter, uint16_t filterLength, uint32_t count,
+						std::vector<float>* readings, float* timeout)
 {
-	auto unique_lock = comm_->lock();
+	using namespace std::chrono;
 
-	ackBits_.reset (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION);
-	comm_->transmit_VM_loadDefaultCalibration();
-	waitForResponse (COMM_CBCODE_VM_LOAD_DEFAULT_CALIBRATION, timeout);
-}
+	readings->clear();
 
-/************************************************************************/
-/************************************************************************/
+	if (count == 0)
+		return;
 
-void Driver::RM_readAutoscale (uint16_t* filterLength,
-								  float* resistance,float* timeout)
-{
-	auto unique_lock = comm_->lock();
+	if (burstRead_) try {
 
-	ackBits_.reset (COMM_CBCODE_RM_READ_AUTOSCALE);
-	comm_->transmit_RM_readAutoscale (*filterLength);
-	if (waitForResponse (COMM_CBCODE_RM_READ_AUTOSCALE, timeout)) {
-		*resistance = rm_->resistance();
-	}
-}
+		auto unique_lock = comm_->lock();
 
-/************************************************************************/
-/************************************************************************/
+		{
+			/**** Held across transmit, till burstTag_ is known ****/
+			std::lock_guard<std::mutex> lock (burstLock_);
 
-void Driver::SystemConfig_Save (float* timeout)
-{
-	auto unique_lock = comm_->lock();
+			burstReadings_.assign (count, 0);
+			burstReceived_ = 0;
 
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_SAVE);
-	comm_->transmit_SystemConfig_Save();
-	waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SAVE, timeout);
-}
+			completions_.reset (COMM_CBCODE_BURST_READ);
+			burstTag_ = comm_->transmit_BurstRead (
+				toComm_Meter (meter), filterLength, count);
+		}
 
-void Driver::SystemConfig_LoadDefault (float* timeout)
-{
-	auto unique_lock = comm_->lock();
+		const bool done = waitForResponse (COMM_CBCODE_BURST_READ, timeout);
 
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT);
-	comm_->transmit_SystemConfig_LoadDefault();
-	waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_LOAD_DEFAULT, timeout);
-}
+		std::lock_guard<std::mutex> lock (burstLock_);
 
-void Driver::
-SystemConfig_Get_hardwareVersion (uint32_t* version, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+		if (done && (burstReceived_ == count))
+			readings->swap (burstReadings_);
 
-	/**** Getting PCB information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
-	comm_->transmit_SystemConfig_Get (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO);
+		else if (done) {
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
-		return;
+			SMU_LOG_WARNING (LOG_DRIVER, "Burst read lost {} of {} readings",
+				count - burstReceived_, count);
 
-	/**** Getting BOM information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
-	comm_->transmit_SystemConfig_Get (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO);
+			*timeout = 0;
+		}
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
+		burstReadings_.clear();
 		return;
+	}
+	catch (const NoOperation&) {
 
-	/**** Getting bugfix information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_GET);
-	comm_->transmit_SystemConfig_Get (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO);
+		SMU_LOG_INFO (LOG_DRIVER, "Firmware reads one reading per request");
+		burstRead_ = false;
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_GET, timeout))
-		return;
+		std::lock_guard<std::mutex> lock (burstLock_);
+		burstReadings_.clear();
+	}
 
-	/**** Merging all info ****/
+	/**** Pipelined reads, a window of them outstanding at a time ****/
+	static const BatchOp ops[] =
+	{
+		BatchOp::CM_READ,
+		BatchOp::VM_READ,
+		BatchOp::VM2_READ,
+	};
 
-	*version = MAKE_VERSION_NO   (sysconf_->hwBoardNo(),
-								  sysconf_->hwBomNo(),
-								  sysconf_->hwBugfixNo());
-}
+	const size_t m = static_cast<size_t> (meter);
+	const BatchCommand read = {
+		(m < sizeof (ops) / sizeof (ops[0])) ? ops[m] : BatchOp::VM_READ,
+		static_cast<double> (filterLength), 0, BatchStatus::DONE};
+
+	const uint32_t window = 32;
+
+	const steady_clock::time_point entry = steady_clock::now();
+	const steady_clock::time_point deadline = entry +
+		duration_cast<steady_clock::duration> (duration<float> (*timeout));
 
-void Driver::
-SystemConfig_Set_hardwareVersion (uint32_t* version, float* timeout)
-{
 	auto unique_lock = comm_->lock();
 
-	/**** Setting PCB information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
-	comm_->transmit_SystemConfig_Set (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOARD_NO,
-		MAJOR_VERSION_NO (*version));
+	std::deque<std::future<double>> outstanding;
+	uint32_t sent = 0;
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
-		return;
+	readings->reserve (count);
 
-	/**** Setting BOM information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
-	comm_->transmit_SystemConfig_Set (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BOM_NO,
-		MINOR_VERSION_NO (*version));
+	while (readings->size() < count) {
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
-		return;
+		while ((sent < count) && (outstanding.size() < window)) {
 
-	/**** Setting bugfix information ****/
-	ackBits_.reset (COMM_CBCODE_SYSTEM_CONFIG_SET);
-	comm_->transmit_SystemConfig_Set (
-		COMM_SYSTEM_CONFIG_PARAM_ID_HW_BUGFIX_NO,
-		BUGFIX_VERSION_NO (*version));
+			outstanding.push_back (enqueueBatchCommand (read));
+			++sent;
+		}
 
-	if (!waitForResponse (COMM_CBCODE_SYSTEM_CONFIG_SET, timeout))
-		return;
+		comm_->flush();
 
-	/**** Merging all info ****/
+		bool good = (outstanding.front().wait_until (deadline) ==
+			std::future_status::ready);
 
-	*version = MAKE_VERSION_NO (sysconf_->hwBoardNo(),
-							    sysconf_->hwBomNo(),
-							    sysconf_->hwBugfixNo());
+		if (good) try {
+			readings->push_back (outstanding.front().get());
+		}
+		catch (const RequestLost&) {
+			good = false;
+		}
+		catch (const NoOperation&) {
+
+			SMU_LOG_INFO (LOG_DRIVER, "Firmware cannot read meter {}", m);
+			good = false;
+		}
+
+		if (!good) {
+
+			readings->clear();
+			*timeout = 0;
+			return;
+		}
+
+		outstanding.pop_front();
+	}
+
+	const double elapsed =
+		duration<double> (steady_clock::now() - entry).count();
+
+	*timeout = (elapsed > *timeout) ? 0 : (*timeout - elapsed);
 }
 
 /************************************************************************/
 /************************************************************************/
 
-void Driver::VM2_setRange (VM2_Range* range, float* timeout)
+template <typename Result, typename Transmit, typename Complete>
+std::future<Result> Driver::submit (Transmit transmit, Complete complete)
 {
 	auto unique_lock = comm_->lock();
+	return enqueue<Result> (transmit, complete);
+}
 
-	ackBits_.reset (COMM_CBCODE_VM2_SET_RANGE);
-	comm_->transmit_VM2_setRange (toComm_VM2_Range (*range));
+template <typename Result, typename Transmit, typename Complete>
+std::future<Result> Driver::enqueue (Transmit transmit, Complete complete)
+/*
+ * As submit(), with the comm lock held.
+ */
+{
+	auto promise = std::make_shared<std::promise<Result>>();
+	std::future<Result> future = promise->get_future();
 
-	if (waitForResponse (COMM_CBCODE_VM2_SET_RANGE, timeout))
-		*range = (vm2_->range());
-}
+	AsyncRequest request;
 
-/************************************************************************/
+	request.complete = [promise, complete] (const CommCB* oCB) {
+		promise->set_value (complete (oCB));
+	};
 
-void Driver::VM2_getCalibration (uint16_t* index, int32_t* adc,
-								  float* voltage, float* timeout)
-{
-	auto unique_lock = comm_->lock();
+	request.fail = [promise] (std::exception_ptr e) {
+		promise->set_exception (e);
+	};
 
-	ackBits_.reset (COMM_CBCODE_VM2_GET_CALIBRATION);
-	comm_->transmit_VM2_getCalibration (*index);
+	/*
+	 * Held across transmit, with the comm lock, so that requests are
+	 * listed in the order sent, and their responses wait till they are.
+	 */
+	std::lock_guard<std::mutex> lock (asyncLock_);
 
-	if (waitForResponse (COMM_CBCODE_VM2_GET_CALIBRATION, timeout)) {
+	request.tag = transmit();
+	asyncRequests_.push_back (request);
 
-		*adc = vm2_->calibration_adc (*index);
-		*voltage = vm2_->calibration_voltage (*index);
-	}
+	return future;
 }
 
-/************************************************************************/
-
-void Driver::VM2_setCalibration (uint16_t* index, int32_t* adc,
-								  float* voltage, float* timeout)
+bool Driver::completeAsync (const CommCB* oCB)
+/*
+ * Completes the pipelined request that oCB answers, if any, and fails
+ * those sent before it, whose responses were lost. Returns whether
+ * oCB answered a pipelined request.
+ */
 {
-	auto unique_lock = comm_->lock();
+	std::vector<AsyncRequest> lost;
+	AsyncRequest answered;
+	bool found = false;
 
-	ackBits_.reset (COMM_CBCODE_VM2_SET_CALIBRATION);
-	comm_->transmit_VM2_setCalibration (*index,* voltage);
+	{
+		std::lock_guard<std::mutex> lock (asyncLock_);
 
-	if (waitForResponse (COMM_CBCODE_VM2_SET_CALIBRATION, timeout)) {
+		if (asyncRequests_.empty())
+			return false;
 
-		*adc = vm2_->calibration_adc (*index);
-		*voltage = vm2_->calibration_voltage (*index);
+		for (std::deque<AsyncRequest>::iterator it = asyncRequests_.begin();
+			 oCB->tag() && (it != asyncRequests_.end()); ++it)
+				if (it->tag == oCB->tag()) {
+
+					answered = *it;
+					asyncRequests_.erase (it);
+					found = true;
+					break;
+				}
+
+		/**** Comm drops requests overtaken by a response ****/
+		while (!asyncRequests_.empty() &&
+			   !comm_->pending (asyncRequests_.front().tag)) {
+
+			lost.push_back (asyncRequests_.front());
+			asyncRequests_.pop_front();
+		}
 	}
-}
 
-/************************************************************************/
+	for (size_t i = 0; i < lost.size(); ++i)
+		lost[i].fail (std::make_exception_ptr (RequestLost()));
 
-void Driver::VM2_saveCalibration (float* timeout)
-{
-	auto unique_lock = comm_->lock();
+	if (!found)
+		return false;
 
-	ackBits_.reset (COMM_CBCODE_VM2_SAVE_CALIBRATION);
-	comm_->transmit_VM2_saveCalibration();
-	waitForResponse (COMM_CBCODE_VM2_SAVE_CALIBRATION, timeout);
-}
+	if (oCB->code() == COMM_CBCODE_NOP)
+		answered.fail (std::make_exception_ptr (NoOperation()));
+	else
+		answered.complete (oCB);
 
-/************************************************************************/
+	return true;
+}
 
-void Driver::VM2_read (uint16_t* filterLength, float* voltage,
-						float* timeout)
+void Driver::failAsync (void)
 {
-	auto unique_lock = comm_->lock();
+	std::deque<AsyncRequest> lost;
 
-	ackBits_.reset (COMM_CBCODE_VM2_READ);
-	comm_->transmit_VM2_read (*filterLength);
+	{
+		std::lock_guard<std::mutex> lock (asyncLock_);
+		lost.swap (asyncRequests_);
+	}
 
-	if (waitForResponse (COMM_CBCODE_VM2_READ, timeout))
-		*voltage = vm2_->voltage();
+	for (size_t i = 0; i < lost.size(); ++i)
+		lost[i].fail (std::make_exception_ptr (RequestLost()));
 }
 
-/************************************************************************/
-
-void Driver::VM2_loadDefaultCalibration (float* timeout)
+size_t Driver::pendingRequests (void)
 {
-	auto unique_lock = comm_->lock();
-
-	ackBits_.reset (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION);
-	comm_->transmit_VM2_loadDefaultCalibration();
-	waitForResponse (COMM_CBCODE_VM2_LOAD_DEFAULT_CALIBRATION, timeout);
+	std::lock_guard<std::mutex> lock (asyncLock_);
+	return asyncRequests_.size();
 }
 
 /************************************************************************/
 
-void Driver::VM_setTerminal (VM_Terminal* terminal, float* timeout)
+std::future<float> Driver::CS_setCurrentAsync (float current)
 {
-	auto unique_lock = comm_->lock();
+	return submit<float> (
+		[this, current] { return comm_->transmit_CS_setCurrent (current); },
+		[this] (const CommCB* oCB) {
 
-	ackBits_.reset (COMM_CBCODE_VM_SET_TERMINAL);
-	comm_->transmit_VM_setTerminal (toComm_VM_Terminal (*terminal));
+			const CommCB_CS_SetCurrent* o =
+				reinterpret_cast<const CommCB_CS_SetCurrent*> (oCB);
 
-	if (waitForResponse (COMM_CBCODE_VM_SET_TERMINAL, timeout))
-		*terminal = (vm_->terminal());
+			cs_->setCurrent (o->current());
+			return o->current();
+		});
 }
 
-void Driver::VM_getTerminal (VM_Terminal* terminal, float* timeout)
+std::future<float> Driver::VS_setVoltageAsync (float voltage)
 {
-	auto unique_lock = comm_->lock();
+	return submit<float> (
+		[this, voltage] { return comm_->transmit_VS_setVoltage (voltage); },
+		[this] (const CommCB* oCB) {
 
-	ackBits_.reset (COMM_CBCODE_VM_GET_TERMINAL);
-	comm_->transmit_VM_getTerminal ();
+			const CommCB_VS_SetVoltage* o =
+				reinterpret_cast<const CommCB_VS_SetVoltage*> (oCB);
 
-	if (waitForResponse (COMM_CBCODE_VM_GET_TERMINAL, timeout))
-		*terminal = (vm_->terminal());
+			vs_->setVoltage (o->voltage());
+			return o->voltage();
+		});
 }
 
-/************************************************************************/
-/************************************************************************/
-
-void Driver::changeBaud (uint32_t* baudRate, float* timeout)
-/*
- * Transmits a request for a change in the baudrate of communication
- * channel; waits for acknowledgement of a change in baudrate in the
- * firmware
- */
+std::future<float> Driver::CM_readAsync (uint16_t filterLength)
 {
-	auto unique_lock = comm_->lock();
+	return submit<float> (
+		[this, filterLength] { return comm_->transmit_CM_read (filterLength); },
+		[this] (const CommCB* oCB) {
 
-	ackBits_.reset (COMM_CBCODE_CHANGE_BAUD);
+			const CommCB_CM_Read* o =
+				reinterpret_cast<const CommCB_CM_Read*> (oCB);
 
-	comm_->transmit_changeBaud (*baudRate);
-
-	if (waitForResponse (COMM_CBCODE_CHANGE_BAUD, timeout))
-		*baudRate = baudRate_;
+			cm_->setCurrent (o->current());
+			return o->current();
+		});
 }
 
-/************************************************************************/
-
-void Driver::recSize (uint16_t* recSize, float* timeout)
-/*
- * Transmits a request for the size of standby data queue stored in the
- * SMU RAM, through the communication channel; and waits for a response
- * within timeout duration.
- */
+std::future<float> Driver::VM_readAsync (uint16_t filterLength)
 {
-	auto unique_lock = comm_->lock();
-
-	ackBits_.reset (COMM_CBCODE_REC_SIZE);
+	return submit<float> (
+		[this, filterLength] { return comm_->transmit_VM_read (filterLength); },
+		[this] (const CommCB* oCB) {
 
-	comm_->transmit_recSize();
+			const CommCB_VM_Read* o =
+				reinterpret_cast<const CommCB_VM_Read*> (oCB);
 
-	if (waitForResponse (COMM_CBCODE_REC_SIZE, timeout))
-		*recSize = recSize_;
+			vm_->setVoltage (o->voltage());
+			return o->voltage();
+		});
 }
 
-/************************************************************************/
-
-void Driver::recData (uint16_t* size, float* timeout)
-/*
- * Transmits a request for data stored in the data queue in SMU RAM,
- * through the communication channel; and waits for a response
- * within timeout duration.
- */
+std::future<float> Driver::VM2_readAsync (uint16_t filterLength)
 {
-	PRINT_DEBUG ("Trying to acquire lock")
-	auto unique_lock = comm_->lock();
-	PRINT_DEBUG ("Lock Acquired")
+	return submit<float> (
+		[this, filterLength] { return comm_->transmit_VM2_read (filterLength); },
+		[this] (const CommCB* oCB) {
 
-	ackBits_.reset (COMM_CBCODE_REC_DATA);
-
-	comm_->transmit_recData (*size);
-	PRINT_DEBUG ("Successfully transmitted, waiting for response")
+			const CommCB_VM2_Read* o =
+				reinterpret_cast<const CommCB_VM2_Read*> (oCB);
 
-	waitForResponse (COMM_CBCODE_REC_DATA, timeout);
+			vm2_->setVoltage (o->voltage());
+			return o->voltage();
+		});
 }
 
-/************************************************************************/
-
-std::vector<float> Driver::getData (void)
-/*
- * Passes streamed data stored in the Driver to the Application layer.
- * Data stored in the queue is cleared as it passed to the user.
- *
- * Output : std::vector<float>
- */
+std::future<float> Driver::RM_readAutoscaleAsync (uint16_t filterLength)
 {
-	//std::vector<float> data {1.0, 3.5, 5.1, 7.2};
+	return submit<float> (
+		[this, filterLength] {
+			return comm_->transmit_RM_readAutoscale (filterLength);
+		},
+		[this] (const CommCB* oCB) {
 
-	std::vector<float> data;
+			const CommCB_RM_ReadAutoscale* o =
+				reinterpret_cast<const CommCB_RM_ReadAutoscale*> (oCB);
 
-	std::lock_guard<std::mutex> lock(_dataq_lock);
+			rm_->setResistance (o->resistance());
+			return o->resistance();
+		});
+}
 
-	while (!_dataq.empty())
-	{
-		data.push_back(_dataq.front());
-		_dataq.pop();
-		_dataq_32.pop();
-	}
+std::future<int16_t> Driver::SystemConfig_GetAsync (uint16_t paramID)
+{
+	return submit<int16_t> (
+		[this, paramID] { return comm_->transmit_SystemConfig_Get (paramID); },
+		[this] (const CommCB* oCB) {
 
-	return data;
+			const CommCB_SystemConfig_Get* o =
+				reinterpret_cast<const CommCB_SystemConfig_Get*> (oCB);
+
+			sysconf_->set (o->paramID(), o->value());
+			return o->value();
+		});
 }
 
 /************************************************************************/
-
-void Driver::StartRec (float *timeout)
+/************************************************************************/
+std::future<double> Driver::enqueueBatchCommand (const BatchCommand& command)
 /*
- * Sets a flag to instruct the SMU to start streaming data, and the driver
- * to start recording the streamed data. Then instructs the firmware to
- * start streaming data from the ADC
+ * Expects the comm lock held. Responses go through the opcode's
+ * callback, as for a blocking call, and the result is then read
+ * back from the host object it updated.
  */
 {
-	auto unique_lock = comm_->lock();
-	PRINT_DEBUG ("Lock Acquired")
-
-	ackBits_.reset (COMM_CBCODE_START_REC);
-
-	comm_->transmit_StartRec();
-	PRINT_DEBUG ("Successfully transmitted, waiting for response")
+	Comm* comm = comm_;
+	const double argument = command.argument;
+	const uint16_t n = static_cast<uint16_t> (argument);
+
+	switch (command.op) {
+
+		case BatchOp::SET_SOURCE_MODE:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmitSourceMode (toComm_SourceMode (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) (uint16_t) (vs_->active() ?
+						SourceMode::VOLTAGE : SourceMode::CURRENT);
+				});
+
+		case BatchOp::CS_SET_RANGE:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmit_CS_setRange (toComm_CS_Range (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) cs_->range();
+				});
+
+		case BatchOp::CS_SET_CURRENT:
+			return enqueue<double> (
+				[comm, argument] {
+					return comm->transmit_CS_setCurrent (argument);
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) cs_->current();
+				});
+
+		case BatchOp::VS_SET_RANGE:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmit_VS_setRange (toComm_VS_Range (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vs_->range();
+				});
+
+		case BatchOp::VS_SET_VOLTAGE:
+			return enqueue<double> (
+				[comm, argument] {
+					return comm->transmit_VS_setVoltage (argument);
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vs_->voltage();
+				});
+
+		case BatchOp::CM_SET_RANGE:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmit_CM_setRange (toComm_CM_Range (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) cm_->range();
+				});
+
+		case BatchOp::CM_READ:
+			return enqueue<double> (
+				[comm, n] { return comm->transmit_CM_read (n); },
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) cm_->current();
+				});
+
+		case BatchOp::VM_SET_RANGE:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmit_VM_setRange (toComm_VM_Range (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vm_->range();
+				});
+
+		case BatchOp::VM_READ:
+			return enqueue<double> (
+				[comm, n] { return comm->transmit_VM_read (n); },
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vm_->voltage();
+				});
+
+		case BatchOp::VM2_READ:
+			return enqueue<double> (
+				[comm, n] { return comm->transmit_VM2_read (n); },
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vm2_->voltage();
+				});
+
+		case BatchOp::RM_READ_AUTOSCALE:
+			return enqueue<double> (
+				[comm, n] { return comm->transmit_RM_readAutoscale (n); },
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) rm_->resistance();
+				});
+
+		case BatchOp::VM_SET_TERMINAL:
+			return enqueue<double> (
+				[comm, n] {
+					return comm->transmit_VM_setTerminal (
+						toComm_VM_Terminal (n));
+				},
+				[this] (const CommCB* oCB) {
+					dispatch (oCB);
+					return (double) vm_->terminal();
+				});
+	}
 
-	waitForResponse (COMM_CBCODE_START_REC, timeout);
-    PRINT_DEBUG ("Response Recieved")
+	return std::future<double>();
 }
 
-void Driver::StopRec (float *timeout)
-/*
- * Unsets a flag to instruct the SMU to stop streaming data, and the driver
- * to stop recording. Then instructs the firmware to stop streaming data
- * from the ADC
- */
+void Driver::execute (std::vector<BatchCommand>* commands, float* timeout)
 {
+	using namespace std::chrono;
+
+	const steady_clock::time_point entry = steady_clock::now();
+	const steady_clock::time_point deadline = entry +
+		duration_cast<steady_clock::duration> (duration<float> (*timeout));
+
 	auto unique_lock = comm_->lock();
-	PRINT_DEBUG ("Lock Acquired")
 
-	ackBits_.reset (COMM_CBCODE_STOP_REC);
+	std::vector<std::future<double>> results;
+	results.reserve (commands->size());
 
-	comm_->transmit_StopRec();
-	PRINT_DEBUG ("Successfully transmitted, waiting for response")
+	/**** All requests go out in one write ****/
+	comm_->cork();
 
-	waitForResponse (COMM_CBCODE_STOP_REC, timeout);
-	_rec = false;
-    PRINT_DEBUG ("Response Recieved")
+	for (size_t i = 0; i < commands->size(); ++i)
+		results.push_back (enqueueBatchCommand ((*commands)[i]));
 
-	/*
-	 * Restore Baud Rate of communication when streaming stops
-	 */
+	comm_->uncork();
 
-	// uint32_t baudRate = 9600;
-	// float time_out = 1;
-	// changeBaud (&baudRate, &time_out);
-}
+	bool timedOut = false;
 
-/************************************************************************/
+	for (size_t i = 0; i < commands->size(); ++i) {
 
-float Driver::applyCalibration (int32_t adc_value)
-/*
- * Applys the calibration (depending upon what physical quantity is being
- * measured, and the range for the same; eg. current, 100uA range) to
- * convert an ADC value into a voltage or current value
- */
-{
-	//TODO : How to apply calibration from a table?
-	return float (adc_value);
+		BatchCommand& command = (*commands)[i];
+		command.result = 0;
+
+		if (!results[i].valid())
+			command.status = BatchStatus::INVALID;
+
+		else if (results[i].wait_until (deadline) != std::future_status::ready)
+			command.status = BatchStatus::TIMEOUT;
+
+		else try {
+
+			command.result = results[i].get();
+			command.status = BatchStatus::DONE;
+		}
+		catch (const NoOperation&) {
+			command.status = BatchStatus::NO_OPERATION;
+		}
+		catch (const RequestLost&) {
+			command.status = BatchStatus::LOST;
+		}
+
+		timedOut |= (command.status == BatchStatus::TIMEOUT);
+	}
+
+	const double elapsed =
+		duration<double> (steady_clock::now() - entry).count();
+
+	*timeout = (timedOut || (elapsed > *timeout)) ? 0 : (*timeout - elapsed);
 }
 
 /************************************************************************/
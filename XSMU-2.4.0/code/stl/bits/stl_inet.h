@@ -2,6 +2,13 @@
 #define __SMU_STD_INET__
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace smu
 {
@@ -42,6 +49,35 @@ inline T ntoh (const T& x)
 	return u.x;
 }
 
+/*
+ * Converts n 32-bit words from network order in bulk, e.g. straight
+ * out of a received frame. src need not be aligned.
+ */
+inline void ntoh (int32_t* dst, const void* src, size_t n)
+{
+	const uint8_t* s = reinterpret_cast<const uint8_t*> (src);
+
+#if defined(__SSE2__)
+	for (; n >= 4; n -= 4, s += 16, dst += 4) {
+
+		__m128i x = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s));
+
+		/**** Swaps 16-bit halves, then the bytes within them ****/
+		x = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (x, 0xB1), 0xB1);
+		x = _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+
+		_mm_storeu_si128 (reinterpret_cast<__m128i*> (dst), x);
+	}
+#endif
+
+	for (; n; --n, s += 4) {
+
+		int32_t x;
+		std::memcpy (&x, s, sizeof (x));
+		*dst++ = ntoh (x);
+	}
+}
+
 }; // namespace smu
 
 #endif
@@ -0,0 +1,235 @@
+#include "../sys/DeviceRegistry.h"
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+DeviceRegistry& DeviceRegistry::instance (void)
+{
+	static DeviceRegistry registry;
+	return registry;
+}
+
+DeviceRegistry::DeviceRegistry (void) :
+	ctx_ (0),
+	hotplugHandle_ (0),
+	hotplug_ (false),
+	running_ (false),
+	nextSubscriberId_ (1)
+{
+	if (libusb_init (&ctx_) != LIBUSB_SUCCESS) {
+
+		ctx_ = 0;
+		return;
+	}
+
+	if (!libusb_has_capability (LIBUSB_CAP_HAS_HOTPLUG))
+		return;
+
+	/**** Devices already attached are reported right away ****/
+	if (libusb_hotplug_register_callback (ctx_,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+		LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_ENUMERATE, FTDI_VID,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		hotplug_cb, this, &hotplugHandle_) != LIBUSB_SUCCESS)
+			return;
+
+	hotplug_ = true;
+	processPending();
+
+	running_ = true;
+	thread_ = std::thread (&DeviceRegistry::eventThread, this);
+}
+
+DeviceRegistry::~DeviceRegistry (void)
+{
+	running_ = false;
+
+	if (thread_.joinable())
+		thread_.join();
+
+	if (hotplug_)
+		libusb_hotplug_deregister_callback (ctx_, hotplugHandle_);
+
+	for (auto it = devices_.begin(); it != devices_.end(); ++it)
+		libusb_unref_device (it->first);
+
+	for (auto it = pending_.begin(); it != pending_.end(); ++it)
+		libusb_unref_device (it->first);
+
+	if (ctx_)
+		libusb_exit (ctx_);
+}
+
+/************************************************************************/
+
+std::vector<FTDI_DeviceInfo> DeviceRegistry::devices (void)
+{
+	if (!hotplug_)
+		return FTDI::scan();
+
+	std::lock_guard<std::mutex> lock (devicesLock_);
+	std::vector<FTDI_DeviceInfo> list;
+
+	for (auto it = devices_.begin(); it != devices_.end(); ++it)
+		list.insert (list.end(), it->second.begin(), it->second.end());
+
+	return list;
+}
+
+int DeviceRegistry::subscribe (DeviceRegistryCallback cb, void* user_data)
+{
+	std::lock_guard<std::mutex> lock (subscribersLock_);
+
+	const Subscriber subscriber = {cb, user_data};
+	subscribers_[nextSubscriberId_] = subscriber;
+	return nextSubscriberId_++;
+}
+
+void DeviceRegistry::unsubscribe (int id)
+{
+	std::lock_guard<std::mutex> lock (subscribersLock_);
+	subscribers_.erase (id);
+}
+
+/************************************************************************/
+
+void DeviceRegistry::eventThread (void)
+{
+	while (running_) {
+
+		struct timeval tv = {0, 100000};
+		libusb_handle_events_timeout_completed (ctx_, &tv, 0);
+		processPending();
+	}
+}
+
+int LIBUSB_CALL DeviceRegistry::hotplug_cb (libusb_context* ctx,
+	libusb_device* dev, libusb_hotplug_event event, void* user_data)
+/*
+ * libusb forbids opening devices from within this callback,
+ * so events are only queued here.
+ */
+{
+	DeviceRegistry* registry = reinterpret_cast<DeviceRegistry*> (user_data);
+
+	std::lock_guard<std::mutex> lock (registry->pendingLock_);
+	registry->pending_.push_back (std::make_pair (
+		libusb_ref_device (dev), event));
+
+	return 0;
+}
+
+void DeviceRegistry::processPending (void)
+{
+	for (;;) {
+
+		std::pair<libusb_device*, libusb_hotplug_event> event;
+
+		{
+			std::lock_guard<std::mutex> lock (pendingLock_);
+
+			if (pending_.empty())
+				return;
+
+			event = pending_.front();
+			pending_.pop_front();
+		}
+
+		if (event.second == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+			arrived (event.first);
+		else
+			left (event.first);
+
+		libusb_unref_device (event.first);
+	}
+}
+
+void DeviceRegistry::arrived (libusb_device* dev)
+/*
+ * Reads the serial number and description once, on arrival.
+ */
+{
+	libusb_device_descriptor desc;
+
+	if (libusb_get_device_descriptor (dev, &desc) != LIBUSB_SUCCESS)
+		return;
+
+	libusb_device_handle* handle = 0;
+
+	if (libusb_open (dev, &handle) != LIBUSB_SUCCESS)
+		return;
+
+	unsigned char serialNo[256], description[256];
+
+	const bool good =
+		(libusb_get_string_descriptor_ascii (handle, desc.iSerialNumber,
+			serialNo, sizeof (serialNo)) >= 0) &&
+		(libusb_get_string_descriptor_ascii (handle, desc.iProduct,
+			description, sizeof (description)) >= 0);
+
+	libusb_close (handle);
+
+	if (!good) return;
+
+	const std::vector<FTDI_DeviceInfo> interfaces =
+		FTDI::interfaces (desc.idProduct,
+			reinterpret_cast<const char*> (serialNo),
+			reinterpret_cast<const char*> (description));
+
+	if (interfaces.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock (devicesLock_);
+
+		if (devices_.count (dev)) return;
+		devices_[libusb_ref_device (dev)] = interfaces;
+	}
+
+	notify (DEVICE_EVENT_ARRIVED, interfaces);
+}
+
+void DeviceRegistry::left (libusb_device* dev)
+{
+	std::vector<FTDI_DeviceInfo> interfaces;
+
+	{
+		std::lock_guard<std::mutex> lock (devicesLock_);
+
+		auto it = devices_.find (dev);
+		if (it == devices_.end()) return;
+
+		interfaces = it->second;
+		libusb_unref_device (it->first);
+		devices_.erase (it);
+	}
+
+	notify (DEVICE_EVENT_LEFT, interfaces);
+}
+
+void DeviceRegistry::notify (DeviceEventType type,
+							 const std::vector<FTDI_DeviceInfo>& devices)
+{
+	std::map<int, Subscriber> subscribers;
+
+	{
+		std::lock_guard<std::mutex> lock (subscribersLock_);
+		subscribers = subscribers_;
+	}
+
+	for (size_t i = 0; i < devices.size(); ++i)
+		for (auto it = subscribers.begin(); it != subscribers.end(); ++it)
+			it->second.cb (it->second.user_data,
+				DeviceEvent (type, devices[i]));
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
+
+#endif // linux
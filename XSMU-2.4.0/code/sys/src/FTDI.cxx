@@ -1,10 +1,13 @@
 #include "../sys/FTDI.h"
+#include "../sys/IoEngine.h"
+#include "../sys/Log.h"
 
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
 #include <cstring>
 #include <string>
+#include <algorithm>
 
 #ifdef min
 #undef min
@@ -21,26 +24,48 @@ FTDI_DeviceInfo::FTDI_DeviceInfo (const char* serialNo,
     description_ (description)
 {}
 
+FTDI_Parameters::FTDI_Parameters (void) :
+    latencyTimer_     (16),
+    readChunkSize_    (4096),
+    writeChunkSize_   (4096),
+    eventChar_        (0),
+    eventCharEnabled_ (false)
+{}
+
 /*************************************************************************/
 /************************************************************************/
 
 }
 #if defined(linux) || defined(__linux) || defined(__linux__)
 
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 namespace smu {
 
 /************************************************************************/
 /************************************************************************/
 
 #define FTDI_OK          0
-#define FTDI_VID         0x0403
-#define FTDI_FT232_PID   0x6001
-#define FTDI_FT2232_PID  0x6010
-#define FTDI_FT4232_PID  0x6011
 
-FTDI::FTDI (void) : handle_ (0)
+FTDI::FTDI (void) :
+	handle_    (0),
+	rxRing_    (FTDI_RX_RING_SIZE),
+	rxRunning_ (false),
+	rxFailed_  (false),
+	rxPending_ (0),
+	rxEvent_   (eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC))
 {}
 
+FTDI::~FTDI (void)
+{
+	close();
+
+	if (rxEvent_ >= 0)
+		::close (rxEvent_);
+}
+
 std::vector<FTDI_DeviceInfo> FTDI::scan (int vid, int pid)
 {
 	ftdi_context* handle = 0;
@@ -63,42 +88,43 @@ std::vector<FTDI_DeviceInfo> FTDI::scan (int vid, int pid)
 			serialNo, sizeof (serialNo)) != FTDI_OK)
 				continue;
 
-		std::string _serialNo (serialNo);
-
-		if (pid == FTDI_FT232_PID) {
-
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "A").c_str(), description));
-		}
+		const std::vector<FTDI_DeviceInfo> devs =
+			interfaces (pid, serialNo, description);
 
-		else if (pid == FTDI_FT2232_PID) {
+		devices.insert (devices.end(), devs.begin(), devs.end());
+	}
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "A").c_str(), description));
+abort:
+	if (list) ftdi_list_free (&list);
+	if (handle) ftdi_free (handle);
+	return devices;
+}
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "B").c_str(), description));
-		}
+std::vector<FTDI_DeviceInfo> FTDI::interfaces (int pid,
+	const char* serialNo, const char* description)
+/*
+ * One entry per UART of the chip, named by the serial
+ * number suffixed with the interface letter.
+ */
+{
+	std::vector<FTDI_DeviceInfo> devices;
+	const std::string _serialNo (serialNo);
 
-		else if (pid == FTDI_FT4232_PID) {
+	int count = 0;
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "A").c_str(), description));
+	if (pid == FTDI_FT232_PID)
+		count = 1;
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "B").c_str(), description));
+	else if (pid == FTDI_FT2232_PID)
+		count = 2;
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "C").c_str(), description));
+	else if (pid == FTDI_FT4232_PID)
+		count = 4;
 
-			devices.push_back (FTDI_DeviceInfo (
-				(_serialNo + "D").c_str(), description));
-		}
-	}
+	for (int i = 0; i < count; ++i)
+		devices.push_back (FTDI_DeviceInfo (
+			(_serialNo + (char)('A' + i)).c_str(), description));
 
-abort:
-	if (list) ftdi_list_free (&list);
-	if (handle) ftdi_free (handle);
 	return devices;
 }
 
@@ -143,6 +169,8 @@ void FTDI::open (const char* serialNumber)
 	if (good() || ((handle_ = ftdi_new()) == 0))
 		return;
 
+	parameters_ = FTDI_Parameters();
+
 	/**** Selects an interface ****/
 	if (ftdi_set_interface (handle_, interface) != FTDI_OK) {
 
@@ -160,6 +188,9 @@ void FTDI::open (const char* serialNumber)
 			if (ftdi_usb_open_desc (handle_,
 			FTDI_VID, FTDI_FT4232_PID, 0, serialNo) != FTDI_OK) {
 
+				SMU_LOG_WARNING (LOG_FTDI, "Cannot open {}: {}",
+					serialNo, ftdi_get_error_string (handle_));
+
 				close();
 				return;
 			}
@@ -170,6 +201,13 @@ void FTDI::open (const char* serialNumber)
 		close();
 		return;
 	}
+
+	/**** Keeps bulk-IN transfers queued from here on ****/
+	if (!startReceiveEngine()) {
+
+		close();
+		return;
+	}
 }
 
 void FTDI::open (const char* serialNo, int baudrate)
@@ -195,17 +233,24 @@ void FTDI::open (const char* serialNo, int baudrate)
 
 uint32_t FTDI::read (void* data, uint32_t size)
 {
-	int rxsize;
 	if (!good()) return 0;
 
-	if ((rxsize = ftdi_read_data (handle_,
-		reinterpret_cast<unsigned char*> (data),
-		size)) < FTDI_OK) {
+	if (rxFailed_) {
 
-			close();
-			return 0;
+		close();
+		return 0;
 	}
 
+	/**** Clears the event before draining, so no arrival is missed ****/
+	uint64_t events;
+	if (::read (rxEvent_, &events, sizeof (events)) < 0) {}
+
+	const uint32_t rxsize =
+		rxRing_.pop (reinterpret_cast<uint8_t*> (data), size);
+
+	if (!rxRing_.empty())
+		signalReceived();
+
 	return rxsize;
 }
 
@@ -217,6 +262,9 @@ uint32_t FTDI::write (const void* data, uint32_t size)
 	if ((txsize = ftdi_write_data (handle_, const_cast<unsigned char*> (
 		reinterpret_cast<const unsigned char*> (data)), size)) < FTDI_OK) {
 
+			SMU_LOG_WARNING (LOG_FTDI, "Write failed: {}",
+				ftdi_get_error_string (handle_));
+
 			close();
 			return 0;
 	}
@@ -228,6 +276,7 @@ void FTDI::close (void)
 {
 	if (good()) {
 
+		stopReceiveEngine();
 		ftdi_usb_close (handle_);
 		ftdi_free (handle_);
 		handle_ = 0;
@@ -239,45 +288,299 @@ bool FTDI::good (void) const
 	return handle_;
 }
 
-void FTDI::setBaudRate (uint32_t bd)
+bool FTDI::setBaudRate (uint32_t bd)
+/*
+ * Besides the standard rates, the FT232 derives any rate of
+ * 3 MHz / (n + k/8) from its clock. libftdi picks the divisor,
+ * and refuses rates that cannot be met within 3%.
+ */
+{
+	if ((bd < FTDI_MIN_BAUDRATE) || (bd > FTDI_MAX_BAUDRATE))
+		return false;
+
+	return _setBaudrate (bd);
+}
+
+bool FTDI::_setBaudrate (uint32_t baudrate)
 {
-	switch (bd)
+	if (!good()) return false;
+
+	/**** An unsupported rate leaves the port as it was ****/
+	if (ftdi_set_baudrate (handle_, baudrate) != FTDI_OK)
+		return false;
+
+	if (ftdi_set_line_property2 (handle_, BITS_8,
+		STOP_BIT_1, NONE, BREAK_OFF) != FTDI_OK) {
+
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+/************************************************************************/
+
+bool FTDI::setParameters (const FTDI_Parameters& p)
+{
+	if (!good()) return false;
+
+	/**** The receive engine sizes its transfers by the read chunk ****/
+	const bool restart =
+		(p.readChunkSize() != parameters_.readChunkSize());
+
+	if (restart)
+		stopReceiveEngine();
+
+	bool ok =
+		(ftdi_set_latency_timer (handle_, p.latencyTimer()) == FTDI_OK) &&
+		(ftdi_read_data_set_chunksize (handle_, p.readChunkSize()) == FTDI_OK) &&
+		(ftdi_write_data_set_chunksize (handle_, p.writeChunkSize()) == FTDI_OK) &&
+		(ftdi_set_event_char (handle_,
+			p.eventChar(), p.eventCharEnabled()) == FTDI_OK);
+
+	if (ok)
+		parameters_ = p;
+
+	if (restart && !startReceiveEngine()) {
+
+		close();
+		return false;
+	}
+
+	return ok;
+}
+
+/************************************************************************/
+
+bool FTDI::startReceiveEngine (void)
+{
+	const int chunksize = handle_->readbuffer_chunksize;
+
+	rxRing_.clear();
+	rxFailed_  = false;
+	rxRunning_ = true;
+	rxPending_ = 0;
+
+	rxBuffers_.assign (FTDI_RX_TRANSFERS * chunksize, 0);
+
+	for (int i = 0; i < FTDI_RX_TRANSFERS; ++i) {
+
+		libusb_transfer* transfer = libusb_alloc_transfer (0);
+		if (!transfer) break;
+
+		rxTransfers_.push_back (transfer);
+
+		libusb_fill_bulk_transfer (transfer,
+			handle_->usb_dev, handle_->out_ep,
+			&rxBuffers_[i * chunksize], chunksize,
+			receive_cb, this, 0);
+
+		if (libusb_submit_transfer (transfer) != LIBUSB_SUCCESS)
+			break;
+
+		++rxPending_;
+	}
+
+	watchEvents();
+
+	if (rxPending_ != FTDI_RX_TRANSFERS) {
+
+		stopReceiveEngine();
+		return false;
+	}
+
+	return true;
+}
+
+void FTDI::stopReceiveEngine (void)
+{
+	/**** No transfer is resubmitted once these are cancelled ****/
 	{
-		case 9600:
-			return _setBaudrate (9600);
+		std::lock_guard<std::mutex> lock (rxLock_);
+
+		rxRunning_ = false;
+
+		for (size_t i = 0; i < rxTransfers_.size(); ++i)
+			libusb_cancel_transfer (rxTransfers_[i]);
+	}
+
+	unwatchEvents();
+
+	/**** Cancelled transfers complete before they are freed ****/
+	while (rxPending_ > 0) {
+
+		struct timeval tv = {0, 100000};
+		libusb_handle_events_timeout_completed (handle_->usb_ctx, &tv, 0);
+	}
+
+	for (size_t i = 0; i < rxTransfers_.size(); ++i)
+		libusb_free_transfer (rxTransfers_[i]);
+
+	rxTransfers_.clear();
+}
 
+void FTDI::signalReceived (void)
+{
+	const uint64_t one = 1;
+	if (::write (rxEvent_, &one, sizeof (one)) < 0) {}
+}
+
+void LIBUSB_CALL FTDI::receive_cb (libusb_transfer* transfer)
+{
+	reinterpret_cast<FTDI*> (transfer->user_data)->received (transfer);
+}
 
-		case 19200:
-			return _setBaudrate (19200);
+void FTDI::received (libusb_transfer* transfer)
+{
+	switch (transfer->status) {
 
+		case LIBUSB_TRANSFER_COMPLETED: {
 
-		case 38400:
-			return _setBaudrate (38400);
+			/**** Each USB packet begins with two modem status bytes ****/
+			const int packet_size = handle_->max_packet_size;
+			const uint8_t* src = transfer->buffer;
+			int remaining = transfer->actual_length;
 
+			while (remaining > 2) {
 
-		case 57600:
-			return _setBaudrate (57600);
+				const int len = std::min (remaining, packet_size);
 
+				// Bytes that do not fit are dropped here and
+				// rejected by the QP4 checksum downstream.
+				const size_t pushed = rxRing_.push (src + 2, len - 2);
+
+				if (pushed < size_t (len - 2))
+					SMU_LOG_DEBUG (LOG_FTDI, "Receive ring full, {} bytes dropped",
+						len - 2 - pushed);
+
+				src += len;
+				remaining -= len;
+			}
+
+			if (transfer->actual_length > 2)
+				signalReceived();
+		}
 
-		case 115200:
-			return _setBaudrate (115200);
+		// Fall through to resubmit
+
+		case LIBUSB_TRANSFER_TIMED_OUT: {
+
+			std::lock_guard<std::mutex> lock (rxLock_);
+
+			if (rxRunning_ &&
+				(libusb_submit_transfer (transfer) == LIBUSB_SUCCESS))
+					return;
+
+			break;
+		}
+
+		case LIBUSB_TRANSFER_CANCELLED:
+			break;
+
+		default:
+			SMU_LOG_WARNING (LOG_FTDI, "Bulk-IN transfer failed, status {}",
+				int (transfer->status));
+
+			rxFailed_ = true;
+			signalReceived();
+			break;
 	}
+
+	--rxPending_;
 }
 
-void FTDI::_setBaudrate (uint32_t baudrate)
+/************************************************************************/
+
+void FTDI::watchEvents (void)
+/*
+ * Transfers have no timeout, and libusb keeps its own timer
+ * descriptor on Linux, so its descriptors are all there is to wait on.
+ */
 {
-	if (ftdi_set_baudrate (handle_, baudrate) != FTDI_OK) {
+	libusb_context* ctx = handle_->usb_ctx;
 
-		close();
-		return;
+	libusb_set_pollfd_notifiers (ctx,
+		pollfd_added_cb, pollfd_removed_cb, this);
+
+	const libusb_pollfd** fds = libusb_get_pollfds (ctx);
+
+	if (!fds) return;
+
+	for (const libusb_pollfd** it = fds; *it; ++it)
+		addPollfd ((*it)->fd, (*it)->events);
+
+	libusb_free_pollfds (fds);
+}
+
+void FTDI::unwatchEvents (void)
+{
+	libusb_set_pollfd_notifiers (handle_->usb_ctx, 0, 0, 0);
+
+	std::map<int, int> watches;
+
+	{
+		std::lock_guard<std::mutex> lock (rxWatchLock_);
+		watches.swap (rxWatches_);
 	}
 
-	if (ftdi_set_line_property2 (handle_, BITS_8,
-		STOP_BIT_1, NONE, BREAK_OFF) != FTDI_OK) {
+	for (std::map<int, int>::const_iterator it = watches.begin();
+		 it != watches.end(); ++it)
+			IoEngine::instance().unwatch (it->second);
+}
 
-		close();
-		return;
+void FTDI::addPollfd (int fd, short events)
+{
+	const int id = IoEngine::instance().watch (fd, handleEvents, this,
+		((events & POLLIN)  ? IO_READABLE : 0) |
+		((events & POLLOUT) ? IO_WRITABLE : 0));
+
+	std::lock_guard<std::mutex> lock (rxWatchLock_);
+	rxWatches_[fd] = id;
+}
+
+void FTDI::removePollfd (int fd)
+{
+	int id = 0;
+
+	{
+		std::lock_guard<std::mutex> lock (rxWatchLock_);
+
+		std::map<int, int>::iterator it = rxWatches_.find (fd);
+
+		if (it == rxWatches_.end())
+			return;
+
+		id = it->second;
+		rxWatches_.erase (it);
 	}
+
+	IoEngine::instance().unwatch (id);
+}
+
+bool FTDI::handleEvents (void* user_data)
+/*
+ * On the IoEngine's thread, which must not block: completes
+ * whatever transfers are done, and returns at once.
+ */
+{
+	FTDI* ftdi = reinterpret_cast<FTDI*> (user_data);
+
+	struct timeval tv = {0, 0};
+	libusb_handle_events_timeout_completed (ftdi->handle_->usb_ctx, &tv, 0);
+
+	return true;
+}
+
+void LIBUSB_CALL FTDI::pollfd_added_cb (int fd, short events,
+										void* user_data)
+{
+	reinterpret_cast<FTDI*> (user_data)->addPollfd (fd, events);
+}
+
+void LIBUSB_CALL FTDI::pollfd_removed_cb (int fd, void* user_data)
+{
+	reinterpret_cast<FTDI*> (user_data)->removePollfd (fd);
 }
 
 /************************************************************************/
@@ -354,6 +657,10 @@ void FTDI::open (const char* serialNo)
 	if (FT_SetUSBParameters (handle_, 64 * 1024, 64 * 1024) != FT_OK)
 		goto abort;
 
+	parameters_ = FTDI_Parameters();
+	parameters_.readChunkSize (64 * 1024);
+	parameters_.writeChunkSize (64 * 1024);
+
 	configureTimeouts();
 	return;
 
@@ -446,6 +753,35 @@ bool FTDI::good (void) const
 	return (handle_ != (FT_HANDLE)INVALID_HANDLE_VALUE);
 }
 
+bool FTDI::setBaudRate (uint32_t bd)
+{
+	if (!good()) return false;
+
+	if ((bd < FTDI_MIN_BAUDRATE) || (bd > FTDI_MAX_BAUDRATE))
+		return false;
+
+	return (FT_SetBaudRate (handle_, bd) == FT_OK);
+}
+
+bool FTDI::setParameters (const FTDI_Parameters& p)
+{
+	if (!good()) return false;
+
+	if (FT_SetLatencyTimer (handle_, p.latencyTimer()) != FT_OK)
+		return false;
+
+	if (FT_SetUSBParameters (handle_,
+		p.readChunkSize(), p.writeChunkSize()) != FT_OK)
+			return false;
+
+	if (FT_SetChars (handle_,
+		p.eventChar(), p.eventCharEnabled(), 0, 0) != FT_OK)
+			return false;
+
+	parameters_ = p;
+	return true;
+}
+
 void FTDI::configureTimeouts (void)
 {
 	FTTIMEOUTS ftTS;
@@ -0,0 +1,647 @@
+#include "../sys/IoEngine.h"
+#include "../sys/Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+/**** epoll keys of the engine's own descriptors; watches use their ids ****/
+static const uint64_t WAKE_KEY  = ~uint64_t (0);
+static const uint64_t TIMER_KEY = ~uint64_t (0) - 1;
+
+/**** Delay before a task whose handler threw runs again ****/
+static const double TASK_RETRY_DELAY = 1.0;
+
+IoEngine& IoEngine::instance (void)
+/*
+ * Never destroyed, like the threads it runs, which
+ * may still be serving a device at exit.
+ */
+{
+	static IoEngine* engine = new IoEngine;
+	return *engine;
+}
+
+IoEngine::IoEngine (void) :
+	nextId_ (1),
+	polledWatches_ (0),
+	runningWatch_ (0),
+	epoch_ (Clock::now()),
+	lastTick_ (0),
+	armedTick_ (0),
+	maxWorkers_ (4),
+	workers_ (0),
+	idleWorkers_ (0),
+	wakeups_ (0),
+	writer_ (false),
+	epoll_ (-1),
+	timerfd_ (-1),
+	wakefd_ (-1)
+{
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	epoll_   = epoll_create1 (EPOLL_CLOEXEC);
+	timerfd_ = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	wakefd_  = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	struct epoll_event event;
+	memset (&event, 0, sizeof (event));
+	event.events = EPOLLIN;
+
+	event.data.u64 = TIMER_KEY;
+	epoll_ctl (epoll_, EPOLL_CTL_ADD, timerfd_, &event);
+
+	event.data.u64 = WAKE_KEY;
+	epoll_ctl (epoll_, EPOLL_CTL_ADD, wakefd_, &event);
+#endif
+
+	std::lock_guard<std::mutex> lock (lock_);
+
+	std::thread thread (&IoEngine::loop, this);
+	loopThread_ = thread.get_id();
+	thread.detach();
+}
+
+/************************************************************************/
+
+int IoEngine::watch (int fd, IoWatchHandler handler, void* user_data,
+					 unsigned events)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	Watch watch = {-1, handler, user_data};
+	const int id = nextId_++;
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (fd >= 0) {
+
+		struct epoll_event event;
+		memset (&event, 0, sizeof (event));
+		event.data.u64 = id;
+
+		if (events & IO_READABLE) event.events |= EPOLLIN;
+		if (events & IO_WRITABLE) event.events |= EPOLLOUT;
+
+		if (epoll_ctl (epoll_, EPOLL_CTL_ADD, fd, &event) == 0)
+			watch.fd = fd;
+		else
+			SMU_LOG_WARNING (LOG_COMM, "Cannot wait on descriptor {}, "
+				"polling it instead", fd);
+	}
+#endif
+
+	watches_[id] = watch;
+
+	if (watch.fd < 0) {
+
+		++polledWatches_;
+		wake();
+	}
+
+	return id;
+}
+
+void IoEngine::unwatch (int id)
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	removeWatch (id);
+
+	if (std::this_thread::get_id() != loopThread_)
+		while (runningWatch_ == id)
+			doneCond_.wait (lock);
+}
+
+void IoEngine::removeWatch (int id)
+/*
+ * Expects lock_ held.
+ */
+{
+	std::map<int, Watch>::iterator it = watches_.find (id);
+
+	if (it == watches_.end())
+		return;
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (it->second.fd >= 0)
+		epoll_ctl (epoll_, EPOLL_CTL_DEL, it->second.fd, 0);
+#endif
+
+	if (it->second.fd < 0)
+		--polledWatches_;
+
+	watches_.erase (it);
+}
+
+void IoEngine::runWatch (int id)
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	std::map<int, Watch>::iterator it = watches_.find (id);
+
+	if (it == watches_.end())
+		return;
+
+	const Watch watch = it->second;
+	runningWatch_ = id;
+
+	lock.unlock();
+
+	/**** A handler that throws keeps its watch, and the thread ****/
+	bool keep = true;
+
+	try {
+		keep = watch.handler (watch.user_data);
+	}
+	catch (const std::exception& e) {
+		SMU_LOG_ERROR (LOG_COMM, "Watch {} failed: {}", id, e.what());
+	}
+	catch (...) {
+		SMU_LOG_ERROR (LOG_COMM, "Watch {} failed", id);
+	}
+
+	lock.lock();
+
+	runningWatch_ = 0;
+
+	if (!keep)
+		removeWatch (id);
+
+	doneCond_.notify_all();
+}
+
+/************************************************************************/
+
+int IoEngine::schedule (IoTaskHandler handler, void* user_data, double delay)
+{
+	return add (handler, user_data, delay, false);
+}
+
+int IoEngine::scheduleWrite (IoTaskHandler handler, void* user_data,
+							 double delay)
+{
+	return add (handler, user_data, delay, true);
+}
+
+int IoEngine::add (IoTaskHandler handler, void* user_data, double delay,
+				   bool write)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	const int id = nextId_++;
+
+	Task& task = tasks_[id];
+	task.handler = handler;
+	task.user_data = user_data;
+	task.state = TASK_WAITING;
+	task.due = 0;
+	task.generation = 0;
+	task.rescheduled = -1;
+	task.cancelled = false;
+	task.write = write;
+
+	enqueue (id, task, delay);
+	return id;
+}
+
+void IoEngine::reschedule (int id, double delay)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+
+	std::map<int, Task>::iterator it = tasks_.find (id);
+
+	if (it == tasks_.end())
+		return;
+
+	Task& task = it->second;
+
+	switch (task.state) {
+
+	case TASK_WAITING:
+		enqueue (id, task, delay);
+		break;
+
+	case TASK_RUNNING:
+		task.rescheduled = (task.rescheduled < 0) ?
+			delay : std::min (task.rescheduled, delay);
+		break;
+
+	case TASK_READY:
+		break;
+	}
+}
+
+void IoEngine::cancel (int id)
+/*
+ * Entries left behind in the wheel or the ready queue
+ * no longer match a task, and are skipped.
+ */
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	std::map<int, Task>::iterator it = tasks_.find (id);
+
+	if (it == tasks_.end())
+		return;
+
+	if (it->second.state != TASK_RUNNING) {
+
+		tasks_.erase (it);
+		return;
+	}
+
+	it->second.cancelled = true;
+
+	if (it->second.runner == std::this_thread::get_id())
+		return;
+
+	while (tasks_.count (id))
+		doneCond_.wait (lock);
+}
+
+/************************************************************************/
+
+unsigned IoEngine::maxWorkers (void) const
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	return maxWorkers_;
+}
+
+void IoEngine::setMaxWorkers (unsigned n)
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	maxWorkers_ = std::max (1u, n);
+}
+
+unsigned IoEngine::workers (void) const
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	return workers_;
+}
+
+uint64_t IoEngine::wakeups (void) const
+{
+	std::lock_guard<std::mutex> lock (lock_);
+	return wakeups_;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+uint64_t IoEngine::tick (Clock::time_point t) const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds> (
+		t - epoch_).count();
+}
+
+uint64_t IoEngine::dueTick (double delay) const
+/*
+ * Rounded up, so that a task never runs early.
+ */
+{
+	const double at = std::chrono::duration<double> (
+		Clock::now() - epoch_).count() + std::max (0.0, delay);
+
+	return uint64_t (std::ceil (at * 1e3));
+}
+
+void IoEngine::enqueue (int id, Task& task, double delay)
+/*
+ * Expects lock_ held. Moving a task leaves its old wheel entry
+ * behind, which the new generation marks stale.
+ */
+{
+	const uint64_t due = dueTick (delay);
+
+	++task.generation;
+	task.rescheduled = -1;
+
+	/**** Rounding up must not hold back what is due now ****/
+	if ((delay <= 0) || (due <= tick (Clock::now()))) {
+
+		ready (id, task);
+		return;
+	}
+
+	task.state = TASK_WAITING;
+	task.due = due;
+
+	const WheelEntry entry = {id, task.generation};
+	wheel_[due % WHEEL_SLOTS].push_back (entry);
+
+	if (!armedTick_ || (due < armedTick_))
+		arm (due);
+}
+
+void IoEngine::ready (int id, Task& task)
+/*
+ * Expects lock_ held. Starts another worker if
+ * there are more due tasks than idle workers.
+ */
+{
+	task.state = TASK_READY;
+
+	if (task.write) {
+
+		writes_.push_back (id);
+
+		if (!writer_) {
+
+			writer_ = true;
+			std::thread (&IoEngine::writer, this).detach();
+		}
+
+		writeCond_.notify_one();
+		return;
+	}
+
+	ready_.push_back (id);
+
+	if ((ready_.size() > idleWorkers_) && (workers_ < maxWorkers_)) {
+
+		++workers_;
+		std::thread (&IoEngine::worker, this).detach();
+	}
+
+	readyCond_.notify_one();
+}
+
+void IoEngine::expire (void)
+/*
+ * Expects lock_ held. Readies what is due in the ticks since the last
+ * call, at most one turn of the wheel, and arms the timer for the next
+ * live entry. Entries a turn or more away stay in their slots.
+ */
+{
+	const uint64_t now = tick (Clock::now());
+
+	const uint64_t first = (now - lastTick_ >= WHEEL_SLOTS) ?
+		now - WHEEL_SLOTS + 1 : lastTick_ + 1;
+
+	for (uint64_t t = first; t <= now; ++t) {
+
+		std::vector<WheelEntry>& slot = wheel_[t % WHEEL_SLOTS];
+		size_t kept = 0;
+
+		for (size_t i = 0; i < slot.size(); ++i) {
+
+			std::map<int, Task>::iterator it = tasks_.find (slot[i].id);
+
+			if ((it == tasks_.end()) ||
+				(it->second.generation != slot[i].generation) ||
+				(it->second.state != TASK_WAITING))
+					continue;
+
+			if (it->second.due <= now)
+				ready (it->first, it->second);
+			else
+				slot[kept++] = slot[i];
+		}
+
+		slot.resize (kept);
+	}
+
+	lastTick_ = now;
+	armedTick_ = 0;
+
+	/*
+	 * A live entry in the slot of tick t is due at t or a whole number
+	 * of turns later, so the first slot due at its own tick is the
+	 * earliest.
+	 */
+	uint64_t next = 0;
+
+	for (uint64_t t = now + 1; (t <= now + WHEEL_SLOTS) && !(next && next <= t);
+		 ++t) {
+
+		const std::vector<WheelEntry>& slot = wheel_[t % WHEEL_SLOTS];
+
+		for (size_t i = 0; i < slot.size(); ++i) {
+
+			std::map<int, Task>::const_iterator it = tasks_.find (slot[i].id);
+
+			if ((it != tasks_.end()) &&
+				(it->second.generation == slot[i].generation) &&
+				(it->second.state == TASK_WAITING) &&
+				(!next || (it->second.due < next)))
+					next = it->second.due;
+		}
+	}
+
+	if (next)
+		arm (next);
+}
+
+void IoEngine::arm (uint64_t due)
+/*
+ * Expects lock_ held.
+ */
+{
+	armedTick_ = due;
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	const double delay = std::max (1e-9, due * 1e-3 -
+		std::chrono::duration<double> (Clock::now() - epoch_).count());
+
+	struct itimerspec spec;
+	memset (&spec, 0, sizeof (spec));
+
+	spec.it_value.tv_sec  = (time_t)(delay);
+	spec.it_value.tv_nsec = (long)((delay - spec.it_value.tv_sec) * 1e9);
+
+	timerfd_settime (timerfd_, 0, &spec, 0);
+#else
+	loopCond_.notify_one();
+#endif
+}
+
+void IoEngine::wake (void)
+/*
+ * Makes the loop reconsider how long to sleep.
+ */
+{
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	const uint64_t one = 1;
+	if (::write (wakefd_, &one, sizeof (one)) < 0) {}
+#else
+	loopCond_.notify_one();
+#endif
+}
+
+/************************************************************************/
+/************************************************************************/
+
+void IoEngine::loop (void)
+{
+	std::vector<int> due;
+
+	for (;;) {
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+		int timeout;
+
+		{
+			std::lock_guard<std::mutex> lock (lock_);
+			timeout = polledWatches_ ? 1 : -1;
+		}
+
+		struct epoll_event events[MAX_EVENTS];
+		const int n = epoll_wait (epoll_, events, MAX_EVENTS, timeout);
+
+		std::unique_lock<std::mutex> lock (lock_);
+		++wakeups_;
+
+		for (int i = 0; i < n; ++i) {
+
+			uint64_t count;
+
+			if (events[i].data.u64 == WAKE_KEY) {
+
+				if (::read (wakefd_, &count, sizeof (count)) < 0) {}
+			}
+			else if (events[i].data.u64 == TIMER_KEY) {
+
+				if (::read (timerfd_, &count, sizeof (count)) < 0) {}
+				expire();
+			}
+			else
+				due.push_back (int (events[i].data.u64));
+		}
+#else
+		std::unique_lock<std::mutex> lock (lock_);
+
+		if (polledWatches_)
+			loopCond_.wait_for (lock, std::chrono::milliseconds (1));
+
+		else if (armedTick_)
+			loopCond_.wait_until (lock,
+				epoch_ + std::chrono::milliseconds (armedTick_));
+		else
+			loopCond_.wait (lock);
+
+		++wakeups_;
+
+		if (armedTick_ && (tick (Clock::now()) >= armedTick_))
+			expire();
+#endif
+
+		if (polledWatches_)
+			for (std::map<int, Watch>::const_iterator it = watches_.begin();
+				 it != watches_.end(); ++it)
+					if (it->second.fd < 0)
+						due.push_back (it->first);
+
+		lock.unlock();
+
+		for (size_t i = 0; i < due.size(); ++i)
+			runWatch (due[i]);
+
+		due.clear();
+	}
+}
+
+void IoEngine::worker (void)
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	for (;;) {
+
+		if (ready_.empty()) {
+
+			++idleWorkers_;
+			readyCond_.wait (lock);
+			--idleWorkers_;
+			continue;
+		}
+
+		const int id = ready_.front();
+		ready_.pop_front();
+
+		run (id, lock);
+	}
+}
+
+void IoEngine::writer (void)
+{
+	std::unique_lock<std::mutex> lock (lock_);
+
+	for (;;) {
+
+		if (writes_.empty()) {
+
+			writeCond_.wait (lock);
+			continue;
+		}
+
+		const int id = writes_.front();
+		writes_.pop_front();
+
+		run (id, lock);
+	}
+}
+
+void IoEngine::run (int id, std::unique_lock<std::mutex>& lock)
+/*
+ * Runs a due task, with lock_ held in lock but for the handler.
+ */
+{
+	std::map<int, Task>::iterator it = tasks_.find (id);
+
+	if ((it == tasks_.end()) || (it->second.state != TASK_READY))
+		return;
+
+	/**** The entry stays put till erased, here or by cancel() ****/
+	Task& task = it->second;
+
+	task.state = TASK_RUNNING;
+	task.runner = std::this_thread::get_id();
+	task.rescheduled = -1;
+
+	lock.unlock();
+
+	/**** Nothing may unwind a detached thread; the task runs again ****/
+	double delay = TASK_RETRY_DELAY;
+
+	try {
+		delay = task.handler (task.user_data);
+	}
+	catch (const std::exception& e) {
+		SMU_LOG_ERROR (LOG_COMM, "Task {} failed: {}", id, e.what());
+	}
+	catch (...) {
+		SMU_LOG_ERROR (LOG_COMM, "Task {} failed", id);
+	}
+
+	lock.lock();
+
+	task.runner = std::thread::id();
+
+	if (task.cancelled || (delay < 0)) {
+
+		tasks_.erase (id);
+		doneCond_.notify_all();
+		return;
+	}
+
+	if (task.rescheduled >= 0)
+		delay = std::min (delay, task.rescheduled);
+
+	enqueue (id, task, delay);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
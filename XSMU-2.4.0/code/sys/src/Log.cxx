@@ -0,0 +1,328 @@
+#include "../sys/Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+static const char* const levelNames[] = {
+	"none", "error", "warning", "info", "debug",
+};
+
+static const char* const categoryNames[] = {
+	"ftdi", "qp4", "comm", "driver", "stream",
+};
+
+static uint64_t now (void)
+{
+	using namespace std::chrono;
+
+	static const steady_clock::time_point start = steady_clock::now();
+	return duration_cast<nanoseconds> (steady_clock::now() - start).count();
+}
+
+/************************************************************************/
+
+std::atomic<int> Log::levels_[LOG_CATEGORIES] = {
+	{LOG_LEVEL_WARNING}, {LOG_LEVEL_WARNING}, {LOG_LEVEL_WARNING},
+	{LOG_LEVEL_WARNING}, {LOG_LEVEL_WARNING},
+};
+
+/*
+ * Applies XSMU_LOG before anything gets a chance to log.
+ */
+static struct LogEnvironment
+{
+	LogEnvironment (void)
+	{
+		if (const char* spec = getenv ("XSMU_LOG"))
+			Log::configure (spec);
+	}
+} logEnvironment;
+
+/************************************************************************/
+
+Log& Log::instance (void)
+/*
+ * Never destroyed, so that threads still running at exit, and
+ * destructors of other statics, may log safely. flush() runs
+ * at exit instead.
+ */
+{
+	static Log* log = new Log;
+	return *log;
+}
+
+Log::Log (void) :
+	ring_ (new Record[RING_SIZE]),
+	enqueue_ (0),
+	dequeue_ (0),
+	dropped_ (0),
+	reportedDropped_ (0),
+	file_ (stderr)
+{
+	for (size_t i = 0; i < RING_SIZE; ++i)
+		ring_[i].sequence.store (i, std::memory_order_relaxed);
+
+	now();
+	atexit (&Log::flush);
+
+	thread_ = std::thread (&Log::flusher, this);
+	thread_.detach();
+}
+
+/************************************************************************/
+
+LogLevel Log::level (LogCategory category)
+{
+	return static_cast<LogLevel> (levels_[category].load());
+}
+
+void Log::setLevel (LogCategory category, LogLevel level)
+{
+	levels_[category] = level;
+}
+
+void Log::setLevel (LogLevel level)
+{
+	for (int i = 0; i < LOG_CATEGORIES; ++i)
+		levels_[i] = level;
+}
+
+void Log::configure (const char* spec)
+{
+	std::string rest (spec);
+
+	while (!rest.empty()) {
+
+		const size_t comma = rest.find (',');
+		const std::string item = rest.substr (0, comma);
+		rest = (comma == std::string::npos) ? "" : rest.substr (comma + 1);
+
+		const size_t equals = item.find ('=');
+		const std::string name = (equals == std::string::npos) ?
+			item : item.substr (equals + 1);
+
+		for (int level = LOG_LEVEL_NONE; level <= LOG_LEVEL_DEBUG; ++level) {
+
+			if (strcasecmp (name.c_str(), levelNames[level]))
+				continue;
+
+			if (equals == std::string::npos)
+				setLevel (static_cast<LogLevel> (level));
+
+			else for (int i = 0; i < LOG_CATEGORIES; ++i)
+				if (!strcasecmp (item.substr (0, equals).c_str(),
+								 categoryNames[i]))
+					setLevel (static_cast<LogCategory> (i),
+							  static_cast<LogLevel> (level));
+		}
+	}
+}
+
+bool Log::setFile (const char* path)
+{
+	Log& log = instance();
+	std::FILE* file = stderr;
+
+	if (path && *path && !(file = std::fopen (path, "a")))
+		return false;
+
+	std::lock_guard<std::mutex> lock (log.drainLock_);
+
+	log.drain();
+
+	if (log.file_ != stderr)
+		std::fclose (log.file_);
+
+	log.file_ = file;
+	return true;
+}
+
+void Log::flush (void)
+{
+	Log& log = instance();
+
+	std::lock_guard<std::mutex> lock (log.drainLock_);
+	log.drain();
+}
+
+uint64_t Log::dropped (void)
+{
+	return instance().dropped_;
+}
+
+/************************************************************************/
+
+void Log::post (LogLevel level, LogCategory category,
+				const char* function, int line,
+				const char* format, const LogArg* args, size_t nargs)
+/*
+ * Claims the next slot of the ring, as in a bounded MPMC queue: a slot
+ * is free for position pos when its sequence equals pos, and ready for
+ * the flusher once set to pos + 1.
+ */
+{
+	size_t pos = enqueue_.load (std::memory_order_relaxed);
+	Record* record;
+
+	for (;;) {
+
+		record = &ring_[pos & (RING_SIZE - 1)];
+
+		const size_t sequence =
+			record->sequence.load (std::memory_order_acquire);
+
+		const ptrdiff_t diff = ptrdiff_t (sequence) - ptrdiff_t (pos);
+
+		if (diff == 0) {
+
+			if (enqueue_.compare_exchange_weak (pos, pos + 1,
+					std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) {
+
+			++dropped_;
+			return;
+		}
+		else
+			pos = enqueue_.load (std::memory_order_relaxed);
+	}
+
+	record->time = now();
+	record->level = level;
+	record->category = category;
+	record->function = function;
+	record->line = line;
+	record->format = format;
+	record->nargs = (nargs < MAX_ARGS) ? nargs : MAX_ARGS;
+
+	/**** Strings may not outlive the caller, so are copied ****/
+	size_t used = 0;
+
+	for (size_t i = 0; i < record->nargs; ++i) {
+
+		record->args[i] = args[i];
+
+		if (args[i].type() != LogArg::TEXT)
+			continue;
+
+		const size_t n = std::min (strlen (args[i].s()),
+								   size_t (TEXT_SIZE - 1 - used));
+
+		memcpy (record->text + used, args[i].s(), n);
+		record->text[used + n] = '\0';
+
+		record->args[i].s_ = record->text + used;
+		used = std::min (used + n + 1, size_t (TEXT_SIZE - 1));
+	}
+
+	record->sequence.store (pos + 1, std::memory_order_release);
+
+	/**** Trouble is worth a prompt write ****/
+	if (level <= LOG_LEVEL_WARNING)
+		wakeCond_.notify_one();
+}
+
+/************************************************************************/
+
+void Log::flusher (void)
+{
+	for (;;) {
+
+		{
+			std::unique_lock<std::mutex> lock (wakeLock_);
+			wakeCond_.wait_for (lock, std::chrono::milliseconds (50));
+		}
+
+		std::lock_guard<std::mutex> lock (drainLock_);
+		drain();
+	}
+}
+
+void Log::drain (void)
+/*
+ * Expects drainLock_ held.
+ */
+{
+	bool wrote = false;
+
+	for (;;) {
+
+		Record& record = ring_[dequeue_ & (RING_SIZE - 1)];
+
+		if (record.sequence.load (std::memory_order_acquire) != dequeue_ + 1)
+			break;
+
+		print (record);
+		record.sequence.store (dequeue_ + RING_SIZE,
+							   std::memory_order_release);
+		++dequeue_;
+		wrote = true;
+	}
+
+	const uint64_t dropped = dropped_;
+
+	if (dropped != reportedDropped_) {
+
+		std::fprintf (file_, "%12.6f warning log    %llu records dropped\n",
+			now() * 1e-9, (unsigned long long) (dropped - reportedDropped_));
+
+		reportedDropped_ = dropped;
+		wrote = true;
+	}
+
+	if (wrote)
+		std::fflush (file_);
+}
+
+void Log::print (const Record& record)
+{
+	char message[512];
+	size_t n = 0;
+	size_t arg = 0;
+
+	for (const char* p = record.format; *p && (n < sizeof (message) - 1); ++p) {
+
+		if ((p[0] != '{') || (p[1] != '}') || (arg >= record.nargs)) {
+
+			message[n++] = *p;
+			continue;
+		}
+
+		const LogArg& a = record.args[arg++];
+		const size_t room = sizeof (message) - n;
+		int k = 0;
+
+		switch (a.type()) {
+
+		case LogArg::INT:  k = snprintf (message + n, room, "%lld", a.i()); break;
+		case LogArg::UINT: k = snprintf (message + n, room, "%llu", a.u()); break;
+		case LogArg::REAL: k = snprintf (message + n, room, "%g",   a.d()); break;
+		case LogArg::TEXT: k = snprintf (message + n, room, "%s",   a.s()); break;
+		default: break;
+		}
+
+		n += std::min (size_t (k > 0 ? k : 0), room - 1);
+		++p;
+	}
+
+	message[n] = '\0';
+
+	std::fprintf (file_, "%12.6f %-7s %-6s %s:%d: %s\n",
+		record.time * 1e-9, levelNames[record.level],
+		categoryNames[record.category],
+		record.function, record.line, message);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -0,0 +1,122 @@
+#include "../sys/Loopback.h"
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+std::mutex Loopback::peerLock_;
+
+Loopback::Loopback (void) :
+	open_ (false),
+	peer_ (this),
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	rxEvent_ (eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC))
+#else
+	rxEvent_ (-1)
+#endif
+{}
+
+Loopback::~Loopback (void)
+{
+	{
+		std::lock_guard<std::mutex> lock (peerLock_);
+		peer_->peer_ = peer_;
+	}
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	if (rxEvent_ >= 0)
+		::close (rxEvent_);
+#endif
+}
+
+void Loopback::connect (Loopback* a, Loopback* b)
+{
+	std::lock_guard<std::mutex> lock (peerLock_);
+
+	a->peer_ = b;
+	b->peer_ = a;
+}
+
+/************************************************************************/
+
+void Loopback::open (const char* name, int baudrate)
+{
+	std::lock_guard<std::mutex> lock (rxLock_);
+
+	rxQueue_.clear();
+	open_ = true;
+}
+
+uint32_t Loopback::read (void* data, uint32_t size)
+{
+	if (!good()) return 0;
+
+	std::lock_guard<std::mutex> lock (rxLock_);
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	uint64_t events;
+	if (::read (rxEvent_, &events, sizeof (events)) < 0) {}
+#endif
+
+	uint8_t* dst = reinterpret_cast<uint8_t*> (data);
+	uint32_t rxsize = 0;
+
+	while ((rxsize < size) && !rxQueue_.empty()) {
+
+		dst[rxsize++] = rxQueue_.front();
+		rxQueue_.pop_front();
+	}
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	const uint64_t one = 1;
+	if (!rxQueue_.empty() && (::write (rxEvent_, &one, sizeof (one)) < 0)) {}
+#endif
+
+	return rxsize;
+}
+
+uint32_t Loopback::write (const void* data, uint32_t size)
+{
+	if (!good()) return 0;
+
+	std::lock_guard<std::mutex> lock (peerLock_);
+	peer_->deliver (reinterpret_cast<const uint8_t*> (data), size);
+
+	return size;
+}
+
+void Loopback::close (void)
+{
+	std::lock_guard<std::mutex> lock (rxLock_);
+
+	rxQueue_.clear();
+	open_ = false;
+}
+
+/************************************************************************/
+
+void Loopback::deliver (const uint8_t* data, uint32_t size)
+{
+	std::lock_guard<std::mutex> lock (rxLock_);
+
+	/**** A closed end drops what it is sent, like a real port ****/
+	if (!open_) return;
+
+	rxQueue_.insert (rxQueue_.end(), data, data + size);
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+	const uint64_t one = 1;
+	if (::write (rxEvent_, &one, sizeof (one)) < 0) {}
+#endif
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -1,6 +1,12 @@
 #include "../sys/QP4.h"
+#include "../sys/Log.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -25,15 +31,7 @@ QP4_Packet::QP4_Packet (uint16_t size) :
 
 void QP4_Packet::seal (void)
 {
-	uint16_t checksum = 0;
-	const uint8_t* begin = body_;
-	const uint8_t* end = begin + datasize();
-
-	for (const uint8_t* it = begin; it != end; ++it)
-		checksum += *it;
-
-	checksum = ~checksum + 1;
-	checksum_ = hton (checksum);
+	checksum_ = hton (QP4_checksum (body_, datasize()));
 }
 
 /***********************************************************************/
@@ -56,9 +54,11 @@ QP4_Receiver::QP4_Receiver (void) :
 	expectedChecksum_ ((~0) + 1),
 	receivedChecksum_ (0),
 	dataWriter_       (data_),
+	view_             (0),
 	ready_            (false),
 	window_           (0),
-	byteCounter_      (0)
+	byteCounter_      (0),
+	errors_           (0)
 {}
 
 void QP4_Receiver::clear (void)
@@ -68,6 +68,7 @@ void QP4_Receiver::clear (void)
 	expectedChecksum_ = ((~0) + 1);
 	receivedChecksum_ = 0;
 	dataWriter_       = data_;
+	view_             = 0;
 	ready_            = false;
 	window_           = 0;
 	byteCounter_      = 0;
@@ -79,7 +80,7 @@ void QP4_Receiver::push_back (uint8_t x)
 {
 	typedef void (QP4_Receiver::*Callback)(uint8_t x);
 
-	Callback callbacks[] =
+	static const Callback callbacks[] =
 	{
 		&QP4_Receiver::idle_cb,
 		&QP4_Receiver::size_cb,
@@ -98,6 +99,177 @@ void QP4_Receiver::push_back (uint8_t x)
 	(this->*callbacks[state_])(x);
 }
 
+/***********************************************************/
+
+size_t QP4_Receiver::push (const uint8_t* data, size_t size)
+{
+	size_t consumed = 0;
+
+	while ((consumed < size) && !ready_) {
+
+		const uint8_t* src = data + consumed;
+		const size_t remaining = size - consumed;
+
+		switch (state_) {
+
+		case QP4_RX_STATE_IDLE: {
+
+			/**** Skips everything up to a start of frame ****/
+			const size_t n = findStartFrameMarker (src, remaining);
+
+			if (n == remaining) {
+
+				shiftWindow (src, remaining);
+				consumed = size;
+			}
+			else {
+
+				initiateReceptionSequence();
+				consumed += n + 1;
+			}
+
+			break;
+		}
+
+		case QP4_RX_STATE_DATA:
+			consumed += pushData (src, remaining);
+			break;
+
+		default:
+			/**** Size and checksum are just four bytes ****/
+			push_back (*src);
+			++consumed;
+			break;
+		}
+	}
+
+	return consumed;
+}
+
+size_t QP4_Receiver::pushData (const uint8_t* data, size_t size)
+/*
+ * Consumes payload bytes, up to and including the end of the
+ * payload or a start of frame marker, whichever comes first.
+ */
+{
+	const size_t n = (size < byteCounter_) ? size : byteCounter_;
+	const size_t marker = findStartFrameMarker (data, n);
+
+	if (marker < n) {
+
+		initiateReceptionSequence();
+		return marker + 1;
+	}
+
+	if ((dataWriter_ == data_) && (n == size_))
+		view_ = data;
+
+	else {
+
+		memcpy (dataWriter_, data, n);
+		dataWriter_ += n;
+	}
+
+	expectedChecksum_ += sum (data, n);
+	shiftWindow (data, n);
+	byteCounter_ -= n;
+
+	if (byteCounter_ == 0) {
+
+		expectedChecksum_ = ~expectedChecksum_ + 1;
+
+		if (expectedChecksum_ == receivedChecksum_)
+			ready_ = true;
+
+		else {
+
+			++errors_;
+			SMU_LOG_DEBUG (LOG_QP4, "Checksum mismatch, {} bytes", size_);
+		}
+
+		setState (QP4_RX_STATE_IDLE);
+	}
+
+	return n;
+}
+
+size_t QP4_Receiver::findStartFrameMarker (const uint8_t* data,
+										   size_t size) const
+/*
+ * Index of the byte completing the first start of frame marker,
+ * counting the bytes already in the window, or size if none does.
+ */
+{
+	static const uint8_t marker[] = {'Q', 'P', '4', '1'};
+
+	/**** Markers straddling the previous bytes ****/
+	uint32_t window = window_;
+
+	for (size_t i = 0; (i < size) && (i < sizeof (marker) - 1); ++i) {
+
+		window = (window << 8) | data[i];
+
+		if (window == QP4_SOF_MARKER)
+			return i;
+	}
+
+	/**** Markers wholly inside data ****/
+	const uint8_t* it = data;
+	const uint8_t* const end = data + size;
+
+	while (end - it >= (ptrdiff_t) sizeof (marker)) {
+
+		it = reinterpret_cast<const uint8_t*> (
+			memchr (it, marker[0], end - it - (sizeof (marker) - 1)));
+
+		if (!it) break;
+
+		if (memcmp (it, marker, sizeof (marker)) == 0)
+			return (it - data) + sizeof (marker) - 1;
+
+		++it;
+	}
+
+	return size;
+}
+
+void QP4_Receiver::shiftWindow (const uint8_t* data, size_t size)
+{
+	if (size > sizeof (window_))
+		data += size - sizeof (window_), size = sizeof (window_);
+
+	while (size--)
+		window_ = (window_ << 8) | *data++;
+}
+
+uint16_t QP4_Receiver::sum (const uint8_t* data, size_t size)
+/*
+ * Byte sum, modulo 2^16.
+ */
+{
+	uint32_t total = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+
+	for (; size >= 16; data += 16, size -= 16)
+		acc = _mm_add_epi64 (acc, _mm_sad_epu8 (
+			_mm_loadu_si128 (reinterpret_cast<const __m128i*> (data)),
+			zero));
+
+	total = _mm_cvtsi128_si32 (acc) +
+		_mm_cvtsi128_si32 (_mm_srli_si128 (acc, 8));
+#endif
+
+	while (size--)
+		total += *data++;
+
+	return total;
+}
+
+/***********************************************************/
+
 void QP4_Receiver::setState (QP4_RxState state)
 {
 	typedef void (QP4_Receiver::*cb_t)(void);
@@ -156,8 +328,13 @@ void QP4_Receiver::size_cb (uint8_t x)
 
 	if (--byteCounter_ == 0) {
 
-		if (size_ > maxAllowedDataSize_)
+		if (size_ > maxAllowedDataSize_) {
+
+			++errors_;
+			SMU_LOG_DEBUG (LOG_QP4, "Frame of {} bytes exceeds {}",
+				size_, unsigned (maxAllowedDataSize_));
 			abortReceptionSequence();
+		}
 		else
 			setState (QP4_RX_STATE_CHECKSUM);
 	}
@@ -177,6 +354,12 @@ void QP4_Receiver::checksum_cb (uint8_t x)
 			if (receivedChecksum_ == expectedChecksum_)
 				ready_ = true;
 
+			else {
+
+				++errors_;
+				SMU_LOG_DEBUG (LOG_QP4, "Checksum mismatch, empty frame");
+			}
+
 			setState (QP4_RX_STATE_IDLE);
 		}
 	}
@@ -194,6 +377,12 @@ void QP4_Receiver::data_cb (uint8_t x)
 		if (expectedChecksum_ == receivedChecksum_)
 			ready_ = true;
 
+		else {
+
+			++errors_;
+			SMU_LOG_DEBUG (LOG_QP4, "Checksum mismatch, {} bytes", size_);
+		}
+
 		setState (QP4_RX_STATE_IDLE);
 	}
 }
@@ -0,0 +1,178 @@
+#include "../sys/Serial.h"
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+static speed_t toSpeed (uint32_t bd)
+{
+	static const struct {
+		uint32_t baudrate;
+		speed_t speed;
+	} speeds[] = {
+
+		{    300,    B300}, {   1200,   B1200}, {   2400,   B2400},
+		{   4800,   B4800}, {   9600,   B9600}, {  19200,  B19200},
+		{  38400,  B38400}, {  57600,  B57600}, { 115200, B115200},
+		{ 230400, B230400}, { 460800, B460800}, { 921600, B921600},
+		{1000000, B1000000}, {1500000, B1500000},
+		{2000000, B2000000}, {3000000, B3000000}
+	};
+
+	for (unsigned i = 0; i < sizeof (speeds) / sizeof (speeds[0]); ++i)
+		if (speeds[i].baudrate == bd)
+			return speeds[i].speed;
+
+	return B0;
+}
+
+/************************************************************************/
+
+Serial::Serial (void) :
+	fd_ (-1)
+{}
+
+Serial::~Serial (void)
+{
+	close();
+}
+
+void Serial::open (const char* device, int baudrate)
+{
+	if (good()) return;
+
+	fd_ = ::open (device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (!good()) return;
+
+	/**** Raw 8N1, no flow control, reads return immediately ****/
+	struct termios tio;
+
+	if (tcgetattr (fd_, &tio) != 0) {
+
+		close();
+		return;
+	}
+
+	cfmakeraw (&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN]  = 0;
+	tio.c_cc[VTIME] = 0;
+
+	if (tcsetattr (fd_, TCSANOW, &tio) != 0) {
+
+		close();
+		return;
+	}
+
+	if (!setBaudRate (baudrate)) {
+
+		close();
+		return;
+	}
+
+	/**** Purge everything in the Rx and Tx buffers ****/
+	tcflush (fd_, TCIOFLUSH);
+}
+
+uint32_t Serial::read (void* data, uint32_t size)
+{
+	if (!good()) return 0;
+
+	const ssize_t rxsize = ::read (fd_, data, size);
+
+	if (rxsize < 0) {
+
+		if ((errno != EAGAIN) && (errno != EINTR))
+			close();
+
+		return 0;
+	}
+
+	return rxsize;
+}
+
+uint32_t Serial::write (const void* data, uint32_t size)
+/*
+ * Waits for room in the kernel's transmit buffer
+ * rather than returning a partial write.
+ */
+{
+	const uint8_t* src = reinterpret_cast<const uint8_t*> (data);
+	uint32_t written = 0;
+
+	while (good() && (written < size)) {
+
+		const ssize_t txsize = ::write (fd_, src + written, size - written);
+
+		if (txsize >= 0) {
+
+			written += txsize;
+			continue;
+		}
+
+		if (errno == EAGAIN) {
+
+			struct pollfd pfd = {fd_, POLLOUT, 0};
+			poll (&pfd, 1, 100);
+		}
+
+		else if (errno != EINTR)
+			close();
+	}
+
+	return written;
+}
+
+void Serial::close (void)
+{
+	if (good()) {
+
+		::close (fd_);
+		fd_ = -1;
+	}
+}
+
+bool Serial::good (void) const
+{
+	return (fd_ >= 0);
+}
+
+bool Serial::setBaudRate (uint32_t bd)
+/*
+ * Only the rates that termios names are supported. These include
+ * every rate that baud rate negotiation tries.
+ */
+{
+	if (!good()) return false;
+
+	const speed_t speed = toSpeed (bd);
+	if (speed == B0) return false;
+
+	struct termios tio;
+
+	if (tcgetattr (fd_, &tio) != 0)
+		return false;
+
+	cfsetispeed (&tio, speed);
+	cfsetospeed (&tio, speed);
+
+	/**** Lets queued output go out at the old rate ****/
+	return (tcsetattr (fd_, TCSADRAIN, &tio) == 0);
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
+
+#endif // linux
@@ -0,0 +1,359 @@
+#include "../sys/StreamBuffer.h"
+#include "../../stl/inet"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace smu {
+
+/************************************************************************/
+/************************************************************************/
+
+StreamBuffer::StreamBuffer (size_t capacity, StreamOverflow overflow) :
+	ring_ (new RingBuffer<int32_t> (capacity)),
+	overflow_ (overflow),
+	dropped_ (0),
+	spilled_ (0),
+	highWater_ (0),
+	spillFile_ (0),
+	spillRead_ (0),
+	spillWrite_ (0),
+	spilling_ (false),
+	spillPending_ (0),
+	offered_ (0),
+	accepted_ (0),
+	gapsPending_ (false),
+	shift_ (0),
+	unspilled_ (0)
+{}
+
+StreamBuffer::~StreamBuffer (void)
+{
+	closeSpill();
+	delete ring_;
+}
+
+void StreamBuffer::configure (size_t capacity, StreamOverflow overflow)
+{
+	closeSpill();
+
+	delete ring_;
+	ring_ = new RingBuffer<int32_t> (capacity);
+	overflow_ = overflow;
+
+	dropped_ = 0;
+	spilled_ = 0;
+	highWater_ = 0;
+
+	reset();
+}
+
+void StreamBuffer::clear (void)
+{
+	ring_->clear();
+	closeSpill();
+	reset();
+}
+
+void StreamBuffer::reset (void)
+{
+	std::lock_guard<std::mutex> lock (gapLock_);
+
+	offered_ = 0;
+	accepted_ = 0;
+	gaps_.clear();
+	gapsPending_ = false;
+	shift_ = 0;
+	unspilled_ = 0;
+}
+
+/************************************************************************/
+
+void StreamBuffer::push (const int32_t* samples, size_t n)
+{
+	store (reinterpret_cast<const uint8_t*> (samples), n,
+		[](int32_t* dst, const uint8_t* src, size_t n) {
+			memcpy (dst, src, n * sizeof (int32_t));
+		});
+}
+
+void StreamBuffer::pushNetworkOrder (const void* samples, size_t n)
+/*
+ * Byte swaps the samples straight into the ring.
+ */
+{
+	store (reinterpret_cast<const uint8_t*> (samples), n,
+		[](int32_t* dst, const uint8_t* src, size_t n) {
+			smu::ntoh (dst, src, n);
+		});
+}
+
+template <typename Copy>
+void StreamBuffer::store (const uint8_t* src, size_t n, Copy copy)
+{
+	offered_ += n;
+
+	if ((overflow_ == STREAM_OVERFLOW_DROP_OLDEST) &&
+		(n > ring_->capacity())) {
+
+		const size_t excess = n - ring_->capacity();
+
+		skip (excess);
+		src += excess * sizeof (int32_t);
+		n -= excess;
+	}
+
+	/**** Nothing may overtake what is already in the file ****/
+	if (spilling_.load (std::memory_order_acquire))
+		return spill (src, n, copy);
+
+	while (n) {
+
+		size_t k = n;
+		int32_t* dst = ring_->prepare (&k);
+
+		if (k == 0) {
+
+			if (overflow_ == STREAM_OVERFLOW_DROP_OLDEST) {
+
+				dropped_ += ring_->discard (n);
+				continue;
+			}
+
+			if (overflow_ == STREAM_OVERFLOW_SPILL)
+				return spill (src, n, copy);
+
+			skip (n);
+			break;
+		}
+
+		copy (dst, src, k);
+		ring_->commit (k);
+		accepted_ += k;
+
+		src += k * sizeof (int32_t);
+		n -= k;
+	}
+
+	const size_t level = ring_->size();
+	if (level > highWater_)
+		highWater_ = level;
+}
+
+void StreamBuffer::skip (size_t n)
+/*
+ * Producer side. Drops n samples that were never kept, leaving a gap
+ * in the numbering. Should the consumer fall far behind, the oldest
+ * gaps are merged, so that their number stays bounded.
+ */
+{
+	dropped_ += n;
+
+	std::lock_guard<std::mutex> lock (gapLock_);
+
+	if (!gaps_.empty() && (gaps_.back().at == accepted_))
+		gaps_.back().skipped += n;
+
+	else {
+
+		const Gap gap = {accepted_, n};
+		gaps_.push_back (gap);
+	}
+
+	if (gaps_.size() > MAX_GAPS) {
+
+		gaps_[1].skipped += gaps_[0].skipped;
+		gaps_.pop_front();
+	}
+
+	gapsPending_.store (true, std::memory_order_release);
+}
+
+/************************************************************************/
+
+size_t StreamBuffer::room (void) const
+{
+	return spilling_ ? 0 : ring_->capacity() - ring_->size();
+}
+
+bool StreamBuffer::waitForRoom (size_t n, double timeout)
+{
+	n = std::min (n, ring_->capacity());
+
+	std::unique_lock<std::mutex> lock (roomLock_);
+
+	return roomCond_.wait_for (lock,
+		std::chrono::duration<double> (timeout),
+		[this, n] { return room() >= n; });
+}
+
+/************************************************************************/
+
+size_t StreamBuffer::drain (int32_t* dst, size_t n, uint64_t* index)
+/*
+ * Samples in the ring that were pushed after some went to the file
+ * follow all of those, which the consumer has unspilled by then. The
+ * ring's own position, plus what has been unspilled, then counts the
+ * samples accepted before any drained.
+ */
+{
+	size_t got = 0;
+
+	for (;;) {
+
+		size_t at;
+		const size_t popped = ring_->pop (dst + got, n - got, &at);
+
+		if (index && popped)
+			number (index + got, popped, at + unspilled_);
+
+		got += popped;
+
+		if ((got == n) || !spilling_.load (std::memory_order_acquire))
+			break;
+
+		std::lock_guard<std::mutex> lock (spillLock_);
+
+		/**** The ring holds older samples than the file ****/
+		if (!ring_->empty())
+			continue;
+
+		const uint64_t first = ring_->position() + unspilled_;
+		const size_t unspilled = unspill (dst + got, n - got);
+
+		if (index && unspilled)
+			number (index + got, unspilled, first);
+
+		got += unspilled;
+		break;
+	}
+
+	if (got) {
+
+		{ std::lock_guard<std::mutex> lock (roomLock_); }
+		roomCond_.notify_all();
+	}
+
+	return got;
+}
+
+/************************************************************************/
+
+template <typename Copy>
+void StreamBuffer::spill (const uint8_t* src, size_t n, Copy copy)
+{
+	std::lock_guard<std::mutex> lock (spillLock_);
+
+	if (!spillFile_)
+		spillFile_ = std::tmpfile();
+
+	if (!spillFile_ || std::fseek (spillFile_, spillWrite_, SEEK_SET)) {
+
+		skip (n);
+		return;
+	}
+
+	int32_t chunk[SPILL_CHUNK];
+
+	while (n) {
+
+		const size_t k = std::min (n, size_t (SPILL_CHUNK));
+		copy (chunk, src, k);
+
+		if (std::fwrite (chunk, sizeof (int32_t), k, spillFile_) != k) {
+
+			skip (n);
+			break;
+		}
+
+		spillWrite_ += k * sizeof (int32_t);
+		spilled_ += k;
+		accepted_ += k;
+		spillPending_ += k;
+		spilling_ = true;
+
+		src += k * sizeof (int32_t);
+		n -= k;
+	}
+
+	const size_t level = ring_->size() + spillPending_;
+	if (level > highWater_)
+		highWater_ = level;
+}
+
+size_t StreamBuffer::unspill (int32_t* dst, size_t n)
+/*
+ * Expects spillLock_ held. The file is rewound once drained,
+ * so it grows no larger than the longest backlog.
+ */
+{
+	n = std::min (n, size_t (spillPending_));
+
+	if (std::fseek (spillFile_, spillRead_, SEEK_SET))
+		return 0;
+
+	n = std::fread (dst, sizeof (int32_t), n, spillFile_);
+
+	spillRead_ += n * sizeof (int32_t);
+	spillPending_ -= n;
+	unspilled_ += n;
+
+	if (spillPending_ == 0) {
+
+		spillRead_ = spillWrite_ = 0;
+		spilling_ = false;
+	}
+
+	return n;
+}
+
+void StreamBuffer::number (uint64_t* index, size_t n, uint64_t first)
+/*
+ * Numbers n samples drained, the first of which
+ * was accepted after first others.
+ */
+{
+	if (!gapsPending_.load (std::memory_order_acquire)) {
+
+		for (size_t i = 0; i < n; ++i)
+			index[i] = first + i + shift_;
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock (gapLock_);
+
+	for (size_t i = 0; i < n; ++i) {
+
+		while (!gaps_.empty() && (gaps_.front().at <= first + i)) {
+
+			shift_ += gaps_.front().skipped;
+			gaps_.pop_front();
+		}
+
+		index[i] = first + i + shift_;
+	}
+
+	gapsPending_ = !gaps_.empty();
+}
+
+/************************************************************************/
+
+void StreamBuffer::closeSpill (void)
+{
+	std::lock_guard<std::mutex> lock (spillLock_);
+
+	if (spillFile_)
+		std::fclose (spillFile_);
+
+	spillFile_ = 0;
+	spillRead_ = spillWrite_ = 0;
+	spillPending_ = 0;
+	spilling_ = false;
+}
+
+/************************************************************************/
+/************************************************************************/
+
+} // namespace smu
@@ -7,17 +7,15 @@ namespace smu {
 	
 double Timer::get (void)
 {
-	FILETIME fileTime;
-	GetSystemTimeAsFileTime (&fileTime);
+	static LARGE_INTEGER frequency = {};
 
-	ULARGE_INTEGER iTime;
-	iTime.LowPart = fileTime.dwLowDateTime;
-	iTime.HighPart = fileTime.dwHighDateTime;
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency (&frequency);
 
-	return iTime.QuadPart * 100e-9 - 11644473600;
-	// Windows keeps time since 1 Jan, 1601.
-	// Linux keeps it from 1 Jan, 1970.
-	// 11644473600 seconds are there between these two dates.
+	LARGE_INTEGER count;
+	QueryPerformanceCounter (&count);
+
+	return double (count.QuadPart) / frequency.QuadPart;
 }
 
 void Timer::sleep (double duration)
@@ -29,14 +27,13 @@ void Timer::sleep (double duration)
 
 #if defined(linux) || defined(__linux) || defined(__linux__)
 #include <time.h>
-#include <sys/time.h>
 
 namespace smu {
 double Timer::get (void)
 {
-	struct timeval tval;
-	gettimeofday (&tval, 0);
-	return tval.tv_sec + 1e-6 * tval.tv_usec;
+	struct timespec tspec;
+	clock_gettime (CLOCK_MONOTONIC, &tspec);
+	return tspec.tv_sec + 1e-9 * tspec.tv_nsec;
 }
 
 void Timer::sleep (double duration)
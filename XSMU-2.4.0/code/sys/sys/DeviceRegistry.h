@@ -0,0 +1,114 @@
+#ifndef __SMU_DEVICE_REGISTRY__
+#define __SMU_DEVICE_REGISTRY__
+
+#include "FTDI.h"
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+
+#include <libusb.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace smu {
+
+enum DeviceEventType
+{
+	DEVICE_EVENT_ARRIVED = 1,
+	DEVICE_EVENT_LEFT,
+};
+
+class DeviceEvent
+{
+	public:
+	DeviceEvent (DeviceEventType type, const FTDI_DeviceInfo& device) :
+		type_ (type), device_ (device)
+	{}
+
+	public:
+	DeviceEventType type (void) const { return type_; }
+	const FTDI_DeviceInfo& device (void) const { return device_; }
+
+	private:
+	DeviceEventType type_;
+	FTDI_DeviceInfo device_;
+};
+
+typedef void (*DeviceRegistryCallback)(void* user_data,
+									   const DeviceEvent& event);
+
+/*
+ * Process-wide list of attached FTDI interfaces, kept current by libusb
+ * hotplug notifications, so that a scan is a lookup rather than a walk
+ * of the bus. Where libusb lacks hotplug support, devices() falls back
+ * to FTDI::scan().
+ *
+ * Subscribers are called from the registry's thread, once per interface
+ * that arrives or leaves.
+ */
+class DeviceRegistry
+{
+	public:
+	static DeviceRegistry& instance (void);
+
+	public:
+	std::vector<FTDI_DeviceInfo> devices (void);
+
+	public:
+	int subscribe (DeviceRegistryCallback cb, void* user_data);
+	void unsubscribe (int id);
+
+	private:
+	DeviceRegistry (void);
+	~DeviceRegistry (void);
+
+	private:
+	void eventThread (void);
+	void processPending (void);
+	void arrived (libusb_device* dev);
+	void left (libusb_device* dev);
+	void notify (DeviceEventType type,
+				 const std::vector<FTDI_DeviceInfo>& devices);
+
+	static int LIBUSB_CALL hotplug_cb (libusb_context* ctx,
+		libusb_device* dev, libusb_hotplug_event event, void* user_data);
+
+	private:
+	struct Subscriber
+	{
+		DeviceRegistryCallback cb;
+		void* user_data;
+	};
+
+	private:
+	libusb_context* ctx_;
+	libusb_hotplug_callback_handle hotplugHandle_;
+	bool hotplug_;
+
+	std::thread thread_;
+	std::atomic<bool> running_;
+
+	/**** Hotplug events, queued until devices may be opened ****/
+	std::mutex pendingLock_;
+	std::deque<std::pair<libusb_device*, libusb_hotplug_event> > pending_;
+
+	std::mutex devicesLock_;
+	std::map<libusb_device*, std::vector<FTDI_DeviceInfo> > devices_;
+
+	std::mutex subscribersLock_;
+	std::map<int, Subscriber> subscribers_;
+	int nextSubscriberId_;
+
+	private:
+	DeviceRegistry (const DeviceRegistry&);
+	DeviceRegistry& operator= (const DeviceRegistry&);
+};
+} // end of namespace smu
+
+#endif // linux
+
+#endif
@@ -5,8 +5,16 @@
 #include <string>
 #include <stdint.h>
 
+#include "Transport.h"
+
 namespace smu {
 
+enum FTDI_BaudRateLimits
+{
+	FTDI_MIN_BAUDRATE = 300,
+	FTDI_MAX_BAUDRATE = 3000000,      // 3 MHz clock, divisor of 1
+};
+
 class FTDI_DeviceInfo
 {
 	public:
@@ -20,21 +28,79 @@ class FTDI_DeviceInfo
 	std::string serialNo_;
 	std::string description_;
 };
+
+/*
+ * USB transport parameters of an FTDI interface.
+ * Defaults are the chip's power-on settings.
+ */
+class FTDI_Parameters
+{
+	public:
+	FTDI_Parameters (void);
+
+	public:
+	uint8_t  latencyTimer     (void) const { return latencyTimer_;     }
+	uint32_t readChunkSize    (void) const { return readChunkSize_;    }
+	uint32_t writeChunkSize   (void) const { return writeChunkSize_;   }
+	uint8_t  eventChar        (void) const { return eventChar_;        }
+	bool     eventCharEnabled (void) const { return eventCharEnabled_; }
+
+	public:
+	void latencyTimer   (uint8_t ms)    { latencyTimer_   = ms;   }
+	void readChunkSize  (uint32_t size) { readChunkSize_  = size; }
+	void writeChunkSize (uint32_t size) { writeChunkSize_ = size; }
+
+	void eventChar (uint8_t c, bool enabled) {
+		eventChar_ = c;
+		eventCharEnabled_ = enabled;
+	}
+
+	private:
+	uint8_t  latencyTimer_;
+	uint32_t readChunkSize_;
+	uint32_t writeChunkSize_;
+	uint8_t  eventChar_;
+	bool     eventCharEnabled_;
+};
 } // end of namespace smu
 
 #if defined(linux) || defined(__linux) || defined(__linux__)
 
 #include <ftdi.h>
+#include <libusb.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "RingBuffer.h"
 
 namespace smu {
 
-class FTDI
+enum FTDI_UsbId
+{
+	FTDI_VID        = 0x0403,
+	FTDI_FT232_PID  = 0x6001,
+	FTDI_FT2232_PID = 0x6010,
+	FTDI_FT4232_PID = 0x6011,
+};
+
+enum FTDI_RxEngineConfig
+{
+	FTDI_RX_TRANSFERS = 8,            // Bulk-IN transfers kept in flight
+	FTDI_RX_RING_SIZE = 256 * 1024,   // Bytes buffered for the parser
+};
+
+class FTDI : public Transport
 {
 public:
 	FTDI (void);
+	~FTDI (void);
 
 public:
 	static std::vector<FTDI_DeviceInfo> scan (void);
+	static std::vector<FTDI_DeviceInfo> interfaces (int pid,
+		const char* serialNo, const char* description);
 
 public:
 	void open (const char* serialNo);
@@ -45,18 +111,66 @@ public:
 
 public:
 	bool good (void) const;
+	int pollfd (void) const { return rxEvent_; }
 
 private:
 	ftdi_context* handle_;
 	static std::vector<FTDI_DeviceInfo> scan (int vid, int pid);
 
 public:
-	void setBaudRate (uint32_t bd);
+	bool setBaudRate (uint32_t bd);
+
+public:
+	bool setParameters (const FTDI_Parameters& parameters);
+	const FTDI_Parameters& parameters (void) const { return parameters_; }
 
 private:
-	void _setBaudrate (uint32_t baudrate);
+	bool _setBaudrate (uint32_t baudrate);
 
+private:
+	FTDI_Parameters parameters_;
+
+	/*
+	 * Asynchronous receive engine.
+	 *
+	 * FTDI_RX_TRANSFERS bulk-IN transfers are kept queued on the
+	 * device at all times. Their payload, stripped of the modem
+	 * status bytes, is pushed into rxRing_, which read() drains
+	 * without blocking. rxEvent_ is an eventfd that is signalled
+	 * while the ring holds data.
+	 *
+	 * Transfers complete on the IoEngine's thread, which watches
+	 * libusb's descriptors for every open device, so that an idle
+	 * device costs no thread and no wakeups.
+	 */
+private:
+	bool startReceiveEngine (void);
+	void stopReceiveEngine (void);
+	void received (libusb_transfer* transfer);
+	void signalReceived (void);
+	static void LIBUSB_CALL receive_cb (libusb_transfer* transfer);
+
+private:
+	void watchEvents (void);
+	void unwatchEvents (void);
+	void addPollfd (int fd, short events);
+	void removePollfd (int fd);
+	static bool handleEvents (void* user_data);
+	static void LIBUSB_CALL pollfd_added_cb (int fd, short events,
+											 void* user_data);
+	static void LIBUSB_CALL pollfd_removed_cb (int fd, void* user_data);
 
+private:
+	std::vector<libusb_transfer*> rxTransfers_;
+	std::vector<unsigned char> rxBuffers_;
+	RingBuffer<uint8_t> rxRing_;
+	std::map<int, int> rxWatches_;     // libusb descriptor to IoEngine watch
+	std::mutex rxWatchLock_;
+	std::atomic<bool> rxRunning_;
+	std::mutex rxLock_;                // Resubmitting against stopping
+	std::atomic<bool> rxFailed_;
+	std::atomic<int> rxPending_;
+	int rxEvent_;
 };
 } // end of namespace smu
 
@@ -69,7 +183,7 @@ private:
 
 namespace smu {
 
-class FTDI
+class FTDI : public Transport
 {
 	public:
 	FTDI (void);
@@ -87,8 +201,16 @@ class FTDI
 	public:
 	bool good (void) const;
 
+	public:
+	bool setBaudRate (uint32_t bd);
+
+	public:
+	bool setParameters (const FTDI_Parameters& parameters);
+	const FTDI_Parameters& parameters (void) const { return parameters_; }
+
 	private:
 	FT_HANDLE handle_;
+	FTDI_Parameters parameters_;
 	void configureTimeouts (void);
 };
 } // end of namespace smu
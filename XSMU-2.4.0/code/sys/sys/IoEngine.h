@@ -0,0 +1,191 @@
+#ifndef __SMU_IO_ENGINE__
+#define __SMU_IO_ENGINE__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace smu {
+
+/**** What a watch waits for ****/
+enum IoEvents
+{
+	IO_READABLE = 1,
+	IO_WRITABLE = 2,
+};
+
+/*
+ * Called on the engine's thread when a watched descriptor is ready.
+ * Must not block. Returns false to stop watching.
+ */
+typedef bool (*IoWatchHandler)(void* user_data);
+
+/*
+ * Called on a worker thread when a task is due. May block. Returns the
+ * delay in seconds till it is next due, or a negative value once done.
+ */
+typedef double (*IoTaskHandler)(void* user_data);
+
+/*
+ * Process-wide event loop shared by all open devices, in place of a
+ * receive thread and a keep-alive thread per device.
+ *
+ * One thread waits on every watched descriptor, with epoll on Linux, and
+ * on a timer descriptor armed for the earliest due task. Tasks sit in a
+ * hashed timer wheel of millisecond ticks, so that scheduling one costs
+ * the same however many are pending, and an idle engine sleeps till the
+ * next deadline.
+ *
+ * Due tasks run on a pool of worker threads, since they wait for replies
+ * which the engine's thread delivers. The pool grows while tasks are
+ * waiting for a worker, up to maxWorkers(). A task never runs on two
+ * workers at once. Writes run on a thread of their own instead, so that
+ * a request goes out even while every worker waits for a reply.
+ *
+ * Elsewhere than Linux, and for a descriptor of -1, watches are polled
+ * every millisecond instead.
+ */
+class IoEngine
+{
+	public:
+	static IoEngine& instance (void);
+
+	public:
+	/**** Ids are positive; zero is never returned ****/
+	int watch (int fd, IoWatchHandler handler, void* user_data,
+			   unsigned events = IO_READABLE);
+
+	/**** Waits for the handler to return, unless called from it ****/
+	void unwatch (int id);
+
+	public:
+	int schedule (IoTaskHandler handler, void* user_data, double delay);
+
+	/*
+	 * Like schedule(), but the task runs on the engine's writer thread,
+	 * never on a worker. Its handler may block on the write alone.
+	 */
+	int scheduleWrite (IoTaskHandler handler, void* user_data, double delay);
+
+	/*
+	 * Moves a pending task to delay from now. A task that is running
+	 * is next due at the earlier of this and what it returns.
+	 */
+	void reschedule (int id, double delay);
+
+	/**** Waits for the task to return, unless called from it ****/
+	void cancel (int id);
+
+	public:
+	unsigned maxWorkers (void) const;
+	void setMaxWorkers (unsigned n);
+
+	/**** Workers started so far, and times the engine's thread woke ****/
+	unsigned workers (void) const;
+	uint64_t wakeups (void) const;
+
+	private:
+	IoEngine (void);
+
+	typedef std::chrono::steady_clock Clock;
+
+	enum
+	{
+		WHEEL_SLOTS = 1024,       // Ticks per turn of the wheel
+		MAX_EVENTS = 64,          // Descriptors handled per wakeup
+	};
+
+	enum TaskState
+	{
+		TASK_WAITING,             // In the wheel
+		TASK_READY,               // Queued for a worker
+		TASK_RUNNING,
+	};
+
+	struct Watch
+	{
+		int fd;
+		IoWatchHandler handler;
+		void* user_data;
+	};
+
+	struct Task
+	{
+		IoTaskHandler handler;
+		void* user_data;
+		TaskState state;
+		uint64_t due;             // Tick, while waiting
+		uint32_t generation;      // Tells stale wheel entries apart
+		double rescheduled;       // Delay asked for while running, or -1
+		bool cancelled;
+		bool write;               // Runs on the writer thread
+		std::thread::id runner;
+	};
+
+	struct WheelEntry
+	{
+		int id;
+		uint32_t generation;
+	};
+
+	private:
+	void loop (void);
+	void worker (void);
+	void writer (void);
+	void run (int id, std::unique_lock<std::mutex>& lock);
+	void runWatch (int id);
+	void removeWatch (int id);
+
+	uint64_t tick (Clock::time_point t) const;
+	uint64_t dueTick (double delay) const;
+	int add (IoTaskHandler handler, void* user_data, double delay, bool write);
+	void enqueue (int id, Task& task, double delay);
+	void ready (int id, Task& task);
+	void expire (void);
+	void arm (uint64_t due);
+	void wake (void);
+
+	private:
+	mutable std::mutex lock_;
+	std::condition_variable readyCond_;    // Workers wait here
+	std::condition_variable writeCond_;    // The writer waits here
+	std::condition_variable doneCond_;     // unwatch() and cancel() wait here
+	std::condition_variable loopCond_;     // The loop, without epoll
+
+	int nextId_;
+	std::map<int, Watch> watches_;
+	unsigned polledWatches_;               // Watches without a descriptor
+	int runningWatch_;
+	std::thread::id loopThread_;
+
+	std::map<int, Task> tasks_;
+	std::vector<WheelEntry> wheel_[WHEEL_SLOTS];
+	const Clock::time_point epoch_;
+	uint64_t lastTick_;                    // Last tick expired
+	uint64_t armedTick_;                   // Tick the timer is set for, 0 if none
+
+	std::deque<int> ready_;
+	unsigned maxWorkers_;
+	unsigned workers_;
+	unsigned idleWorkers_;
+	uint64_t wakeups_;
+
+	std::deque<int> writes_;               // Write tasks due
+	bool writer_;                          // Writer thread started
+
+	int epoll_;
+	int timerfd_;
+	int wakefd_;
+
+	private:
+	IoEngine (const IoEngine&);
+	IoEngine& operator= (const IoEngine&);
+};
+} // end of namespace smu
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef __SMU_LOG__
+#define __SMU_LOG__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+/*
+ * Most verbose level compiled in. Statements above it vanish, test
+ * and all. Build with e.g. -DSMU_LOG_LEVEL=2 to keep only errors
+ * and warnings.
+ */
+#ifndef SMU_LOG_LEVEL
+#define SMU_LOG_LEVEL 4
+#endif
+
+/*
+ * SMU_LOG_DEBUG (LOG_COMM, "Sent {} bytes", n);
+ *
+ * Each {} in the format is replaced by the next argument. Arguments
+ * are captured, not formatted, by the caller; strings are copied.
+ */
+#define SMU_LOG(level, category, ...)                                   \
+	do {                                                                \
+		if (((level) <= SMU_LOG_LEVEL) &&                               \
+			smu::Log::enabled ((level), (category)))                    \
+			smu::Log::write ((level), (category),                       \
+							 __func__, __LINE__, __VA_ARGS__);          \
+	} while (0)
+
+#define SMU_LOG_ERROR(category, ...)                                    \
+	SMU_LOG (smu::LOG_LEVEL_ERROR, smu::category, __VA_ARGS__)
+
+#define SMU_LOG_WARNING(category, ...)                                  \
+	SMU_LOG (smu::LOG_LEVEL_WARNING, smu::category, __VA_ARGS__)
+
+#define SMU_LOG_INFO(category, ...)                                     \
+	SMU_LOG (smu::LOG_LEVEL_INFO, smu::category, __VA_ARGS__)
+
+#define SMU_LOG_DEBUG(category, ...)                                    \
+	SMU_LOG (smu::LOG_LEVEL_DEBUG, smu::category, __VA_ARGS__)
+
+namespace smu {
+
+enum LogLevel
+{
+	LOG_LEVEL_NONE,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+};
+
+enum LogCategory
+{
+	LOG_FTDI,
+	LOG_QP4,
+	LOG_COMM,
+	LOG_DRIVER,
+	LOG_STREAM,
+	LOG_CATEGORIES,
+};
+
+/*
+ * A log argument, as captured on the caller's thread.
+ */
+class LogArg
+{
+public:
+	enum Type {NONE, INT, UINT, REAL, TEXT};
+
+	LogArg (void)                 : type_ (NONE) {}
+	LogArg (int x)                : type_ (INT)  { i_ = x; }
+	LogArg (long x)               : type_ (INT)  { i_ = x; }
+	LogArg (long long x)          : type_ (INT)  { i_ = x; }
+	LogArg (unsigned int x)       : type_ (UINT) { u_ = x; }
+	LogArg (unsigned long x)      : type_ (UINT) { u_ = x; }
+	LogArg (unsigned long long x) : type_ (UINT) { u_ = x; }
+	LogArg (double x)             : type_ (REAL) { d_ = x; }
+	LogArg (const char* x)        : type_ (TEXT) { s_ = x ? x : ""; }
+	LogArg (const std::string& x) : type_ (TEXT) { s_ = x.c_str(); }
+
+public:
+	Type type (void) const { return type_; }
+
+	long long          i (void) const { return i_; }
+	unsigned long long u (void) const { return u_; }
+	double             d (void) const { return d_; }
+	const char*        s (void) const { return s_; }
+
+private:
+	friend class Log;
+
+	Type type_;
+	union {
+		long long i_;
+		unsigned long long u_;
+		double d_;
+		const char* s_;
+	};
+};
+
+/*
+ * Process-wide log. Records go into a fixed, lock-free ring, shared by
+ * all threads, and a background thread formats them into the log file,
+ * stderr by default, every few milliseconds. When the ring is full,
+ * records are dropped and counted rather than waited for.
+ *
+ * Every category starts at LOG_LEVEL_WARNING. The XSMU_LOG environment
+ * variable, read at startup, is parsed by configure().
+ */
+class Log
+{
+public:
+	static bool enabled (LogLevel level, LogCategory category)
+	{
+		return level <= levels_[category].load (std::memory_order_relaxed);
+	}
+
+	template <typename... Args>
+	static void write (LogLevel level, LogCategory category,
+					   const char* function, int line,
+					   const char* format, const Args&... args)
+	{
+		const LogArg argv[] = {LogArg (args)..., LogArg()};
+		instance().post (level, category, function, line,
+						 format, argv, sizeof... (args));
+	}
+
+public:
+	static LogLevel level (LogCategory category);
+	static void setLevel (LogCategory category, LogLevel level);
+	static void setLevel (LogLevel level);
+
+	/*
+	 * Sets levels from a spec such as "debug", or "info,stream=debug"
+	 * for one category. Names are as printed in the log.
+	 */
+	static void configure (const char* spec);
+
+	/**** Appends to path, or goes back to stderr for 0 or "" ****/
+	static bool setFile (const char* path);
+
+	/**** Writes out whatever is pending, from the calling thread ****/
+	static void flush (void);
+
+	static uint64_t dropped (void);
+
+private:
+	enum
+	{
+		RING_SIZE = 1024,             // Records, a power of two
+		MAX_ARGS  = 6,
+		TEXT_SIZE = 128,              // Room for string arguments
+	};
+
+	struct Record
+	{
+		std::atomic<size_t> sequence;
+
+		uint64_t time;                // Nanoseconds since the log started
+		LogLevel level;
+		LogCategory category;
+		const char* function;
+		int line;
+		const char* format;
+
+		uint8_t nargs;
+		LogArg args[MAX_ARGS];
+		char text[TEXT_SIZE];
+	};
+
+private:
+	static Log& instance (void);
+
+	Log (void);
+
+	void post (LogLevel level, LogCategory category,
+			   const char* function, int line,
+			   const char* format, const LogArg* args, size_t nargs);
+
+	void flusher (void);
+	void drain (void);
+	void print (const Record& record);
+
+private:
+	static std::atomic<int> levels_[LOG_CATEGORIES];
+
+	Record* ring_;
+	std::atomic<size_t> enqueue_;
+	size_t dequeue_;                  // Guarded by drainLock_
+	std::atomic<uint64_t> dropped_;
+	uint64_t reportedDropped_;        // Guarded by drainLock_
+
+	std::mutex drainLock_;
+	std::FILE* file_;                 // Guarded by drainLock_
+
+	std::mutex wakeLock_;
+	std::condition_variable wakeCond_;
+	std::thread thread_;
+
+private:
+	Log (const Log&);
+	Log& operator= (const Log&);
+};
+
+} // end of namespace smu
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __SMU_LOOPBACK__
+#define __SMU_LOOPBACK__
+
+#include "Transport.h"
+
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * In-memory transport. Bytes written to it come back from its own
+ * read(), or from its peer's once two loopbacks are connected. Useful
+ * for exercising Comm without hardware.
+ */
+class Loopback : public Transport
+{
+public:
+	Loopback (void);
+	~Loopback (void);
+
+public:
+	static void connect (Loopback* a, Loopback* b);
+
+public:
+	void open (const char* name, int baudrate);
+	uint32_t read (void* data, uint32_t size);
+	uint32_t write (const void* data, uint32_t size);
+	void close (void);
+
+public:
+	bool good (void) const { return open_; }
+	bool setBaudRate (uint32_t bd) { return open_; }
+	int pollfd (void) const { return rxEvent_; }
+
+private:
+	void deliver (const uint8_t* data, uint32_t size);
+
+private:
+	bool open_;
+	Loopback* peer_;              // Receives written bytes
+	std::mutex rxLock_;
+	std::deque<uint8_t> rxQueue_;
+	int rxEvent_;                 // eventfd on Linux, -1 elsewhere
+
+	static std::mutex peerLock_;
+
+private:
+	Loopback (const Loopback&);
+	Loopback& operator= (const Loopback&);
+};
+} // end of namespace smu
+
+#endif
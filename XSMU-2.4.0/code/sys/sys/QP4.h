@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <utility>
+#include <cstddef>
 #include <stdint.h>
 
 #include "../../stl/inet"
@@ -46,6 +47,59 @@ class QP4_Packet
 	QP4_Packet (uint16_t size);
 };
 
+/*
+ * Two's complement of the byte sum, as carried in the frame header.
+ */
+inline uint16_t QP4_checksum (const void* data, uint16_t size)
+{
+	const uint8_t* src = reinterpret_cast<const uint8_t*> (data);
+	uint16_t checksum = 0;
+
+	for (uint16_t i = 0; i < size; ++i)
+		checksum += src[i];
+
+	return ~checksum + 1;
+}
+
+/*
+ * A frame around a body of type T, built in place, typically on the
+ * stack. Unlike QP4_Packet, its size is known at compile time, so it
+ * needs no allocation, and the checksum loop unrolls. It is built
+ * unsealed, so that the body may yet be amended, e.g. tagged, and
+ * seal() sums it once it is final.
+ */
+template <typename T>
+class QP4_Frame
+{
+	public:
+	template <typename... Args>
+	explicit QP4_Frame (Args... args) :
+		startFrameMarker_ (hton (QP4_SOF_MARKER)),
+		size_ (hton ((uint16_t) sizeof (T))),
+		checksum_ (0),
+		body_ (args...)
+	{}
+
+	public:
+	const void* data (void) const {return this;}
+	static uint16_t size (void) {
+		return sizeof (uint32_t) + 2 * sizeof (uint16_t) + sizeof (T);
+	}
+
+	public:
+	T& body (void) {return body_;}
+	void seal (void) {
+		checksum_ = hton (QP4_checksum (&body_, sizeof (T)));
+	}
+
+	private:
+	uint32_t startFrameMarker_;
+	uint16_t size_, checksum_;
+	T body_;
+};
+
+/************************************************************************/
+
 class QP4_Transmitter
 {
 	public:
@@ -69,13 +123,34 @@ class QP4_Receiver
 	public:
 	const bool& ready (void) const {return ready_;}
 	std::pair<const void*, uint16_t> data (void) const {
-		return std::pair<const void*, uint16_t> (data_, size_);
+		return std::pair<const void*, uint16_t> (
+			view_ ? view_ : data_, size_);
 	}
 
 	public:
 	void clear (void);
 	void push_back (uint8_t x);
 
+	/*
+	 * Parses up to size bytes in bulk, and returns how many were
+	 * consumed. It stops right after a byte that completes a frame,
+	 * which data() then returns till clear(), so the caller should
+	 * clear() and push the rest. A frame received whole by one call
+	 * is not copied: data() points into the caller's buffer, and is
+	 * only valid as long as that is.
+	 *
+	 * Gives the same results as calling push_back() on each byte,
+	 * and clear() after each frame.
+	 */
+	size_t push (const uint8_t* data, size_t size);
+
+	/*
+	 * Count of frames dropped for a bad size or checksum.
+	 * Never reset, so callers compare snapshots.
+	 */
+	public:
+	uint32_t errors (void) const {return errors_;}
+
 	private:
 	QP4_RxState state_;
 
@@ -92,6 +167,13 @@ class QP4_Receiver
 #endif
 
 	uint8_t* dataWriter_;
+	const uint8_t* view_;
+
+	private:
+	size_t findStartFrameMarker (const uint8_t* data, size_t size) const;
+	size_t pushData (const uint8_t* data, size_t size);
+	void shiftWindow (const uint8_t* data, size_t size);
+	static uint16_t sum (const uint8_t* data, size_t size);
 
 	private:
 	void initiateReceptionSequence (void);
@@ -114,6 +196,7 @@ class QP4_Receiver
 	bool ready_;
 	uint32_t window_;
 	uint16_t byteCounter_;
+	uint32_t errors_;
 };
 
 class QP4 : public QP4_Receiver, public QP4_Transmitter
@@ -0,0 +1,194 @@
+#ifndef __SMU_RING_BUFFER__
+#define __SMU_RING_BUFFER__
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+namespace smu {
+
+/*
+ * Bounded single-producer / single-consumer queue.
+ *
+ * One thread may push() while another thread pops(), without locks.
+ * Capacity is rounded up to a power of two. Elements must be trivially
+ * copyable, since blocks are moved with memcpy.
+ *
+ * The producer may also discard() the oldest elements to make room.
+ * pop() therefore claims what it copied with a compare-and-swap, and
+ * copies again should the producer have discarded them meanwhile.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+	RingBuffer (size_t capacity) :
+		mask_ (roundup (capacity) - 1),
+		data_ (mask_ + 1),
+		head_ (0),
+		tail_ (0)
+	{}
+
+public:
+	size_t capacity (void) const { return mask_ + 1; }
+
+	size_t size (void) const {
+		return head_.load (std::memory_order_acquire) -
+			tail_.load (std::memory_order_acquire);
+	}
+
+	bool empty (void) const { return size() == 0; }
+
+public:
+	/* Producer side. Returns the number of elements actually queued. */
+	size_t push (const T* src, size_t n)
+	{
+		const size_t head = head_.load (std::memory_order_relaxed);
+		const size_t tail = tail_.load (std::memory_order_acquire);
+
+		const size_t room = capacity() - (head - tail);
+		if (n > room) n = room;
+
+		copy_in (head, src, n);
+		head_.store (head + n, std::memory_order_release);
+		return n;
+	}
+
+	/*
+	 * Producer side, in place. Returns where up to *n elements may be
+	 * written without wrapping, and reduces *n to what fits there.
+	 * commit() then queues them.
+	 */
+	T* prepare (size_t* n)
+	{
+		const size_t head = head_.load (std::memory_order_relaxed);
+		const size_t tail = tail_.load (std::memory_order_acquire);
+
+		const size_t i = head & mask_;
+		size_t room = capacity() - (head - tail);
+		if (room > capacity() - i) room = capacity() - i;
+		if (*n > room) *n = room;
+
+		return &data_[i];
+	}
+
+	void commit (size_t n)
+	{
+		head_.store (head_.load (std::memory_order_relaxed) + n,
+					 std::memory_order_release);
+	}
+
+	/*
+	 * Producer side. Drops up to n of the oldest elements.
+	 * Returns the number actually dropped.
+	 */
+	size_t discard (size_t n)
+	{
+		const size_t head = head_.load (std::memory_order_relaxed);
+		size_t tail = tail_.load (std::memory_order_acquire);
+
+		for (;;) {
+
+			const size_t k = (n < head - tail) ? n : head - tail;
+
+			if (tail_.compare_exchange_weak (tail, tail + k,
+					std::memory_order_acq_rel, std::memory_order_acquire))
+				return k;
+		}
+	}
+
+	/* Consumer side. Returns the number of elements actually dequeued. */
+	size_t pop (T* dst, size_t n)
+	{
+		size_t at;
+		return pop (dst, n, &at);
+	}
+
+	/*
+	 * As above, also returning in *at the position of the first element
+	 * dequeued, counting every element ever queued.
+	 */
+	size_t pop (T* dst, size_t n, size_t* at)
+	{
+		size_t tail = tail_.load (std::memory_order_acquire);
+
+		for (;;) {
+
+			const size_t head = head_.load (std::memory_order_acquire);
+			const size_t k = (n < head - tail) ? n : head - tail;
+
+			copy_out (tail, dst, k);
+
+			if (tail_.compare_exchange_weak (tail, tail + k,
+					std::memory_order_acq_rel, std::memory_order_acquire)) {
+
+				*at = tail;
+				return k;
+			}
+		}
+	}
+
+	/**** Position of the oldest element, counting as pop() does ****/
+	size_t position (void) const {
+		return tail_.load (std::memory_order_acquire);
+	}
+
+	/* Must only be called while neither side is active. */
+	void clear (void)
+	{
+		head_.store (0, std::memory_order_relaxed);
+		tail_.store (0, std::memory_order_relaxed);
+	}
+
+private:
+	static size_t roundup (size_t n)
+	{
+		size_t c = 1;
+		while (c < n) c <<= 1;
+		return c;
+	}
+
+	void copy_in (size_t at, const T* src, size_t n)
+	{
+		const size_t i = at & mask_;
+		const size_t first = (n < capacity() - i) ? n : capacity() - i;
+
+		memcpy (&data_[i], src, first * sizeof (T));
+		memcpy (&data_[0], src + first, (n - first) * sizeof (T));
+	}
+
+	void copy_out (size_t at, T* dst, size_t n) const
+	{
+		const size_t i = at & mask_;
+		const size_t first = (n < capacity() - i) ? n : capacity() - i;
+
+		memcpy (dst, &data_[i], first * sizeof (T));
+		memcpy (dst + first, &data_[0], (n - first) * sizeof (T));
+	}
+
+private:
+	enum {CACHE_LINE = 64};
+
+	const size_t mask_;
+	std::vector<T> data_;
+
+	/*
+	 * Padding keeps each index on a cache line of its own, so that
+	 * neither side invalidates the other's line, or the constants
+	 * above, as it moves on. Unlike alignas, it needs no aligned new.
+	 */
+	char pad0_[CACHE_LINE];
+	std::atomic<size_t> head_;
+	char pad1_[CACHE_LINE - sizeof (std::atomic<size_t>)];
+	std::atomic<size_t> tail_;
+	char pad2_[CACHE_LINE - sizeof (std::atomic<size_t>)];
+
+private:
+	RingBuffer (const RingBuffer&);
+	RingBuffer& operator= (const RingBuffer&);
+};
+
+} // end of namespace smu
+
+#endif
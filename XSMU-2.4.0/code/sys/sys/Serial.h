@@ -0,0 +1,43 @@
+#ifndef __SMU_SERIAL__
+#define __SMU_SERIAL__
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+
+#include "Transport.h"
+
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * Serial port transport, for an SMU bound to the kernel ftdi_sio
+ * driver and reached through a tty such as /dev/ttyUSB0.
+ *
+ * The port is opened non-blocking in raw 8N1 mode, so its descriptor
+ * can be handed to poll or epoll directly.
+ */
+class Serial : public Transport
+{
+public:
+	Serial (void);
+	~Serial (void);
+
+public:
+	void open (const char* device, int baudrate);
+	uint32_t read (void* data, uint32_t size);
+	uint32_t write (const void* data, uint32_t size);
+	void close (void);
+
+public:
+	bool good (void) const;
+	bool setBaudRate (uint32_t bd);
+	int pollfd (void) const { return fd_; }
+
+private:
+	int fd_;
+};
+} // end of namespace smu
+
+#endif // linux
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __SMU_STREAM_BUFFER__
+#define __SMU_STREAM_BUFFER__
+
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * What the stream buffer does with samples that do not fit.
+ */
+enum StreamOverflow
+{
+	STREAM_OVERFLOW_BLOCK,        // Leave them with the SMU till there is room
+	STREAM_OVERFLOW_DROP_OLDEST,  // Make room by dropping the oldest samples
+	STREAM_OVERFLOW_SPILL,        // Keep them in a temporary file
+};
+
+/*
+ * Fixed capacity buffer of streamed samples, between the receiver
+ * (producer) and the application (consumer). Samples move through a
+ * lock-free RingBuffer; only overflow takes a lock.
+ *
+ * With STREAM_OVERFLOW_BLOCK, the poller asks for no more than room()
+ * and waitForRoom() holds it back, so that the SMU keeps the backlog.
+ * Samples pushed regardless are dropped.
+ *
+ * With STREAM_OVERFLOW_SPILL, once the ring fills, samples go to a
+ * temporary file until the consumer has caught up with all of it, so
+ * that they come out in the order they came in.
+ *
+ * Samples are numbered in the order they were pushed, dropped ones
+ * included, so that the consumer may tell where each drained sample
+ * stood in the stream despite gaps.
+ */
+class StreamBuffer
+{
+public:
+	enum {DEFAULT_CAPACITY = 1 << 20};
+
+	StreamBuffer (size_t capacity = DEFAULT_CAPACITY,
+				  StreamOverflow overflow = STREAM_OVERFLOW_BLOCK);
+	~StreamBuffer (void);
+
+public:
+	size_t capacity (void) const { return ring_->capacity(); }
+	StreamOverflow overflow (void) const { return overflow_; }
+
+	/**** Must only be called while neither side is active ****/
+	void configure (size_t capacity, StreamOverflow overflow);
+	void clear (void);
+
+public:
+	/**** Producer side ****/
+	void push (const int32_t* samples, size_t n);
+	void pushNetworkOrder (const void* samples, size_t n);
+
+	size_t room (void) const;
+	bool waitForRoom (size_t n, double timeout);
+
+public:
+	/*
+	 * Consumer side. Returns the number of samples copied to dst, and
+	 * if index is given, the number of each of them in index.
+	 */
+	size_t drain (int32_t* dst, size_t n, uint64_t* index = 0);
+
+public:
+	size_t size (void) const { return ring_->size() + spillPending_; }
+
+	uint64_t dropped   (void) const { return dropped_;   }
+	uint64_t spilled   (void) const { return spilled_;   }
+	size_t   highWater (void) const { return highWater_; }
+
+	/**** Samples pushed so far, that is, the number of the next one ****/
+	uint64_t offered (void) const { return offered_; }
+
+private:
+	template <typename Copy>
+	void store (const uint8_t* src, size_t n, Copy copy);
+
+	template <typename Copy>
+	void spill (const uint8_t* src, size_t n, Copy copy);
+
+	size_t unspill (int32_t* dst, size_t n);
+	void closeSpill (void);
+
+	void skip (size_t n);
+	void number (uint64_t* index, size_t n, uint64_t first);
+	void reset (void);
+
+private:
+	enum {SPILL_CHUNK = 1024};
+	enum {MAX_GAPS = 1024};
+
+	RingBuffer<int32_t>* ring_;
+	StreamOverflow overflow_;
+
+	/**** Written by the producer only ****/
+	std::atomic<uint64_t> dropped_;
+	std::atomic<uint64_t> spilled_;
+	std::atomic<size_t> highWater_;
+
+	/**** Spill file, and the read and write offsets into it ****/
+	std::mutex spillLock_;
+	std::FILE* spillFile_;
+	long spillRead_;
+	long spillWrite_;
+	std::atomic<bool> spilling_;
+	std::atomic<uint64_t> spillPending_;
+
+	/*
+	 * Numbering. Samples kept are counted as accepted_, and those
+	 * dropped before being kept leave a gap at that count. The
+	 * consumer adds up the gaps it has gone past in shift_.
+	 */
+	struct Gap
+	{
+		uint64_t at;                  // Samples accepted before the gap
+		uint64_t skipped;
+	};
+
+	std::atomic<uint64_t> offered_;
+	uint64_t accepted_;               // Producer only
+	std::mutex gapLock_;
+	std::deque<Gap> gaps_;
+	std::atomic<bool> gapsPending_;
+	uint64_t shift_;                  // Consumer only
+	uint64_t unspilled_;              // Consumer only, under spillLock_
+
+	/**** Wakes a producer waiting for room ****/
+	std::mutex roomLock_;
+	std::condition_variable roomCond_;
+
+private:
+	StreamBuffer (const StreamBuffer&);
+	StreamBuffer& operator= (const StreamBuffer&);
+};
+} // end of namespace smu
+
+#endif
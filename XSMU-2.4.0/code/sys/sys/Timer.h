@@ -3,6 +3,12 @@
 
 namespace smu {
 
+/*
+ * get() reads a monotonic clock, in seconds from an arbitrary origin.
+ * Unlike the time of day, it never jumps when the clock is set, so it
+ * is only good for measuring intervals and for timestamps compared
+ * with one another.
+ */
 class Timer
 {
 public:
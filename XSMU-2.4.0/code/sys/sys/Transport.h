@@ -0,0 +1,39 @@
+#ifndef __SMU_TRANSPORT__
+#define __SMU_TRANSPORT__
+
+#include <stdint.h>
+
+namespace smu {
+
+/*
+ * Byte stream to and from the SMU.
+ *
+ * read() and write() never block for long: read() returns whatever
+ * has arrived, possibly nothing. A transport that fails closes itself,
+ * after which good() returns false.
+ */
+class Transport
+{
+	public:
+	virtual ~Transport (void) {}
+
+	public:
+	virtual void open (const char* name, int baudrate) = 0;
+	virtual uint32_t read (void* data, uint32_t size) = 0;
+	virtual uint32_t write (const void* data, uint32_t size) = 0;
+	virtual void close (void) = 0;
+
+	public:
+	virtual bool good (void) const = 0;
+	virtual bool setBaudRate (uint32_t bd) = 0;
+
+	/*
+	 * A descriptor that polls readable while read() has data,
+	 * for use with poll/epoll. -1 if the transport has none.
+	 */
+	public:
+	virtual int pollfd (void) const { return -1; }
+};
+} // end of namespace smu
+
+#endif
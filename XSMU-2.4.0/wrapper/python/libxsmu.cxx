@@ -1,8 +1,16 @@
 #include "libxsmu.h"
 #include "../../code/app/app/virtuaSMU.h"
+#include "../../code/sys/sys/DeviceRegistry.h"
+#include "../../code/sys/sys/IoEngine.h"
+#include "../../code/sys/sys/Log.h"
+#include "../../code/sys/sys/Timer.h"
 
 #include <iostream>
 #include <cstring>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
 
 using namespace std;
 
@@ -11,6 +19,10 @@ using namespace std;
 
 static vector <VirtuaSMU *> virtuaSMUs;
 static vector <smu::FTDI_DeviceInfo> devices;
+static bool autoTune_ = false;
+static bool calibrationCache_ = true;
+
+static void dropRequests (int deviceID);
 
 int scan(void)
 {
@@ -42,6 +54,8 @@ int open_device(const char *serialNo,
 	/**************************************/
 
 	float timeout_ = timeout;
+	virtuaSMU->autoTune (autoTune_);
+	virtuaSMU->enableCalibrationCache (calibrationCache_);
 	virtuaSMU->open (serialNo, &timeout_);
 
 	*ret_goodID = virtuaSMU->goodID();
@@ -54,6 +68,8 @@ int open_device(const char *serialNo,
 
 void close_device(int deviceID)
 {
+	dropRequests (deviceID);
+
 	delete virtuaSMUs[deviceID];
 	virtuaSMUs[deviceID] = 0;
 }
@@ -963,5 +979,679 @@ void recData (int deviceID, short unsigned int size, float timeout,
 	*ret_size = size_;
 }
 
+/************************************************************************/
+
+void autoTune (unsigned int enable)
+{
+	autoTune_ = enable;
+}
+
+void setTransportParameters (int deviceID, unsigned int latencyTimer,
+				unsigned int readChunkSize, unsigned int writeChunkSize,
+				unsigned int *ret_good)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	smu::FTDI_Parameters parameters = virtuaSMU->transportParameters();
+	parameters.latencyTimer (latencyTimer);
+	parameters.readChunkSize (readChunkSize);
+	parameters.writeChunkSize (writeChunkSize);
+
+	*ret_good = virtuaSMU->setTransportParameters (parameters);
+}
+
+void getTransportParameters (int deviceID, unsigned int *ret_latencyTimer,
+				unsigned int *ret_readChunkSize,
+				unsigned int *ret_writeChunkSize)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	smu::FTDI_Parameters parameters = virtuaSMU->transportParameters();
+
+	*ret_latencyTimer   = parameters.latencyTimer();
+	*ret_readChunkSize  = parameters.readChunkSize();
+	*ret_writeChunkSize = parameters.writeChunkSize();
+}
+
+/************************************************************************/
+
+void negotiateBaudRate (int deviceID, unsigned int baudRate, float timeout,
+				unsigned int *ret_baudRate, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	unsigned int baudRate_ = baudRate;
+	float timeout_ = timeout;
+
+	virtuaSMU->negotiateBaudRate (&baudRate_, &timeout_);
+
+	*ret_baudRate = baudRate_;
+	*ret_timeout = timeout_;
+}
+
+void setStreamSampleRate (int deviceID, float sampleRate)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	virtuaSMU->setStreamSampleRate (sampleRate);
+}
+
+/************************************************************************/
+
+#if defined(linux) || defined(__linux) || defined(__linux__)
+
+static std::mutex deviceEventsLock;
+static std::deque <smu::DeviceEvent> deviceEvents;
+static smu::FTDI_DeviceInfo deviceEventInfo ("", "");
+
+static void queueDeviceEvent (void *, const smu::DeviceEvent &event)
+{
+	std::lock_guard <std::mutex> lock (deviceEventsLock);
+	deviceEvents.push_back (event);
+}
+
+int pollDeviceEvent (void)
+{
+	static const int subscription =
+		smu::DeviceRegistry::instance().subscribe (queueDeviceEvent, 0);
+	(void) subscription;
+
+	std::lock_guard <std::mutex> lock (deviceEventsLock);
+
+	if (deviceEvents.empty())
+		return 0;
+
+	const smu::DeviceEvent event = deviceEvents.front();
+	deviceEvents.pop_front();
+
+	deviceEventInfo = event.device();
+	return event.type();
+}
+
+const char *deviceEventSerialNo (void)
+{
+	return deviceEventInfo.serialNo();
+}
+
+#else
+
+int pollDeviceEvent (void)
+{
+	return 0;
+}
+
+const char *deviceEventSerialNo (void)
+{
+	return "";
+}
+
+#endif
+
+/************************************************************************/
+
+void setTransmitPolicy (int deviceID, float maxDelay, unsigned int maxBytes)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	smu::Comm_TransmitPolicy policy;
+	policy.maxDelay (maxDelay);
+	policy.maxBytes (maxBytes);
+
+	virtuaSMU->setTransmitPolicy (policy);
+}
+
+void getTransmitPolicy (int deviceID, float *ret_maxDelay,
+				unsigned int *ret_maxBytes)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	smu::Comm_TransmitPolicy policy = virtuaSMU->transmitPolicy();
+
+	*ret_maxDelay = policy.maxDelay();
+	*ret_maxBytes = policy.maxBytes();
+}
+
+/************************************************************************/
+
+void setStreamBuffer (int deviceID, unsigned int capacity, int overflow)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	virtuaSMU->setStreamBuffer (capacity,
+		static_cast<smu::StreamOverflow> (overflow));
+}
+
+void getStreamStatistics (int deviceID,
+				unsigned long long *ret_dropped,
+				unsigned long long *ret_spilled,
+				unsigned int *ret_highWater)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	*ret_dropped   = virtuaSMU->streamDropped();
+	*ret_spilled   = virtuaSMU->streamSpilled();
+	*ret_highWater = virtuaSMU->streamHighWater();
+}
+
+/************************************************************************/
+
+void setLogLevel (int category, int level)
+{
+	if ((category < 0) || (category >= smu::LOG_CATEGORIES))
+		smu::Log::setLevel (static_cast<smu::LogLevel> (level));
+	else
+		smu::Log::setLevel (static_cast<smu::LogCategory> (category),
+							static_cast<smu::LogLevel> (level));
+}
+
+int setLogFile (const char *path)
+{
+	return smu::Log::setFile (path);
+}
+
+/************************************************************************/
+
+void setStreamPollPolicy (int deviceID, float minInterval,
+				float maxInterval, float targetLatency,
+				float targetFill, unsigned int capacity)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	smu::StreamPollPolicy policy;
+	policy.minInterval (minInterval);
+	policy.maxInterval (maxInterval);
+	policy.targetLatency (targetLatency);
+	policy.targetFill (targetFill);
+	policy.capacity (capacity);
+
+	virtuaSMU->setStreamPollPolicy (policy);
+}
+
+float getStreamFillRate (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->streamFillRate();
+}
+
+/************************************************************************/
+
+void setStreamPipelineDepth (int deviceID, unsigned int depth)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	virtuaSMU->setStreamPipelineDepth (depth);
+}
+
+unsigned int getStreamPipelineDepth (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->streamPipelineDepth();
+}
+
+/************************************************************************/
+
+void StartRecPush (int deviceID, unsigned short chunkSize, float timeout,
+				unsigned short *ret_chunkSize, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	uint16_t chunkSize_ = chunkSize;
+	float timeout_ = timeout;
+	virtuaSMU->StartRecPush (&chunkSize_, &timeout_);
+
+	*ret_chunkSize = chunkSize_;
+	*ret_timeout = timeout_;
+}
+
+unsigned long long getStreamFramesLost (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->streamFramesLost();
+}
+
+/************************************************************************/
+
+void setIoEngineWorkers (unsigned int n)
+{
+	smu::IoEngine::instance().setMaxWorkers (n);
+}
+
+unsigned int getIoEngineWorkers (void)
+{
+	return smu::IoEngine::instance().workers();
+}
+
+unsigned long long getIoEngineWakeups (void)
+{
+	return smu::IoEngine::instance().wakeups();
+}
+
+/************************************************************************/
+
+std::vector<double> getDataTimed (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	float data[1024];
+	double time[1024];
+	size_t n;
+
+	std::vector<double> pairs;
+
+	while ((n = virtuaSMU->getData (data, time, 1024)) > 0)
+		for (size_t i = 0; i < n; ++i) {
+
+			pairs.push_back (time[i]);
+			pairs.push_back (data[i]);
+		}
+
+	return pairs;
+}
+
+std::vector<float> getResampledData (int deviceID, double interval,
+				double *ret_start)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->getResampledData (interval, ret_start);
+}
+
+double getStreamClockRate (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->streamClockRate();
+}
+
+void setStreamClockTimeConstant (int deviceID, double seconds)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	virtuaSMU->setStreamClockTimeConstant (seconds);
+}
+
+double getMonotonicTime (void)
+{
+	return smu::Timer::get();
+}
+
+/************************************************************************/
+
+std::vector<double> getDataTagged (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	float data[1024];
+	double time[1024];
+	smu::VM_Range range[1024];
+	size_t n;
+
+	std::vector<double> triples;
+
+	while ((n = virtuaSMU->getData (data, time, range, 1024)) > 0)
+		for (size_t i = 0; i < n; ++i) {
+
+			triples.push_back (time[i]);
+			triples.push_back (data[i]);
+			triples.push_back (range[i]);
+		}
+
+	return triples;
+}
+
+int getStreamCalibrated (int deviceID, int range)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->streamCalibrated (smu::toVM_Range (range));
+}
+
+/************************************************************************/
+
+void calibrationCache (unsigned int enable)
+{
+	calibrationCache_ = enable;
+}
+
+int getCalibrationCacheLoaded (int deviceID)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	return virtuaSMU->calibrationCacheLoaded();
+}
+
+void CalibrationChecksum (int deviceID, float timeout,
+				unsigned int *ret_checksum, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	uint32_t checksum = 0;
+	float timeout_ = timeout;
+	virtuaSMU->CalibrationChecksum (&checksum, &timeout_);
+
+	*ret_checksum = checksum;
+	*ret_timeout = timeout_;
+}
+
+/************************************************************************/
+
+template <typename Table>
+static void flattenCalibrationTables (const std::vector<Table>& tables,
+									  std::vector<double>& quadruples)
+{
+	for (size_t r = 0; r < tables.size(); ++r)
+		for (uint_fast8_t i = 0; i < tables[r].size(); ++i) {
+
+			quadruples.push_back (r);
+			quadruples.push_back (i);
+			quadruples.push_back (tables[r][i].first());
+			quadruples.push_back (tables[r][i].second());
+		}
+}
+
+std::vector<double> getCalibrationTables (int deviceID, int meter,
+				float timeout, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	std::vector<double> quadruples;
+	float timeout_ = timeout;
+
+	switch (meter) {
+
+		case 0: {
+			std::vector<smu::CS_CalibrationTable> tables;
+			virtuaSMU->CS_getCalibrationTables (&tables, &timeout_);
+			flattenCalibrationTables (tables, quadruples);
+			break;
+		}
+
+		case 1: {
+			std::vector<smu::VS_CalibrationTable> tables;
+			virtuaSMU->VS_getCalibrationTables (&tables, &timeout_);
+			flattenCalibrationTables (tables, quadruples);
+			break;
+		}
+
+		case 2: {
+			std::vector<smu::CM_CalibrationTable> tables;
+			virtuaSMU->CM_getCalibrationTables (&tables, &timeout_);
+			flattenCalibrationTables (tables, quadruples);
+			break;
+		}
+
+		case 3: {
+			std::vector<smu::VM_CalibrationTable> tables;
+			virtuaSMU->VM_getCalibrationTables (&tables, &timeout_);
+			flattenCalibrationTables (tables, quadruples);
+			break;
+		}
+
+		case 4: {
+			std::vector<smu::VM_CalibrationTable> tables;
+			virtuaSMU->VM2_getCalibrationTables (&tables, &timeout_);
+			flattenCalibrationTables (tables, quadruples);
+			break;
+		}
+	}
+
+	*ret_timeout = timeout_;
+	return quadruples;
+}
+
+std::vector<int> SystemConfig_GetList (int deviceID,
+				const std::vector<int>& paramIDs,
+				float timeout, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	std::vector<int16_t> ids (paramIDs.begin(), paramIDs.end());
+	std::vector<int16_t> values (ids.size());
+
+	float timeout_ = timeout;
+	if (!ids.empty())
+		virtuaSMU->SystemConfig_Get (ids.size(), &ids[0], &values[0],
+									 &timeout_);
+
+	*ret_timeout = timeout_;
+	return std::vector<int> (values.begin(), values.end());
+}
+
+/************************************************************************/
+
+/*
+ * Outstanding pipelined requests, by handle. Each holds the future
+ * of whichever type its Driver method returns, and the device it was
+ * sent to, whose close_device() drops it.
+ */
+struct AsyncRequest
+{
+	int deviceID;
+	std::future<float> value;
+	std::future<int16_t> param;
+};
+
+static std::map<int, AsyncRequest> asyncRequests_;
+static int nextAsyncRequest_ = 1;
+static std::mutex asyncRequestsLock_;
+
+static int addRequest (int deviceID, std::future<float> value)
+{
+	std::lock_guard<std::mutex> lock (asyncRequestsLock_);
+
+	const int request = nextAsyncRequest_++;
+	asyncRequests_[request].deviceID = deviceID;
+	asyncRequests_[request].value = std::move (value);
+	return request;
+}
+
+static int addRequest (int deviceID, std::future<int16_t> param)
+{
+	std::lock_guard<std::mutex> lock (asyncRequestsLock_);
+
+	const int request = nextAsyncRequest_++;
+	asyncRequests_[request].deviceID = deviceID;
+	asyncRequests_[request].param = std::move (param);
+	return request;
+}
+
+static void dropRequests (int deviceID)
+{
+	std::lock_guard<std::mutex> lock (asyncRequestsLock_);
+
+	std::map<int, AsyncRequest>::iterator it = asyncRequests_.begin();
+
+	while (it != asyncRequests_.end()) {
+
+		if (it->second.deviceID == deviceID)
+			asyncRequests_.erase (it++);
+		else
+			++it;
+	}
+}
+
+int CS_setCurrentAsync (int deviceID, float current)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->CS_setCurrentAsync (current));
+}
+
+int VS_setVoltageAsync (int deviceID, float voltage)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->VS_setVoltageAsync (voltage));
+}
+
+int CM_readAsync (int deviceID, unsigned int filterLength)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->CM_readAsync (filterLength));
+}
+
+int VM_readAsync (int deviceID, unsigned int filterLength)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->VM_readAsync (filterLength));
+}
+
+int VM2_readAsync (int deviceID, unsigned int filterLength)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->VM2_readAsync (filterLength));
+}
+
+int RM_readAutoscaleAsync (int deviceID, unsigned int filterLength)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->RM_readAutoscaleAsync (filterLength));
+}
+
+int SystemConfig_GetAsync (int deviceID, unsigned int paramID)
+{
+	return addRequest (deviceID,
+		virtuaSMUs[deviceID]->SystemConfig_GetAsync (paramID));
+}
+
+int waitRequest (int request, float timeout,
+				double *ret_value, float *ret_timeout)
+{
+	using namespace std::chrono;
+
+	*ret_value = 0;
+	*ret_timeout = 0;
+
+	AsyncRequest taken;
+
+	{
+		std::lock_guard<std::mutex> lock (asyncRequestsLock_);
+
+		std::map<int, AsyncRequest>::iterator it =
+			asyncRequests_.find (request);
+
+		if (it == asyncRequests_.end())
+			return -1;
+
+		taken = std::move (it->second);
+		asyncRequests_.erase (it);
+	}
+
+	const steady_clock::time_point entry = steady_clock::now();
+	const duration<float> wait (timeout);
+
+	const bool ready = taken.value.valid() ?
+		(taken.value.wait_for (wait) == future_status::ready) :
+		(taken.param.wait_for (wait) == future_status::ready);
+
+	if (!ready) {
+
+		std::lock_guard<std::mutex> lock (asyncRequestsLock_);
+
+		/**** Unless its device closed meanwhile ****/
+		if (!virtuaSMUs[taken.deviceID])
+			return -1;
+
+		asyncRequests_[request] = std::move (taken);
+		return 0;
+	}
+
+	try {
+		*ret_value = taken.value.valid() ?
+			taken.value.get() : taken.param.get();
+	}
+	catch (...) {
+		return -1;
+	}
+
+	const float elapsed =
+		duration<float> (steady_clock::now() - entry).count();
+
+	*ret_timeout = (elapsed < timeout) ? (timeout - elapsed) : 0;
+	return 1;
+}
+
+int getPendingRequests (int deviceID)
+{
+	return virtuaSMUs[deviceID]->pendingRequests();
+}
+
+/************************************************************************/
+
+std::vector<double> executeBatch (int deviceID,
+				const std::vector<double>& commands,
+				float timeout, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	std::vector<smu::BatchCommand> batch (commands.size() / 2);
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+
+		batch[i].op = static_cast<smu::BatchOp> ((int) commands[2 * i]);
+		batch[i].argument = commands[2 * i + 1];
+	}
+
+	float timeout_ = timeout;
+	virtuaSMU->execute (&batch, &timeout_);
+
+	std::vector<double> pairs;
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+
+		pairs.push_back ((int) batch[i].status);
+		pairs.push_back (batch[i].result);
+	}
+
+	*ret_timeout = timeout_;
+	return pairs;
+}
+
+/************************************************************************/
+
+void SourceMeasure (int deviceID, unsigned int source, float value,
+				float settlingTime, unsigned int meter,
+				unsigned int filterLength, float timeout,
+				float *ret_value, float *ret_reading, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	float value_ = value;
+	float reading_ = 0;
+	float timeout_ = timeout;
+
+	virtuaSMU->SourceMeasure (smu::toSourceMode (source), &value_,
+		settlingTime, static_cast<smu::Meter> (meter), filterLength,
+		&reading_, &timeout_);
+
+	*ret_value = 0.0;
+	*ret_reading = 0.0;
+
+	if ((*ret_timeout = timeout_) == 0)
+		return;
+
+	*ret_value = value_;
+	*ret_reading = reading_;
+}
+
+/************************************************************************/
+
+std::vector<float> BurstRead (int deviceID, unsigned int meter,
+				unsigned int filterLength, unsigned int count,
+				float timeout, float *ret_timeout)
+{
+	VirtuaSMU *virtuaSMU = virtuaSMUs[deviceID];
+
+	std::vector<float> readings;
+	float timeout_ = timeout;
+
+	virtuaSMU->BurstRead (static_cast<smu::Meter> (meter), filterLength,
+		count, &readings, &timeout_);
+
+	*ret_timeout = timeout_;
+	return readings;
+}
+
 /************************************************************************/
 /************************************************************************/
@@ -45,6 +45,13 @@ const char *serialNo(int i);
  * \brief Opens a previously scanned device for communication,
  * and queries its identity.
  *
+ * \param serialNo
+ * 		Serial number as returned by \ref serialNo. A tty path such
+ * 		as "/dev/ttyUSB0" opens the device through the kernel
+ * 		ftdi_sio driver instead of libftdi. "sim:" opens a
+ * 		simulated SMU, optionally followed by its parameters,
+ * 		e.g. "sim:latency=0.001,jitter=0.0005,rate=1000".
+ *
  * \param timeout
  * 		Communication timeout in second.
  *
@@ -69,6 +76,8 @@ int open_device(const char *serialNo,
 /**
  * \brief Closes a previously opened device.
  *
+ * Spends the handles of its pipelined requests.
+ *
  * \param deviceID Device ID as returned by \ref open_device.
  */
 void close_device(int deviceID);
@@ -332,6 +341,427 @@ void recSize (int deviceID, float timeout,
 void recData (int deviceID, short unsigned int size, float timeout,
 				short unsigned int *ret_size, float *ret_timeout);
 
+/************************************************************************/
+/**
+ * \brief Enables USB transport auto-tuning of devices opened hereafter.
+ *
+ * When enabled, \ref open_device measures the command round-trip time
+ * for a few USB latency timer and read chunk size settings, and keeps
+ * the fastest. The result is cached per serial number, so re-opening
+ * the same device does not repeat the search.
+ */
+
+void autoTune (unsigned int enable);
+
+/************************************************************************/
+/**
+ * \brief Sets the USB transport parameters of an open device.
+ *
+ * \param latencyTimer USB latency timer in milliseconds (1 - 255).
+ * \param readChunkSize Size of USB read transfers in bytes.
+ * \param writeChunkSize Size of USB write transfers in bytes.
+ *
+ * \return Non-zero in ret_good if the parameters were applied.
+ */
+
+void setTransportParameters (int deviceID, unsigned int latencyTimer,
+				unsigned int readChunkSize, unsigned int writeChunkSize,
+				unsigned int *ret_good);
+
+void getTransportParameters (int deviceID, unsigned int *ret_latencyTimer,
+				unsigned int *ret_readChunkSize,
+				unsigned int *ret_writeChunkSize);
+
+/************************************************************************/
+/**
+ * \brief Negotiates the fastest reliable Baud Rate with the SMU.
+ *
+ * Steps through progressively faster rates up to baudRate, confirming
+ * each with a few identify exchanges, and falls back to the last rate
+ * that worked.
+ *
+ * \return Baud Rate in use after negotiation.
+ */
+
+void negotiateBaudRate (int deviceID, unsigned int baudRate, float timeout,
+				unsigned int *ret_baudRate, float *ret_timeout);
+
+/**
+ * \brief Sets the sample rate expected while streaming.
+ *
+ * \ref StartRec raises the Baud Rate as far as needed to carry this rate,
+ * and \ref StopRec restores the previous one.
+ */
+
+void setStreamSampleRate (int deviceID, float sampleRate);
+
+/************************************************************************/
+/**
+ * \brief Returns the next device arrival or removal, if any.
+ *
+ * Devices are tracked in the background from USB hotplug notifications,
+ * which also keeps \ref scan from having to walk the bus. The first call
+ * starts the tracking; events from before it are not reported.
+ *
+ * \return 0 if no event is pending, 1 if a device arrived and
+ * 2 if a device left. \ref deviceEventSerialNo then returns its
+ * serial number.
+ */
+
+int pollDeviceEvent (void);
+
+/**
+ * \brief Serial number of the device reported by the last call
+ * to \ref pollDeviceEvent.
+ *
+ * The returned pointer remains valid till the next call to
+ * \ref pollDeviceEvent.
+ */
+
+const char *deviceEventSerialNo (void);
+
+/************************************************************************/
+/**
+ * \brief Sets how requests are gathered into USB transfers.
+ *
+ * Requests queued while a transfer is in progress always go out
+ * together in the next one. Besides, a request may be held back up to
+ * maxDelay seconds for others to join it, unless maxBytes are already
+ * pending or a response is awaited.
+ */
+
+void setTransmitPolicy (int deviceID, float maxDelay, unsigned int maxBytes);
+
+void getTransmitPolicy (int deviceID, float *ret_maxDelay,
+				unsigned int *ret_maxBytes);
+
+/************************************************************************/
+/**
+ * \brief Sets the capacity, in samples, of the buffer that holds streamed
+ * data until getData(), and what becomes of samples that overflow it.
+ *
+ * overflow is 0 to leave them with the SMU till there is room, 1 to drop
+ * the oldest samples, or 2 to spill them to a temporary file. Buffered
+ * samples are discarded, so call it while not recording.
+ */
+
+void setStreamBuffer (int deviceID, unsigned int capacity, int overflow);
+
+void getStreamStatistics (int deviceID,
+				unsigned long long *ret_dropped,
+				unsigned long long *ret_spilled,
+				unsigned int *ret_highWater);
+
+/************************************************************************/
+/**
+ * \brief Sets how much the library logs.
+ *
+ * category is 0 for FTDI, 1 for QP4, 2 for Comm, 3 for Driver, 4 for
+ * stream, or -1 for all of them. level is 0 for none, 1 for errors,
+ * 2 for warnings, the default, 3 for info and 4 for debug. The XSMU_LOG
+ * environment variable, e.g. "info,stream=debug", sets them at startup.
+ */
+
+void setLogLevel (int category, int level);
+
+/**
+ * \brief Appends the log to path, or writes it to stderr if path is
+ * empty. Returns 0 if the file cannot be opened.
+ */
+
+int setLogFile (const char *path);
+
+/************************************************************************/
+/**
+ * \brief Sets how the stream is polled while recording.
+ *
+ * Polls are timed from the rate the SMU's queue is seen to fill at,
+ * so that samples wait no longer than targetLatency seconds and the
+ * queue, of capacity samples, stays below the targetFill fraction;
+ * but never closer than minInterval, nor further apart than
+ * maxInterval seconds.
+ */
+
+void setStreamPollPolicy (int deviceID, float minInterval,
+				float maxInterval, float targetLatency,
+				float targetFill, unsigned int capacity);
+
+/**
+ * \brief Samples per second the SMU's queue is seen to fill at.
+ */
+
+float getStreamFillRate (int deviceID);
+
+/************************************************************************/
+/**
+ * \brief Sets how many recData requests are kept in flight while
+ * recording. Zero picks it from the round-trip time and baud rate.
+ */
+
+void setStreamPipelineDepth (int deviceID, unsigned int depth);
+
+/**
+ * \brief Pipeline depth in use, or zero if picked automatically.
+ */
+
+unsigned int getStreamPipelineDepth (int deviceID);
+
+/************************************************************************/
+/**
+ * \brief Starts recording, with the SMU pushing streamed data.
+ *
+ * Instead of being polled, the SMU sends chunkSize samples at a time as
+ * they become ready, which leaves the link free for other commands. A
+ * chunkSize of 0 lets the driver pick one from the sample rate. Stop
+ * with \ref StopRec as usual.
+ *
+ * \return Samples per frame the SMU settled on, or 0 if the firmware
+ * cannot push and recording fell back to polling.
+ */
+
+void StartRecPush (int deviceID, unsigned short chunkSize, float timeout,
+				unsigned short *ret_chunkSize, float *ret_timeout);
+
+/**
+ * \brief Frames of pushed data found missing since recording started.
+ */
+
+unsigned long long getStreamFramesLost (int deviceID);
+
+/************************************************************************/
+/**
+ * \brief Caps the worker threads shared by all open devices.
+ *
+ * Devices are served by one event loop, whose due tasks such as
+ * keep-alive and stream polls run on a small pool of workers. The pool
+ * grows on demand up to this many, 4 by default. Raise it when serving
+ * many devices that stream at once.
+ */
+
+void setIoEngineWorkers (unsigned int n);
+
+/**
+ * \brief Workers started so far by the shared event loop.
+ */
+
+unsigned int getIoEngineWorkers (void);
+
+/**
+ * \brief Times the shared event loop has woken up, to tell an idle
+ * driver from a busy one.
+ */
+
+unsigned long long getIoEngineWakeups (void);
+
+/************************************************************************/
+/**
+ * \brief Gets streamed data with the time each sample was taken.
+ *
+ * \return Times and values interleaved: t0, v0, t1, v1, ... Times are in
+ * seconds on the monotonic clock of \ref getMonotonicTime, estimated
+ * from when chunks of the stream arrived.
+ *
+ * The driver fits the SMU's sample rate and its offset from the host's
+ * clock as the stream comes in, following drift between the two, so
+ * that timestamps cost no extra requests. Samples dropped by the stream
+ * buffer leave gaps in the times.
+ */
+
+std::vector<double> getDataTimed (int deviceID);
+
+/**
+ * \brief Gets streamed data resampled to a uniform grid of times.
+ *
+ * Values are interpolated at multiples of interval seconds, and
+ * ret_start is the time of the first. Successive calls continue the
+ * grid, unless interval changes.
+ */
+
+std::vector<float> getResampledData (int deviceID, double interval,
+				double *ret_start);
+
+/**
+ * \brief Samples per second the SMU takes, as timed by the host's clock.
+ */
+
+double getStreamClockRate (int deviceID);
+
+/**
+ * \brief Sets how many seconds the stream clock takes to forget older
+ * chunks, 60 by default. Shorter tracks drift faster, but with more
+ * jitter.
+ */
+
+void setStreamClockTimeConstant (int deviceID, double seconds);
+
+/**
+ * \brief Seconds on the host's monotonic clock, which stream timestamps
+ * are on.
+ */
+
+double getMonotonicTime (void);
+
+/************************************************************************/
+/**
+ * \brief Gets streamed data with the time and the VM range of each
+ * sample.
+ *
+ * \return Times, values and ranges interleaved: t0, v0, r0, t1, v1,
+ * r1, ... Values are converted to volts by the range's calibration
+ * table, once the driver holds all of it from \ref VM_getCalibration or
+ * \ref VM_setCalibration, and are ADC codes till then.
+ */
+
+std::vector<double> getDataTagged (int deviceID);
+
+/**
+ * \brief Whether streamed samples taken on a VM range come out in volts.
+ */
+
+int getStreamCalibrated (int deviceID, int range);
+
+/************************************************************************/
+/**
+ * \brief Enables the on-disk calibration cache for devices opened
+ * hereafter. Enabled by default.
+ *
+ * Calibration tables and the hardware version, once read, are kept in
+ * a file per serial number, under $XSMU_CACHE_DIR, or else
+ * ~/.cache/xsmu. \ref open_device checks the file against the SMU's
+ * \ref CalibrationChecksum, and if it matches, *_getCalibration and
+ * \ref SystemConfig_Get_hardwareVersion answer from it, for ranges set
+ * since, without asking the SMU. Setting, saving or loading default
+ * calibration drops the affected range from the cache.
+ */
+
+void calibrationCache (unsigned int enable);
+
+/**
+ * \brief Whether \ref open_device found the calibration cache good.
+ */
+
+int getCalibrationCacheLoaded (int deviceID);
+
+/**
+ * \brief Gets a checksum over the SMU's calibration tables, of every
+ * meter and range, and its system configuration. Returns a zero
+ * timeout with firmware that cannot.
+ */
+
+void CalibrationChecksum (int deviceID, float timeout,
+				unsigned int *ret_checksum, float *ret_timeout);
+
+/************************************************************************/
+/**
+ * \brief Gets all of a meter's calibration tables, of every range, in
+ * one round trip.
+ *
+ * meter is 0 for CS, 1 for VS, 2 for CM, 3 for VM and 4 for VM2. Returns
+ * (range, index, code, value) quadruples, flattened, range by range.
+ * Returns none, and a zero timeout, with firmware that cannot.
+ */
+
+std::vector<double> getCalibrationTables (int deviceID, int meter,
+				float timeout, float *ret_timeout);
+
+/**
+ * \brief Gets several system configuration parameters in as few round
+ * trips as the firmware's request size allows, twelve a time, or one
+ * at a time with firmware that reads no more.
+ *
+ * Returns the values in the order of paramIDs.
+ */
+
+std::vector<int> SystemConfig_GetList (int deviceID,
+				const std::vector<int>& paramIDs,
+				float timeout, float *ret_timeout);
+
+/************************************************************************/
+/**
+ * \brief Pipelined requests. Each sends its request and returns at once
+ * with a request handle, so that many may be outstanding on a device.
+ * \ref waitRequest collects the response.
+ *
+ * CS_setCurrentAsync and VS_setVoltageAsync answer the value applied,
+ * the reads the value read, and SystemConfig_GetAsync the parameter.
+ */
+
+int CS_setCurrentAsync (int deviceID, float current);
+int VS_setVoltageAsync (int deviceID, float voltage);
+int CM_readAsync (int deviceID, unsigned int filterLength);
+int VM_readAsync (int deviceID, unsigned int filterLength);
+int VM2_readAsync (int deviceID, unsigned int filterLength);
+int RM_readAutoscaleAsync (int deviceID, unsigned int filterLength);
+int SystemConfig_GetAsync (int deviceID, unsigned int paramID);
+
+/**
+ * \brief Waits up to timeout for a pipelined request's response.
+ *
+ * Returns 1 with the value once answered, 0 if still outstanding, when
+ * it may be waited for again, and -1 if the SMU rejected the request or
+ * its response was lost. The handle is spent unless 0 is returned.
+ */
+
+int waitRequest (int request, float timeout,
+				double *ret_value, float *ret_timeout);
+
+/**
+ * \brief Number of pipelined requests awaiting their response.
+ */
+
+int getPendingRequests (int deviceID);
+
+/************************************************************************/
+/**
+ * \brief Runs several commands in one call and about one round trip.
+ *
+ * commands holds (op, argument) pairs, flattened, run in order. op is
+ * 0 setSourceMode, 1 CS_setRange, 2 CS_setCurrent, 3 VS_setRange,
+ * 4 VS_setVoltage, 5 CM_setRange, 6 CM_read, 7 VM_setRange, 8 VM_read,
+ * 9 VM2_read, 10 RM_readAutoscale or 11 VM_setTerminal. argument is
+ * the value, range, mode or terminal to set, or the filter length of
+ * a read.
+ *
+ * Returns a (status, result) pair per command, flattened, where status
+ * is 0 done, 1 timed out, 2 rejected by the firmware, 3 lost or
+ * 4 unknown op, and result is what the SMU applied or read.
+ */
+
+std::vector<double> executeBatch (int deviceID,
+				const std::vector<double>& commands,
+				float timeout, float *ret_timeout);
+
+/************************************************************************/
+/**
+ * \brief Sources and measures in one round trip.
+ *
+ * Sets the current source (source 0) or the voltage source (source 1)
+ * to value, waits settlingTime seconds, then reads CM (meter 0), VM
+ * (meter 1) or VM2 (meter 2) over filterLength conversions, all on the
+ * SMU. Returns the value applied and the reading. timeout must allow
+ * for the settling and the read.
+ */
+
+void SourceMeasure (int deviceID, unsigned int source, float value,
+				float settlingTime, unsigned int meter,
+				unsigned int filterLength, float timeout,
+				float *ret_value, float *ret_reading, float *ret_timeout);
+
+/************************************************************************/
+/**
+ * \brief Takes count consecutive readings of a meter in one request.
+ *
+ * meter is 0 for CM, 1 for VM and 2 for VM2, read on its present range
+ * and terminal, over filterLength conversions each. Returns the
+ * readings in the order taken, or none on timeout. timeout must allow
+ * for all of them. Firmware that cannot read the meter returns none,
+ * with a zero timeout.
+ */
+
+std::vector<float> BurstRead (int deviceID, unsigned int meter,
+				unsigned int filterLength, unsigned int count,
+				float timeout, float *ret_timeout);
+
 /************************************************************************/
 /************************************************************************/
 #ifdef __cplusplus
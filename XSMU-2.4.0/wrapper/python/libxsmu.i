@@ -9,6 +9,8 @@
 namespace std
 {
   %template(FloatVector) vector<float>;
+  %template(DoubleVector) vector<double>;
+  %template(IntVector) vector<int>;
 }
 
 %{
@@ -235,6 +237,152 @@ extern void recData (int deviceID, short unsigned int size, float timeout,
 
 /**************************************************************/
 
+extern void autoTune (unsigned int enable);
+
+extern void setTransportParameters (int deviceID, unsigned int latencyTimer,
+						unsigned int readChunkSize, unsigned int writeChunkSize,
+						unsigned int *ret_good);
+
+extern void getTransportParameters (int deviceID,
+						unsigned int *ret_latencyTimer,
+						unsigned int *ret_readChunkSize,
+						unsigned int *ret_writeChunkSize);
+
+/**************************************************************/
+
+extern void negotiateBaudRate (int deviceID, unsigned int baudRate,
+						float timeout, unsigned int *ret_baudRate,
+						float *ret_timeout);
+
+extern void setStreamSampleRate (int deviceID, float sampleRate);
+
+/**************************************************************/
+
+extern int pollDeviceEvent (void);
+
+extern const char *deviceEventSerialNo (void);
+
+/**************************************************************/
+
+extern void setTransmitPolicy (int deviceID, float maxDelay,
+							   unsigned int maxBytes);
+
+extern void getTransmitPolicy (int deviceID, float *ret_maxDelay,
+							   unsigned int *ret_maxBytes);
+
+/**************************************************************/
+
+extern void setStreamBuffer (int deviceID, unsigned int capacity,
+							 int overflow);
+
+extern void getStreamStatistics (int deviceID,
+								 unsigned long long *ret_dropped,
+								 unsigned long long *ret_spilled,
+								 unsigned int *ret_highWater);
+
+/**************************************************************/
+
+extern void setLogLevel (int category, int level);
+
+extern int setLogFile (const char *path);
+
+/**************************************************************/
+
+extern void setStreamPollPolicy (int deviceID, float minInterval,
+								 float maxInterval, float targetLatency,
+								 float targetFill, unsigned int capacity);
+
+extern float getStreamFillRate (int deviceID);
+
+/**************************************************************/
+
+extern void setStreamPipelineDepth (int deviceID, unsigned int depth);
+extern unsigned int getStreamPipelineDepth (int deviceID);
+
+/**************************************************************/
+
+extern void StartRecPush (int deviceID, unsigned short chunkSize,
+						  float timeout, unsigned short *ret_chunkSize,
+						  float *ret_timeout);
+
+extern unsigned long long getStreamFramesLost (int deviceID);
+
+/**************************************************************/
+
+extern void setIoEngineWorkers (unsigned int n);
+extern unsigned int getIoEngineWorkers (void);
+extern unsigned long long getIoEngineWakeups (void);
+
+/**************************************************************/
+
+extern std::vector<double> getDataTimed (int deviceID);
+
+extern std::vector<float> getResampledData (int deviceID, double interval,
+						double *ret_start);
+
+extern double getStreamClockRate (int deviceID);
+extern void setStreamClockTimeConstant (int deviceID, double seconds);
+extern double getMonotonicTime (void);
+
+/**************************************************************/
+
+extern std::vector<double> getDataTagged (int deviceID);
+extern int getStreamCalibrated (int deviceID, int range);
+
+/**************************************************************/
+
+extern void calibrationCache (unsigned int enable);
+extern int getCalibrationCacheLoaded (int deviceID);
+extern void CalibrationChecksum (int deviceID, float timeout,
+								 unsigned int *ret_checksum,
+								 float *ret_timeout);
+
+/**************************************************************/
+
+extern std::vector<double> getCalibrationTables (int deviceID, int meter,
+												 float timeout,
+												 float *ret_timeout);
+extern std::vector<int> SystemConfig_GetList (int deviceID,
+											  const std::vector<int>& paramIDs,
+											  float timeout,
+											  float *ret_timeout);
+
+/**************************************************************/
+
+extern int CS_setCurrentAsync (int deviceID, float current);
+extern int VS_setVoltageAsync (int deviceID, float voltage);
+extern int CM_readAsync (int deviceID, unsigned int filterLength);
+extern int VM_readAsync (int deviceID, unsigned int filterLength);
+extern int VM2_readAsync (int deviceID, unsigned int filterLength);
+extern int RM_readAutoscaleAsync (int deviceID, unsigned int filterLength);
+extern int SystemConfig_GetAsync (int deviceID, unsigned int paramID);
+extern int waitRequest (int request, float timeout,
+						double *ret_value, float *ret_timeout);
+extern int getPendingRequests (int deviceID);
+
+/**************************************************************/
+
+extern std::vector<double> executeBatch (int deviceID,
+										 const std::vector<double>& commands,
+										 float timeout, float *ret_timeout);
+
+/**************************************************************/
+
+extern void SourceMeasure (int deviceID, unsigned int source, float value,
+						   float settlingTime, unsigned int meter,
+						   unsigned int filterLength, float timeout,
+						   float *ret_value, float *ret_reading,
+						   float *ret_timeout);
+
+/**************************************************************/
+
+extern std::vector<float> BurstRead (int deviceID, unsigned int meter,
+									 unsigned int filterLength,
+									 unsigned int count, float timeout,
+									 float *ret_timeout);
+
+/**************************************************************/
+
 %}
 
 /**************************************************************/
@@ -430,5 +578,145 @@ extern void recSize (int deviceID, float timeout,
 extern void recData (int deviceID, short unsigned int size, float timeout,
 							short unsigned int *OUTPUT, float *OUTPUT);
 
+/**************************************************************/
+
+extern void autoTune (unsigned int enable);
+
+extern void setTransportParameters (int deviceID, unsigned int latencyTimer,
+						unsigned int readChunkSize, unsigned int writeChunkSize,
+						unsigned int *OUTPUT);
+
+extern void getTransportParameters (int deviceID, unsigned int *OUTPUT,
+						unsigned int *OUTPUT, unsigned int *OUTPUT);
+
+/**************************************************************/
+
+extern void negotiateBaudRate (int deviceID, unsigned int baudRate,
+						float timeout, unsigned int *OUTPUT, float *OUTPUT);
+
+extern void setStreamSampleRate (int deviceID, float sampleRate);
+
+/**************************************************************/
+
+extern int pollDeviceEvent (void);
+
+extern const char *deviceEventSerialNo (void);
+
+/**************************************************************/
+
+extern void setTransmitPolicy (int deviceID, float maxDelay,
+							   unsigned int maxBytes);
+
+extern void getTransmitPolicy (int deviceID, float *OUTPUT,
+							   unsigned int *OUTPUT);
+
+/**************************************************************/
+
+extern void setStreamBuffer (int deviceID, unsigned int capacity,
+							 int overflow);
+
+extern void getStreamStatistics (int deviceID,
+								 unsigned long long *OUTPUT,
+								 unsigned long long *OUTPUT,
+								 unsigned int *OUTPUT);
+
+/**************************************************************/
+
+extern void setLogLevel (int category, int level);
+
+extern int setLogFile (const char *path);
+
+/**************************************************************/
+
+extern void setStreamPollPolicy (int deviceID, float minInterval,
+								 float maxInterval, float targetLatency,
+								 float targetFill, unsigned int capacity);
+
+extern float getStreamFillRate (int deviceID);
+
+/**************************************************************/
+
+extern void setStreamPipelineDepth (int deviceID, unsigned int depth);
+extern unsigned int getStreamPipelineDepth (int deviceID);
+
+/**************************************************************/
+
+extern void StartRecPush (int deviceID, unsigned short chunkSize,
+						  float timeout, unsigned short *OUTPUT,
+						  float *OUTPUT);
+
+extern unsigned long long getStreamFramesLost (int deviceID);
+
+/**************************************************************/
+
+extern void setIoEngineWorkers (unsigned int n);
+extern unsigned int getIoEngineWorkers (void);
+extern unsigned long long getIoEngineWakeups (void);
+
+/**************************************************************/
+
+extern std::vector<double> getDataTimed (int deviceID);
+
+extern std::vector<float> getResampledData (int deviceID, double interval,
+						double *OUTPUT);
+
+extern double getStreamClockRate (int deviceID);
+extern void setStreamClockTimeConstant (int deviceID, double seconds);
+extern double getMonotonicTime (void);
+
+/**************************************************************/
+
+extern std::vector<double> getDataTagged (int deviceID);
+extern int getStreamCalibrated (int deviceID, int range);
+
+/**************************************************************/
+
+extern void calibrationCache (unsigned int enable);
+extern int getCalibrationCacheLoaded (int deviceID);
+extern void CalibrationChecksum (int deviceID, float timeout,
+								 unsigned int *OUTPUT, float *OUTPUT);
+
+/**************************************************************/
+
+extern std::vector<double> getCalibrationTables (int deviceID, int meter,
+												 float timeout,
+												 float *OUTPUT);
+extern std::vector<int> SystemConfig_GetList (int deviceID,
+											  const std::vector<int>& paramIDs,
+											  float timeout, float *OUTPUT);
+
+/**************************************************************/
+
+extern int CS_setCurrentAsync (int deviceID, float current);
+extern int VS_setVoltageAsync (int deviceID, float voltage);
+extern int CM_readAsync (int deviceID, unsigned int filterLength);
+extern int VM_readAsync (int deviceID, unsigned int filterLength);
+extern int VM2_readAsync (int deviceID, unsigned int filterLength);
+extern int RM_readAutoscaleAsync (int deviceID, unsigned int filterLength);
+extern int SystemConfig_GetAsync (int deviceID, unsigned int paramID);
+extern int waitRequest (int request, float timeout,
+						double *OUTPUT, float *OUTPUT);
+extern int getPendingRequests (int deviceID);
+
+/**************************************************************/
+
+extern std::vector<double> executeBatch (int deviceID,
+										 const std::vector<double>& commands,
+										 float timeout, float *OUTPUT);
+
+/**************************************************************/
+
+extern void SourceMeasure (int deviceID, unsigned int source, float value,
+						   float settlingTime, unsigned int meter,
+						   unsigned int filterLength, float timeout,
+						   float *OUTPUT, float *OUTPUT, float *OUTPUT);
+
+/**************************************************************/
+
+extern std::vector<float> BurstRead (int deviceID, unsigned int meter,
+									 unsigned int filterLength,
+									 unsigned int count, float timeout,
+									 float *OUTPUT);
+
 /**************************************************************/
 /**************************************************************/
\ No newline at end of file
@@ -8,8 +8,9 @@ from distutils.core import setup, Extension
 
 libxsmu_module = Extension('_libxsmu',
     sources=['libxsmu_wrap.cxx', 'libxsmu.cxx'],
+    include_dirs=['/usr/include/libftdi1', '/usr/include/libusb-1.0'],
     library_dirs=['../../code/app/src'],
-    libraries=['smu', 'ftdi'],
+    libraries=['smu', 'ftdi1', 'usb-1.0'],
     extra_compile_args=['-std=c++11'],
     extra_link_args=['-std=c++11']
 )
@@ -0,0 +1,60 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+##########################################################################
+# Takes 1000 readings of VM in one request, for noise statistics
+
+VM = 1
+
+filterLength = 1
+count        = 1000
+
+timeout = 10.0
+readings, timeout = libxsmu.BurstRead (deviceID, VM, filterLength, count,
+									   timeout)
+
+if (timeout == 0.0):
+	print 'Communication timeout in BurstRead.'
+	exit (-2)
+
+mean = sum (readings) / len (readings)
+rms  = math.sqrt (sum ((x - mean) ** 2 for x in readings) / len (readings))
+
+print \
+	"Readings      :", len (readings), "\n" \
+	"Mean          :", mean, "V", "\n" \
+	"RMS noise     :", rms, "V", "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+##########################################################################
+# closes the device.
+
+libxsmu.close_device(deviceID)
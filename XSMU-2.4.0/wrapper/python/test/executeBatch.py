@@ -0,0 +1,68 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+##########################################################################
+# Sources 1 mA and reads the voltage, in one batch
+
+SET_SOURCE_MODE = 0
+CS_SET_RANGE    = 1
+CS_SET_CURRENT  = 2
+VM_SET_RANGE    = 7
+VM_READ         = 8
+
+commands = [
+	SET_SOURCE_MODE, 0,    # Current source
+	CS_SET_RANGE,    2,    # 1 mA
+	CS_SET_CURRENT,  1e-3,
+	VM_SET_RANGE,    4,    # 10 V
+	VM_READ,         8]    # Filter length
+
+timeout = 1.0
+results, timeout = libxsmu.executeBatch (deviceID, commands, timeout)
+
+print "Remaining time:", timeout, "sec"
+
+if (timeout == 0.0):
+	print 'Communication timeout in executeBatch.'
+	exit (-2)
+
+for i in range (0, len (results), 2):
+	print \
+		"Command:", int (commands[i]), \
+		"Status:", int (results[i]), \
+		"Result:", results[i + 1]
+
+print
+
+##########################################################################
+# closes the device.
+
+libxsmu.close_device(deviceID)
@@ -0,0 +1,70 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+##########################################################################
+# Gets VM calibration tables of all ranges in one round trip
+
+timeout = 1.0
+quadruples, timeout = libxsmu.getCalibrationTables (deviceID, 3, timeout)
+
+print "Remaining time:", timeout, "sec"
+
+if (timeout == 0.0):
+	print 'Communication timeout in getCalibrationTables.'
+	exit (-2)
+
+for i in range (0, len (quadruples), 4):
+	print \
+		"Range:", int (quadruples[i]), \
+		"Index:", int (quadruples[i + 1]), \
+		"ADC:", int (quadruples[i + 2]), \
+		"Voltage:", quadruples[i + 3]
+
+print
+
+##########################################################################
+# Gets the hardware version parameters in one round trip
+
+timeout = 1.0
+values, timeout = libxsmu.SystemConfig_GetList (deviceID, [0, 1, 2], timeout)
+
+print \
+	"Parameters    :", list (values), "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0):
+	print 'Communication timeout in SystemConfig_GetList.'
+	exit (-2)
+
+##########################################################################
+# closes the device.
+
+libxsmu.close_device(deviceID)
@@ -48,17 +48,18 @@ print \
 logfile = open ('log.txt', 'w')
 
 t0 = time.time()
-_time_ = 0
+start = None
 while (time.time() - t0 < 60*60):
 	print "Remaining time: ", 60 - (time.time() - t0) / 60.0, " minutes" 
-	timeout = 5.0
-	recSize, timeout = libxsmu.recSize (deviceID, timeout)
-	data = libxsmu.getData (deviceID)
-	for voltage in data:
+	print "Sample rate   : ", libxsmu.getStreamClockRate (deviceID), " Hz"
+	data = libxsmu.getDataTimed (deviceID)
+	for i in range (0, len (data), 2):
+		if start is None:
+			start = data[i]
+		_time_, voltage = data[i] - start, data[i + 1]
 		logfile.write (str (_time_) + ", " + str (voltage) + '\n')
 		print _time_, ',\t', voltage * 1e9, ' ADC'
-		logfile.flush()
-		_time_ = _time_ + 0.1
+	logfile.flush()
 	time.sleep (10)
 
 timeout = 5
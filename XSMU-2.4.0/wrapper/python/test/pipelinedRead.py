@@ -0,0 +1,64 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+##########################################################################
+# Keeps many voltage reads outstanding at once, then collects them
+
+filterLength = 8
+requests = [libxsmu.VM_readAsync (deviceID, filterLength)
+			for i in range (0, 20)]
+
+print "Outstanding   :", libxsmu.getPendingRequests (deviceID)
+
+for request in requests:
+
+	timeout = 1.0
+	status, voltage, timeout = libxsmu.waitRequest (request, timeout)
+
+	if (status == 0):
+		print 'Communication timeout in waitRequest.'
+		exit (-2)
+
+	if (status < 0):
+		print 'Request', request, 'was rejected or lost.'
+		continue
+
+	print \
+		"Request:", request, \
+		"Voltage:", voltage, "V", \
+		"Remaining time:", timeout, "sec"
+
+print
+
+##########################################################################
+# closes the device.
+
+libxsmu.close_device(deviceID)
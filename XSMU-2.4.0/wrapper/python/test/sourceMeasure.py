@@ -0,0 +1,63 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+##########################################################################
+# Sweeps the current source, reading VM at each point in one round trip
+
+CURRENT_SOURCE = 0
+VM             = 1
+
+settlingTime = 0.01
+filterLength = 8
+
+for i in range (0, 11):
+
+	current = i * 1e-4
+
+	timeout = 1.0
+	current, voltage, timeout = libxsmu.SourceMeasure (deviceID,
+		CURRENT_SOURCE, current, settlingTime, VM, filterLength, timeout)
+
+	if (timeout == 0.0):
+		print 'Communication timeout in SourceMeasure.'
+		exit (-2)
+
+	print \
+		"Current:", current, "A", \
+		"Voltage:", voltage, "V", \
+		"Remaining time:", timeout, "sec"
+
+print
+
+##########################################################################
+# closes the device.
+
+libxsmu.close_device(deviceID)
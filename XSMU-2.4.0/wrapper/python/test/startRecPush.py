@@ -0,0 +1,65 @@
+import libxsmu, time, math, sys
+from time import sleep
+
+##########################################################################
+# Scans USB bus for Xplore SMU.
+
+N = libxsmu.scan()
+print "Total device:", N
+
+if N == 0:
+	print 'No Xplore SMU device found.'
+	exit (-1)
+
+##########################################################################
+# Queries serial number of the first device.
+# This should be sufficient if only a single device is present.
+
+serialNo = libxsmu.serialNo(0)
+print "Seial number:", serialNo
+
+timeout = 1.0
+deviceID, goodID, timeout = libxsmu.open_device (serialNo, timeout)
+print \
+	"Device ID     :", deviceID, "\n" \
+	"goodID        :", goodID, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0) or (not goodID):
+	print 'Communication timeout in open_device.'
+	exit (-2)
+
+sleep (5)
+##########################################################################
+# Start recording, with the SMU pushing streamed data
+
+timeout = 5.0
+chunkSize = 0
+print \
+	"Starting Recording Pushed Data"
+chunkSize, timeout = libxsmu.StartRecPush (deviceID, chunkSize, timeout)
+print \
+	"Chunk size    :", chunkSize, "\n" \
+	"Remaining time:", timeout, "sec", "\n"
+
+if (timeout == 0.0):
+	print 'Communication timeout in StartRecPush'
+	exit (-2)
+
+sleep(20)
+
+data = libxsmu.getData (deviceID)
+print \
+	"Samples       :", len (data), "\n" \
+	"Frames lost   :", libxsmu.getStreamFramesLost (deviceID)
+
+timeout = 5.0
+timeout = libxsmu.StopRec (deviceID, timeout)
+print \
+	"Stopped Recording Streamed Data"
+
+##########################################################################
+# closes the device.
+
+sleep(5)
+libxsmu.close_device(deviceID)